@@ -0,0 +1,374 @@
+/*****************************************************************************************
+ File: BatchResult.cpp
+ Desc: Mergeable results of batches of headless games
+*****************************************************************************************/
+
+#include "include/BatchResult.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+/*
+======================================
+Init, an empty sketch
+======================================
+*/
+Sketch::Sketch() : mCount(0), mSum(0), mMin(~0ull), mMax(0)
+{
+  mBuckets.assign(SKETCH_BUCKETS, 0);
+}
+
+/*
+======================================
+Bucket of a value: the value itself while it is small, else its power of
+two and the SKETCH_SUB_BITS bits that follow the leading one
+======================================
+*/
+int Sketch::GetBucket(unsigned long long pValue)
+{
+  if (pValue < (1ull << SKETCH_SUB_BITS))
+    return (int)pValue;
+
+  int mExponent = 63 - __builtin_clzll(pValue);
+  int mShift = mExponent - SKETCH_SUB_BITS;
+  return ((mShift + 1) << SKETCH_SUB_BITS) +
+         (int)((pValue >> mShift) - (1ull << SKETCH_SUB_BITS));
+}
+
+unsigned long long Sketch::GetBucketLow(int pBucket)
+{
+  if (pBucket < (1 << SKETCH_SUB_BITS))
+    return pBucket;
+
+  int mShift = (pBucket >> SKETCH_SUB_BITS) - 1;
+  unsigned long long mMantissa =
+      (pBucket & ((1 << SKETCH_SUB_BITS) - 1)) + (1ull << SKETCH_SUB_BITS);
+  return mMantissa << mShift;
+}
+
+void Sketch::Add(unsigned long long pValue)
+{
+  mCount++;
+  mSum += pValue;
+  mMin = std::min(mMin, pValue);
+  mMax = std::max(mMax, pValue);
+  mBuckets[GetBucket(pValue)]++;
+}
+
+void Sketch::Merge(const Sketch &pOther)
+{
+  mCount += pOther.mCount;
+  mSum += pOther.mSum;
+  mMin = std::min(mMin, pOther.mMin);
+  mMax = std::max(mMax, pOther.mMax);
+  for (int i = 0; i < SKETCH_BUCKETS; i++)
+    mBuckets[i] += pOther.mBuckets[i];
+}
+
+/*
+======================================
+Value at a quantile, exact for small values and within the bucket width
+for the rest
+
+Parameters:
+>> pQuantile: 0 for the smallest value, 1 for the largest
+
+returns 0 for an empty sketch
+======================================
+*/
+unsigned long long Sketch::GetQuantile(double pQuantile) const
+{
+  if (mCount == 0)
+    return 0;
+
+  unsigned long long mRank = (unsigned long long)(pQuantile * mCount + 0.5);
+  mRank = std::max(1ull, std::min(mCount, mRank));
+
+  unsigned long long mSeen = 0;
+  for (int i = 0; i < SKETCH_BUCKETS; i++)
+  {
+    mSeen += mBuckets[i];
+    if (mSeen < mRank)
+      continue;
+
+    // Middle of the bucket, kept within the values seen
+    unsigned long long mLow = GetBucketLow(i);
+    unsigned long long mHigh =
+        i + 1 < SKETCH_BUCKETS ? GetBucketLow(i + 1) - 1 : ~0ull;
+    unsigned long long mValue = mLow + (mHigh - mLow) / 2;
+    return std::max(mMin, std::min(mMax, mValue));
+  }
+  return mMax;
+}
+
+/*
+======================================
+Init, no seeds and no games
+======================================
+*/
+BatchResult::BatchResult()
+    : mPieceSet(0), mSequence(0), mMaxPieces(0), mGames(0), mCapped(0)
+{
+  memset(mClears, 0, sizeof(mClears));
+}
+
+/*
+======================================
+Add seeds [pFirst, pLast) to the seeds covered, joining the ranges that
+touch so every split of a range ends up with the same list
+======================================
+*/
+void BatchResult::AddSeeds(unsigned long long pFirst, unsigned long long pLast)
+{
+  if (pFirst >= pLast)
+    return;
+
+  SeedRange mRange = {pFirst, pLast};
+  mSeeds.push_back(mRange);
+  std::sort(mSeeds.begin(), mSeeds.end(),
+            [](const SeedRange &a, const SeedRange &b) {
+              return a.mFirst < b.mFirst;
+            });
+
+  std::vector<SeedRange> mJoined;
+  for (size_t i = 0; i < mSeeds.size(); i++)
+  {
+    if (!mJoined.empty() && mJoined.back().mLast >= mSeeds[i].mFirst)
+      mJoined.back().mLast = std::max(mJoined.back().mLast, mSeeds[i].mLast);
+    else
+      mJoined.push_back(mSeeds[i]);
+  }
+  mSeeds.swap(mJoined);
+}
+
+/*
+======================================
+Count one game
+
+Parameters:
+>> pScore, pLines, pPieces: end of the game
+>> pCapped: the game was stopped at mMaxPieces
+>> pClears: line clears of the game by size, BATCH_CLEAR_SIZES
+======================================
+*/
+void BatchResult::AddGame(unsigned long long pScore, unsigned long long pLines,
+                          unsigned long long pPieces, bool pCapped,
+                          const unsigned long long *pClears)
+{
+  mGames++;
+  mCapped += pCapped;
+  for (int i = 0; i < BATCH_CLEAR_SIZES; i++)
+    mClears[i] += pClears[i];
+
+  mScore.Add(pScore);
+  mLines.Add(pLines);
+  mPieces.Add(pPieces);
+}
+
+/*
+======================================
+Check that two results were played with the same settings
+======================================
+*/
+bool BatchResult::IsCompatible(const BatchResult &pOther) const
+{
+  return mPieceSet == pOther.mPieceSet && mSequence == pOther.mSequence &&
+         mMaxPieces == pOther.mMaxPieces &&
+         mWeights.mHeight == pOther.mWeights.mHeight &&
+         mWeights.mHoles == pOther.mWeights.mHoles &&
+         mWeights.mBumpiness == pOther.mWeights.mBumpiness &&
+         mWeights.mWells == pOther.mWeights.mWells &&
+         mWeights.mLines == pOther.mWeights.mLines;
+}
+
+/*
+======================================
+Add the games of another result with the same settings
+
+returns false if the settings differ or the seeds overlap, nothing is
+merged then
+======================================
+*/
+bool BatchResult::Merge(const BatchResult &pOther)
+{
+  if (!IsCompatible(pOther))
+    return false;
+
+  for (size_t i = 0; i < mSeeds.size(); i++)
+    for (size_t j = 0; j < pOther.mSeeds.size(); j++)
+      if (mSeeds[i].mFirst < pOther.mSeeds[j].mLast &&
+          pOther.mSeeds[j].mFirst < mSeeds[i].mLast)
+        return false;
+
+  for (size_t j = 0; j < pOther.mSeeds.size(); j++)
+    AddSeeds(pOther.mSeeds[j].mFirst, pOther.mSeeds[j].mLast);
+
+  mGames += pOther.mGames;
+  mCapped += pOther.mCapped;
+  for (int i = 0; i < BATCH_CLEAR_SIZES; i++)
+    mClears[i] += pOther.mClears[i];
+  mScore.Merge(pOther.mScore);
+  mLines.Merge(pOther.mLines);
+  mPieces.Merge(pOther.mPieces);
+  return true;
+}
+
+// Sketch as "name count sum min max buckets" and the non empty buckets
+static void SaveSketch(FILE *pFile, const char *pName, const Sketch &pSketch)
+{
+  int mUsed = 0;
+  for (int i = 0; i < SKETCH_BUCKETS; i++)
+    mUsed += pSketch.mBuckets[i] != 0;
+
+  fprintf(pFile, "%s %llu %llu %llu %llu %d", pName, pSketch.mCount,
+          pSketch.mSum, pSketch.mMin, pSketch.mMax, mUsed);
+  for (int i = 0; i < SKETCH_BUCKETS; i++)
+    if (pSketch.mBuckets[i] != 0)
+      fprintf(pFile, " %d:%llu", i, pSketch.mBuckets[i]);
+  fprintf(pFile, "\n");
+}
+
+static bool LoadSketch(FILE *pFile, const char *pName, Sketch &pSketch)
+{
+  char mName[32];
+  int mUsed;
+  if (fscanf(pFile, "%31s %llu %llu %llu %llu %d", mName, &pSketch.mCount,
+             &pSketch.mSum, &pSketch.mMin, &pSketch.mMax, &mUsed) != 6 ||
+      strcmp(mName, pName) != 0)
+    return false;
+
+  pSketch.mBuckets.assign(SKETCH_BUCKETS, 0);
+  for (int i = 0; i < mUsed; i++)
+  {
+    int mBucket;
+    unsigned long long mCount;
+    if (fscanf(pFile, "%d:%llu", &mBucket, &mCount) != 2 || mBucket < 0 ||
+        mBucket >= SKETCH_BUCKETS)
+      return false;
+    pSketch.mBuckets[mBucket] = mCount;
+  }
+  return true;
+}
+
+/*
+======================================
+Write the result as text, to a temporary file renamed over pPath so a
+killed run always leaves a whole file
+
+returns false if the file can't be written
+======================================
+*/
+bool BatchResult::Save(const char *pPath) const
+{
+  std::string mTemp = std::string(pPath) + ".tmp";
+  FILE *mFile = fopen(mTemp.c_str(), "w");
+  if (mFile == NULL)
+    return false;
+
+  fprintf(mFile, "tetris-batch-result %d\n", BATCH_RESULT_VERSION);
+  fprintf(mFile, "pieces %016llx\n", mPieceSet);
+  fprintf(mFile, "sequence %016llx\n", mSequence);
+  fprintf(mFile, "max-pieces %d\n", mMaxPieces);
+  fprintf(mFile, "weights %.17g %.17g %.17g %.17g %.17g\n", mWeights.mHeight,
+          mWeights.mHoles, mWeights.mBumpiness, mWeights.mWells,
+          mWeights.mLines);
+  fprintf(mFile, "seeds %d", (int)mSeeds.size());
+  for (size_t i = 0; i < mSeeds.size(); i++)
+    fprintf(mFile, " %llu-%llu", mSeeds[i].mFirst, mSeeds[i].mLast);
+  fprintf(mFile, "\ngames %llu\ncapped %llu\nclears %d", mGames, mCapped,
+          BATCH_CLEAR_SIZES);
+  for (int i = 0; i < BATCH_CLEAR_SIZES; i++)
+    fprintf(mFile, " %llu", mClears[i]);
+  fprintf(mFile, "\n");
+  SaveSketch(mFile, "score", mScore);
+  SaveSketch(mFile, "lines", mLines);
+  SaveSketch(mFile, "pieces", mPieces);
+
+  bool mOk = !ferror(mFile);
+  mOk = fclose(mFile) == 0 && mOk;
+  return mOk && rename(mTemp.c_str(), pPath) == 0;
+}
+
+/*
+======================================
+Read a result written by Save
+
+returns false if the file can't be read or isn't a result of a version it knows
+======================================
+*/
+bool BatchResult::Load(const char *pPath)
+{
+  FILE *mFile = fopen(pPath, "r");
+  if (mFile == NULL)
+    return false;
+
+  *this = BatchResult();
+  int mVersion = 0, mRanges = 0, mSizes = 0;
+  bool mOk =
+      fscanf(mFile, "tetris-batch-result %d", &mVersion) == 1 &&
+      mVersion >= 1 && mVersion <= BATCH_RESULT_VERSION &&
+      fscanf(mFile, " pieces %llx", &mPieceSet) == 1 &&
+      (mVersion < 2 || fscanf(mFile, " sequence %llx", &mSequence) == 1) &&
+      fscanf(mFile, " max-pieces %d", &mMaxPieces) == 1 &&
+      fscanf(mFile, " weights %lf %lf %lf %lf %lf", &mWeights.mHeight,
+             &mWeights.mHoles, &mWeights.mBumpiness, &mWeights.mWells,
+             &mWeights.mLines) == 5 &&
+      fscanf(mFile, " seeds %d", &mRanges) == 1 && mRanges >= 0;
+
+  for (int i = 0; mOk && i < mRanges; i++)
+  {
+    SeedRange mRange;
+    mOk = fscanf(mFile, " %llu-%llu", &mRange.mFirst, &mRange.mLast) == 2 &&
+          mRange.mFirst < mRange.mLast;
+    if (mOk)
+      AddSeeds(mRange.mFirst, mRange.mLast);
+  }
+
+  mOk = mOk && fscanf(mFile, " games %llu capped %llu clears %d", &mGames,
+                      &mCapped, &mSizes) == 3 &&
+        mSizes == BATCH_CLEAR_SIZES;
+  for (int i = 0; mOk && i < BATCH_CLEAR_SIZES; i++)
+    mOk = fscanf(mFile, "%llu", &mClears[i]) == 1;
+
+  mOk = mOk && LoadSketch(mFile, "score", mScore) &&
+        LoadSketch(mFile, "lines", mLines) &&
+        LoadSketch(mFile, "pieces", mPieces);
+  fclose(mFile);
+  return mOk;
+}
+
+/*
+======================================
+Print the seeds, totals and quantiles for people
+======================================
+*/
+void BatchResult::Print(FILE *pFile) const
+{
+  unsigned long long mSeedCount = 0;
+  for (size_t i = 0; i < mSeeds.size(); i++)
+    mSeedCount += mSeeds[i].mLast - mSeeds[i].mFirst;
+
+  fprintf(pFile, "%llu games from %llu seeds in %d ranges, %llu stopped at "
+                 "%d pieces\n",
+          mGames, mSeedCount, (int)mSeeds.size(), mCapped, mMaxPieces);
+  if (mSequence != 0)
+    fprintf(pFile, "pieces from the sequence %016llx\n", mSequence);
+  fprintf(pFile, "clears");
+  for (int i = 0; i < BATCH_CLEAR_SIZES; i++)
+    fprintf(pFile, " %d%s:%llu", i + 1, i == BATCH_CLEAR_SIZES - 1 ? "+" : "",
+            mClears[i]);
+  fprintf(pFile, "\n%-8s %12s %14s %10s %10s %10s %10s %10s\n", "", "mean",
+          "total", "min", "p50", "p90", "p99", "max");
+
+  const char *mNames[3] = {"score", "lines", "pieces"};
+  const Sketch *mSketches[3] = {&mScore, &mLines, &mPieces};
+  for (int i = 0; i < 3; i++)
+  {
+    const Sketch &mSketch = *mSketches[i];
+    fprintf(pFile, "%-8s %12.2f %14llu %10llu %10llu %10llu %10llu %10llu\n",
+            mNames[i], mSketch.mCount ? (double)mSketch.mSum / mSketch.mCount : 0,
+            mSketch.mSum, mSketch.mCount ? mSketch.mMin : 0,
+            mSketch.GetQuantile(0.5), mSketch.GetQuantile(0.9),
+            mSketch.GetQuantile(0.99), mSketch.mMax);
+  }
+}
@@ -0,0 +1,234 @@
+/*****************************************************************************************
+ File: Battle.cpp
+ Desc: Battle of many boards with garbage lines, ticked in parallel
+*****************************************************************************************/
+
+#include "include/Battle.h"
+#include <algorithm>
+
+// Garbage lines sent for the lines cleared at once, larger clears send
+// as many lines as they clear
+static const int mAttackTable[] = {0, 0, 1, 2, 4};
+#define ATTACK_TABLE_SIZE ((int)(sizeof(mAttackTable) / sizeof(mAttackTable[0])))
+
+static unsigned int NextRand(unsigned int &pState)
+{
+  pState = pState * 1103515245u + 12345u;
+  return pState >> 16;
+}
+
+/*
+======================================
+Init, a new round with the pieces of a seed on the player's own clock
+======================================
+*/
+BattlePlayer::BattlePlayer(Pieces *pPieces, unsigned int pSeed)
+    : mBoard(pPieces, 0), mGame(&mBoard, pPieces, NULL, 0), mControl(&mGame),
+      mRand(pSeed ^ 0x9e3779b9u), mLines(0), mSequence(0), mSent(0),
+      mReceived(0), mDropped(0), mDeathTick(0)
+{
+  mControl.Reset(pSeed);
+}
+
+/*
+======================================
+Init
+
+Parameters:
+>> pPieces, pWeights: piece set and weights of every bot
+>> pPlayers: boards in the battle
+>> pSeed: seed of the battle, every player gets one of its own from it
+>> pThreads: threads ticking the boards, the caller is one of them
+======================================
+*/
+Battle::Battle(Pieces *pPieces, const EvalWeights &pWeights, int pPlayers,
+               unsigned int pSeed, int pThreads)
+    : mPieces(pPieces), mWeights(pWeights), mPool(pThreads), mTick(0),
+      mAliveCount(pPlayers)
+{
+  for (int i = 0; i < pPlayers; i++)
+    mPlayers.push_back(new BattlePlayer(pPieces, pSeed + i * 2654435761u));
+  mAlive.assign(mPlayers.size(), 1);
+
+  // Contiguous boards per partition, one partition per thread
+  int mCount = std::min(mPool.GetThreads(), std::max(pPlayers, 1));
+  for (int p = 0; p < mCount; p++)
+  {
+    Partition mPartition = {this, pPlayers * p / mCount,
+                            pPlayers * (p + 1) / mCount};
+    mPartitions.push_back(mPartition);
+  }
+}
+
+Battle::~Battle()
+{
+  for (size_t i = 0; i < mPlayers.size(); i++)
+    delete mPlayers[i];
+}
+
+void Battle::RunPartition(void *pArg)
+{
+  Partition *mPartition = (Partition *)pArg;
+  for (int i = mPartition->mFirst; i < mPartition->mLast; i++)
+    mPartition->mBattle->TickPlayer(i);
+}
+
+/*
+======================================
+Opponent of a player that was alive at the start of the tick, picked with
+the player's own random numbers
+
+returns -1 if no opponent is left
+======================================
+*/
+int Battle::ChooseTarget(int pIndex)
+{
+  int mOpponents = mAliveCount - (mAlive[pIndex] ? 1 : 0);
+  if (mOpponents <= 0)
+    return -1;
+
+  int mPick = NextRand(mPlayers[pIndex]->mRand) % mOpponents;
+  for (int i = 0; i < (int)mPlayers.size(); i++)
+  {
+    if (i == pIndex || !mAlive[i])
+      continue;
+    if (mPick-- == 0)
+      return i;
+  }
+  return -1;
+}
+
+/*
+======================================
+One tick of a board: apply the garbage of the last tick, let the bot play
+and send garbage for the lines it cleared. Runs on any thread, touching
+only this board and the queues of the others
+======================================
+*/
+void Battle::TickPlayer(int pIndex)
+{
+  BattlePlayer &mPlayer = *mPlayers[pIndex];
+  Game &mGame = mPlayer.mGame;
+
+  // Attacks arrive in any order, they are applied by sender
+  GarbageAttack mAttack;
+  mPlayer.mPending.clear();
+  while (mPlayer.mIncoming[mTick & 1].Pop(mAttack))
+    mPlayer.mPending.push_back(mAttack);
+  std::sort(mPlayer.mPending.begin(), mPlayer.mPending.end(),
+            [](const GarbageAttack &a, const GarbageAttack &b) {
+              return a.mSender != b.mSender ? a.mSender < b.mSender
+                                            : a.mSequence < b.mSequence;
+            });
+
+  if (mGame.IsGameOver())
+    return;
+
+  for (size_t i = 0; i < mPlayer.mPending.size(); i++)
+  {
+    mPlayer.mReceived += mPlayer.mPending[i].mLines;
+    if (mGame.AddGarbage(mPlayer.mPending[i].mLines,
+                         mPlayer.mPending[i].mHole))
+    {
+      mPlayer.mDeathTick = mTick + 1;
+      return;
+    }
+  }
+
+  // The bot places the piece as soon as it appears
+  if (!mGame.IsSpawning())
+  {
+    Placement mBest;
+    if (ChoosePlacement(mPlayer.mBoard, *mPieces, mGame.mPiece, mWeights,
+                        mBest))
+      mPlayer.mControl.Place(mBest);
+    else
+      mPlayer.mControl.Act(ACTION_HARD_DROP);
+  }
+  mPlayer.mControl.Step(1);
+
+  int mCleared = mGame.GetLines() - mPlayer.mLines;
+  mPlayer.mLines = mGame.GetLines();
+  if (mGame.IsGameOver())
+    mPlayer.mDeathTick = mTick + 1;
+
+  int mLines = mCleared < ATTACK_TABLE_SIZE ? mAttackTable[mCleared] : mCleared;
+  int mTarget = mLines > 0 ? ChooseTarget(pIndex) : -1;
+  if (mTarget < 0)
+    return;
+
+  mAttack.mSender = pIndex;
+  mAttack.mSequence = mPlayer.mSequence++;
+  mAttack.mLines = mLines;
+  mAttack.mHole = NextRand(mPlayer.mRand) % BOARD_WIDTH;
+  if (mPlayers[mTarget]->mIncoming[(mTick + 1) & 1].Push(mAttack))
+    mPlayer.mSent += mLines;
+  else
+    mPlayer.mDropped += mLines;
+}
+
+/*
+======================================
+Play one tick of every board, the partitions in parallel
+======================================
+*/
+void Battle::Tick()
+{
+  TaskGroup mGroup;
+  for (size_t p = 0; p < mPartitions.size(); p++)
+    mPool.Submit(mGroup, RunPartition, &mPartitions[p]);
+  mPool.Wait(mGroup);
+  mTick++;
+
+  // Players that topped out no longer get attacked from the next tick
+  mAliveCount = 0;
+  for (size_t i = 0; i < mPlayers.size(); i++)
+  {
+    mAlive[i] = !mPlayers[i]->mGame.IsGameOver();
+    mAliveCount += mAlive[i];
+  }
+}
+
+/*
+======================================
+Tick until one board is left or pMaxTicks ticks were played
+
+returns the winner, or -1 if the battle isn't over
+======================================
+*/
+int Battle::Run(unsigned long long pMaxTicks)
+{
+  while (mAliveCount > 1 && mTick < pMaxTicks)
+    Tick();
+
+  if (mAliveCount != 1)
+    return -1;
+  for (size_t i = 0; i < mPlayers.size(); i++)
+    if (mAlive[i])
+      return (int)i;
+  return -1;
+}
+
+/*
+======================================
+Fingerprint of every board and counter, equal for equal battles
+======================================
+*/
+unsigned long long Battle::Hash() const
+{
+  unsigned long long mHash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < mPlayers.size(); i++)
+  {
+    BattlePlayer &mPlayer = *mPlayers[i];
+    unsigned long long mValues[] = {
+        mPlayer.mBoard.Hash(), (unsigned long long)mPlayer.mGame.getScore(),
+        (unsigned long long)mPlayer.mLines, mPlayer.mSent, mPlayer.mReceived,
+        mPlayer.mDeathTick};
+    for (size_t k = 0; k < sizeof(mValues) / sizeof(mValues[0]); k++)
+    {
+      mHash ^= mValues[k];
+      mHash *= 0x100000001b3ull;
+    }
+  }
+  return mHash;
+}
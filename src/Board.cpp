@@ -14,19 +14,28 @@ Board::Board(Pieces *pPieces, int pScreenHeight)
   mPieces = pPieces;
 
   // Init the board blocks with free positions
-  InitBoard();
+  mBits.Clear();
 }
 
+/*
+======================================
+Empty the board for a new round
+======================================
+*/
+void Board::Reset() { mBits.Clear(); }
+
 /*
 ======================================
 Init the board blocks with free position
 ======================================
 */
-void Board::InitBoard()
+void BoardBits::Clear()
 {
+  for (int j = 0; j < BOARD_HEIGHT; j++)
+    mRows[j] = 0;
+
   for (int i = 0; i < BOARD_WIDTH; i++)
-    for (int j = 0; j < BOARD_HEIGHT; j++)
-      mBoard[i][j] = POS_FREE;
+    mColumnTop[i] = BOARD_HEIGHT;
 }
 
 /*
@@ -41,40 +50,27 @@ parameters:
 >> pRotation 1 of the 4 possible rotation
 =======================================
 */
-void Board::StorePieces(int pX, int pY, int pPiece, int pRotation)
+void BoardBits::StorePieces(const Pieces &pPieces, int pX, int pY, int pPiece,
+                            int pRotation)
 {
+  const PieceShape &mShape = pPieces.GetShape(pPiece, pRotation);
+
   // Store each block of the piece into the board
-  for (int i1 = pX, i2 = 0; i1 < pX + PIECES_BLOCKS; i1++, i2++)
+  for (int i = 0; i < mShape.mNumCells; i++)
   {
-    for (int j1 = pY, j2 = 0; j1 < pY + PIECES_BLOCKS; j1++, j2++)
-    {
-      // Store only blocks of the piece that are not holes
-      // And check bounds to prevent accessing invalid memory
-      if (mPieces->GetBlockType(pPiece, pRotation, j2, i2) != 0 && i1 >= 0 &&
-          i1 < BOARD_WIDTH && j1 >= 0 && j1 < BOARD_HEIGHT)
-      {
-        mBoard[i1][j1] = POS_FILLED;
-      }
-    }
-  }
-}
+    int mX = pX + mShape.mCells[i].mX;
+    int mY = pY + mShape.mCells[i].mY;
 
-/*
-=========================================
-Check if the game is over coz a pieces have achived the upper positon
+    // Check bounds to prevent accessing invalid memory
+    if (mX >= 0 && mX < BOARD_WIDTH && mY >= 0 && mY < BOARD_HEIGHT)
+    {
+      mRows[mY] |= 1 << mX;
 
-returns true or false
-=========================================
-*/
-bool Board::IsGameOver()
-{
-  // if the first line has blocks, then game over
-  for (int i = 0; i < BOARD_WIDTH; i++)
-  {
-    if (mBoard[i][0] == POS_FILLED)
-      return true;
+      // Keep the skyline up to date
+      if (mY < mColumnTop[mX])
+        mColumnTop[mX] = mY;
+    }
   }
-  return false;
 }
 
 /*
@@ -85,14 +81,26 @@ parameters
 >> pY vertical postion in blocks of the line to delete
 =========================================
 */
-void Board::DeleteLine(int pY)
+void BoardBits::DeleteLine(int pY)
 {
   // moves all the upper lines one row down
   for (int j = pY; j > 0; j--)
+    mRows[j] = mRows[j - 1];
+  mRows[0] = 0;
+
+  for (int i = 0; i < BOARD_WIDTH; i++)
   {
-    for (int i = 0; i < BOARD_WIDTH; i++)
+    // Every column has a block in the deleted line, so the column top is at
+    // or above it. Blocks above the line moved one row down; if the line held
+    // the top block, the new top is the first filled block below it
+    if (mColumnTop[i] < pY)
+      mColumnTop[i]++;
+    else
     {
-      mBoard[i][j] = mBoard[i][j - 1];
+      int j = pY + 1;
+      while (j < BOARD_HEIGHT && !(mRows[j] & (1 << i)))
+        j++;
+      mColumnTop[i] = j;
     }
   }
 }
@@ -100,43 +108,67 @@ void Board::DeleteLine(int pY)
 /*
  =======================================
   delete all the lines that should be removed
+
+  returns the number of deleted lines
  =======================================
 */
-void Board::DeletePossibleLines()
+int BoardBits::DeletePossibleLines()
 {
+  int mLines = 0;
+
   for (int j = 0; j < BOARD_HEIGHT; j++)
   {
-    int i = 0;
-    while (i < BOARD_WIDTH)
-    {
-      if (mBoard[i][j] != POS_FILLED)
-        break;
-      i++;
-    }
-
-    if (i == BOARD_WIDTH)
+    if (mRows[j] == BOARD_FULL_ROW)
     {
       DeleteLine(j);
+      mLines++;
     }
   }
+
+  return mLines;
 }
 
 /*
- ==============================
-  Returns 1 if this block of the board is empty, 0 if it's filled
+ =======================================
+  push the stack up and fill the bottom rows with garbage, full lines with
+  one free block in the same column
 
   parameters:
-  >> pX horizontal position in blocks
-  >> pY vertical position in blocks
- ==============================
+  >> pLines number of garbage lines
+  >> pHole column of the free block
+
+  returns false if blocks were pushed out of the top of the board
+ =======================================
 */
-bool Board::IsFreeBlock(int pX, int pY)
+bool BoardBits::InsertGarbage(int pLines, int pHole)
 {
-  if (mBoard[pX][pY] == POS_FREE)
-  {
+  if (pLines <= 0)
     return true;
+  if (pLines > BOARD_HEIGHT)
+    pLines = BOARD_HEIGHT;
+
+  bool mFits = true;
+  for (int j = 0; j < pLines; j++)
+    if (mRows[j] != 0)
+      mFits = false;
+
+  for (int j = 0; j < BOARD_HEIGHT - pLines; j++)
+    mRows[j] = mRows[j + pLines];
+  unsigned short mGarbage = BOARD_FULL_ROW & ~(1 << pHole);
+  for (int j = BOARD_HEIGHT - pLines; j < BOARD_HEIGHT; j++)
+    mRows[j] = mGarbage;
+
+  // The old top moved up pLines rows if it stayed on the board, else the
+  // new top is the first filled block from the top or in the garbage
+  for (int i = 0; i < BOARD_WIDTH; i++)
+  {
+    int j = mColumnTop[i] - pLines > 0 ? mColumnTop[i] - pLines : 0;
+    while (j < BOARD_HEIGHT && !(mRows[j] & (1 << i)))
+      j++;
+    mColumnTop[i] = j;
   }
-  return false;
+
+  return mFits;
 }
 
 /*
@@ -178,33 +210,130 @@ int Board::GetYPosInPixels(int pPos)
   >> pRotation 1 of the 4 possible rotations
  ===================================
 */
-bool Board::IsPossibleMovement(int pX, int pY, int pPiece, int pRotation)
+bool BoardBits::IsPossibleMovement(const Pieces &pPieces, int pX, int pY,
+                                   int pPiece, int pRotation) const
 {
-  // Checks collision with pieces already stored in the board or the board
-  // limits This is just to check the 5x5 blocks of a piece with the appropiate
-  // area in the board
-  for (int i1 = pX, i2 = 0; i1 < pX + PIECES_BLOCKS; i1++, i2++)
+  const PieceShape &mShape = pPieces.GetShape(pPiece, pRotation);
+
+  // Check if the piece is outside the limits of the board
+  if (pX + mShape.mMinX < 0 || pX + mShape.mMaxX > BOARD_WIDTH - 1 ||
+      pY + mShape.mMaxY > BOARD_HEIGHT - 1)
+    return false;
+
+  // Check if the piece have collisioned with a block already stored in the
+  // map, one row of the piece at a time. Rows above the board are free
+  int mFirst = pY + mShape.mMinY >= 0 ? mShape.mMinY : -pY;
+  for (int j = mFirst; j <= mShape.mMaxY; j++)
   {
-    for (int j1 = pY, j2 = 0; j1 < pY + PIECES_BLOCKS; j1++, j2++)
-    {
-      // Check if the piece is outside the limits of the board
-      if (i1 < 0 || i1 > BOARD_WIDTH - 1 || j1 > BOARD_HEIGHT - 1)
-      {
-        if (mPieces->GetBlockType(pPiece, pRotation, j2, i2) != 0)
-          return 0;
-      }
-
-      // Check if the piece have collisioned with a block already stored in the
-      // map
-      if (j1 >= 0)
-      {
-        if ((mPieces->GetBlockType(pPiece, pRotation, j2, i2) != 0) &&
-            (!IsFreeBlock(i1, j1)))
-          return false;
-      }
-    }
+    if (mRows[pY + j] & ShiftRow(mShape.mRows[j], pX))
+      return false;
   }
 
   // No collision
   return true;
 }
+
+/*
+ ===================================
+  turn a piece to another rotation, trying the kicks of the rotation in
+  order until one fits. The kicks come compiled from the piece set, so a
+  rotation that fits in place costs one collision check like a move
+
+  returns the index of the kick that fit and moves pX, pY by it, or -1 if
+  none fits and they are left alone
+
+  parameters:
+  >> pX, pY position of the piece in blocks
+  >> pPiece piece kind
+  >> pFrom, pTo rotations before and after the turn
+ ===================================
+*/
+int BoardBits::TryRotation(const Pieces &pPieces, int &pX, int &pY, int pPiece,
+                           int pFrom, int pTo) const
+{
+  const KickTable &mKicks = pPieces.GetKicks(pPiece, pFrom, pTo);
+  for (int i = 0; i < mKicks.mCount; i++)
+  {
+    int mX = pX + mKicks.mOffsets[i][0], mY = pY + mKicks.mOffsets[i][1];
+    if (IsPossibleMovement(pPieces, mX, mY, pPiece, pTo))
+    {
+      pX = mX;
+      pY = mY;
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*
+ ===================================
+  returns how many rows the piece can fall from its position before it
+  collides. The piece must be at a possible position.
+
+  Each column of the piece is compared against the column top of the board,
+  so a piece above the stack is resolved with one comparison per column.
+  Only a piece tucked under an overhang falls back to testing every row.
+
+  parameters:
+  >> pX horizontal positon in blocks
+  >> pY vertical position in blocks
+  >> pPiece piece to drop
+  >> pRotation 1 of the 4 possible rotations
+ ===================================
+*/
+int BoardBits::GetDropDistance(const Pieces &pPieces, int pX, int pY,
+                               int pPiece, int pRotation) const
+{
+  const PieceShape &mShape = pPieces.GetShape(pPiece, pRotation);
+  int mDistance = BOARD_HEIGHT + PIECES_MAX_BLOCKS;
+
+  for (int i = mShape.mMinX; i <= mShape.mMaxX; i++)
+  {
+    int mBottom = mShape.mBottom[i];
+    if (mBottom < 0)
+      continue;
+
+    int mColumn = mColumnTop[pX + i] - (pY + mBottom) - 1;
+
+    // The piece is below the surface of this column
+    if (mColumn < 0)
+      return ScanDropDistance(pPieces, pX, pY, pPiece, pRotation);
+
+    if (mColumn < mDistance)
+      mDistance = mColumn;
+  }
+
+  return mDistance;
+}
+
+/*
+ ===================================
+  returns the drop distance by testing the piece one row at a time
+ ===================================
+*/
+int BoardBits::ScanDropDistance(const Pieces &pPieces, int pX, int pY,
+                                int pPiece, int pRotation) const
+{
+  int mDistance = 0;
+  while (IsPossibleMovement(pPieces, pX, pY + mDistance + 1, pPiece, pRotation))
+    mDistance++;
+
+  return mDistance;
+}
+
+/*
+ ===================================
+  returns a 64 bit hash of the blocks of the board, equal boards have equal
+  hashes
+ ===================================
+*/
+unsigned long long BoardBits::Hash() const
+{
+  unsigned long long mHash = 0x9e3779b97f4a7c15ull;
+  for (int j = 0; j < BOARD_HEIGHT; j++)
+  {
+    mHash = (mHash ^ mRows[j]) * 0xff51afd7ed558ccdull;
+    mHash ^= mHash >> 32;
+  }
+  return mHash;
+}
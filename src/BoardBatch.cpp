@@ -0,0 +1,222 @@
+/*****************************************************************************************
+ File: BoardBatch.cpp
+ Desc: Boards stepped in lockstep, BATCH_WIDTH lanes per vector instruction
+*****************************************************************************************/
+
+#include "include/BoardBatch.h"
+#include "include/Lanes.h"
+
+// Mask of a piece row placed with its matrix at column pX
+static inline unsigned short ShiftRow(unsigned int pRow, int pX)
+{
+  return pX >= 0 ? pRow << pX : pRow >> -pX;
+}
+
+/*
+======================================
+Init, every lane starts with an empty board and no piece
+
+Parameters:
+>> pPieces: piece set of the spawned pieces
+>> pBoards: lanes in the batch
+======================================
+*/
+BoardBatch::BoardBatch(const Pieces *pPieces, int pBoards)
+{
+  mPieces = pPieces;
+  mBoards = pBoards;
+  mLanes = (pBoards + BATCH_WIDTH - 1) / BATCH_WIDTH * BATCH_WIDTH;
+
+  mWindow = 1;
+  for (int i = 0; i < mPieces->GetKinds(); i++)
+  {
+    for (int r = 0; r < PIECES_ROTATIONS; r++)
+    {
+      const PieceShape &mShape = mPieces->GetShape(i, r);
+      if (mShape.mMaxY - mShape.mMinY + 1 > mWindow)
+        mWindow = mShape.mMaxY - mShape.mMinY + 1;
+    }
+  }
+
+  mRows.resize(BOARD_HEIGHT * mLanes);
+  mPiece.resize(mWindow * mLanes);
+  mAlive.resize(mLanes);
+  mLines.resize(mLanes);
+  Reset();
+}
+
+/*
+======================================
+Empty every board, the padding lanes stay masked out
+======================================
+*/
+void BoardBatch::Reset()
+{
+  for (int i = 0; i < mLanes; i++)
+  {
+    ResetLane(i);
+    if (i >= mBoards)
+      mAlive[i] = 0;
+  }
+}
+
+/*
+======================================
+Empty one board for a new game
+======================================
+*/
+void BoardBatch::ResetLane(int pLane)
+{
+  for (int j = 0; j < BOARD_HEIGHT; j++)
+    mRows[j * mLanes + pLane] = 0;
+  for (int j = 0; j < mWindow; j++)
+    mPiece[j * mLanes + pLane] = 0;
+  mAlive[pLane] = 0xffff;
+  mLines[pLane] = 0;
+}
+
+/*
+======================================
+Choose the piece a lane plays in the next step. pX must keep the piece
+inside the board
+
+Parameters:
+>> pLane: board of the piece
+>> pPiece, pRotation: piece to spawn
+>> pX: horizontal position in blocks
+======================================
+*/
+void BoardBatch::SetPiece(int pLane, int pPiece, int pRotation, int pX)
+{
+  const PieceShape &mShape = mPieces->GetShape(pPiece, pRotation);
+
+  for (int j = 0; j < mWindow; j++)
+  {
+    int mRow = mShape.mMinY + j;
+    mPiece[j * mLanes + pLane] =
+        mRow <= mShape.mMaxY ? ShiftRow(mShape.mRows[mRow], pX) : 0;
+  }
+}
+
+/*
+======================================
+Play the chosen piece of every live lane. The pieces spawn with their top
+row of blocks on the top row of the board and fall until they are stored;
+full lines are deleted. A lane is over when its piece doesn't fit at the
+top or leaves blocks on the top row, as in Board::IsGameOver. Every lane
+needs a new piece for the next step
+
+returns the gravity steps of all lanes, one per row tested
+======================================
+*/
+unsigned long long BoardBatch::Step()
+{
+  const Lanes mZero = Splat(0);
+  const Lanes mFullRow = Splat(BOARD_FULL_ROW);
+  unsigned long long mSteps = 0;
+
+  for (int c = 0; c < mLanes; c += BATCH_WIDTH)
+  {
+    unsigned short *mRow = &mRows[c];
+    Lanes mAliveNow = Load(&mAlive[c]);
+
+    // The top row of a piece always has a block, lanes without one idle
+    Lanes mPieceRows[PIECES_MAX_BLOCKS];
+    for (int k = 0; k < PIECES_MAX_BLOCKS; k++)
+      mPieceRows[k] = mZero;
+    for (int k = 0; k < mWindow; k++)
+    {
+      mPieceRows[k] = Load(&mPiece[k * mLanes + c]);
+      Store(&mPiece[k * mLanes + c], mZero);
+    }
+    Lanes mFalling = AndNot(CmpEq(mPieceRows[0], mZero), mAliveNow);
+    if (!Any(mFalling))
+      continue;
+
+    // Pieces that don't fit at the top end their game
+    Lanes mHit = mZero;
+    for (int k = 0; k < mWindow; k++)
+      mHit = Or(mHit, And(mPieceRows[k], Load(mRow + k * mLanes)));
+    Lanes mOver = AndNot(CmpEq(mHit, mZero), mFalling);
+    mFalling = AndNot(mOver, mFalling);
+    Lanes mPlaced = mFalling;
+    int mFirst = BOARD_HEIGHT, mLast = 0; // rows where pieces were stored
+
+    // Every falling piece has its top row on row t, it is stored when the
+    // floor or a block is under any of its rows
+    for (int t = 0; Any(mFalling); t++)
+    {
+      mSteps += Count(mFalling);
+
+      mHit = mZero;
+      for (int k = 0; k < mWindow && t + k < BOARD_HEIGHT; k++)
+      {
+        if (t + k + 1 < BOARD_HEIGHT)
+          mHit = Or(mHit, And(mPieceRows[k], Load(mRow + (t + k + 1) * mLanes)));
+        else
+          mHit = Or(mHit, mPieceRows[k]);
+      }
+
+      Lanes mLock = AndNot(CmpEq(mHit, mZero), mFalling);
+      if (!Any(mLock))
+        continue;
+
+      for (int k = 0; k < mWindow && t + k < BOARD_HEIGHT; k++)
+      {
+        unsigned short *p = mRow + (t + k) * mLanes;
+        Store(p, Or(Load(p), And(mLock, mPieceRows[k])));
+        mLast = t + k;
+      }
+      if (t < mFirst)
+        mFirst = t;
+      mFalling = AndNot(mLock, mFalling);
+    }
+
+    // Only the rows with new blocks can be full
+    Lanes mFull = mZero;
+    for (int j = mFirst; j <= mLast; j++)
+      mFull = Or(mFull, CmpEq(Load(mRow + j * mLanes), mFullRow));
+    if (Any(mFull))
+      ClearLines(c, mFirst, mLast);
+
+    mOver = Or(mOver, AndNot(CmpEq(Load(mRow), mZero), mPlaced));
+    Store(&mAlive[c], AndNot(mOver, mAliveNow));
+  }
+
+  return mSteps;
+}
+
+/*
+======================================
+Delete the full lines of BATCH_WIDTH lanes, every lane moves the lines
+above its own full lines down
+
+Parameters:
+>> pFirst: first lane of the vector
+>> pTop, pBottom: rows that may be full
+======================================
+*/
+void BoardBatch::ClearLines(int pFirst, int pTop, int pBottom)
+{
+  const Lanes mFullRow = Splat(BOARD_FULL_ROW);
+  unsigned short *mRow = &mRows[pFirst];
+
+  for (int j = pTop; j <= pBottom; j++)
+  {
+    Lanes mFull = CmpEq(Load(mRow + j * mLanes), mFullRow);
+    if (!Any(mFull))
+      continue;
+
+    for (int k = j; k > 0; k--)
+    {
+      unsigned short *p = mRow + k * mLanes;
+      Store(p, Blend(mFull, Load(p - mLanes), Load(p)));
+    }
+    Store(mRow, AndNot(mFull, Load(mRow)));
+
+    unsigned short mMask[BATCH_WIDTH];
+    Store(mMask, mFull);
+    for (int i = 0; i < BATCH_WIDTH; i++)
+      mLines[pFirst + i] += mMask[i] & 1;
+  }
+}
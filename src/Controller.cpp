@@ -0,0 +1,142 @@
+/*****************************************************************************************
+ File: Controller.cpp
+ Desc: Game driven by a program, on a clock it steps itself
+*****************************************************************************************/
+
+#include "include/Controller.h"
+
+/*
+======================================
+Init, the game goes on from where it is on the timers of the controller
+
+Parameters:
+>> pGame: game to drive, only touched through the controller from now on
+======================================
+*/
+Controller::Controller(Game *pGame) : mGame(pGame), mTimers(0), mTicks(0)
+{
+  mGame->SetTimers(&mTimers, 0);
+}
+
+Controller::~Controller() { mGame->SetTimers(NULL, 0); }
+
+/*
+======================================
+Start a new round with the pieces of a seed, at tick 0
+======================================
+*/
+void Controller::Reset(unsigned int pSeed)
+{
+  mGame->SetTimers(NULL, 0);
+  mTimers = TimerWheel(0);
+  mTicks = 0;
+  mGame->Reset(pSeed);
+  mGame->SetTimers(&mTimers, 0);
+}
+
+/*
+======================================
+Play an action at the current tick
+
+returns false if it did nothing: the piece is blocked, there is no falling
+piece or the game is over
+======================================
+*/
+bool Controller::Act(int pAction)
+{
+  if (mGame->IsGameOver() || mGame->IsSpawning())
+    return false;
+
+  switch (pAction)
+  {
+  case ACTION_LEFT:
+    return mGame->MoveLeft();
+  case ACTION_RIGHT:
+    return mGame->MoveRight();
+  case ACTION_ROTATE:
+    return mGame->Rotate();
+  case ACTION_ROTATE_CCW:
+    return mGame->Rotate(3);
+  case ACTION_ROTATE_180:
+    return mGame->Rotate(2);
+  case ACTION_SOFT_DROP:
+    return mGame->MoveDown();
+  case ACTION_HARD_DROP:
+    mGame->HardDrop();
+    return true;
+  }
+  return false;
+}
+
+/*
+======================================
+Play the actions that take the falling piece to a placement, like a bot
+would: rotate the shortest way, shift, then hard drop. Placements only
+reachable by tucks or spins end up dropped wherever the shift stopped
+
+returns false if the piece didn't reach the rotation and column
+======================================
+*/
+bool Controller::Place(const Placement &pPlacement)
+{
+  static const int mTurns[PIECES_ROTATIONS] = {ACTION_ROTATE, ACTION_ROTATE,
+                                               ACTION_ROTATE_180,
+                                               ACTION_ROTATE_CCW};
+  if (mGame->mRotation != pPlacement.mRotation)
+    Act(mTurns[(pPlacement.mRotation - mGame->mRotation + PIECES_ROTATIONS) %
+               PIECES_ROTATIONS]);
+
+  int mAction = pPlacement.mX < mGame->mPosX ? ACTION_LEFT : ACTION_RIGHT;
+  while (mGame->mPosX != pPlacement.mX && Act(mAction))
+    ;
+
+  bool mReached = mGame->mRotation == pPlacement.mRotation &&
+                  mGame->mPosX == pPlacement.mX;
+  return Act(ACTION_HARD_DROP) && mReached;
+}
+
+/*
+======================================
+Advance the game by exactly pTicks ticks of TICK_TIME milliseconds, playing
+every timer due on the way in order
+======================================
+*/
+void Controller::Step(int pTicks)
+{
+  if (pTicks <= 0)
+    return;
+
+  mTicks += pTicks;
+  TimerEvent mEvent;
+  while (mTimers.PopExpired(mTicks * TICK_TIME, mEvent))
+    mGame->OnTimer(mEvent);
+}
+
+/*
+======================================
+Step through the line clear and entry delays until the next piece falls,
+jumping over the ticks where no timer is due
+
+returns the ticks stepped
+======================================
+*/
+int Controller::StepToPiece(int pMaxTicks)
+{
+  int mStepped = 0;
+  while (mGame->IsSpawning() && !mGame->IsGameOver() && mStepped < pMaxTicks)
+  {
+    unsigned long long mNext = mTimers.GetNextDeadline();
+    if (mNext == WHEEL_NEVER)
+      break;
+
+    unsigned long long mNow = mTicks * TICK_TIME;
+    int mTicksToNext =
+        mNext <= mNow ? 1 : (int)((mNext - mNow + TICK_TIME - 1) / TICK_TIME);
+    if (mTicksToNext > pMaxTicks - mStepped)
+      mTicksToNext = pMaxTicks - mStepped;
+
+    Step(mTicksToNext);
+    mStepped += mTicksToNext;
+  }
+  return mStepped;
+}
@@ -0,0 +1,340 @@
+/*****************************************************************************************
+ File: EvalCache.cpp
+ Desc: Persistent memory mapped cache of the bot placements
+*****************************************************************************************/
+
+#include "include/EvalCache.h"
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Processes share the entries, their atomics must not hide a lock
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64 bit atomics must be lock free");
+static_assert(sizeof(EvalCacheBucket) == CACHE_LINE_SIZE,
+              "a bucket must be one cache line");
+
+#define FLAG_FOUND 1 // the entry holds a placement, else the piece can't be
+                     // placed anywhere
+
+static unsigned long long Mix(unsigned long long pValue)
+{
+  pValue ^= pValue >> 30;
+  pValue *= 0xbf58476d1ce4e5b9ull;
+  pValue ^= pValue >> 27;
+  pValue *= 0x94d049bb133111ebull;
+  return pValue ^ (pValue >> 31);
+}
+
+static long long GetNs(std::chrono::steady_clock::time_point pStart)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - pStart)
+      .count();
+}
+
+/*
+======================================
+Init
+======================================
+*/
+EvalCacheStats::EvalCacheStats()
+    : mHits(0), mMisses(0), mHitNs(0), mMissNs(0)
+{
+}
+
+void EvalCacheStats::Add(const EvalCacheStats &pOther)
+{
+  mHits += pOther.mHits;
+  mMisses += pOther.mMisses;
+  mHitNs += pOther.mHitNs;
+  mMissNs += pOther.mMissNs;
+}
+
+/*
+======================================
+Print the hit rate and the time the hits saved: each one would have cost
+an average miss
+======================================
+*/
+void EvalCacheStats::Print(FILE *pFile) const
+{
+  unsigned long long mLookups = mHits + mMisses;
+  double mMissCost = mMisses ? (double)mMissNs / mMisses : 0;
+  double mHitCost = mHits ? (double)mHitNs / mHits : 0;
+  double mSaved = (mHits * mMissCost - mHitNs) / 1e9;
+
+  fprintf(pFile, "cache: %llu lookups, %llu hits (%.1f%%)\n", mLookups, mHits,
+          mLookups ? 100.0 * mHits / mLookups : 0.0);
+  fprintf(pFile, "cache: hit %.0f ns, miss %.0f ns, %.2f s saved\n", mHitCost,
+          mMissCost, mSaved);
+}
+
+/*
+======================================
+Init, no file
+======================================
+*/
+EvalCache::EvalCache()
+    : mHeader(NULL), mBuckets(NULL), mSize(0), mMask(0), mSettings(0),
+      mPieces(NULL)
+{
+}
+
+EvalCache::~EvalCache() { Close(); }
+
+/*
+======================================
+Map a cache file and check its header
+
+returns false if it isn't a cache file of the size its header gives
+======================================
+*/
+bool EvalCache::Map(int pFd)
+{
+#ifdef _WIN32
+  return false;
+#else
+  struct stat mStat;
+  if (fstat(pFd, &mStat) != 0 || mStat.st_size < (off_t)sizeof(EvalCacheHeader))
+    return false;
+
+  EvalCacheHeader mRead;
+  if (pread(pFd, &mRead, sizeof(mRead), 0) != (ssize_t)sizeof(mRead) ||
+      mRead.mMagic != EVAL_CACHE_MAGIC || mRead.mVersion != EVAL_CACHE_VERSION ||
+      mRead.mBucketBits < 1 || mRead.mBucketBits > EVAL_CACHE_MAX_BITS)
+    return false;
+
+  size_t mBytes = sizeof(EvalCacheHeader) +
+                  (sizeof(EvalCacheBucket) << mRead.mBucketBits);
+  if ((size_t)mStat.st_size != mBytes)
+    return false;
+
+  void *mMemory =
+      mmap(NULL, mBytes, PROT_READ | PROT_WRITE, MAP_SHARED, pFd, 0);
+  if (mMemory == MAP_FAILED)
+    return false;
+
+  mHeader = (EvalCacheHeader *)mMemory;
+  mBuckets = (EvalCacheBucket *)((char *)mMemory + sizeof(EvalCacheHeader));
+  mSize = mBytes;
+  mMask = (1ull << mRead.mBucketBits) - 1;
+  return true;
+#endif
+}
+
+/*
+======================================
+Open a cache file, creating it if it doesn't exist. A new file is filled
+under a temporary name and linked in place once it is complete, so a
+process that opens it at the same time sees either no file or a whole one
+
+Parameters:
+>> pPath: cache file
+>> pPieces, pWeights: settings of the bot, only their entries are used
+>> pBucketBits: buckets of a new file, as bits; an existing file keeps its
+   size
+
+returns false if the file can't be created or isn't a cache file
+======================================
+*/
+bool EvalCache::Open(const char *pPath, const Pieces &pPieces,
+                     const EvalWeights &pWeights, int pBucketBits)
+{
+#ifdef _WIN32
+  return false;
+#else
+  Close();
+  if (pBucketBits < 1 || pBucketBits > EVAL_CACHE_MAX_BITS)
+    return false;
+
+  int mFd = open(pPath, O_RDWR);
+  if (mFd < 0)
+  {
+    std::string mTemp = std::string(pPath) + ".XXXXXX";
+    mFd = mkstemp(&mTemp[0]);
+    if (mFd < 0)
+      return false;
+
+    // Entries start as zero, a key is never zero
+    EvalCacheHeader mNew;
+    memset(&mNew, 0, sizeof(mNew));
+    mNew.mMagic = EVAL_CACHE_MAGIC;
+    mNew.mVersion = EVAL_CACHE_VERSION;
+    mNew.mBucketBits = pBucketBits;
+    bool mWritten =
+        ftruncate(mFd, sizeof(EvalCacheHeader) +
+                           (sizeof(EvalCacheBucket) << pBucketBits)) == 0 &&
+        pwrite(mFd, &mNew, sizeof(mNew), 0) == (ssize_t)sizeof(mNew) &&
+        fchmod(mFd, 0644) == 0;
+
+    // Another process may have created the file first, then it is used
+    if (!mWritten || link(mTemp.c_str(), pPath) != 0)
+    {
+      close(mFd);
+      mFd = mWritten ? open(pPath, O_RDWR) : -1;
+    }
+    unlink(mTemp.c_str());
+    if (mFd < 0)
+      return false;
+  }
+
+  bool mMapped = Map(mFd);
+  close(mFd);
+  if (!mMapped)
+    return false;
+
+  // Settings that give other placements, mixed into every key
+  unsigned long long mWords[5];
+  memcpy(&mWords[0], &pWeights.mHeight, sizeof(double));
+  memcpy(&mWords[1], &pWeights.mHoles, sizeof(double));
+  memcpy(&mWords[2], &pWeights.mBumpiness, sizeof(double));
+  memcpy(&mWords[3], &pWeights.mWells, sizeof(double));
+  memcpy(&mWords[4], &pWeights.mLines, sizeof(double));
+  mSettings = Mix(pPieces.GetHash());
+  for (int i = 0; i < 5; i++)
+    mSettings = Mix(mSettings ^ mWords[i]);
+
+  mPieces = &pPieces;
+  mWeights = pWeights;
+  return true;
+#endif
+}
+
+void EvalCache::Close()
+{
+#ifndef _WIN32
+  if (mHeader != NULL)
+    munmap(mHeader, mSize);
+#endif
+  mHeader = NULL;
+  mBuckets = NULL;
+  mSize = 0;
+}
+
+/*
+======================================
+Key of a piece on a board, never zero so an empty entry matches nothing
+======================================
+*/
+unsigned long long EvalCache::GetKey(const BoardBits &pBoard, int pPiece) const
+{
+  unsigned long long mKey = mSettings ^ (unsigned long long)pPiece;
+  for (int y = 0; y < BOARD_HEIGHT; y += 4)
+  {
+    unsigned long long mWord = 0;
+    for (int j = 0; j < 4 && y + j < BOARD_HEIGHT; j++)
+      mWord |= (unsigned long long)pBoard.mRows[y + j] << (16 * j);
+    mKey = Mix(mKey ^ mWord);
+  }
+  return mKey | 1;
+}
+
+/*
+======================================
+Find a key in its bucket, without locks
+
+Parameters:
+>> pFound: returns false if the piece has no placement on the board
+>> pBest, pScore: return the cached placement and its evaluation
+
+returns false on a miss
+======================================
+*/
+bool EvalCache::Lookup(unsigned long long pKey, bool &pFound, Placement &pBest,
+                       double &pScore) const
+{
+  const EvalCacheBucket &mBucket = mBuckets[pKey & mMask];
+  for (int i = 0; i < EVAL_CACHE_WAYS; i++)
+  {
+    unsigned long long mCheck =
+        mBucket.mEntries[i].mCheck.load(std::memory_order_acquire);
+    unsigned long long mData =
+        mBucket.mEntries[i].mData.load(std::memory_order_relaxed);
+    if ((mCheck ^ mData) != pKey)
+      continue;
+
+    unsigned int mScoreBits = (unsigned int)(mData >> 32);
+    float mScore;
+    memcpy(&mScore, &mScoreBits, sizeof(mScore));
+    pScore = mScore;
+    pFound = (mData >> 24) & FLAG_FOUND;
+    pBest.mRotation = (int)((mData >> 16) & 0xff);
+    pBest.mY = (signed char)((mData >> 8) & 0xff);
+    pBest.mX = (signed char)(mData & 0xff);
+    return true;
+  }
+  return false;
+}
+
+/*
+======================================
+Store the choice for a key, in an empty entry of its bucket or else over
+the entry the key picks. Two processes writing the same entry can leave it
+mixed, it then matches no key
+======================================
+*/
+void EvalCache::Store(unsigned long long pKey, bool pFound,
+                      const Placement &pBest, double pScore)
+{
+  float mScore = (float)pScore;
+  unsigned int mScoreBits;
+  memcpy(&mScoreBits, &mScore, sizeof(mScoreBits));
+  unsigned long long mData =
+      ((unsigned long long)mScoreBits << 32) |
+      ((unsigned long long)(pFound ? FLAG_FOUND : 0) << 24) |
+      ((unsigned long long)(pBest.mRotation & 0xff) << 16) |
+      ((unsigned long long)(pBest.mY & 0xff) << 8) |
+      (unsigned long long)(pBest.mX & 0xff);
+
+  EvalCacheBucket &mBucket = mBuckets[pKey & mMask];
+  int mWay = (int)(pKey >> 62) % EVAL_CACHE_WAYS;
+  for (int i = 0; i < EVAL_CACHE_WAYS; i++)
+    if (mBucket.mEntries[i].mCheck.load(std::memory_order_relaxed) == 0)
+    {
+      mWay = i;
+      break;
+    }
+
+  EvalCacheEntry &mEntry = mBucket.mEntries[mWay];
+  mEntry.mData.store(mData, std::memory_order_relaxed);
+  mEntry.mCheck.store(pKey ^ mData, std::memory_order_release);
+}
+
+/*
+======================================
+::ChoosePlacement through the cache: a hit returns the stored choice, a
+miss evaluates the board and stores it
+
+returns false if the piece can't be placed
+======================================
+*/
+bool EvalCache::ChoosePlacement(const Board &pBoard, int pPiece,
+                                Placement &pBest, EvalCacheStats &pStats)
+{
+  std::chrono::steady_clock::time_point mStart =
+      std::chrono::steady_clock::now();
+  unsigned long long mKey = GetKey(pBoard.GetBits(), pPiece);
+
+  bool mFound;
+  double mScore;
+  if (Lookup(mKey, mFound, pBest, mScore))
+  {
+    pStats.mHits++;
+    pStats.mHitNs += GetNs(mStart);
+    return mFound;
+  }
+
+  mScore = 0;
+  mFound = ::ChoosePlacement(pBoard, *mPieces, pPiece, mWeights, pBest, &mScore);
+  Store(mKey, mFound, pBest, mScore);
+  pStats.mMisses++;
+  pStats.mMissNs += GetNs(mStart);
+  return mFound;
+}
@@ -0,0 +1,93 @@
+/*****************************************************************************************
+ File: Evaluator.cpp
+ Desc: Heuristic evaluation of a board for the bots
+*****************************************************************************************/
+
+#include "include/Evaluator.h"
+
+/*
+======================================
+Default weights, tuned for the standard tetrominoes
+======================================
+*/
+EvalWeights::EvalWeights()
+    : mHeight(-0.510066), mHoles(-0.35663), mBumpiness(-0.184483),
+      mWells(-0.1), mLines(0.760666)
+{
+}
+
+/*
+======================================
+Weighted sum of the features, higher is better
+
+Parameters:
+>> pFeatures: features of a board, with the lines cleared to get there
+>> pWeights: weight of every feature
+======================================
+*/
+double Evaluate(const FeatureVector &pFeatures, const EvalWeights &pWeights)
+{
+  return pWeights.mHeight * pFeatures[FEATURE_HEIGHT] +
+         pWeights.mHoles * pFeatures[FEATURE_HOLES] +
+         pWeights.mBumpiness * pFeatures[FEATURE_BUMPINESS] +
+         pWeights.mWells * pFeatures[FEATURE_WELLS] +
+         pWeights.mLines * pFeatures[FEATURE_LINES];
+}
+
+/*
+======================================
+Evaluate the shape of the stack, higher is better. Cleared lines are not
+part of the board and are scored by the caller with mLines
+
+Parameters:
+>> pBoard: board to evaluate
+>> pWeights: weight of every feature
+======================================
+*/
+double Evaluate(const BoardBits &pBoard, const EvalWeights &pWeights)
+{
+  FeatureVector mFeatures;
+  ExtractFeatures(pBoard, mFeatures);
+  return Evaluate(mFeatures, pWeights);
+}
+
+/*
+======================================
+Greedy bot, choose the placement of the piece with the best evaluation of
+the board it leaves
+
+Parameters:
+>> pBoard: board before the piece is stored
+>> pPieces: piece set
+>> pPiece: kind of the piece to place
+>> pWeights: weight of every feature
+>> pBest: returns the chosen placement
+>> pScore: returns its evaluation, if not NULL
+
+returns false if the piece has no placement
+======================================
+*/
+bool ChoosePlacement(const Board &pBoard, const Pieces &pPieces, int pPiece,
+                     const EvalWeights &pWeights, Placement &pBest,
+                     double *pScore)
+{
+  Placement mPlacements[MAX_PLACEMENTS];
+  FeatureVector mFeatures[MAX_PLACEMENTS];
+  int mCount = ExtractPlacementFeatures(pBoard.GetBits(), pPieces, pPiece,
+                                        mPlacements, mFeatures);
+
+  double mBestValue = 0;
+  for (int i = 0; i < mCount; i++)
+  {
+    double mValue = Evaluate(mFeatures[i], pWeights);
+    if (i == 0 || mValue > mBestValue)
+    {
+      mBestValue = mValue;
+      pBest = mPlacements[i];
+    }
+  }
+
+  if (pScore != NULL)
+    *pScore = mBestValue;
+  return mCount > 0;
+}
@@ -0,0 +1,392 @@
+/*****************************************************************************************
+ File: Expectimax.cpp
+ Desc: Parallel expectimax search over the placements of the coming pieces
+*****************************************************************************************/
+
+#include "include/Expectimax.h"
+#include <chrono>
+#include <cstring>
+
+// Monotonic time in nanoseconds
+static unsigned long long Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Placement of the root evaluated on the pool
+struct RootTask
+{
+  Expectimax *mSearch;
+  const BoardBits *mBoard;
+  Placement mPlacement;
+  int mPiece, mNextPiece, mDepth;
+  double mValue;
+
+  static void Run(void *pArg)
+  {
+    RootTask *mTask = (RootTask *)pArg;
+    unsigned long long mNodes = 0;
+    mTask->mValue = mTask->mSearch->PlacementValue(
+        *mTask->mBoard, mTask->mPlacement, mTask->mPiece, mTask->mNextPiece,
+        mTask->mDepth, mTask->mSearch->mArenas.Get(), mNodes);
+    mTask->mSearch->mNodes.fetch_add(mNodes, std::memory_order_relaxed);
+  }
+};
+
+// One kind of piece of a chance node evaluated on the pool
+struct ChanceTask
+{
+  Expectimax *mSearch;
+  const BoardBits *mBoard;
+  int mPiece, mDepth;
+  double mValue;
+
+  static void Run(void *pArg)
+  {
+    ChanceTask *mTask = (ChanceTask *)pArg;
+    unsigned long long mNodes = 0;
+    mTask->mValue =
+        mTask->mSearch->MaxNode(*mTask->mBoard, mTask->mPiece, -1, mTask->mDepth,
+                                mTask->mSearch->mArenas.Get(), mNodes);
+    mTask->mSearch->mNodes.fetch_add(mNodes, std::memory_order_relaxed);
+  }
+};
+
+/*
+======================================
+Init
+
+Parameters:
+>> pPieces: the piece set
+>> pPool: threads running the search
+>> pWeights: weights of the board evaluation
+>> pTableBits: log2 of the number of transposition table entries
+======================================
+*/
+Expectimax::Expectimax(const Pieces *pPieces, ThreadPool *pPool,
+                       const EvalWeights &pWeights, int pTableBits)
+    : mPieces(pPieces), mPool(pPool), mWeights(pWeights),
+      mTable(1ull << pTableBits), mTableMask((1ull << pTableBits) - 1),
+      mPeakNodes(0), mStop(false), mNodes(0), mTableHits(0), mDeadline(0)
+{
+  ClearTable();
+}
+
+/*
+======================================
+Forget every stored value, needed after changing the piece set
+======================================
+*/
+void Expectimax::ClearTable()
+{
+  for (size_t i = 0; i < mTable.size(); i++)
+  {
+    mTable[i].mCheck.store(0, std::memory_order_relaxed);
+    mTable[i].mValue.store(0, std::memory_order_relaxed);
+  }
+}
+
+/*
+======================================
+Find the best placement of the falling piece with iterative deepening: the
+search goes one ply deeper at a time until the time budget or the maximum
+depth is reached, and keeps the result of the deepest complete iteration.
+The first ply places the falling piece, the second the next piece, and the
+deeper ones average over every kind of piece
+
+Parameters:
+>> pBoard: current board
+>> pPiece: kind of the falling piece
+>> pNextPiece: kind of the next piece, -1 if unknown
+>> pTimeBudget: milliseconds to search, 0 for no limit
+>> pMaxDepth: maximum plies
+>> pStats: filled with the search statistics, can be NULL
+
+returns the best placement, with mRotation -1 if the piece can't be placed
+======================================
+*/
+Placement Expectimax::Search(const Board &pBoard, int pPiece, int pNextPiece,
+                             int pTimeBudget, int pMaxDepth,
+                             SearchStats *pStats)
+{
+  unsigned long long mStart = Now();
+  mDeadline = pTimeBudget > 0 ? mStart + pTimeBudget * 1000000ull : 0;
+  mStop.store(false);
+  mNodes.store(0);
+  mTableHits.store(0);
+
+  Placement mBest = {0, 0, -1};
+  int mDepth = 0;
+  for (int d = 1; d <= pMaxDepth; d++)
+  {
+    Placement mPlacement;
+    if (!SearchDepth(pBoard.GetBits(), pPiece, pNextPiece, d, &mPlacement))
+      break;
+
+    mBest = mPlacement;
+    mDepth = d;
+  }
+
+  // Out of time before the first ply completed, finish it anyway
+  if (mDepth == 0 && pMaxDepth > 0)
+  {
+    mDeadline = 0;
+    mStop.store(false);
+    SearchDepth(pBoard.GetBits(), pPiece, pNextPiece, 1, &mBest);
+    mDepth = 1;
+  }
+
+  // Every board of the decision is dropped at once
+  size_t mArenaNodes = mArenas.GetUsed();
+  if (mArenaNodes > mPeakNodes)
+    mPeakNodes = mArenaNodes;
+  mArenas.ResetAll();
+
+  if (pStats != NULL)
+  {
+    pStats->mNodes = mNodes.load();
+    pStats->mDepth = mDepth;
+    pStats->mSeconds = (Now() - mStart) / 1e9;
+    pStats->mTableHits = mTableHits.load();
+    pStats->mArenaNodes = mArenaNodes;
+    pStats->mArenaBytes = mArenaNodes * ARENA_NODE_SIZE;
+    pStats->mArenaPeakBytes = mPeakNodes * ARENA_NODE_SIZE;
+  }
+
+  return mBest;
+}
+
+/*
+======================================
+One iteration of the search, every root placement runs as a task
+
+returns false if the search was stopped before finishing
+======================================
+*/
+bool Expectimax::SearchDepth(const BoardBits &pBoard, int pPiece,
+                             int pNextPiece, int pDepth, Placement *pBest)
+{
+  Placement mPlacements[MAX_PLACEMENTS];
+  int mCount = EnumeratePlacements(pBoard, *mPieces, pPiece, mPlacements);
+
+  pBest->mRotation = -1;
+  if (mCount == 0)
+    return true;
+
+  RootTask mTasks[MAX_PLACEMENTS];
+  TaskGroup mGroup;
+  for (int i = 0; i < mCount; i++)
+  {
+    RootTask &mTask = mTasks[i];
+    mTask.mSearch = this;
+    mTask.mBoard = &pBoard;
+    mTask.mPlacement = mPlacements[i];
+    mTask.mPiece = pPiece;
+    mTask.mNextPiece = pNextPiece;
+    mTask.mDepth = pDepth;
+    mPool->Submit(mGroup, &RootTask::Run, &mTask);
+  }
+  mPool->Wait(mGroup);
+
+  if (mStop.load())
+    return false;
+
+  int mBest = 0;
+  for (int i = 1; i < mCount; i++)
+    if (mTasks[i].mValue > mTasks[mBest].mValue)
+      mBest = i;
+
+  *pBest = mPlacements[mBest];
+  return true;
+}
+
+/*
+======================================
+Value of storing a piece at a placement: the cleared lines plus the value
+of the resulting board with one ply less
+======================================
+*/
+double Expectimax::PlacementValue(const BoardBits &pBoard,
+                                  const Placement &pPlacement, int pPiece,
+                                  int pNextPiece, int pDepth,
+                                  SearchArena &pArena,
+                                  unsigned long long &pNodes)
+{
+  BoardBits *mBoard = pArena.NewNode(pBoard);
+  mBoard->StorePieces(*mPieces, pPlacement.mX, pPlacement.mY, pPiece,
+                      pPlacement.mRotation);
+  int mLines = mBoard->DeletePossibleLines();
+  pNodes++;
+
+  if (mBoard->IsGameOver())
+    return SEARCH_LOSS;
+
+  double mValue = mLines * mWeights.mLines;
+  if (pDepth == 1)
+    return mValue + Evaluate(*mBoard, mWeights);
+  if (pNextPiece >= 0)
+    return mValue +
+           MaxNode(*mBoard, pNextPiece, -1, pDepth - 1, pArena, pNodes);
+  return mValue + ChanceNode(*mBoard, pDepth - 1, pArena, pNodes);
+}
+
+/*
+======================================
+Max node, the best value over the placements of a known piece
+======================================
+*/
+double Expectimax::MaxNode(const BoardBits &pBoard, int pPiece,
+                           int pNextPiece, int pDepth, SearchArena &pArena,
+                           unsigned long long &pNodes)
+{
+  if (pDepth == 1)
+    return LeafNode(pBoard, pPiece, pNodes);
+
+  Placement mPlacements[MAX_PLACEMENTS];
+  int mCount = EnumeratePlacements(pBoard, *mPieces, pPiece, mPlacements);
+
+  double mBest = SEARCH_LOSS;
+  for (int i = 0; i < mCount; i++)
+  {
+    if (CheckStop())
+      break;
+
+    double mValue = PlacementValue(pBoard, mPlacements[i], pPiece, pNextPiece,
+                                   pDepth, pArena, pNodes);
+    if (mValue > mBest)
+      mBest = mValue;
+  }
+  return mBest;
+}
+
+/*
+======================================
+Max node of the last ply, the features of every placement are extracted
+together and only evaluated. A board with a full column is lost
+======================================
+*/
+double Expectimax::LeafNode(const BoardBits &pBoard, int pPiece,
+                            unsigned long long &pNodes)
+{
+  if (CheckStop())
+    return SEARCH_LOSS;
+
+  Placement mPlacements[MAX_PLACEMENTS];
+  FeatureVector mFeatures[MAX_PLACEMENTS];
+  int mCount = ExtractPlacementFeatures(pBoard, *mPieces, pPiece, mPlacements,
+                                        mFeatures);
+  pNodes += mCount;
+
+  double mBest = SEARCH_LOSS;
+  for (int i = 0; i < mCount; i++)
+  {
+    if (mFeatures[i][FEATURE_MAX_HEIGHT] == BOARD_HEIGHT)
+      continue;
+
+    double mValue = Evaluate(mFeatures[i], mWeights);
+    if (mValue > mBest)
+      mBest = mValue;
+  }
+  return mBest;
+}
+
+/*
+======================================
+Chance node, the average value over every kind of the unknown next piece.
+Values are shared between threads through the transposition table
+======================================
+*/
+double Expectimax::ChanceNode(const BoardBits &pBoard, int pDepth,
+                              SearchArena &pArena, unsigned long long &pNodes)
+{
+  unsigned long long mKey =
+      pBoard.Hash() ^ ((unsigned long long)pDepth * 0xc2b2ae3d27d4eb4full);
+
+  double mValue;
+  if (Lookup(mKey, mValue))
+    return mValue;
+
+  int mKinds = mPieces->GetKinds();
+  double mSum = 0;
+
+  if (pDepth >= SEARCH_PARALLEL_DEPTH && mPool->GetThreads() > 1)
+  {
+    ChanceTask mTasks[PIECES_MAX_KINDS];
+    TaskGroup mGroup;
+    for (int k = 0; k < mKinds; k++)
+    {
+      mTasks[k].mSearch = this;
+      mTasks[k].mBoard = &pBoard;
+      mTasks[k].mPiece = k;
+      mTasks[k].mDepth = pDepth;
+      mPool->Submit(mGroup, &ChanceTask::Run, &mTasks[k]);
+    }
+    mPool->Wait(mGroup);
+
+    for (int k = 0; k < mKinds; k++)
+      mSum += mTasks[k].mValue;
+  }
+  else
+  {
+    for (int k = 0; k < mKinds; k++)
+      mSum += MaxNode(pBoard, k, -1, pDepth, pArena, pNodes);
+  }
+
+  mValue = mSum / mKinds;
+
+  // A stopped search returns partial values, they must not be reused
+  if (!mStop.load(std::memory_order_relaxed))
+    Store(mKey, mValue);
+  return mValue;
+}
+
+/*
+======================================
+Transposition table access. Entries are replaced always, a lookup only
+hits when the whole key matches
+======================================
+*/
+bool Expectimax::Lookup(unsigned long long pKey, double &pValue)
+{
+  TableEntry &mEntry = mTable[pKey & mTableMask];
+  unsigned long long mBits = mEntry.mValue.load(std::memory_order_relaxed);
+  if ((mEntry.mCheck.load(std::memory_order_relaxed) ^ mBits) != pKey)
+    return false;
+
+  memcpy(&pValue, &mBits, sizeof(pValue));
+  mTableHits.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void Expectimax::Store(unsigned long long pKey, double pValue)
+{
+  unsigned long long mBits;
+  memcpy(&mBits, &pValue, sizeof(mBits));
+
+  TableEntry &mEntry = mTable[pKey & mTableMask];
+  mEntry.mValue.store(mBits, std::memory_order_relaxed);
+  mEntry.mCheck.store(pKey ^ mBits, std::memory_order_relaxed);
+}
+
+/*
+======================================
+Check the deadline every 256 calls on a thread, returns true once the
+search must stop
+======================================
+*/
+bool Expectimax::CheckStop()
+{
+  static thread_local unsigned int sChecks = 0;
+
+  if (mStop.load(std::memory_order_relaxed))
+    return true;
+
+  if (mDeadline != 0 && (++sChecks & 255) == 0 && Now() > mDeadline)
+  {
+    mStop.store(true);
+    return true;
+  }
+  return false;
+}
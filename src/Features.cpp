@@ -0,0 +1,269 @@
+/*****************************************************************************************
+ File: Features.cpp
+ Desc: Board features from the row masks, one board at a time or in batches
+*****************************************************************************************/
+
+#include "include/Features.h"
+#include "include/Lanes.h"
+
+// A row with a filled wall on each side: bit 0 is the left wall, bit x + 1
+// the block in column x and bit BOARD_WIDTH + 1 the right wall
+#define WALLED_ROW_WALLS (1 | (1 << (BOARD_WIDTH + 1)))
+#define WALLED_ROW_PAIRS ((1 << (BOARD_WIDTH + 1)) - 1) // neighbouring bits
+
+static const char *sNames[] = {
+    "height",    "max_height", "holes",    "covered",
+    "bumpiness", "wells",      "max_well", "row_transitions",
+    "column_transitions",      "lines",    "column_0",
+    "column_1",  "column_2",   "column_3", "column_4",
+    "column_5",  "column_6",   "column_7", "column_8",
+    "column_9"};
+
+static_assert(sizeof(sNames) / sizeof(sNames[0]) == FEATURE_COUNT,
+              "one name per feature and per column");
+
+const char *GetFeatureName(int pIndex) { return sNames[pIndex]; }
+
+/*
+======================================
+Features of the column heights: bumpiness and wells
+======================================
+*/
+static void ColumnFeatures(const int *pHeights, short *pOut)
+{
+  int mMaxHeight = 0, mBumpiness = 0, mWells = 0, mMaxWell = 0;
+
+  for (int i = 0; i < BOARD_WIDTH; i++)
+  {
+    pOut[FEATURE_COLUMN_HEIGHT + i] = pHeights[i];
+    if (pHeights[i] > mMaxHeight)
+      mMaxHeight = pHeights[i];
+    if (i > 0)
+      mBumpiness += pHeights[i] > pHeights[i - 1]
+                        ? pHeights[i] - pHeights[i - 1]
+                        : pHeights[i - 1] - pHeights[i];
+
+    int mLeft = i > 0 ? pHeights[i - 1] : BOARD_HEIGHT;
+    int mRight = i < BOARD_WIDTH - 1 ? pHeights[i + 1] : BOARD_HEIGHT;
+    int mDepth = (mLeft < mRight ? mLeft : mRight) - pHeights[i];
+    if (mDepth > 0)
+    {
+      mWells += mDepth;
+      if (mDepth > mMaxWell)
+        mMaxWell = mDepth;
+    }
+  }
+
+  pOut[FEATURE_MAX_HEIGHT] = mMaxHeight;
+  pOut[FEATURE_BUMPINESS] = mBumpiness;
+  pOut[FEATURE_WELLS] = mWells;
+  pOut[FEATURE_MAX_WELL] = mMaxWell;
+}
+
+/*
+======================================
+Features of one board. The rows are walked once from the top: the blocks
+filled in any row above make the holes of a row, and their popcount is the
+height the row adds to every column
+
+Parameters:
+>> pBoard: board to measure
+>> pOut: returns the features, lines cleared is 0
+======================================
+*/
+void ExtractFeatures(const BoardBits &pBoard, FeatureVector &pOut)
+{
+  short *mOut = pOut.mValues;
+  unsigned int mHoleRows[BOARD_HEIGHT];
+  unsigned int mAbove = 0, mPrevious = 0; // above the board is free
+  int mHeight = 0, mHoles = 0, mRowTransitions = 0, mColumnTransitions = 0;
+
+  for (int j = 0; j < BOARD_HEIGHT; j++)
+  {
+    unsigned int mRow = pBoard.mRows[j];
+    mHoleRows[j] = ~mRow & mAbove;
+    mHoles += __builtin_popcount(mHoleRows[j]);
+    mAbove |= mRow;
+    mHeight += __builtin_popcount(mAbove);
+
+    // The free rows over the stack don't count
+    if (mAbove != 0)
+    {
+      unsigned int mWalled = (mRow << 1) | WALLED_ROW_WALLS;
+      mRowTransitions +=
+          __builtin_popcount((mWalled ^ (mWalled >> 1)) & WALLED_ROW_PAIRS);
+    }
+    mColumnTransitions += __builtin_popcount(mRow ^ mPrevious);
+    mPrevious = mRow;
+  }
+  mColumnTransitions += __builtin_popcount(~mPrevious & BOARD_FULL_ROW);
+
+  // Filled blocks over the holes, from the floor up
+  unsigned int mBelow = 0;
+  int mCovered = 0;
+  for (int j = BOARD_HEIGHT - 1; j >= 0; j--)
+  {
+    mCovered += __builtin_popcount(pBoard.mRows[j] & mBelow);
+    mBelow |= mHoleRows[j];
+  }
+
+  int mHeights[BOARD_WIDTH];
+  for (int i = 0; i < BOARD_WIDTH; i++)
+    mHeights[i] = pBoard.GetColumnHeight(i);
+  ColumnFeatures(mHeights, mOut);
+
+  mOut[FEATURE_HEIGHT] = mHeight;
+  mOut[FEATURE_HOLES] = mHoles;
+  mOut[FEATURE_COVERED] = mCovered;
+  mOut[FEATURE_ROW_TRANSITIONS] = mRowTransitions;
+  mOut[FEATURE_COLUMN_TRANSITIONS] = mColumnTransitions;
+  mOut[FEATURE_LINES] = 0;
+}
+
+// Write one feature of the lanes in use
+static inline void StoreFeature(Lanes pValues, int pIndex, FeatureVector *pOut,
+                                int pLanes)
+{
+  unsigned short mValues[BATCH_WIDTH];
+  Store(mValues, pValues);
+  for (int l = 0; l < pLanes; l++)
+    pOut[l].mValues[pIndex] = mValues[l];
+}
+
+/*
+======================================
+Features of many boards, the same computation as for one board with a
+board in every lane: BATCH_WIDTH boards per vector instruction
+
+Parameters:
+>> pBoards: boards to measure
+>> pCount: number of boards
+>> pOut: returns the features of every board, lines cleared is 0
+======================================
+*/
+void ExtractFeatures(const BoardBits *pBoards, int pCount, FeatureVector *pOut)
+{
+  const Lanes mZero = Splat(0);
+  const Lanes mWalls = Splat(WALLED_ROW_WALLS);
+  const Lanes mPairs = Splat(WALLED_ROW_PAIRS);
+
+  for (int c = 0; c < pCount; c += BATCH_WIDTH)
+  {
+    int mLanes = pCount - c < BATCH_WIDTH ? pCount - c : BATCH_WIDTH;
+
+    // Row y and column height x of the boards side by side, the lanes past
+    // the last board hold empty boards
+    unsigned short mRows[BOARD_HEIGHT][BATCH_WIDTH];
+    unsigned short mHeights[BOARD_WIDTH][BATCH_WIDTH];
+    for (int l = 0; l < BATCH_WIDTH; l++)
+    {
+      const BoardBits *mBoard = l < mLanes ? &pBoards[c + l] : 0;
+      for (int j = 0; j < BOARD_HEIGHT; j++)
+        mRows[j][l] = mBoard ? mBoard->mRows[j] : 0;
+      for (int i = 0; i < BOARD_WIDTH; i++)
+        mHeights[i][l] = mBoard ? mBoard->GetColumnHeight(i) : 0;
+    }
+
+    Lanes mHoleRows[BOARD_HEIGHT];
+    Lanes mAbove = mZero, mPrevious = mZero;
+    Lanes mHeight = mZero, mHoles = mZero;
+    Lanes mRowTransitions = mZero, mColumnTransitions = mZero;
+    for (int j = 0; j < BOARD_HEIGHT; j++)
+    {
+      Lanes mRow = Load(mRows[j]);
+      mHoleRows[j] = AndNot(mRow, mAbove);
+      mHoles = Add(mHoles, PopCount(mHoleRows[j]));
+      mAbove = Or(mAbove, mRow);
+      mHeight = Add(mHeight, PopCount(mAbove));
+
+      Lanes mWalled = Or(ShiftLeft(mRow, 1), mWalls);
+      Lanes mChanges =
+          PopCount(And(Xor(mWalled, ShiftRight(mWalled, 1)), mPairs));
+      mRowTransitions =
+          Add(mRowTransitions, AndNot(CmpEq(mAbove, mZero), mChanges));
+      mColumnTransitions =
+          Add(mColumnTransitions, PopCount(Xor(mRow, mPrevious)));
+      mPrevious = mRow;
+    }
+    mColumnTransitions = Add(mColumnTransitions,
+                             PopCount(AndNot(mPrevious, Splat(BOARD_FULL_ROW))));
+
+    Lanes mBelow = mZero, mCovered = mZero;
+    for (int j = BOARD_HEIGHT - 1; j >= 0; j--)
+    {
+      mCovered = Add(mCovered, PopCount(And(Load(mRows[j]), mBelow)));
+      mBelow = Or(mBelow, mHoleRows[j]);
+    }
+
+    // Column features, the walls are full columns
+    const Lanes mWall = Splat(BOARD_HEIGHT);
+    Lanes mMaxHeight = mZero, mBumpiness = mZero;
+    Lanes mWells = mZero, mMaxWell = mZero;
+    Lanes mLeft = mWall, mColumn = Load(mHeights[0]);
+    for (int i = 0; i < BOARD_WIDTH; i++)
+    {
+      Lanes mRight = i < BOARD_WIDTH - 1 ? Load(mHeights[i + 1]) : mWall;
+      StoreFeature(mColumn, FEATURE_COLUMN_HEIGHT + i, pOut + c, mLanes);
+      mMaxHeight = Max(mMaxHeight, mColumn);
+      if (i > 0)
+        mBumpiness =
+            Add(mBumpiness, Sub(Max(mLeft, mColumn), Min(mLeft, mColumn)));
+
+      Lanes mDepth = Max(Sub(Min(mLeft, mRight), mColumn), mZero);
+      mWells = Add(mWells, mDepth);
+      mMaxWell = Max(mMaxWell, mDepth);
+
+      mLeft = mColumn;
+      mColumn = mRight;
+    }
+
+    StoreFeature(mHeight, FEATURE_HEIGHT, pOut + c, mLanes);
+    StoreFeature(mMaxHeight, FEATURE_MAX_HEIGHT, pOut + c, mLanes);
+    StoreFeature(mHoles, FEATURE_HOLES, pOut + c, mLanes);
+    StoreFeature(mCovered, FEATURE_COVERED, pOut + c, mLanes);
+    StoreFeature(mBumpiness, FEATURE_BUMPINESS, pOut + c, mLanes);
+    StoreFeature(mWells, FEATURE_WELLS, pOut + c, mLanes);
+    StoreFeature(mMaxWell, FEATURE_MAX_WELL, pOut + c, mLanes);
+    StoreFeature(mRowTransitions, FEATURE_ROW_TRANSITIONS, pOut + c, mLanes);
+    StoreFeature(mColumnTransitions, FEATURE_COLUMN_TRANSITIONS, pOut + c,
+                 mLanes);
+    StoreFeature(mZero, FEATURE_LINES, pOut + c, mLanes);
+  }
+}
+
+/*
+======================================
+Features of every placement of a piece, all of them measured together
+
+Parameters:
+>> pBoard: board before the piece is stored
+>> pPieces: piece set
+>> pPiece: kind of the piece to place
+>> pPlacements: returns the placements, room for MAX_PLACEMENTS
+>> pOut: returns the features of the board each placement leaves, with the
+   lines it clears; room for MAX_PLACEMENTS
+
+returns the number of placements
+======================================
+*/
+int ExtractPlacementFeatures(const BoardBits &pBoard, const Pieces &pPieces,
+                             int pPiece, Placement *pPlacements,
+                             FeatureVector *pOut)
+{
+  int mCount = EnumeratePlacements(pBoard, pPieces, pPiece, pPlacements);
+
+  BoardBits mBoards[MAX_PLACEMENTS];
+  int mLines[MAX_PLACEMENTS];
+  for (int i = 0; i < mCount; i++)
+  {
+    mBoards[i] = pBoard;
+    mBoards[i].StorePieces(pPieces, pPlacements[i].mX, pPlacements[i].mY,
+                           pPiece, pPlacements[i].mRotation);
+    mLines[i] = mBoards[i].DeletePossibleLines();
+  }
+
+  ExtractFeatures(mBoards, mCount, pOut);
+  for (int i = 0; i < mCount; i++)
+    pOut[i].mValues[FEATURE_LINES] = mLines[i];
+  return mCount;
+}
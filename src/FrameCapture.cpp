@@ -0,0 +1,220 @@
+/*****************************************************************************************
+ File: FrameCapture.cpp
+ Desc: Presented frames written as raw RGB or Y4M video by a writer thread
+*****************************************************************************************/
+
+#include "include/FrameCapture.h"
+#include <chrono>
+#include <cstring>
+
+/*
+======================================
+Init
+======================================
+*/
+FrameCapture::FrameCapture()
+    : mSourceWidth(0), mSourceHeight(0), mWidth(0), mHeight(0),
+      mConvert(false), mFile(NULL), mRunning(false),
+      mCaptured(0), mDropped(0), mWritten(0)
+{
+}
+
+FrameCapture::~FrameCapture() { Stop(); }
+
+/*
+======================================
+Open the output file, allocate the frame pool and start the writer thread.
+Files ending in ".y4m" get YUV 4:2:0 video, any other file raw RGB24 frames
+
+Parameters:
+>> pPath: file to write
+>> pWidth, pHeight: size of the frames in pixels
+>> pBuffers: frames that can wait for the writer before frames are dropped
+
+returns false if the file can't be opened
+======================================
+*/
+bool FrameCapture::Start(const char *pPath, int pWidth, int pHeight,
+                         int pBuffers)
+{
+  Stop();
+
+  size_t mLen = strlen(pPath);
+  mConvert = mLen > 4 && strcmp(pPath + mLen - 4, ".y4m") == 0;
+
+  mFile = fopen(pPath, "wb");
+  if (mFile == NULL)
+    return false;
+
+  mSourceWidth = mWidth = pWidth;
+  mSourceHeight = mHeight = pHeight;
+  if (mConvert)
+  {
+    // 4:2:0 needs even sizes, the last odd row or column is cut
+    mWidth &= ~1;
+    mHeight &= ~1;
+    fprintf(mFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", mWidth,
+            mHeight, CAPTURE_FPS);
+    mYuv.resize(mWidth * mHeight * 3 / 2);
+  }
+
+  if (pBuffers < 1)
+    pBuffers = 1;
+  if (pBuffers > CAPTURE_MAX_BUFFERS)
+    pBuffers = CAPTURE_MAX_BUFFERS;
+
+  for (int i = 0; i < pBuffers; i++)
+  {
+    mBuffers.push_back(new unsigned char[GetPitch() * mSourceHeight]);
+    mFree.Push(mBuffers.back());
+  }
+
+  mCaptured.store(0);
+  mDropped.store(0);
+  mWritten = 0;
+  mRunning.store(true);
+  mWriter = std::thread(&FrameCapture::WriterLoop, this);
+  return true;
+}
+
+/*
+======================================
+Write the frames still waiting, stop the writer thread and report the
+captured, written and dropped frames
+======================================
+*/
+void FrameCapture::Stop()
+{
+  if (mFile == NULL)
+    return;
+
+  mRunning.store(false);
+  mWriter.join();
+  fclose(mFile);
+  mFile = NULL;
+
+  unsigned char *mBuffer;
+  while (mFree.Pop(mBuffer))
+    ;
+  for (size_t i = 0; i < mBuffers.size(); i++)
+    delete[] mBuffers[i];
+  mBuffers.clear();
+
+  printf("capture: %llu frames captured, %llu written, %llu dropped\n",
+         mCaptured.load(), mWritten, mDropped.load());
+}
+
+/*
+======================================
+Take a free buffer for the next frame, called by the render thread
+
+returns NULL and counts a dropped frame if every buffer is in use
+======================================
+*/
+unsigned char *FrameCapture::AcquireBuffer()
+{
+  unsigned char *mBuffer;
+  if (!mFree.Pop(mBuffer))
+  {
+    mDropped.fetch_add(1, std::memory_order_relaxed);
+    return NULL;
+  }
+  return mBuffer;
+}
+
+/*
+======================================
+Hand a filled buffer to the writer, called by the render thread
+======================================
+*/
+void FrameCapture::SubmitBuffer(unsigned char *pBuffer)
+{
+  mCaptured.fetch_add(1, std::memory_order_relaxed);
+  mFilled.Push(pBuffer); // there are never more buffers than ring slots
+}
+
+/*
+======================================
+Writer thread, writes filled buffers and returns them to the pool
+======================================
+*/
+void FrameCapture::WriterLoop()
+{
+  unsigned char *mBuffer;
+  for (;;)
+  {
+    bool mRunningNow = mRunning.load();
+
+    bool mWrote = false;
+    while (mFilled.Pop(mBuffer))
+    {
+      WriteFrame(mBuffer);
+      mFree.Push(mBuffer);
+      mWrote = true;
+    }
+
+    if (!mRunningNow)
+      break;
+    if (!mWrote)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+/*
+======================================
+Write one frame in the format of the file
+======================================
+*/
+void FrameCapture::WriteFrame(const unsigned char *pPixels)
+{
+  if (mConvert)
+  {
+    ConvertToYuv(pPixels);
+    fputs("FRAME\n", mFile);
+    fwrite(&mYuv[0], 1, mYuv.size(), mFile);
+  }
+  else
+    fwrite(pPixels, 1, GetPitch() * mSourceHeight, mFile);
+
+  mWritten++;
+}
+
+/*
+======================================
+Convert an RGB24 frame to planar YUV 4:2:0 with full range BT.601, every
+chroma sample averages a 2x2 block
+======================================
+*/
+void FrameCapture::ConvertToYuv(const unsigned char *pPixels)
+{
+  int mPitch = GetPitch();
+  unsigned char *mY = &mYuv[0];
+  unsigned char *mU = mY + mWidth * mHeight;
+  unsigned char *mV = mU + mWidth * mHeight / 4;
+
+  for (int y = 0; y < mHeight; y++)
+  {
+    const unsigned char *mRow = pPixels + y * mPitch;
+    for (int x = 0; x < mWidth; x++)
+    {
+      const unsigned char *p = mRow + x * 3;
+      mY[y * mWidth + x] = (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+    }
+  }
+
+  for (int y = 0; y < mHeight / 2; y++)
+  {
+    const unsigned char *mRow0 = pPixels + 2 * y * mPitch;
+    const unsigned char *mRow1 = mRow0 + mPitch;
+    for (int x = 0; x < mWidth / 2; x++)
+    {
+      const unsigned char *a = mRow0 + 6 * x, *b = a + 3;
+      const unsigned char *c = mRow1 + 6 * x, *d = c + 3;
+      int mR = (a[0] + b[0] + c[0] + d[0]) >> 2;
+      int mG = (a[1] + b[1] + c[1] + d[1]) >> 2;
+      int mB = (a[2] + b[2] + c[2] + d[2]) >> 2;
+      mU[y * (mWidth / 2) + x] = ((-43 * mR - 85 * mG + 128 * mB) >> 8) + 128;
+      mV[y * (mWidth / 2) + x] = ((128 * mR - 107 * mG - 21 * mB) >> 8) + 128;
+    }
+  }
+}
@@ -2,17 +2,34 @@
 #include "include/Game.h"
 #include "include/Board.h"
 #include "include/IO.h"
+#include "include/Trace.h"
 #include <cstdlib>
 #include <string>
 
+// Gravity of every level in 1/256 rows per tick. Level 0 matches WAIT_TIME,
+// the last level drops the piece to the stack on every tick
+static const int mGravityTable[LEVEL_MAX + 1] = {
+    (GRAVITY_ONE_G * TICK_TIME + WAIT_TIME / 2) / WAIT_TIME, // ~WAIT_TIME
+    7, 9, 12, 16, 22, 32, 46, 68, 102, 160,
+    GRAVITY_ONE_G,     // 1G
+    2 * GRAVITY_ONE_G, // 2G
+    4 * GRAVITY_ONE_G, // 4G
+    8 * GRAVITY_ONE_G, // 8G
+    GRAVITY_20G        // 20G
+};
+
 /*
 ======================================
 Init
 ======================================
 */
-Game::Game(Board *pBoard, Pieces *pPieces, IO *pIO, int pScreenHeight)
+Game::Game(Board *pBoard, Pieces *pPieces, IO *pIO, int pScreenHeight,
+           int pStartLevel)
 {
   mScreenHeight = pScreenHeight;
+  mStartLevel = pStartLevel < 0          ? 0
+                : pStartLevel > LEVEL_MAX ? LEVEL_MAX
+                                          : pStartLevel;
 
   // Get the pointer to the Board and Pieces classes
   mBoard = pBoard;
@@ -20,9 +37,107 @@ Game::Game(Board *pBoard, Pieces *pPieces, IO *pIO, int pScreenHeight)
   mIO = pIO;
 
   // Game initialization
+  mSeed = (unsigned int)time(NULL);
+  mSequence = NULL;
+  mSequenceStart = mSequenceCursor = 0;
+  mRound = 0;
+  mTelemetry = NULL;
+  mMetrics = NULL;
+  mTimers = NULL;
+  mOwner = 0;
+  mGravityTimer = mLockTimer = mRepeatTimer = mEntryTimer = -1;
+  mRepeatMove = -1;
   InitGame();
 }
 
+/*
+======================================
+Start a new round in place. The board is emptied and the game state is
+initialized again, the pieces and IO are kept
+
+Parameters:
+>> pSeed: seed of the pieces of the new round
+======================================
+*/
+void Game::Reset() { Reset(mSeed * 2654435761u + 1); }
+
+void Game::Reset(unsigned int pSeed)
+{
+  mSeed = pSeed;
+  mBoard->Reset();
+  InitGame();
+}
+
+bool Game::IsGameOver() { return mGameOver; }
+bool Game::IsSpawning() { return mSpawning; }
+unsigned int Game::GetSeed() { return mSeed; }
+int Game::GetNextPiece() { return mNextPiece; }
+
+/*
+======================================
+Take the pieces from a sequence instead of the generator, from the next
+round on. Every round starts again at the same piece, so games given the
+same sequence and start see the same pieces; they spawn in rotation 0
+
+Parameters:
+>> pSequence: open sequence of the piece set, or NULL for the generator
+>> pStart: position of the first piece of every round, wraps around
+======================================
+*/
+void Game::SetSequence(const PieceSequence *pSequence,
+                       unsigned long long pStart)
+{
+  mSequence = pSequence;
+  mSequenceStart = pSequence != NULL ? pStart % pSequence->GetLength() : 0;
+}
+
+/*
+======================================
+Copy the state of the game into a plain structure
+======================================
+*/
+void Game::GetState(GameState &pState)
+{
+  for (int j = 0; j < BOARD_HEIGHT; j++)
+    pState.mRows[j] = mBoard->GetRow(j);
+
+  pState.mPiece = mPiece;
+  pState.mRotation = mRotation;
+  pState.mPosX = mPosX;
+  pState.mPosY = mPosY;
+  pState.mGhostY = mGhostY;
+  pState.mNextPiece = mNextPiece;
+  pState.mNextRotation = mNextRotation;
+  pState.mScore = score;
+  pState.mLevel = mLevel;
+  pState.mLines = mLines;
+  pState.mRound = mRound;
+  pState.mGameOver = mGameOver;
+  pState.mTick = mTicks;
+  pState.mSpawning = mSpawning;
+}
+
+/*
+======================================
+Send lock, line clear and game over events to a telemetry stream, NULL to
+stop sending them
+======================================
+*/
+void Game::SetTelemetry(Telemetry *pTelemetry)
+{
+  mTelemetry = pTelemetry;
+  if (mTelemetry != NULL)
+    mPieceStart = mRoundStart = mTelemetry->Now();
+}
+
+/*
+======================================
+Count ticks, pieces, line clears and game overs in the served metrics, NULL
+to stop counting
+======================================
+*/
+void Game::SetMetrics(Metrics *pMetrics) { mMetrics = pMetrics; }
+
 /*
  ===================================
   Score specific logic func
@@ -31,16 +146,48 @@ Game::Game(Board *pBoard, Pieces *pPieces, IO *pIO, int pScreenHeight)
 void Game::incrementScore() { score++; }
 int Game::getScore() { return score; }
 
+/*
+ ===================================
+  Level specific logic func
+ ===================================
+ */
+int Game::GetLevel() { return mLevel; }
+int Game::GetLines() { return mLines; }
+int Game::GetGravity() { return mGravityTable[mLevel]; }
+
+// The next piece of the round, from the sequence if there is one
+void Game::PickPiece(int &pPiece, int &pRotation)
+{
+  if (mSequence != NULL)
+  {
+    pPiece = mSequence->GetPiece(mSequenceCursor);
+    pRotation = 0;
+    if (++mSequenceCursor == mSequence->GetLength())
+      mSequenceCursor = 0;
+    if (pPiece >= 0)
+      return;
+    // a damaged file, the generator stands in for the piece
+  }
+
+  pPiece = GetRand(0, mPieces->GetKinds() - 1);
+  pRotation = GetRand(0, 3);
+}
+
 /*
 ======================================
-Get a random int between to integers
+Get a random int between to integers. Every game has its own generator so
+rounds can be replayed from their seed
 
 Parameters:
 >> pA: First number
 >> pB: Second number
 ======================================
 */
-int Game::GetRand(int pA, int pB) { return rand() % (pB - pA + 1) + pA; }
+int Game::GetRand(int pA, int pB)
+{
+  mRandState = mRandState * 1103515245u + 12345u;
+  return (int)((mRandState >> 16) & 0x7fff) % (pB - pA + 1) + pA;
+}
 
 /*
 ======================================
@@ -50,22 +197,46 @@ Initial parameters of the game
 void Game::InitGame()
 {
   // Init random numbers
-  srand((unsigned int)time(NULL));
+  mRandState = mSeed;
+  mSequenceCursor = mSequenceStart;
+  mGameOver = false;
 
   // reset score
   score = 0;
 
+  // reset level
+  mLevel = mStartLevel;
+  mLines = 0;
+  mGravityAcc = 0;
+
+  // a round starts with a falling piece and no timers
+  CancelTimers();
+  mSpawning = false;
+  mLockResets = 0;
+  mRepeatMove = -1;
+
+  // reset the round counters
+  mRound++;
+  mTicks = 0;
+  mPiecesPlaced = 0;
+  mKeys = mTotalKeys = 0;
+  if (mTelemetry != NULL)
+    mPieceStart = mRoundStart = mTelemetry->Now();
+
   // First piece
-  mPiece = GetRand(0, 6);
-  mRotation = GetRand(0, 3);
+  PickPiece(mPiece, mRotation);
   mPosX = (BOARD_WIDTH / 2) + mPieces->GetXInitialPosition(mPiece, mRotation);
   mPosY = mPieces->GetYInitialPosition(mPiece, mRotation);
 
   // Next piece
-  mNextPiece = GetRand(0, 6);
-  mNextRotation = GetRand(0, 3);
-  mNextPosX = BOARD_WIDTH + 5;
-  mNextPosY = 5;
+  PickPiece(mNextPiece, mNextRotation);
+
+  UpdateGhost();
+  if (mTimers != NULL)
+  {
+    ScheduleGravity();
+    UpdateLock(false);
+  }
 }
 
 /*
@@ -82,8 +253,525 @@ void Game::CreateNewPiece()
   mPosY = mPieces->GetYInitialPosition(mPiece, mRotation);
 
   // Random next piece
-  mNextPiece = GetRand(0, 6);
-  mNextRotation = GetRand(0, 3);
+  PickPiece(mNextPiece, mNextRotation);
+
+  mGravityAcc = 0;
+  mKeys = 0;
+  if (mTelemetry != NULL)
+    mPieceStart = mTelemetry->Now();
+  UpdateGhost();
+}
+
+/*
+======================================
+Move the falling piece one block, if possible
+
+returns true if the piece moved
+======================================
+*/
+bool Game::MoveLeft()
+{
+  mKeys++;
+  return Shift(-1);
+}
+
+bool Game::MoveRight()
+{
+  mKeys++;
+  return Shift(1);
+}
+
+bool Game::MoveDown()
+{
+  mKeys++;
+  return StepDown();
+}
+
+// Moves shared by the keys and their repeats
+bool Game::Shift(int pDx)
+{
+  if (mSpawning ||
+      !mBoard->IsPossibleMovement(mPosX + pDx, mPosY, mPiece, mRotation))
+    return false;
+
+  mPosX += pDx;
+  UpdateGhost();
+  UpdateLock(true);
+  return true;
+}
+
+bool Game::StepDown()
+{
+  if (mSpawning || mGhostY <= mPosY)
+    return false;
+
+  mPosY++;
+  UpdateLock(false);
+  return true;
+}
+
+/*
+======================================
+Rotate the falling piece, in place or moved by the first wall kick of the
+piece set that fits
+
+Parameters:
+>> pTurns: quarter turns clockwise, 1 clockwise, 2 half turn, 3
+   counter-clockwise; any other count is taken modulo a whole turn, and
+   whole turns don't rotate
+
+returns true if the piece rotated
+======================================
+*/
+bool Game::Rotate(int pTurns)
+{
+  pTurns = ((pTurns % PIECES_ROTATIONS) + PIECES_ROTATIONS) % PIECES_ROTATIONS;
+  if (pTurns == 0)
+    return false;
+
+  mKeys++;
+
+  int mNewRotation = (mRotation + pTurns) % PIECES_ROTATIONS;
+  if (mSpawning ||
+      mBoard->TryRotation(mPosX, mPosY, mPiece, mRotation, mNewRotation) < 0)
+    return false;
+
+  mRotation = mNewRotation;
+  UpdateGhost();
+  UpdateLock(true);
+  return true;
+}
+
+/*
+======================================
+Drop the falling piece to the stack and lock it
+
+returns true if the game is over
+======================================
+*/
+bool Game::HardDrop()
+{
+  if (mGameOver || mSpawning)
+    return mGameOver;
+
+  mKeys++;
+  mPosY = mGhostY;
+  return LockPiece();
+}
+
+/*
+======================================
+Advance gravity by one tick. The piece falls as many rows as the level
+gravity has accumulated, and locks once it rests on the stack
+
+returns true if the game is over
+======================================
+*/
+bool Game::ApplyGravity()
+{
+  if (mGameOver)
+    return true;
+
+  mTicks++;
+  if (mMetrics != NULL)
+    mMetrics->AddTicks(1);
+  mGravityAcc += mGravityTable[mLevel];
+  int mRows = mGravityAcc / GRAVITY_ONE_G;
+  mGravityAcc %= GRAVITY_ONE_G;
+
+  if (mRows == 0)
+    return false;
+
+  int mDistance = mGhostY - mPosY;
+  if (mDistance == 0)
+    return LockPiece();
+
+  mPosY += mRows < mDistance ? mRows : mDistance;
+  return false;
+}
+
+/*
+======================================
+Store the falling piece in the board, delete the completed lines and create
+the next piece, or start the entry delay when the game runs on timers
+
+returns true if the game is over
+======================================
+*/
+bool Game::LockPiece()
+{
+  {
+    TRACE_SCOPE("StorePieces");
+    mBoard->StorePieces(mPosX, mPosY, mPiece, mRotation);
+  }
+
+  int mCleared;
+  {
+    TRACE_SCOPE("DeletePossibleLines");
+    mCleared = mBoard->DeletePossibleLines();
+  }
+  mLines += mCleared;
+  mPiecesPlaced++;
+  mTotalKeys += mKeys;
+  int mNewLevel = mStartLevel + mLines / LEVEL_LINES;
+  if (mNewLevel > mLevel)
+    mLevel = mNewLevel > LEVEL_MAX ? LEVEL_MAX : mNewLevel;
+
+  if (mMetrics != NULL)
+    mMetrics->AddPiece(mCleared);
+  if (mTelemetry != NULL)
+  {
+    EmitTelemetry(TELEMETRY_LOCK, mCleared);
+    if (mCleared > 0)
+      EmitTelemetry(TELEMETRY_CLEAR, mCleared);
+  }
+
+  if (mBoard->IsGameOver())
+  {
+    EndGame();
+    return true;
+  }
+
+  // With timers the next piece comes after the line clear and entry delays
+  if (mTimers != NULL)
+    StartEntry(mCleared > 0);
+  else
+  {
+    TRACE_SCOPE("CreateNewPiece");
+    CreateNewPiece();
+  }
+
+  // score
+  incrementScore();
+
+  return false;
+}
+
+/*
+======================================
+Drive the game with timers of a wheel instead of ApplyGravity: gravity,
+lock delay, held key repeats and the line clear and entry delays become
+timers of pOwner, and every expired one must be passed to OnTimer. The
+wheel time is in milliseconds, several games can share one wheel
+
+Parameters:
+>> pTimers: wheel to schedule in, NULL to stop using timers
+>> pOwner: owner of the timers of this game
+======================================
+*/
+void Game::SetTimers(TimerWheel *pTimers, int pOwner)
+{
+  CancelTimers();
+  mTimers = pTimers;
+  mOwner = pOwner;
+
+  if (mTimers == NULL || mGameOver)
+    return;
+  if (mSpawning)
+    StartEntry(false);
+  else
+  {
+    ScheduleGravity();
+    UpdateLock(false);
+  }
+}
+
+/*
+======================================
+End the round, the board topped out
+======================================
+*/
+void Game::EndGame()
+{
+  mGameOver = true;
+  CancelTimers();
+  if (mMetrics != NULL)
+    mMetrics->AddGameOver();
+  if (mTelemetry != NULL)
+    EmitTelemetry(TELEMETRY_GAME_OVER, 0);
+}
+
+/*
+======================================
+Receive garbage lines from an opponent. The stack rises and the falling
+piece rides up with it when it would overlap the stack
+
+Parameters:
+>> pLines: garbage lines inserted at the bottom
+>> pHole: free column of the garbage lines
+
+returns true if the game is over
+======================================
+*/
+bool Game::AddGarbage(int pLines, int pHole)
+{
+  if (mGameOver || pLines <= 0)
+    return mGameOver;
+
+  bool mFits = mBoard->InsertGarbage(pLines, pHole);
+  bool mFree =
+      mSpawning || mBoard->IsPossibleMovement(mPosX, mPosY, mPiece, mRotation);
+  for (int j = 0; j < pLines && !mFree; j++)
+  {
+    mPosY--;
+    mFree = mBoard->IsPossibleMovement(mPosX, mPosY, mPiece, mRotation);
+  }
+
+  if (!mFits || !mFree || mBoard->IsGameOver())
+  {
+    EndGame();
+    return true;
+  }
+
+  if (!mSpawning)
+  {
+    UpdateGhost();
+    UpdateLock(false);
+  }
+  return false;
+}
+
+/*
+======================================
+Play an expired timer of this game
+======================================
+*/
+void Game::OnTimer(const TimerEvent &pEvent)
+{
+  switch (pEvent.mType)
+  {
+  case TIMER_GRAVITY:
+  {
+    mGravityTimer = -1;
+    if (mGameOver || mSpawning)
+      return;
+
+    mTicks += mGravityTicks;
+    if (mMetrics != NULL)
+      mMetrics->AddTicks(mGravityTicks);
+    mGravityAcc += mGravityTicks * mGravityTable[mLevel];
+    int mRows = mGravityAcc / GRAVITY_ONE_G;
+    mGravityAcc %= GRAVITY_ONE_G;
+
+    int mDistance = mGhostY - mPosY;
+    mPosY += mRows < mDistance ? mRows : mDistance;
+    UpdateLock(false);
+    ScheduleGravity();
+    break;
+  }
+
+  case TIMER_LOCK:
+  {
+    mLockTimer = -1;
+    if (!mGameOver && !mSpawning && mPosY == mGhostY)
+      LockPiece();
+    break;
+  }
+
+  case TIMER_REPEAT:
+  {
+    mRepeatTimer = -1;
+    if (mRepeatMove < 0)
+      return;
+    if (!mGameOver)
+      Repeat(mRepeatMove);
+    mRepeatTimer = mTimers->Schedule(pEvent.mDeadline + ARR_TIME, mOwner,
+                                     TIMER_REPEAT);
+    break;
+  }
+
+  case TIMER_CLEAR:
+  {
+    mEntryTimer = mTimers->Schedule(pEvent.mDeadline + ENTRY_DELAY, mOwner,
+                                    TIMER_ENTRY);
+    break;
+  }
+
+  case TIMER_ENTRY:
+  {
+    mEntryTimer = -1;
+    mSpawning = false;
+    mLockResets = 0;
+    {
+      TRACE_SCOPE("CreateNewPiece");
+      CreateNewPiece();
+    }
+    ScheduleGravity();
+    UpdateLock(false);
+    break;
+  }
+  }
+}
+
+/*
+======================================
+Hold a move down: it repeats after DAS_TIME and then every ARR_TIME until
+StopRepeat, the piece moves for the key itself. Only one move repeats, the
+last one held. Does nothing without timers
+======================================
+*/
+void Game::StartRepeat(int pMove)
+{
+  if (mTimers == NULL)
+    return;
+
+  mTimers->Cancel(mRepeatTimer);
+  mRepeatMove = pMove;
+  mRepeatTimer =
+      mTimers->Schedule(mTimers->GetNow() + DAS_TIME, mOwner, TIMER_REPEAT);
+}
+
+void Game::StopRepeat(int pMove)
+{
+  if (mTimers == NULL || mRepeatMove != pMove)
+    return;
+
+  mTimers->Cancel(mRepeatTimer);
+  mRepeatTimer = -1;
+  mRepeatMove = -1;
+}
+
+// A repeat of a held move, not counted as a key press
+bool Game::Repeat(int pMove)
+{
+  switch (pMove)
+  {
+  case MOVE_LEFT:
+    return Shift(-1);
+  case MOVE_RIGHT:
+    return Shift(1);
+  case MOVE_DOWN:
+    return StepDown();
+  }
+  return false;
+}
+
+/*
+======================================
+Schedule the gravity timer for the tick where the level gravity adds up to
+a whole row, so slow levels wake up once per row instead of every tick.
+The piece falls on the same ticks as with ApplyGravity
+======================================
+*/
+void Game::ScheduleGravity()
+{
+  mTimers->Cancel(mGravityTimer);
+
+  int mGravity = mGravityTable[mLevel];
+  mGravityTicks = (GRAVITY_ONE_G - mGravityAcc + mGravity - 1) / mGravity;
+  if (mGravityTicks < 1)
+    mGravityTicks = 1;
+  mGravityTimer = mTimers->Schedule(
+      mTimers->GetNow() + (unsigned long long)mGravityTicks * TICK_TIME, mOwner,
+      TIMER_GRAVITY);
+}
+
+/*
+======================================
+Start, restart or stop the lock delay after the piece moved. It runs while
+the piece rests on the stack; a move or rotation on the stack restarts it
+up to LOCK_RESETS times per piece
+
+Parameters:
+>> pMoved: the piece moved sideways or rotated
+======================================
+*/
+void Game::UpdateLock(bool pMoved)
+{
+  if (mTimers == NULL)
+    return;
+
+  if (mPosY != mGhostY)
+  {
+    mTimers->Cancel(mLockTimer);
+    mLockTimer = -1;
+    return;
+  }
+
+  if (mTimers->IsPending(mLockTimer))
+  {
+    if (!pMoved || mLockResets >= LOCK_RESETS)
+      return;
+    mLockResets++;
+    mTimers->Cancel(mLockTimer);
+  }
+  mLockTimer =
+      mTimers->Schedule(mTimers->GetNow() + LOCK_DELAY, mOwner, TIMER_LOCK);
+}
+
+/*
+======================================
+The piece locked: no piece falls until the line clear delay, if it cleared
+lines, and the entry delay have passed
+======================================
+*/
+void Game::StartEntry(bool pCleared)
+{
+  mTimers->Cancel(mGravityTimer);
+  mTimers->Cancel(mLockTimer);
+  mTimers->Cancel(mEntryTimer);
+  mGravityTimer = mLockTimer = -1;
+
+  mSpawning = true;
+  mEntryTimer = mTimers->Schedule(
+      mTimers->GetNow() + (pCleared ? CLEAR_DELAY : ENTRY_DELAY), mOwner,
+      pCleared ? TIMER_CLEAR : TIMER_ENTRY);
+}
+
+/*
+======================================
+Stop every timer of the game
+======================================
+*/
+void Game::CancelTimers()
+{
+  if (mTimers == NULL)
+    return;
+
+  mTimers->Cancel(mGravityTimer);
+  mTimers->Cancel(mLockTimer);
+  mTimers->Cancel(mRepeatTimer);
+  mTimers->Cancel(mEntryTimer);
+  mGravityTimer = mLockTimer = mRepeatTimer = mEntryTimer = -1;
+}
+
+/*
+======================================
+Send an event about the piece that was just locked, or about the round for
+TELEMETRY_GAME_OVER
+======================================
+*/
+void Game::EmitTelemetry(int pType, int pLines)
+{
+  unsigned long long mNow = mTelemetry->Now();
+
+  TelemetryEvent mEvent;
+  mEvent.mType = pType;
+  mEvent.mRound = mRound;
+  mEvent.mPieces = mPiecesPlaced;
+  mEvent.mPiece = mPiece;
+  mEvent.mRotation = mRotation;
+  mEvent.mLines = pLines;
+  mEvent.mTotalLines = mLines;
+  mEvent.mKeys = mKeys;
+  mEvent.mTotalKeys = mTotalKeys;
+  mEvent.mPieceTime = pType == TELEMETRY_GAME_OVER ? mNow - mRoundStart
+                                                   : mNow - mPieceStart;
+  mEvent.mScore = score;
+  mEvent.mLevel = mLevel;
+  mTelemetry->Emit(mEvent);
+}
+
+/*
+======================================
+Find the row where the falling piece would rest. Only needed when the piece
+moves sideways, rotates or a new piece appears, so drawing the ghost and
+dropping the piece cost nothing extra
+======================================
+*/
+void Game::UpdateGhost()
+{
+  mGhostY = mPosY + mBoard->GetDropDistance(mPosX, mPosY, mPiece, mRotation);
 }
 
 /*
@@ -105,29 +793,27 @@ void Game::DrawPiece(int pX, int pY, int pPiece, int pRotation)
   int mPixelsX = mBoard->GetXPosInPixels(pX);
   int mPixelsY = mBoard->GetYPosInPixels(pY);
 
-  // Travel the matrix of blocks of the piece and draw the blocks that are
-  // filled
-  for (int i = 0; i < PIECES_BLOCKS; i++)
+  // Travel the blocks of the piece and draw them
+  const PieceShape &mShape = mPieces->GetShape(pPiece, pRotation);
+  for (int c = 0; c < mShape.mNumCells; c++)
   {
-    for (int j = 0; j < PIECES_BLOCKS; j++)
+    int i = mShape.mCells[c].mX;
+    int j = mShape.mCells[c].mY;
+
+    // Get the type of the block and draw it with the correct color
+    switch (mShape.mCells[c].mType)
     {
-      // Get the type of the block and draw it with the correct color
-      switch (mPieces->GetBlockType(pPiece, pRotation, j, i))
-      {
-      case 1:
-        mColor = GREEN;
-        break; // For each block of the piece except the pivot
-      case 2:
-        mColor = BLUE;
-        break; // For the pivot
-      }
-
-      if (mPieces->GetBlockType(pPiece, pRotation, j, i) != 0)
-        mIO->DrawRectangle(mPixelsX + i * BLOCK_SIZE, mPixelsY + j * BLOCK_SIZE,
-                           (mPixelsX + i * BLOCK_SIZE) + BLOCK_SIZE - 1,
-                           (mPixelsY + j * BLOCK_SIZE) + BLOCK_SIZE - 1,
-                           mColor);
+    case 1:
+      mColor = GREEN;
+      break; // For each block of the piece except the pivot
+    default:
+      mColor = BLUE;
+      break; // For the pivot
     }
+
+    mIO->DrawRectangle(mPixelsX + i * BLOCK_SIZE, mPixelsY + j * BLOCK_SIZE,
+                       (mPixelsX + i * BLOCK_SIZE) + BLOCK_SIZE - 1,
+                       (mPixelsY + j * BLOCK_SIZE) + BLOCK_SIZE - 1, mColor);
   }
 }
 
@@ -138,7 +824,7 @@ void Game::DrawPiece(int pX, int pY, int pPiece, int pRotation)
   draw the two lines that delimit the board
  ==================================
 */
-void Game::DrawBoard()
+void Game::DrawBoard(const GameState &pState)
 {
   // Calculate the limits of the board in pixels
   int mX1 = BOARD_POSITION - (BLOCK_SIZE * (BOARD_WIDTH / 2)) - 1;
@@ -155,33 +841,66 @@ void Game::DrawBoard()
   // Check that the horizontal margin is not to small
   // assert (mX1 > MIN_HORIZONTAL_MARGIN);
 
-  // Drawing the blocks that are already stored in the board
-  mX1 += 1;
-  for (int i = 0; i < BOARD_WIDTH; i++)
+  // Drawing the blocks that are already stored in the board, the texture
+  // of the board only takes the rows that changed
+  mIO->DrawBoardCells(pState.mRows, mX1 + 1, mY, RED);
+
+  mIO->DrawScore(pState.mScore);
+}
+
+/*
+ ======================================
+  Draw the ghost piece at the row where the falling piece would rest
+ ======================================
+*/
+void Game::DrawGhost(const GameState &pState)
+{
+  if (pState.mGhostY == pState.mPosY)
+    return;
+
+  int mPixelsX = mBoard->GetXPosInPixels(pState.mPosX);
+  int mPixelsY = mBoard->GetYPosInPixels(pState.mGhostY);
+
+  const PieceShape &mShape = mPieces->GetShape(pState.mPiece, pState.mRotation);
+  for (int c = 0; c < mShape.mNumCells; c++)
   {
-    for (int j = 0; j < BOARD_HEIGHT; j++)
-    {
-      // Check if the block is filled, if so, draw it
-      if (!mBoard->IsFreeBlock(i, j))
-        mIO->DrawRectangle(mX1 + i * BLOCK_SIZE, mY + j * BLOCK_SIZE,
-                           (mX1 + i * BLOCK_SIZE) + BLOCK_SIZE - 1,
-                           (mY + j * BLOCK_SIZE) + BLOCK_SIZE - 1, RED);
-    }
+    int i = mShape.mCells[c].mX;
+    int j = mShape.mCells[c].mY;
+    mIO->DrawRectangle(mPixelsX + i * BLOCK_SIZE, mPixelsY + j * BLOCK_SIZE,
+                       (mPixelsX + i * BLOCK_SIZE) + BLOCK_SIZE - 1,
+                       (mPixelsY + j * BLOCK_SIZE) + BLOCK_SIZE - 1, GREY);
   }
-
-  mIO->DrawScore(score);
 }
 
 /*
  =======================================
   draw scene
-  draw all the objects of the scene
+  draw all the objects of the scene from a copy of the game state. Only the
+  state and the fixed layout are read, so the scene can be drawn by another
+  thread while the game goes on
+ =======================================
+*/
+void Game::DrawScene(const GameState &pState)
+{
+  DrawBoard(pState); // draw the delimitation lines and blocks stored in the board
+  if (!pState.mSpawning)
+  {
+    DrawGhost(pState); // draw where the playing piece would land
+    DrawPiece(pState.mPosX, pState.mPosY, pState.mPiece,
+              pState.mRotation); // draw playing piece
+  }
+  DrawPiece(NEXT_POS_X, NEXT_POS_Y, pState.mNextPiece,
+            pState.mNextRotation); // draw the next piece
+}
+
+/*
+ =======================================
+  draw the game over banner over the scene
  =======================================
 */
-void Game::DrawScene()
+void Game::DrawGameOver()
 {
-  DrawBoard();                                // draw the delimitation lines and blocks stored in the board
-  DrawPiece(mPosX, mPosY, mPiece, mRotation); // draw playing piece
-  DrawPiece(mNextPosX, mNextPosY, mNextPiece,
-            mNextRotation); // draw the next piece
+  int mY = mScreenHeight / 2 - 15;
+  mIO->DrawText("GAME OVER", BOARD_POSITION - 90, mY, BOARD_POSITION + 90,
+                mY + 30, RED);
 }
@@ -10,6 +10,13 @@
 // Initialize static members
 SDL_Window *IO::window = nullptr;
 SDL_Renderer *IO::renderer = nullptr;
+SDL_Texture *IO::boardTexture = nullptr;
+SDL_Texture *IO::cellTexture = nullptr;
+bool IO::boardTexturesFailed = false;
+Uint32 IO::boardPixels[BOARD_HEIGHT][BOARD_WIDTH];
+unsigned short IO::boardRows[BOARD_HEIGHT];
+int IO::boardColor = -1;
+Uint32 IO::wakeEvent = 0;
 
 // Color definitions in RGBA format for SDL2
 SDL_Color sdlColors[COLOR_MAX] = {
@@ -20,15 +27,21 @@ SDL_Color sdlColors[COLOR_MAX] = {
     {0, 255, 255, 255},  // CYAN
     {255, 0, 255, 255},  // MAGENTA
     {255, 255, 0, 255},  // YELLOW
-    {255, 255, 255, 255} // WHITE
+    {255, 255, 255, 255}, // WHITE
+    {64, 64, 64, 255}     // GREY
 };
 
 /*
 ======================================
 Constructor
+
+Parameters:
+>> pVsync: wait for the display on every present
 ======================================
 */
-IO::IO() { InitGraph(); }
+IO::IO(bool pVsync) { InitGraph(pVsync); }
+
+IO::~IO() { DestroyBoardTextures(); }
 
 /*
 ======================================
@@ -69,6 +82,128 @@ void IO::DrawRectangle(int pX1, int pY1, int pX2, int pY2, enum color pC)
   SDL_RenderFillRect(renderer, &rect);
 }
 
+// Color as a texel of an ARGB8888 texture
+static Uint32 GetTexel(const SDL_Color &pColor)
+{
+  return ((Uint32)pColor.a << 24) | ((Uint32)pColor.r << 16) |
+         ((Uint32)pColor.g << 8) | pColor.b;
+}
+
+/*
+======================================
+Create the board textures: a streaming one of one texel per cell, scaled
+up without filtering, and a static one with the border of every cell that
+is blended over it
+======================================
+*/
+bool IO::CreateBoardTextures()
+{
+  boardTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                   SDL_TEXTUREACCESS_STREAMING, BOARD_WIDTH,
+                                   BOARD_HEIGHT);
+  if (boardTexture == nullptr)
+    return false;
+  SDL_SetTextureScaleMode(boardTexture, SDL_ScaleModeNearest);
+
+  // The cell borders of the whole board in one bitmap, so they take a
+  // single copy: a dark edge around each cell, clear inside
+  const int mWidth = BOARD_WIDTH * BLOCK_SIZE;
+  const int mHeight = BOARD_HEIGHT * BLOCK_SIZE;
+  cellTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                  SDL_TEXTUREACCESS_STATIC, mWidth, mHeight);
+  if (cellTexture == nullptr)
+  {
+    DestroyBoardTextures();
+    return false;
+  }
+
+  Uint32 *mPattern = new Uint32[mWidth * mHeight];
+  for (int y = 0; y < mHeight; y++)
+    for (int x = 0; x < mWidth; x++)
+    {
+      int mCellX = x % BLOCK_SIZE, mCellY = y % BLOCK_SIZE;
+      bool mEdge = mCellX == 0 || mCellY == 0 || mCellX == BLOCK_SIZE - 1 ||
+                   mCellY == BLOCK_SIZE - 1;
+      mPattern[y * mWidth + x] = mEdge ? 0x60000000 : 0;
+    }
+  SDL_UpdateTexture(cellTexture, NULL, mPattern, mWidth * sizeof(Uint32));
+  delete[] mPattern;
+  SDL_SetTextureBlendMode(cellTexture, SDL_BLENDMODE_BLEND);
+
+  boardColor = -1;
+  return true;
+}
+
+// Free the board textures, they are made again when next needed
+void IO::DestroyBoardTextures()
+{
+  if (boardTexture != nullptr)
+    SDL_DestroyTexture(boardTexture);
+  if (cellTexture != nullptr)
+    SDL_DestroyTexture(cellTexture);
+  boardTexture = nullptr;
+  cellTexture = nullptr;
+}
+
+/*
+======================================
+Draw the blocks stored in the board with two texture copies, whatever the
+number of blocks. Only the rows that changed since the last call are sent
+to the texture, as one span
+
+Parameters:
+>> pRows: BOARD_HEIGHT rows, bit x of row y is the block (x, y)
+>> pX, pY: upper left corner of the board
+>> pC: color of the blocks
+======================================
+*/
+void IO::DrawBoardCells(const unsigned short *pRows, int pX, int pY, enum color pC)
+{
+  // Textures that couldn't be made aren't tried again every frame
+  if (boardTexture == nullptr && !boardTexturesFailed)
+    boardTexturesFailed = !CreateBoardTextures();
+
+  if (boardTexture == nullptr)
+  {
+    // No textures, a rectangle per block
+    for (int j = 0; j < BOARD_HEIGHT; j++)
+      for (int i = 0; i < BOARD_WIDTH; i++)
+        if (pRows[j] & (1 << i))
+          DrawRectangle(pX + i * BLOCK_SIZE, pY + j * BLOCK_SIZE,
+                        pX + i * BLOCK_SIZE + BLOCK_SIZE - 1,
+                        pY + j * BLOCK_SIZE + BLOCK_SIZE - 1, pC);
+    return;
+  }
+
+  int mFirst = BOARD_HEIGHT, mLast = -1;
+  for (int j = 0; j < BOARD_HEIGHT; j++)
+  {
+    if (boardColor == pC && pRows[j] == boardRows[j])
+      continue;
+
+    Uint32 mFilled = GetTexel(sdlColors[pC]);
+    Uint32 mEmpty = GetTexel(sdlColors[BLACK]);
+    for (int i = 0; i < BOARD_WIDTH; i++)
+      boardPixels[j][i] = (pRows[j] & (1 << i)) ? mFilled : mEmpty;
+    boardRows[j] = pRows[j];
+    if (mFirst > j)
+      mFirst = j;
+    mLast = j;
+  }
+  boardColor = pC;
+
+  if (mLast >= 0)
+  {
+    SDL_Rect mSpan = {0, mFirst, BOARD_WIDTH, mLast - mFirst + 1};
+    SDL_UpdateTexture(boardTexture, &mSpan, boardPixels[mFirst],
+                      sizeof(boardPixels[0]));
+  }
+
+  SDL_Rect mArea = {pX, pY, BOARD_WIDTH * BLOCK_SIZE, BOARD_HEIGHT * BLOCK_SIZE};
+  SDL_RenderCopy(renderer, boardTexture, NULL, &mArea);
+  SDL_RenderCopy(renderer, cellTexture, NULL, &mArea);
+}
+
 void IO::DrawText(const char *text, int pX1, int pY1, int pX2, int pY2, enum color pC)
 {
   // Calculate the total width available
@@ -183,6 +318,42 @@ void IO::DrawText(const char *text, int pX1, int pY1, int pX2, int pY2, enum col
       DrawRectangle(x + 2, pY1 + height - 5, x + charWidth - 4, pY1 + height - 3, pC); // Bottom
       break;
 
+    case 'g':
+    case 'G':
+      // Draw 'G' - a 'C' with a hook
+      DrawRectangle(x + 2, pY1 + 2, x + charWidth - 4, pY1 + 4, pC);                             // Top
+      DrawRectangle(x, pY1 + 4, x + 2, pY1 + height - 5, pC);                                    // Left
+      DrawRectangle(x + 2, pY1 + height - 5, x + charWidth - 4, pY1 + height - 3, pC);           // Bottom
+      DrawRectangle(x + charWidth - 4, pY1 + height / 2, x + charWidth - 2, pY1 + height - 3, pC); // Right-Bottom
+      DrawRectangle(x + charWidth / 2, pY1 + height / 2, x + charWidth - 2, pY1 + height / 2 + 2, pC); // Hook
+      break;
+
+    case 'a':
+    case 'A':
+      // Draw 'A'
+      DrawRectangle(x, pY1 + 4, x + 2, pY1 + height - 3, pC);                              // Left
+      DrawRectangle(x + 2, pY1 + 2, x + charWidth - 4, pY1 + 4, pC);                       // Top
+      DrawRectangle(x + charWidth - 4, pY1 + 4, x + charWidth - 2, pY1 + height - 3, pC);  // Right
+      DrawRectangle(x, pY1 + height / 2 - 1, x + charWidth - 2, pY1 + height / 2 + 1, pC); // Middle
+      break;
+
+    case 'm':
+    case 'M':
+      // Draw 'M'
+      DrawRectangle(x, pY1 + 2, x + 2, pY1 + height - 3, pC);                             // Left
+      DrawRectangle(x + charWidth - 4, pY1 + 2, x + charWidth - 2, pY1 + height - 3, pC); // Right
+      DrawRectangle(x, pY1 + 2, x + charWidth - 2, pY1 + 4, pC);                          // Top
+      DrawRectangle(x + charWidth / 2 - 1, pY1 + 2, x + charWidth / 2, pY1 + height / 2, pC); // Middle
+      break;
+
+    case 'v':
+    case 'V':
+      // Draw 'V'
+      DrawRectangle(x, pY1 + 2, x + 2, pY1 + height - 5, pC);                             // Left
+      DrawRectangle(x + charWidth - 4, pY1 + 2, x + charWidth - 2, pY1 + height - 5, pC); // Right
+      DrawRectangle(x + 2, pY1 + height - 5, x + charWidth - 4, pY1 + height - 3, pC);    // Bottom
+      break;
+
     case 'o':
     case 'O':
       // Draw 'O' (like a '0')
@@ -366,14 +537,72 @@ int IO::GetScreenHeight()
 
 /*
 ======================================
-Update screen
+Update screen. While capturing, the frame is read back into a free capture
+buffer first; with no free buffer the frame is dropped from the capture
 ======================================
 */
-void IO::UpdateScreen() { SDL_RenderPresent(renderer); }
+void IO::UpdateScreen()
+{
+  if (capture.IsCapturing())
+  {
+    unsigned char *pixels = capture.AcquireBuffer();
+    if (pixels != nullptr)
+    {
+      SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGB24, pixels,
+                           capture.GetPitch());
+      capture.SubmitBuffer(pixels);
+    }
+  }
+
+  SDL_RenderPresent(renderer);
+}
+
+/*
+======================================
+Start capturing every presented frame, see FrameCapture::Start
+
+Parameters:
+>> pPath: video file, ".y4m" for YUV video or anything else for raw RGB24
+>> pBuffers: frames that can wait for the writer before frames are dropped
+======================================
+*/
+bool IO::StartCapture(const char *pPath, int pBuffers)
+{
+  int width, height;
+  SDL_GetRendererOutputSize(renderer, &width, &height);
+  return capture.Start(pPath, width, height, pBuffers);
+}
+
+/*
+======================================
+Write the frames still waiting and stop capturing
+======================================
+*/
+void IO::StopCapture()
+{
+  capture.Stop();
+}
+
+// Key of an event: pressed keys as is, released keys with KEY_RELEASED and
+// -1 for anything else. The repeats of a held key are left to the game
+static int GetEventKey(const SDL_Event &pEvent)
+{
+  switch (pEvent.type)
+  {
+  case SDL_KEYDOWN:
+    return pEvent.key.repeat ? -1 : pEvent.key.keysym.sym;
+  case SDL_KEYUP:
+    return pEvent.key.keysym.sym | KEY_RELEASED;
+  case SDL_QUIT:
+    return SDLK_ESCAPE;
+  }
+  return -1;
+}
 
 /*
 ======================================
-Keyboard Input - Poll for a keypress
+Keyboard Input - Poll for a key pressed or released. Closing the window is
+reported as Escape so the game can shut down cleanly
 ======================================
 */
 int IO::PollKey()
@@ -381,17 +610,45 @@ int IO::PollKey()
   SDL_Event event;
   while (SDL_PollEvent(&event))
   {
-    switch (event.type)
-    {
-    case SDL_KEYDOWN:
-      return event.key.keysym.sym;
-    case SDL_QUIT:
-      exit(3);
-    }
+    int mKey = GetEventKey(event);
+    if (mKey != -1)
+      return mKey;
   }
   return -1;
 }
 
+/*
+======================================
+Keyboard Input - Like PollKey, but sleeps until an event comes. WakeUp
+ends the wait from another thread, with no key
+======================================
+*/
+int IO::WaitKey()
+{
+  SDL_Event event;
+  if (!SDL_WaitEvent(&event))
+    return -1;
+
+  int mKey = GetEventKey(event);
+  return mKey != -1 ? mKey : PollKey();
+}
+
+/*
+======================================
+Wake up a WaitKey, safe to call from any thread
+======================================
+*/
+void IO::WakeUp()
+{
+  if (wakeEvent == 0)
+    return;
+
+  SDL_Event event;
+  SDL_zero(event);
+  event.type = wakeEvent;
+  SDL_PushEvent(&event);
+}
+
 /*
 ======================================
 Keyboard Input - Wait for a keypress
@@ -429,7 +686,7 @@ int IO::IsKeyDown(int pKey)
 SDL2 Graphical Initialization
 ======================================
 */
-int IO::InitGraph()
+int IO::InitGraph(bool pVsync)
 {
   // Initialize SDL
   if (SDL_Init(SDL_INIT_VIDEO) < 0)
@@ -453,7 +710,8 @@ int IO::InitGraph()
 
   // Create renderer
   renderer = SDL_CreateRenderer(
-      window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+      window, -1,
+      SDL_RENDERER_ACCELERATED | (pVsync ? SDL_RENDERER_PRESENTVSYNC : 0));
 
   if (renderer == nullptr)
   {
@@ -464,5 +722,9 @@ int IO::InitGraph()
   // Set up blending
   SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
+  // Event other threads push to wake up the event loop
+  Uint32 mEvent = SDL_RegisterEvents(1);
+  wakeEvent = mEvent != (Uint32)-1 ? mEvent : 0;
+
   return 0;
 }
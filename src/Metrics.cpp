@@ -0,0 +1,360 @@
+/*****************************************************************************************
+ File: Metrics.cpp
+ Desc: Game counters and histograms served in the Prometheus text format by a
+       listener thread
+*****************************************************************************************/
+
+#include "include/Metrics.h"
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Frame time buckets in seconds, around the 16.7 ms of a 60 Hz display
+static const double sFrameBounds[METRICS_BUCKETS] = {
+    0.001, 0.002, 0.004, 0.008, 0.012, 0.016,
+    0.017, 0.020, 0.025, 0.033, 0.050, 0.100};
+
+/*
+======================================
+Init
+
+Parameters:
+>> pBounds: METRICS_BUCKETS increasing upper bounds
+======================================
+*/
+MetricsHistogram::MetricsHistogram(const double *pBounds)
+    : mBounds(pBounds), mSum(0)
+{
+  for (int i = 0; i <= METRICS_BUCKETS; i++)
+    mBuckets[i].store(0);
+}
+
+/*
+======================================
+Count a value in its bucket, the last one is +Inf. The count of the
+histogram is the sum of its buckets
+======================================
+*/
+void MetricsHistogram::Observe(double pValue)
+{
+  int mBucket = 0;
+  while (mBucket < METRICS_BUCKETS && pValue > mBounds[mBucket])
+    mBucket++;
+
+  mBuckets[mBucket].fetch_add(1, std::memory_order_relaxed);
+  mSum.fetch_add((unsigned long long)(pValue * 1e6 + 0.5),
+                 std::memory_order_relaxed);
+}
+
+/*
+======================================
+Init
+======================================
+*/
+Metrics::Metrics()
+    : mFrameTime(sFrameBounds), mFrames(0), mInputDepth(0), mInputDepthMax(0),
+      mPiecesPerSecond(0), mTicks(0), mPieces(0), mLines(0), mGameOvers(0),
+      mScrapes(0), mRunning(false), mSocket(-1), mPort(0)
+{
+  for (int i = 0; i < METRICS_CLEAR_SIZES; i++)
+    mClears[i].store(0);
+}
+
+Metrics::~Metrics() { Stop(); }
+
+/*
+======================================
+Listen on 127.0.0.1 and start the listener thread. Only local processes
+can connect, the fleet agent scrapes from the same machine
+
+Parameters:
+>> pPort: TCP port, 0 for any free port (see GetPort)
+
+returns false if the port can't be bound
+======================================
+*/
+bool Metrics::Start(int pPort)
+{
+  Stop();
+
+#ifdef _WIN32
+  return false;
+#else
+  mSocket = socket(AF_INET, SOCK_STREAM, 0);
+  if (mSocket < 0)
+    return false;
+
+  int mReuse = 1;
+  setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, &mReuse, sizeof(mReuse));
+
+  sockaddr_in mAddress;
+  memset(&mAddress, 0, sizeof(mAddress));
+  mAddress.sin_family = AF_INET;
+  mAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  mAddress.sin_port = htons((unsigned short)pPort);
+
+  socklen_t mLength = sizeof(mAddress);
+  if (bind(mSocket, (sockaddr *)&mAddress, sizeof(mAddress)) != 0 ||
+      listen(mSocket, 8) != 0 ||
+      getsockname(mSocket, (sockaddr *)&mAddress, &mLength) != 0)
+  {
+    close(mSocket);
+    mSocket = -1;
+    return false;
+  }
+  mPort = ntohs(mAddress.sin_port);
+
+  mRunning.store(true);
+  mListener = std::thread(&Metrics::ListenerLoop, this);
+  return true;
+#endif
+}
+
+/*
+======================================
+Stop the listener thread and close the socket
+======================================
+*/
+void Metrics::Stop()
+{
+  if (!mRunning.exchange(false))
+    return;
+  mListener.join();
+
+#ifndef _WIN32
+  close(mSocket);
+#endif
+  mSocket = -1;
+}
+
+/*
+======================================
+Samples of the main loop: the time since the last presented frame, the
+keys waiting for the simulation and the recent piece rate
+======================================
+*/
+void Metrics::AddFrame(double pSeconds)
+{
+  mFrameTime.Observe(pSeconds);
+  mFrames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::SetInputDepth(int pDepth)
+{
+  mInputDepth.store(pDepth, std::memory_order_relaxed);
+  if ((unsigned long long)pDepth > mInputDepthMax.load(std::memory_order_relaxed))
+    mInputDepthMax.store(pDepth, std::memory_order_relaxed);
+}
+
+void Metrics::SetPiecesPerSecond(double pRate)
+{
+  mPiecesPerSecond.store(pRate, std::memory_order_relaxed);
+}
+
+/*
+======================================
+Count a locked piece and the lines it cleared
+======================================
+*/
+void Metrics::AddPiece(int pLines)
+{
+  mPieces.fetch_add(1, std::memory_order_relaxed);
+  if (pLines <= 0)
+    return;
+
+  mLines.fetch_add(pLines, std::memory_order_relaxed);
+  int mSize = pLines < METRICS_CLEAR_SIZES ? pLines : METRICS_CLEAR_SIZES;
+  mClears[mSize - 1].fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+======================================
+Listener thread, serves one connection at a time. The socket is polled so
+Stop is noticed within METRICS_POLL_TIME
+======================================
+*/
+void Metrics::ListenerLoop()
+{
+#ifndef _WIN32
+  while (mRunning.load())
+  {
+    pollfd mPoll = {mSocket, POLLIN, 0};
+    if (poll(&mPoll, 1, METRICS_POLL_TIME) <= 0)
+      continue;
+
+    int mClient = accept(mSocket, NULL, NULL);
+    if (mClient < 0)
+      continue;
+    Serve(mClient);
+    close(mClient);
+  }
+#endif
+}
+
+/*
+======================================
+Answer one HTTP request: the metrics for GET /metrics, 404 for anything
+else. A client that doesn't send its request in time is dropped
+
+Parameters:
+>> pClient: connected socket
+======================================
+*/
+void Metrics::Serve(int pClient)
+{
+#ifndef _WIN32
+  char mRequest[METRICS_REQUEST_SIZE];
+  int mRead = 0;
+  while (mRead < METRICS_REQUEST_SIZE - 1)
+  {
+    pollfd mPoll = {pClient, POLLIN, 0};
+    if (poll(&mPoll, 1, METRICS_POLL_TIME * 10) <= 0)
+      return;
+    ssize_t mBytes = recv(pClient, mRequest + mRead,
+                          METRICS_REQUEST_SIZE - 1 - mRead, 0);
+    if (mBytes <= 0)
+      return;
+    mRead += (int)mBytes;
+    mRequest[mRead] = 0;
+    if (strstr(mRequest, "\r\n\r\n") != NULL || strstr(mRequest, "\n\n") != NULL)
+      break;
+  }
+
+  std::string mBody, mResponse;
+  const char *mStatus = "404 Not Found";
+  if (strncmp(mRequest, "GET /metrics ", 13) == 0 ||
+      strncmp(mRequest, "GET /metrics?", 13) == 0)
+  {
+    mScrapes.fetch_add(1, std::memory_order_relaxed);
+    Write(mBody);
+    mStatus = "200 OK";
+  }
+  else
+    mBody = "not found, try /metrics\n";
+
+  char mHeader[256];
+  snprintf(mHeader, sizeof(mHeader),
+           "HTTP/1.1 %s\r\n"
+           "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+           "Content-Length: %zu\r\n"
+           "Connection: close\r\n\r\n",
+           mStatus, mBody.size());
+  mResponse = mHeader + mBody;
+
+  size_t mSent = 0;
+  while (mSent < mResponse.size())
+  {
+    ssize_t mBytes = send(pClient, mResponse.data() + mSent,
+                          mResponse.size() - mSent, MSG_NOSIGNAL);
+    if (mBytes <= 0)
+      return;
+    mSent += mBytes;
+  }
+#endif
+}
+
+// Text of one metric with its HELP and TYPE lines
+static void WriteMetric(std::string &pOut, const char *pName,
+                        const char *pType, const char *pHelp, double pValue)
+{
+  char mLine[512];
+  snprintf(mLine, sizeof(mLine), "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n",
+           pName, pHelp, pName, pType, pName, pValue);
+  pOut += mLine;
+}
+
+// Resident set size of this process in bytes, 0 if unknown
+static double GetResidentBytes()
+{
+#ifdef _WIN32
+  return 0;
+#else
+  FILE *mFile = fopen("/proc/self/statm", "r");
+  if (mFile == NULL)
+    return 0;
+
+  unsigned long mSize = 0, mResident = 0;
+  int mFields = fscanf(mFile, "%lu %lu", &mSize, &mResident);
+  fclose(mFile);
+  return mFields == 2 ? (double)mResident * sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+/*
+======================================
+Append every metric in the Prometheus text exposition format. Counters are
+read one by one, a scrape may see a frame or a piece counted in one metric
+and not yet in another
+======================================
+*/
+void Metrics::Write(std::string &pOut)
+{
+  char mLine[256];
+
+  // Frame time histogram, cumulative buckets
+  pOut += "# HELP tetris_frame_seconds Time between presented frames.\n"
+          "# TYPE tetris_frame_seconds histogram\n";
+  unsigned long long mTotal = 0;
+  for (int i = 0; i <= METRICS_BUCKETS; i++)
+  {
+    mTotal += mFrameTime.mBuckets[i].load(std::memory_order_relaxed);
+    if (i < METRICS_BUCKETS)
+      snprintf(mLine, sizeof(mLine),
+               "tetris_frame_seconds_bucket{le=\"%g\"} %llu\n",
+               mFrameTime.mBounds[i], mTotal);
+    else
+      snprintf(mLine, sizeof(mLine),
+               "tetris_frame_seconds_bucket{le=\"+Inf\"} %llu\n", mTotal);
+    pOut += mLine;
+  }
+  snprintf(mLine, sizeof(mLine),
+           "tetris_frame_seconds_sum %.6f\ntetris_frame_seconds_count %llu\n",
+           mFrameTime.mSum.load(std::memory_order_relaxed) / 1e6, mTotal);
+  pOut += mLine;
+
+  WriteMetric(pOut, "tetris_frames_total", "counter", "Frames presented.",
+              (double)mFrames.load(std::memory_order_relaxed));
+  WriteMetric(pOut, "tetris_input_queue_depth", "gauge",
+              "Keys waiting for the simulation thread at the last frame.",
+              mInputDepth.load(std::memory_order_relaxed));
+  WriteMetric(pOut, "tetris_input_queue_depth_max", "gauge",
+              "Most keys ever waiting for the simulation thread.",
+              (double)mInputDepthMax.load(std::memory_order_relaxed));
+  WriteMetric(pOut, "tetris_sim_ticks_total", "counter",
+              "Gravity ticks simulated.",
+              (double)mTicks.load(std::memory_order_relaxed));
+  WriteMetric(pOut, "tetris_pieces_total", "counter", "Pieces locked.",
+              (double)mPieces.load(std::memory_order_relaxed));
+  WriteMetric(pOut, "tetris_pieces_per_second", "gauge",
+              "Pieces locked over the last second.",
+              mPiecesPerSecond.load(std::memory_order_relaxed));
+  WriteMetric(pOut, "tetris_lines_total", "counter", "Lines cleared.",
+              (double)mLines.load(std::memory_order_relaxed));
+
+  // Line clears by size
+  pOut += "# HELP tetris_line_clears_total Pieces that cleared lines, by "
+          "lines cleared at once.\n"
+          "# TYPE tetris_line_clears_total counter\n";
+  for (int i = 0; i < METRICS_CLEAR_SIZES; i++)
+  {
+    snprintf(mLine, sizeof(mLine), "tetris_line_clears_total{lines=\"%d%s\"} %llu\n",
+             i + 1, i == METRICS_CLEAR_SIZES - 1 ? "+" : "",
+             mClears[i].load(std::memory_order_relaxed));
+    pOut += mLine;
+  }
+
+  WriteMetric(pOut, "tetris_game_overs_total", "counter", "Rounds lost.",
+              (double)mGameOvers.load(std::memory_order_relaxed));
+  WriteMetric(pOut, "tetris_scrapes_total", "counter",
+              "Requests for the metrics, this one included.",
+              (double)mScrapes.load(std::memory_order_relaxed));
+  WriteMetric(pOut, "process_resident_memory_bytes", "gauge",
+              "Resident memory size in bytes.", GetResidentBytes());
+}
@@ -0,0 +1,714 @@
+/*****************************************************************************************
+ File: PerfectClear.cpp
+ Desc: Search for placements of the coming pieces that empty the board
+*****************************************************************************************/
+
+#include "include/PerfectClear.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// What a search below a board found
+#define SEARCH_FAIL 0
+#define SEARCH_FOUND 1
+#define SEARCH_ABORT 2 // a lower root placement already has a solution
+
+// Per thread counters, in the order of the PcStats fields
+#define COUNT_NODES 0
+#define COUNT_FAIL_HITS 1
+#define COUNT_PRUNED 2
+
+static const char *sResultNames[] = {"found",   "invalid",  "cells",
+                                     "regions", "enclosed", "exhausted"};
+
+const char *GetPcResultName(PcResult pResult) { return sResultNames[pResult]; }
+
+// Mask of a piece row placed with its matrix at column pX
+static inline unsigned int ShiftRow(unsigned int pRow, int pX)
+{
+  return pX >= 0 ? pRow << pX : pRow >> -pX;
+}
+
+// The bottom PC_MAX_HEIGHT rows, 10 bits each from the floor up. Nothing
+// is ever stored above them
+static unsigned long long PackRows(const BoardBits &pBoard)
+{
+  unsigned long long mRows = 0;
+  for (int i = 0; i < PC_MAX_HEIGHT; i++)
+    mRows |= (unsigned long long)pBoard.mRows[BOARD_HEIGHT - 1 - i]
+             << (BOARD_WIDTH * i);
+  return mRows;
+}
+
+static int Gcd(int a, int b) { return b == 0 ? a : Gcd(b, a % b); }
+
+// Free blocks of a row reachable from pReach moving sideways
+static inline unsigned int Spread(unsigned int pReach, unsigned int pFree)
+{
+  for (;;)
+  {
+    unsigned int mNext = (pReach | (pReach << 1) | (pReach >> 1)) & pFree;
+    if (mNext == pReach)
+      return pReach;
+    pReach = mNext;
+  }
+}
+
+// Placement of the first piece searched on the pool
+struct PcTask
+{
+  PerfectClear *mSolver;
+  const BoardBits *mBoard;
+  Placement mPlacement;
+  int mRoot, mHeight;
+  int mResult, mUsed;
+  Placement mPath[PC_MAX_PIECES];
+
+  static void Run(void *pArg)
+  {
+    PcTask *mTask = (PcTask *)pArg;
+    PerfectClear *mSolver = mTask->mSolver;
+    unsigned long long mCounts[COUNT_PRUNED + 3] = {0};
+
+    BoardBits mNext = *mTask->mBoard;
+    mNext.StorePieces(*mSolver->mPieces, mTask->mPlacement.mX,
+                      mTask->mPlacement.mY, mSolver->mSequence[0],
+                      mTask->mPlacement.mRotation);
+    int mLines = mNext.DeletePossibleLines();
+    mCounts[COUNT_NODES]++;
+
+    mTask->mPath[0] = mTask->mPlacement;
+    if (PackRows(mNext) == 0)
+    {
+      mTask->mResult = SEARCH_FOUND;
+      mTask->mUsed = 1;
+    }
+    else
+      mTask->mResult =
+          mSolver->Search(mNext, 1, mTask->mHeight - mLines, mTask->mRoot,
+                          mTask->mPath, mTask->mUsed, mCounts);
+
+    // Roots after this one can stop
+    if (mTask->mResult == SEARCH_FOUND)
+    {
+      int mFound = mSolver->mFoundRoot.load();
+      while (mTask->mRoot < mFound &&
+             !mSolver->mFoundRoot.compare_exchange_weak(mFound, mTask->mRoot))
+      {
+      }
+    }
+
+    mSolver->mNodes.fetch_add(mCounts[COUNT_NODES]);
+    mSolver->mFailHits.fetch_add(mCounts[COUNT_FAIL_HITS]);
+    for (int i = 0; i < 3; i++)
+      mSolver->mPruned[i].fetch_add(mCounts[COUNT_PRUNED + i]);
+  }
+};
+
+/*
+======================================
+Init
+
+Parameters:
+>> pPieces: the piece set
+>> pPool: threads running the search
+======================================
+*/
+PerfectClear::PerfectClear(const Pieces *pPieces, ThreadPool *pPool)
+    : mPieces(pPieces), mPool(pPool), mGeneration(0), mCount(0),
+      mFoundRoot(0), mNodes(0), mFailHits(0)
+{
+  for (int i = 0; i < 3; i++)
+    mPruned[i].store(0);
+  for (int i = 0; i < PC_SHARDS; i++)
+  {
+    State mEmpty = {0, -1, 0};
+    mShards[i].mStates.assign(1 << PC_SHARD_BITS, mEmpty);
+  }
+
+  // Rotations with the same blocks, compared from their top left block
+  memset(mSame, 0, sizeof(mSame));
+  for (int k = 0; k < mPieces->GetKinds(); k++)
+    for (int r = 0; r < PIECES_ROTATIONS; r++)
+      for (int q = 0; q < r; q++)
+      {
+        const PieceShape &mShape = mPieces->GetShape(k, r);
+        const PieceShape &mOther = mPieces->GetShape(k, q);
+        bool mEqual =
+            mShape.mMaxY - mShape.mMinY == mOther.mMaxY - mOther.mMinY;
+        for (int j = 0; mEqual && j <= mShape.mMaxY - mShape.mMinY; j++)
+          mEqual = mShape.mRows[mShape.mMinY + j] >> mShape.mMinX ==
+                   mOther.mRows[mOther.mMinY + j] >> mOther.mMinX;
+
+        Same &mEntry = mSame[k][r][q];
+        mEntry.mSame = mEqual;
+        mEntry.mDx = mShape.mMinX - mOther.mMinX;
+        mEntry.mDy = mShape.mMinY - mOther.mMinY;
+      }
+}
+
+// Entry of the failed state set, mixed so nearby boards spread out
+static unsigned long long HashState(unsigned long long pRows, int pIndex)
+{
+  unsigned long long mHash = pRows ^ ((unsigned long long)pIndex << 59);
+  mHash = (mHash ^ (mHash >> 30)) * 0xbf58476d1ce4e5b9ull;
+  mHash = (mHash ^ (mHash >> 27)) * 0x94d049bb133111ebull;
+  return mHash ^ (mHash >> 31);
+}
+
+bool PerfectClear::IsFailed(unsigned long long pRows, int pIndex)
+{
+  unsigned long long mHash = HashState(pRows, pIndex);
+  Shard &mShard = mShards[mHash % PC_SHARDS];
+  size_t mMask = mShard.mStates.size() - 1;
+  size_t mSlot = (mHash >> 8) & mMask;
+
+  std::lock_guard<std::mutex> mLock(mShard.mMutex);
+  for (int i = 0; i < PC_BUCKET; i++)
+  {
+    const State &mState = mShard.mStates[(mSlot + i) & mMask];
+    if (mState.mRows == pRows && mState.mIndex == pIndex &&
+        mState.mGeneration == mGeneration)
+      return true;
+  }
+  return false;
+}
+
+void PerfectClear::AddFailed(unsigned long long pRows, int pIndex)
+{
+  unsigned long long mHash = HashState(pRows, pIndex);
+  Shard &mShard = mShards[mHash % PC_SHARDS];
+  size_t mMask = mShard.mStates.size() - 1;
+  size_t mSlot = (mHash >> 8) & mMask;
+
+  // A stale entry if there is one, else any entry of the bucket
+  std::lock_guard<std::mutex> mLock(mShard.mMutex);
+  State *mVictim = &mShard.mStates[(mSlot + (mHash >> 60) % PC_BUCKET) & mMask];
+  for (int i = 0; i < PC_BUCKET; i++)
+  {
+    State &mState = mShard.mStates[(mSlot + i) & mMask];
+    if (mState.mGeneration != mGeneration)
+    {
+      mVictim = &mState;
+      break;
+    }
+  }
+  mVictim->mRows = pRows;
+  mVictim->mIndex = pIndex;
+  mVictim->mGeneration = mGeneration;
+}
+
+/*
+======================================
+Every position where a piece can rest inside the field, reached from above
+it by moving left, right, down and rotating with the wall kicks of the set
+as in the game.
+
+Positions are bit masks, bit X of a row is the piece at column
+X - PIECES_MAX_BLOCKS. For every rotation and row, the positions where the
+piece fits come from the board rows shifted by each block of the piece.
+The reachable ones start over the field, where the board is empty, and
+spread sideways, down and through the kicks of every rotation until
+nothing changes.
+Positions that fill the same blocks as one of an earlier rotation are
+returned once
+
+Parameters:
+>> pBoard: board to place the piece in
+>> pPiece: kind of the piece
+>> pTop: first row of the field
+>> pOut: array of at least PC_MAX_PLACEMENTS placements
+
+returns the number of placements
+======================================
+*/
+int PerfectClear::Enumerate(const BoardBits &pBoard, int pPiece, int pTop,
+                            Placement *pOut) const
+{
+  enum
+  {
+    OFFSET = PIECES_MAX_BLOCKS,
+    ROWS = BOARD_HEIGHT + 2 * PIECES_MAX_BLOCKS, // row y is at y + OFFSET
+  };
+  // Positions whose blocks all stay in the 32 bits of a walled row
+  const unsigned int mPositions = (1u << (32 - PIECES_MAX_BLOCKS)) - 1;
+
+  // Board rows with everything outside filled, the floor included
+  const unsigned int mOutside = ~((unsigned int)BOARD_FULL_ROW << OFFSET);
+  unsigned int mWalled[ROWS];
+  for (int i = 0; i < ROWS; i++)
+  {
+    int mY = i - OFFSET;
+    if (mY < 0)
+      mWalled[i] = mOutside;
+    else if (mY < BOARD_HEIGHT)
+      mWalled[i] = mOutside | ((unsigned int)pBoard.mRows[mY] << OFFSET);
+    else
+      mWalled[i] = ~0u;
+  }
+
+  unsigned int mFits[PIECES_ROTATIONS][ROWS], mReach[PIECES_ROTATIONS][ROWS];
+  int mFirst[PIECES_ROTATIONS], mLast[PIECES_ROTATIONS];
+  memset(mFits, 0, sizeof(mFits));
+  memset(mReach, 0, sizeof(mReach));
+
+  for (int r = 0; r < PIECES_ROTATIONS; r++)
+  {
+    const PieceShape &mShape = mPieces->GetShape(pPiece, r);
+    mFirst[r] = pTop - 1 - mShape.mMaxY;
+    if (mFirst[r] + mShape.mMinY < 0)
+      mFirst[r] = -mShape.mMinY;
+    mLast[r] = BOARD_HEIGHT - 1 - mShape.mMaxY;
+
+    // Rows above the first reached one are only for the kicks that land
+    // there, their positions are reached from the first one anyway
+    for (int mY = -OFFSET; mY <= mLast[r]; mY++)
+    {
+      unsigned int mBlocked = 0;
+      for (int j = mShape.mMinY; j <= mShape.mMaxY; j++)
+        for (unsigned int mRow = mShape.mRows[j]; mRow != 0; mRow &= mRow - 1)
+          mBlocked |= mWalled[mY + j + OFFSET] >> __builtin_ctz(mRow);
+      mFits[r][mY + OFFSET] = ~mBlocked & mPositions;
+    }
+    mReach[r][mFirst[r] + OFFSET] = mFits[r][mFirst[r] + OFFSET];
+  }
+
+  unsigned int mTurned[ROWS];
+  for (bool mChanged = true; mChanged;)
+  {
+    mChanged = false;
+    for (int r = 0; r < PIECES_ROTATIONS; r++)
+    {
+      // Positions reached turning into the rotation from the others, every
+      // one moved by the first of its kicks that fits as in the game
+      memset(mTurned, 0, sizeof(mTurned));
+      for (int f = 0; f < PIECES_ROTATIONS; f++)
+      {
+        if (f == r)
+          continue;
+        const KickTable &mKicks = mPieces->GetKicks(pPiece, f, r);
+        for (int i = mFirst[f] + OFFSET; i <= mLast[f] + OFFSET; i++)
+        {
+          unsigned int mLeft = mReach[f][i];
+          for (int k = 0; k < mKicks.mCount && mLeft != 0; k++)
+          {
+            int mDx = mKicks.mOffsets[k][0], j = i + mKicks.mOffsets[k][1];
+            unsigned int mFit = j < 0 ? mFits[r][0] : j < ROWS ? mFits[r][j] : 0;
+            unsigned int mMoved = ShiftRow(mLeft, mDx) & mFit;
+            mLeft &= ~ShiftRow(mMoved, -mDx);
+            if (j >= mFirst[r] + OFFSET && j <= mLast[r] + OFFSET)
+              mTurned[j] |= mMoved;
+          }
+        }
+      }
+
+      for (int i = mFirst[r] + OFFSET; i <= mLast[r] + OFFSET; i++)
+      {
+        unsigned int mNext = mReach[r][i] | mTurned[i];
+        if (i > mFirst[r] + OFFSET)
+          mNext |= mReach[r][i - 1] & mFits[r][i];
+        mNext = Spread(mNext, mFits[r][i]);
+        if (mNext != mReach[r][i])
+        {
+          mReach[r][i] = mNext;
+          mChanged = true;
+        }
+      }
+    }
+  }
+
+  // A piece that can't fall rests there, if all of it is inside the field
+  unsigned int mRest[PIECES_ROTATIONS][ROWS];
+  memset(mRest, 0, sizeof(mRest));
+  for (int r = 0; r < PIECES_ROTATIONS; r++)
+  {
+    const PieceShape &mShape = mPieces->GetShape(pPiece, r);
+    for (int i = mFirst[r] + OFFSET; i <= mLast[r] + OFFSET; i++)
+      if (i - OFFSET + mShape.mMinY >= pTop)
+        mRest[r][i] = mReach[r][i] & ~mFits[r][i + 1];
+  }
+
+  int mCount = 0;
+  for (int r = 0; r < PIECES_ROTATIONS; r++)
+    for (int i = mFirst[r] + OFFSET; i <= mLast[r] + OFFSET; i++)
+      for (unsigned int mBits = mRest[r][i]; mBits != 0; mBits &= mBits - 1)
+      {
+        int mX = __builtin_ctz(mBits);
+
+        bool mRepeated = false;
+        for (int q = 0; q < r && !mRepeated; q++)
+        {
+          const Same &mEntry = mSame[pPiece][r][q];
+          int mOtherY = i + mEntry.mDy, mOtherX = mX + mEntry.mDx;
+          mRepeated = mEntry.mSame && mOtherY >= 0 && mOtherY < ROWS &&
+                      mOtherX >= 0 && mOtherX < 32 &&
+                      (mRest[q][mOtherY] >> mOtherX & 1);
+        }
+        if (mRepeated || mCount == PC_MAX_PLACEMENTS)
+          continue;
+
+        Placement &mPlacement = pOut[mCount++];
+        mPlacement.mX = mX - OFFSET;
+        mPlacement.mY = i - OFFSET;
+        mPlacement.mRotation = r;
+      }
+
+  return mCount;
+}
+
+/*
+======================================
+Check that a board can still be cleared by the pieces left; every test only
+rejects boards that have no solution
+
+ - Cells: a clear of L lines needs L * BOARD_WIDTH blocks, the free cells
+   of those lines must be the blocks of the next few pieces
+ - Regions: a column filled in all L lines walls off both sides, a piece
+   can't cross it, so the free cells of each side must be a multiple of the
+   gcd of the piece sizes
+ - Enclosed: free blocks with no free path from above can only open when a
+   line just above or below them clears; a line holding enclosed blocks
+   that can never open can't clear, and when every line around a group of
+   enclosed blocks is like that, they stay enclosed for good. A kick can
+   move a piece through a wall, so a group with room for a whole piece
+   counts as open
+
+Parameters:
+>> pBoard: board to check
+>> pIndex: next piece of the sequence
+>> pHeight: lines of the field
+
+returns 0 or the PcResult of the first failed test
+======================================
+*/
+int PerfectClear::Prune(const BoardBits &pBoard, int pIndex,
+                        int pHeight) const
+{
+  int mTop = BOARD_HEIGHT - pHeight;
+  int mFilled = 0, mStack = 0;
+  for (int j = BOARD_HEIGHT - 1; j >= mTop; j--)
+  {
+    mFilled += __builtin_popcount(pBoard.mRows[j]);
+    if (pBoard.mRows[j] != 0)
+      mStack = BOARD_HEIGHT - j;
+  }
+
+  bool mCells = false, mRegions = false;
+  for (int mLines = mStack > 0 ? mStack : 1; mLines <= pHeight && !mRegions;
+       mLines++)
+  {
+    int mNeed = mLines * BOARD_WIDTH - mFilled;
+    bool mFits = false;
+    for (int i = pIndex + 1; i <= mCount && !mFits; i++)
+      mFits = mSums[i] - mSums[pIndex] == mNeed;
+    if (!mFits)
+      continue;
+    mCells = true;
+
+    unsigned int mWalls = BOARD_FULL_ROW;
+    for (int j = BOARD_HEIGHT - mLines; j < BOARD_HEIGHT; j++)
+      mWalls &= pBoard.mRows[j];
+
+    bool mWhole = true;
+    for (int mStart = 0, x = 0; x <= BOARD_WIDTH && mWhole; x++)
+    {
+      if (x < BOARD_WIDTH && !(mWalls & (1 << x)))
+        continue;
+
+      unsigned int mRegion = ((1 << x) - 1) & ~((1 << mStart) - 1);
+      int mFree = 0;
+      for (int j = BOARD_HEIGHT - mLines; j < BOARD_HEIGHT; j++)
+        mFree += __builtin_popcount(~pBoard.mRows[j] & mRegion);
+      mWhole = mFree % mGcds[pIndex] == 0;
+      mStart = x + 1;
+    }
+    mRegions = mWhole;
+  }
+  if (!mCells)
+    return PC_CELLS;
+  if (!mRegions)
+    return PC_REGIONS;
+
+  // Free blocks reachable from above the field, line i is row mTop + i
+  unsigned int mFree[PC_MAX_HEIGHT], mReach[PC_MAX_HEIGHT];
+  for (int i = 0; i < pHeight; i++)
+  {
+    mFree[i] = ~pBoard.mRows[mTop + i] & BOARD_FULL_ROW;
+    mReach[i] = 0;
+  }
+  mReach[0] = mFree[0];
+
+  for (bool mChanged = true; mChanged;)
+  {
+    mChanged = false;
+    for (int i = 0; i < pHeight; i++)
+    {
+      unsigned int mNext = mReach[i];
+      if (i > 0)
+        mNext |= mFree[i] & mReach[i - 1];
+      if (i < pHeight - 1)
+        mNext |= mFree[i] & mReach[i + 1];
+      mNext = Spread(mNext, mFree[i]);
+      mChanged = mChanged || mNext != mReach[i];
+      mReach[i] = mNext;
+    }
+  }
+
+  // Groups of enclosed blocks, with their first and last line and the
+  // groups in every line
+  unsigned int mLeft[PC_MAX_HEIGHT];
+  unsigned long long mLineGroups[PC_MAX_HEIGHT];
+  int mFirst[PC_MAX_HEIGHT * BOARD_WIDTH], mLast[PC_MAX_HEIGHT * BOARD_WIDTH];
+  int mSizes[PC_MAX_HEIGHT * BOARD_WIDTH];
+  int mGroups = 0;
+  for (int i = 0; i < pHeight; i++)
+  {
+    mLeft[i] = mFree[i] & ~mReach[i];
+    mLineGroups[i] = 0;
+  }
+
+  for (int i = 0; i < pHeight; i++)
+  {
+    while (mLeft[i] != 0)
+    {
+      unsigned int mGroup[PC_MAX_HEIGHT] = {0};
+      mGroup[i] = Spread(mLeft[i] & -mLeft[i], mLeft[i]);
+      for (bool mChanged = true; mChanged;)
+      {
+        mChanged = false;
+        for (int k = 0; k < pHeight; k++)
+        {
+          unsigned int mNext = mGroup[k];
+          if (k > 0)
+            mNext |= mLeft[k] & mGroup[k - 1];
+          if (k < pHeight - 1)
+            mNext |= mLeft[k] & mGroup[k + 1];
+          mNext = Spread(mNext, mLeft[k]);
+          mChanged = mChanged || mNext != mGroup[k];
+          mGroup[k] = mNext;
+        }
+      }
+
+      mFirst[mGroups] = pHeight;
+      mLast[mGroups] = -1;
+      mSizes[mGroups] = 0;
+      for (int k = 0; k < pHeight; k++)
+      {
+        if (mGroup[k] == 0)
+          continue;
+        mSizes[mGroups] += __builtin_popcount(mGroup[k]);
+        mLeft[k] &= ~mGroup[k];
+        mLineGroups[k] |= 1ull << mGroups;
+        if (k < mFirst[mGroups])
+          mFirst[mGroups] = k;
+        mLast[mGroups] = k;
+      }
+      mGroups++;
+    }
+  }
+  if (mGroups == 0)
+    return 0;
+
+  // A group can open when the line above or below it can clear, which
+  // needs every group in that line to open first. The floor never clears
+  unsigned long long mAll = mGroups == 64 ? ~0ull : (1ull << mGroups) - 1;
+  unsigned long long mOpen = 0;
+  for (int g = 0; g < mGroups; g++)
+    if (mSizes[g] >= mSmallest[pIndex])
+      mOpen |= 1ull << g;
+  for (bool mChanged = true; mChanged;)
+  {
+    mChanged = false;
+    for (int g = 0; g < mGroups; g++)
+    {
+      if (mOpen & (1ull << g))
+        continue;
+      int mAbove = mFirst[g] - 1, mBelow = mLast[g] + 1;
+      if (mAbove < 0 || (mLineGroups[mAbove] & ~mOpen) == 0 ||
+          (mBelow < pHeight && (mLineGroups[mBelow] & ~mOpen) == 0))
+      {
+        mOpen |= 1ull << g;
+        mChanged = true;
+      }
+    }
+  }
+  return mOpen == mAll ? 0 : PC_ENCLOSED;
+}
+
+/*
+======================================
+Depth first search below a board
+
+Parameters:
+>> pBoard: board with the pieces before pIndex placed, not empty
+>> pIndex: next piece of the sequence
+>> pHeight: lines of the field left
+>> pRoot: root placement of the search, it stops when a lower one has found
+   a solution
+>> pPath: returns the placements from pIndex on
+>> pUsed: returns the number of pieces of the solution
+>> pCounts: per thread counters
+
+returns SEARCH_FOUND, SEARCH_FAIL or SEARCH_ABORT
+======================================
+*/
+int PerfectClear::Search(const BoardBits &pBoard, int pIndex, int pHeight,
+                         int pRoot, Placement *pPath, int &pUsed,
+                         unsigned long long *pCounts)
+{
+  if (mFoundRoot.load(std::memory_order_relaxed) < pRoot)
+    return SEARCH_ABORT;
+  if (pIndex == mCount)
+    return SEARCH_FAIL;
+
+  unsigned long long mRows = PackRows(pBoard);
+  if (IsFailed(mRows, pIndex))
+  {
+    pCounts[COUNT_FAIL_HITS]++;
+    return SEARCH_FAIL;
+  }
+
+  int mPruned = Prune(pBoard, pIndex, pHeight);
+  if (mPruned != 0)
+  {
+    pCounts[COUNT_PRUNED + mPruned - PC_CELLS]++;
+    return SEARCH_FAIL;
+  }
+
+  int mPiece = mSequence[pIndex];
+  Placement mPlacements[PC_MAX_PLACEMENTS];
+  int mCount = Enumerate(pBoard, mPiece, BOARD_HEIGHT - pHeight, mPlacements);
+
+  for (int i = 0; i < mCount; i++)
+  {
+    const Placement &mPlacement = mPlacements[i];
+    BoardBits mNext = pBoard;
+    mNext.StorePieces(*mPieces, mPlacement.mX, mPlacement.mY, mPiece,
+                      mPlacement.mRotation);
+    int mLines = mNext.DeletePossibleLines();
+    pCounts[COUNT_NODES]++;
+
+    int mResult = SEARCH_FOUND;
+    if (PackRows(mNext) == 0)
+      pUsed = pIndex + 1;
+    else
+      mResult = Search(mNext, pIndex + 1, pHeight - mLines, pRoot, pPath,
+                       pUsed, pCounts);
+
+    if (mResult == SEARCH_FOUND)
+      pPath[pIndex] = mPlacement;
+    if (mResult != SEARCH_FAIL)
+      return mResult;
+  }
+
+  AddFailed(mRows, pIndex);
+  return SEARCH_FAIL;
+}
+
+/*
+======================================
+Find placements of the pieces, in order, that leave the board empty. The
+first piece that empties it ends the solution, the rest are not needed.
+Of the solutions the one found first depth first is returned, the same
+whatever the number of threads
+
+Parameters:
+>> pBoard: starting board, blocks only in the field
+>> pSequence: kinds of the coming pieces
+>> pCount: number of pieces, at most PC_MAX_PIECES
+>> pHeight: lines of the field, 1 to PC_MAX_HEIGHT
+>> pSolution: returns the placements, room for pCount
+>> pUsed: returns the number of pieces of the solution
+>> pStats: returns the search statistics, may be NULL
+
+returns PC_FOUND or why there is no solution
+======================================
+*/
+PcResult PerfectClear::Solve(const BoardBits &pBoard, const int *pSequence,
+                             int pCount, int pHeight, Placement *pSolution,
+                             int &pUsed, PcStats *pStats)
+{
+  std::chrono::steady_clock::time_point mStart =
+      std::chrono::steady_clock::now();
+  mNodes.store(0);
+  mFailHits.store(0);
+  for (int i = 0; i < 3; i++)
+    mPruned[i].store(0);
+  mGeneration++; // forget the failed states of the last solve
+  pUsed = 0;
+
+  bool mValid = pHeight >= 1 && pHeight <= PC_MAX_HEIGHT && pCount >= 1 &&
+                pCount <= PC_MAX_PIECES;
+  for (int j = 0; j < BOARD_HEIGHT - pHeight && mValid; j++)
+    mValid = pBoard.mRows[j] == 0;
+  for (int i = 0; i < pCount && mValid; i++)
+    mValid = pSequence[i] >= 0 && pSequence[i] < mPieces->GetKinds();
+
+  if (mValid)
+  {
+    mCount = pCount;
+    mSums[0] = 0;
+    for (int i = 0; i < pCount; i++)
+    {
+      mSequence[i] = pSequence[i];
+      mSums[i + 1] = mSums[i] + mPieces->GetShape(pSequence[i], 0).mNumCells;
+    }
+    mGcds[pCount] = 0;
+    mSmallest[pCount] = PC_MAX_HEIGHT * BOARD_WIDTH + 1;
+    for (int i = pCount - 1; i >= 0; i--)
+    {
+      int mCells = mPieces->GetShape(pSequence[i], 0).mNumCells;
+      mGcds[i] = Gcd(mCells, mGcds[i + 1]);
+      mSmallest[i] = std::min(mCells, mSmallest[i + 1]);
+    }
+
+  }
+
+  // The starting board may already be hopeless
+  int mCut = mValid ? Prune(pBoard, 0, pHeight) : PC_INVALID;
+  PcResult mResult = mCut != 0 ? (PcResult)mCut : PC_EXHAUSTED;
+
+  if (mCut == 0)
+  {
+    Placement mPlacements[PC_MAX_PLACEMENTS];
+    int mRoots =
+        Enumerate(pBoard, mSequence[0], BOARD_HEIGHT - pHeight, mPlacements);
+    mFoundRoot.store(mRoots);
+
+    PcTask mTasks[PC_MAX_PLACEMENTS];
+    TaskGroup mGroup;
+    for (int i = 0; i < mRoots; i++)
+    {
+      PcTask &mTask = mTasks[i];
+      mTask.mSolver = this;
+      mTask.mBoard = &pBoard;
+      mTask.mPlacement = mPlacements[i];
+      mTask.mRoot = i;
+      mTask.mHeight = pHeight;
+      mTask.mUsed = 0;
+      mPool->Submit(mGroup, &PcTask::Run, &mTask);
+    }
+    mPool->Wait(mGroup);
+
+    int mFound = mFoundRoot.load();
+    if (mFound < mRoots)
+    {
+      mResult = PC_FOUND;
+      pUsed = mTasks[mFound].mUsed;
+      for (int i = 0; i < pUsed; i++)
+        pSolution[i] = mTasks[mFound].mPath[i];
+    }
+  }
+
+  if (pStats != NULL)
+  {
+    pStats->mNodes = mNodes.load();
+    pStats->mFailHits = mFailHits.load();
+    for (int i = 0; i < 3; i++)
+      pStats->mPruned[i] = mPruned[i].load();
+    pStats->mSeconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - mStart)
+                           .count();
+  }
+  return mResult;
+}
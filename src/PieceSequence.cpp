@@ -0,0 +1,215 @@
+/*****************************************************************************************
+ File: PieceSequence.cpp
+ Desc: Pre-generated piece sequences in memory mapped files
+*****************************************************************************************/
+
+#include "include/PieceSequence.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bytes of the packed pieces of a sequence, with the spare byte
+static size_t PackedSize(unsigned long long pLength)
+{
+  return (size_t)((pLength * SEQUENCE_BITS + 7) / 8) + 1;
+}
+
+// Same generator as Game::GetRand, a piece in [0, pKinds)
+static int NextPiece(unsigned int &pState, int pKinds)
+{
+  pState = pState * 1103515245u + 12345u;
+  return (int)((pState >> 16) & 0x7fff) % pKinds;
+}
+
+/*
+======================================
+Init, no file
+======================================
+*/
+PieceSequence::PieceSequence() : mHeader(NULL), mBits(NULL), mSize(0) {}
+
+PieceSequence::~PieceSequence() { Close(); }
+
+/*
+======================================
+Map a sequence file read-only and check it was made for the piece set.
+Only the header and the size are checked, the pieces are left on disk
+until they are read and GetPiece checks each of them then
+
+returns false if it isn't a sequence file of the piece set
+======================================
+*/
+bool PieceSequence::Open(const char *pPath, const Pieces &pPieces)
+{
+#ifdef _WIN32
+  return false;
+#else
+  Close();
+  int mFd = open(pPath, O_RDONLY);
+  if (mFd < 0)
+    return false;
+
+  struct stat mStat;
+  SequenceHeader mRead;
+  bool mValid =
+      fstat(mFd, &mStat) == 0 && mStat.st_size >= (off_t)sizeof(mRead) &&
+      pread(mFd, &mRead, sizeof(mRead), 0) == (ssize_t)sizeof(mRead) &&
+      mRead.mMagic == SEQUENCE_MAGIC && mRead.mVersion == SEQUENCE_VERSION &&
+      mRead.mPolicy < SEQUENCE_POLICIES &&
+      mRead.mKinds == (unsigned int)pPieces.GetKinds() &&
+      mRead.mPieceSet == pPieces.GetHash() && mRead.mLength > 0 &&
+      (size_t)mStat.st_size == sizeof(mRead) + PackedSize(mRead.mLength);
+
+  void *mMemory = MAP_FAILED;
+  if (mValid)
+    mMemory = mmap(NULL, mStat.st_size, PROT_READ, MAP_SHARED, mFd, 0);
+  close(mFd);
+  if (mMemory == MAP_FAILED)
+    return false;
+
+  mHeader = (const SequenceHeader *)mMemory;
+  mBits = (const unsigned char *)mMemory + sizeof(SequenceHeader);
+  mSize = mStat.st_size;
+  return true;
+#endif
+}
+
+void PieceSequence::Close()
+{
+#ifndef _WIN32
+  if (mHeader != NULL)
+    munmap((void *)mHeader, mSize);
+#endif
+  mHeader = NULL;
+  mBits = NULL;
+  mSize = 0;
+}
+
+/*
+======================================
+Fingerprint of the sequence, from the settings it was drawn with
+======================================
+*/
+unsigned long long PieceSequence::GetHash() const
+{
+  unsigned long long mValues[] = {mHeader->mSeed, mHeader->mPolicy,
+                                  mHeader->mKinds, mHeader->mPieceSet,
+                                  mHeader->mLength};
+  unsigned long long mHash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < sizeof(mValues) / sizeof(mValues[0]); i++)
+  {
+    mHash ^= mValues[i];
+    mHash *= 0x100000001b3ull;
+  }
+  return mHash;
+}
+
+/*
+======================================
+Draw a sequence and write it to a file. It is written under a temporary
+name and renamed, so the file is never seen half written
+
+Parameters:
+>> pPath: sequence file
+>> pPieces: piece set, SEQUENCE_MAX_KINDS pieces at most
+>> pSeed, pPolicy: how the pieces are drawn, the same ones always give the
+   same sequence
+>> pLength: pieces in the sequence
+
+returns false if the set has too many pieces or the file can't be written
+======================================
+*/
+bool PieceSequence::Write(const char *pPath, const Pieces &pPieces,
+                          unsigned int pSeed, int pPolicy,
+                          unsigned long long pLength)
+{
+  int mKinds = pPieces.GetKinds();
+  if (mKinds > SEQUENCE_MAX_KINDS || pPolicy < 0 ||
+      pPolicy >= SEQUENCE_POLICIES || pLength == 0)
+    return false;
+
+  std::string mTemp = std::string(pPath) + ".tmp";
+  FILE *mFile = fopen(mTemp.c_str(), "wb");
+  if (mFile == NULL)
+    return false;
+
+  SequenceHeader mHeader;
+  memset(&mHeader, 0, sizeof(mHeader));
+  mHeader.mMagic = SEQUENCE_MAGIC;
+  mHeader.mVersion = SEQUENCE_VERSION;
+  mHeader.mSeed = pSeed;
+  mHeader.mPolicy = pPolicy;
+  mHeader.mKinds = mKinds;
+  mHeader.mPieceSet = pPieces.GetHash();
+  mHeader.mLength = pLength;
+  bool mOk = fwrite(&mHeader, sizeof(mHeader), 1, mFile) == 1;
+
+  // Pieces go into a bit accumulator, written out a block at a time
+  std::vector<unsigned char> mBlock;
+  mBlock.reserve(1 << 16);
+  unsigned int mState = pSeed;
+  int mBag[SEQUENCE_MAX_KINDS];
+  int mBagLeft = 0;
+  unsigned int mAccumulator = 0;
+  int mAccumulated = 0;
+  for (unsigned long long i = 0; i < pLength && mOk; i++)
+  {
+    int mPiece;
+    if (pPolicy == SEQUENCE_BAG)
+    {
+      // A new bag is every kind shuffled, dealt from the end
+      if (mBagLeft == 0)
+      {
+        for (int k = 0; k < mKinds; k++)
+          mBag[k] = k;
+        for (int k = mKinds - 1; k > 0; k--)
+        {
+          int mOther = NextPiece(mState, k + 1);
+          int mSwap = mBag[k];
+          mBag[k] = mBag[mOther];
+          mBag[mOther] = mSwap;
+        }
+        mBagLeft = mKinds;
+      }
+      mPiece = mBag[--mBagLeft];
+    }
+    else
+      mPiece = NextPiece(mState, mKinds);
+
+    mAccumulator |= mPiece << mAccumulated;
+    mAccumulated += SEQUENCE_BITS;
+    while (mAccumulated >= 8)
+    {
+      mBlock.push_back(mAccumulator & 0xff);
+      mAccumulator >>= 8;
+      mAccumulated -= 8;
+    }
+    if (mBlock.size() >= (1 << 16))
+    {
+      mOk = fwrite(&mBlock[0], 1, mBlock.size(), mFile) == mBlock.size();
+      mBlock.clear();
+    }
+  }
+
+  // The last partial byte and the spare byte
+  if (mAccumulated > 0)
+    mBlock.push_back(mAccumulator & 0xff);
+  mBlock.push_back(0);
+  mOk = mOk && fwrite(&mBlock[0], 1, mBlock.size(), mFile) == mBlock.size();
+
+  mOk = fclose(mFile) == 0 && mOk;
+  if (!mOk)
+  {
+    remove(mTemp.c_str());
+    return false;
+  }
+  return rename(mTemp.c_str(), pPath) == 0;
+}
@@ -1,28 +1,496 @@
 #include "include/Pieces.h"
 #include "assets/Blocks.cpp"
+#include "SrsKicks.cpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Names of the built-in pieces, in the order of their matrices
+static const char *sBuiltInNames[PIECES_KINDS] = {"O", "I", "L", "J",
+                                                  "Z", "S", "T"};
+
+Pieces::Pieces() { InitBuiltIn(); }
+
+// Compile the built-in 7 pieces with their hand made rotations and
+// initial positions
+void Pieces::InitBuiltIn()
+{
+  mKinds = PIECES_KINDS;
+  mSize = PIECES_BLOCKS;
+  for (int k = 0; k < PIECES_KINDS; k++)
+    strcpy(mNames[k], sBuiltInNames[k]);
+
+  for (int k = 0; k < PIECES_KINDS; k++)
+    for (int r = 0; r < PIECES_ROTATIONS; r++)
+    {
+      int mMatrix[PIECES_MAX_BLOCKS][PIECES_MAX_BLOCKS] = {{0}};
+      for (int y = 0; y < PIECES_BLOCKS; y++)
+        for (int x = 0; x < PIECES_BLOCKS; x++)
+          mMatrix[y][x] = mPieces[k][r][y][x];
+
+      CompileShape(mShapes[k][r], mMatrix, mPiecesInitialPosition[k][r][0],
+                   mPiecesInitialPosition[k][r][1]);
+    }
+
+  std::istringstream mDefault(sDefaultKicks);
+  LoadKicks(mDefault, "built-in");
+}
+
+// Compile a piece matrix into row masks, bottom profile, bounding box and
+// cell list, the formats used by the board and the drawing
+// pShape - shape to fill
+// pMatrix - block types, pMatrix[row][column]
+// pInitialX, pInitialY - displacement to create the piece
+void Pieces::CompileShape(PieceShape &pShape,
+                          const int pMatrix[][PIECES_MAX_BLOCKS],
+                          int pInitialX, int pInitialY)
+{
+  memset(&pShape, 0, sizeof(pShape));
+  pShape.mMinX = pShape.mMinY = PIECES_MAX_BLOCKS;
+  pShape.mMaxX = pShape.mMaxY = -1;
+  pShape.mInitialX = pInitialX;
+  pShape.mInitialY = pInitialY;
+
+  for (int x = 0; x < PIECES_MAX_BLOCKS; x++)
+    pShape.mBottom[x] = -1;
+
+  for (int y = 0; y < PIECES_MAX_BLOCKS; y++)
+    for (int x = 0; x < PIECES_MAX_BLOCKS; x++)
+    {
+      if (pMatrix[y][x] == 0)
+        continue;
+
+      pShape.mRows[y] |= 1 << x;
+      pShape.mBottom[x] = y;
+
+      if (x < pShape.mMinX)
+        pShape.mMinX = x;
+      if (x > pShape.mMaxX)
+        pShape.mMaxX = x;
+      if (y < pShape.mMinY)
+        pShape.mMinY = y;
+      if (y > pShape.mMaxY)
+        pShape.mMaxY = y;
+
+      PieceCell &mCell = pShape.mCells[pShape.mNumCells++];
+      mCell.mX = x;
+      mCell.mY = y;
+      mCell.mType = pMatrix[y][x];
+    }
+}
+
+// Cells of a piece relative to its pivot, while loading a piece set
+struct LoadedCell
+{
+  int mX, mY, mType;
+};
+
+// Cells rotated clockwise pRotation times around the pivot
+static std::vector<LoadedCell> RotateCells(const std::vector<LoadedCell> &pCells,
+                                           int pRotation)
+{
+  std::vector<LoadedCell> mRotated = pCells;
+  for (int r = 0; r < pRotation; r++)
+    for (size_t i = 0; i < mRotated.size(); i++)
+    {
+      int mX = mRotated[i].mX;
+      mRotated[i].mX = -mRotated[i].mY;
+      mRotated[i].mY = mX;
+    }
+  return mRotated;
+}
+
+// True if both cell sets have the same shape, ignoring their position
+static bool SameShape(const std::vector<LoadedCell> &pA,
+                      const std::vector<LoadedCell> &pB)
+{
+  int mAX = pA[0].mX, mAY = pA[0].mY, mBX = pB[0].mX, mBY = pB[0].mY;
+  for (size_t i = 0; i < pA.size(); i++)
+  {
+    mAX = pA[i].mX < mAX ? pA[i].mX : mAX;
+    mAY = pA[i].mY < mAY ? pA[i].mY : mAY;
+    mBX = pB[i].mX < mBX ? pB[i].mX : mBX;
+    mBY = pB[i].mY < mBY ? pB[i].mY : mBY;
+  }
+
+  for (size_t i = 0; i < pA.size(); i++)
+  {
+    bool mFound = false;
+    for (size_t j = 0; j < pB.size() && !mFound; j++)
+      mFound = pA[i].mX - mAX == pB[j].mX - mBX &&
+               pA[i].mY - mAY == pB[j].mY - mBY;
+    if (!mFound)
+      return false;
+  }
+  return true;
+}
+
+// Load a piece set from a text file and compile it. Every piece starts with a
+// "piece <name>" line followed by the rows of its matrix: '#' for a block,
+// '@' for the pivot block, '.' for a hole; lines with other characters are
+// comments. Rotations are generated clockwise around the pivot
+// (the block closest to the center if there is none) and the initial
+// position centers the piece over the top of the board.
+// Returns false and keeps the current set if the file is not valid
+// pPath - path of the piece set file
+bool Pieces::LoadFromFile(const char *pPath)
+{
+  std::ifstream mFile(pPath);
+  if (!mFile)
+  {
+    std::cerr << "Couldn't open piece set " << pPath << std::endl;
+    return false;
+  }
+
+  // Read the matrix rows and the name of every piece
+  std::vector<std::vector<std::string> > mRows;
+  std::vector<std::string> mPieceNames;
+  std::string mLine;
+  while (std::getline(mFile, mLine))
+  {
+    if (!mLine.empty() && mLine[mLine.size() - 1] == '\r')
+      mLine.erase(mLine.size() - 1);
+
+    // Any other line is a comment
+    if (mLine.compare(0, 6, "piece ") == 0 || mLine == "piece")
+    {
+      mRows.push_back(std::vector<std::string>());
+      std::istringstream mWords(mLine.substr(5));
+      std::string mName;
+      mWords >> mName;
+      mPieceNames.push_back(mName.substr(0, PIECES_MAX_NAME - 1));
+    }
+    else if (!mRows.empty() && !mLine.empty() &&
+             mLine.find_first_not_of("#@. ") == std::string::npos)
+      mRows.back().push_back(mLine);
+  }
+
+  if (mRows.empty() || mRows.size() > PIECES_MAX_KINDS)
+  {
+    std::cerr << "Piece set " << pPath << " must have 1 to "
+              << PIECES_MAX_KINDS << " pieces" << std::endl;
+    return false;
+  }
+
+  // Cells of every piece relative to its pivot
+  std::vector<std::vector<LoadedCell> > mCells(mRows.size());
+  int mRadius = 0;
+  for (size_t k = 0; k < mRows.size(); k++)
+  {
+    int mPivot = -1;
+    int mMinX = 1 << 30, mMaxX = -1, mMinY = 1 << 30, mMaxY = -1;
+    for (int y = 0; y < (int)mRows[k].size(); y++)
+      for (int x = 0; x < (int)mRows[k][y].size(); x++)
+      {
+        char c = mRows[k][y][x];
+        if (c != '#' && c != '@')
+          continue;
+
+        LoadedCell mCell = {x, y, c == '@' ? 2 : 1};
+        if (c == '@')
+          mPivot = mCells[k].size();
+        mCells[k].push_back(mCell);
+
+        mMinX = x < mMinX ? x : mMinX;
+        mMaxX = x > mMaxX ? x : mMaxX;
+        mMinY = y < mMinY ? y : mMinY;
+        mMaxY = y > mMaxY ? y : mMaxY;
+      }
+
+    if (mCells[k].empty() || mCells[k].size() > PIECES_MAX_CELLS)
+    {
+      std::cerr << "Piece " << k << " of " << pPath << " must have 1 to "
+                << PIECES_MAX_CELLS << " blocks" << std::endl;
+      return false;
+    }
+
+    // Without a pivot the piece turns around the block closest to its center
+    if (mPivot < 0)
+    {
+      int mBest = 1 << 30;
+      for (size_t i = 0; i < mCells[k].size(); i++)
+      {
+        int mDX = 2 * mCells[k][i].mX - (mMinX + mMaxX);
+        int mDY = 2 * mCells[k][i].mY - (mMinY + mMaxY);
+        if (mDX * mDX + mDY * mDY < mBest)
+        {
+          mBest = mDX * mDX + mDY * mDY;
+          mPivot = i;
+        }
+      }
+      mCells[k][mPivot].mType = 2;
+    }
+
+    int mPivotX = mCells[k][mPivot].mX, mPivotY = mCells[k][mPivot].mY;
+    for (size_t i = 0; i < mCells[k].size(); i++)
+    {
+      mCells[k][i].mX -= mPivotX;
+      mCells[k][i].mY -= mPivotY;
+
+      // Rotating around the pivot keeps the distance on both axes
+      int mDX = mCells[k][i].mX < 0 ? -mCells[k][i].mX : mCells[k][i].mX;
+      int mDY = mCells[k][i].mY < 0 ? -mCells[k][i].mY : mCells[k][i].mY;
+      mRadius = mDX > mRadius ? mDX : mRadius;
+      mRadius = mDY > mRadius ? mDY : mRadius;
+    }
+  }
+
+  // All the matrices have the same size with the pivot at the center
+  int mNewSize = 2 * mRadius + 1;
+  if (mNewSize > PIECES_MAX_BLOCKS)
+  {
+    std::cerr << "Pieces of " << pPath << " don't fit in a "
+              << PIECES_MAX_BLOCKS << "x" << PIECES_MAX_BLOCKS
+              << " matrix around their pivot" << std::endl;
+    return false;
+  }
+
+  for (size_t k = 0; k < mCells.size(); k++)
+  {
+    std::vector<LoadedCell> mRotations[PIECES_ROTATIONS];
+    for (int r = 0; r < PIECES_ROTATIONS; r++)
+    {
+      mRotations[r] = RotateCells(mCells[k], r);
+
+      // A rotation that only repeats an earlier one keeps its position, so
+      // symmetric pieces don't wobble around their pivot
+      for (int q = 0; q < r; q++)
+        if (SameShape(mRotations[q], mRotations[r]))
+        {
+          mRotations[r] = mRotations[q];
+          break;
+        }
+
+      int mMatrix[PIECES_MAX_BLOCKS][PIECES_MAX_BLOCKS] = {{0}};
+      int mMinX = mNewSize, mMaxX = -1, mMaxY = -1;
+      for (size_t i = 0; i < mRotations[r].size(); i++)
+      {
+        int x = mRotations[r][i].mX + mRadius;
+        int y = mRotations[r][i].mY + mRadius;
+        mMatrix[y][x] = mRotations[r][i].mType;
+        mMinX = x < mMinX ? x : mMinX;
+        mMaxX = x > mMaxX ? x : mMaxX;
+        mMaxY = y > mMaxY ? y : mMaxY;
+      }
+
+      // Center the piece horizontally and put its lowest row on the top row
+      // of the board
+      CompileShape(mShapes[k][r], mMatrix, -((mMinX + mMaxX + 1) / 2), -mMaxY);
+    }
+  }
+
+  mKinds = mCells.size();
+  mSize = mNewSize;
+  for (int k = 0; k < mKinds; k++)
+    strcpy(mNames[k], mPieceNames[k].c_str());
+
+  // The kicks of the new pieces start from the default table again
+  std::istringstream mDefault(sDefaultKicks);
+  LoadKicks(mDefault, "built-in");
+  return true;
+}
+
+// Offsets of one kick table while loading it, x right and y up
+struct LoadedKicks
+{
+  std::vector<std::string> mNames; // pieces it is for, "*" for the rest
+  std::vector<int> mOffsets[PIECES_ROTATIONS][PIECES_ROTATIONS];
+};
+
+// State of a rotation in a kick table: 0, R, 2 or L, -1 for anything else
+static int KickState(char pState)
+{
+  const char *mStates = "0R2L";
+  const char *mFound = pState != 0 ? strchr(mStates, pState) : NULL;
+  return mFound != NULL ? (int)(mFound - mStates) : -1;
+}
+
+// Rotation that plays the spawn state of the kick tables: the first one
+// wider than tall with its pivot on its lowest row, like the tetrominoes
+// spawn in SRS, or rotation 0 if there is none
+// pPieces - piece kind
+int Pieces::GetSpawnState(int pPieces) const
+{
+  for (int r = 0; r < PIECES_ROTATIONS; r++)
+  {
+    const PieceShape &mShape = mShapes[pPieces][r];
+    if (mShape.mMaxX - mShape.mMinX <= mShape.mMaxY - mShape.mMinY)
+      continue;
+
+    for (int i = 0; i < mShape.mNumCells; i++)
+      if (mShape.mCells[i].mType == 2 && mShape.mCells[i].mY == mShape.mMaxY)
+        return r;
+  }
+  return 0;
+}
+
+// Load a kick table and compile it into the kicks of every rotation of
+// every piece, see data/srs_kicks.txt for the format. Tables for pieces
+// the set doesn't have are ignored.
+// Returns false and keeps the current kicks if the table is not valid
+// pStream - table text
+// pSource - name of the table for the errors
+bool Pieces::LoadKicks(std::istream &pStream, const char *pSource)
+{
+  std::vector<LoadedKicks> mTables;
+  std::string mLine;
+  for (int mLineNumber = 1; std::getline(pStream, mLine); mLineNumber++)
+  {
+    std::istringstream mWords(mLine);
+    std::string mWord;
+    if (!(mWords >> mWord) || mWord[0] == '#')
+      continue;
+
+    if (mWord == "kicks")
+    {
+      mTables.push_back(LoadedKicks());
+      while (mWords >> mWord)
+        mTables.back().mNames.push_back(mWord);
+      continue;
+    }
+
+    int mFrom = mWord.size() == 3 && mWord[1] == '>' ? KickState(mWord[0]) : -1;
+    int mTo = mWord.size() == 3 && mWord[1] == '>' ? KickState(mWord[2]) : -1;
+    if (mTables.empty() || mFrom < 0 || mTo < 0 || mFrom == mTo)
+    {
+      std::cerr << "Kick table " << pSource << " line " << mLineNumber
+                << ": expected \"kicks NAMES\" or a rotation like \"0>R\""
+                << std::endl;
+      return false;
+    }
+
+    std::vector<int> &mOffsets = mTables.back().mOffsets[mFrom][mTo];
+    mOffsets.clear();
+    while (mWords >> mWord)
+    {
+      int mX, mY;
+      char mEnd;
+      if (sscanf(mWord.c_str(), "%d,%d%c", &mX, &mY, &mEnd) != 2 ||
+          mX < -PIECES_MAX_BLOCKS || mX > PIECES_MAX_BLOCKS ||
+          mY < -PIECES_MAX_BLOCKS || mY > PIECES_MAX_BLOCKS ||
+          mOffsets.size() == 2 * PIECES_MAX_KICKS)
+      {
+        std::cerr << "Kick table " << pSource << " line " << mLineNumber
+                  << ": expected up to " << PIECES_MAX_KICKS
+                  << " offsets like \"-1,2\"" << std::endl;
+        return false;
+      }
+      mOffsets.push_back(mX);
+      mOffsets.push_back(mY);
+    }
+  }
+
+  for (int k = 0; k < mKinds; k++)
+  {
+    // The table naming the piece, or else the table for the rest
+    const LoadedKicks *mTable = NULL;
+    for (size_t t = 0; t < mTables.size(); t++)
+      for (size_t n = 0; n < mTables[t].mNames.size(); n++)
+      {
+        if (mTables[t].mNames[n] == mNames[k])
+          mTable = &mTables[t];
+        else if (mTables[t].mNames[n] == "*" && mTable == NULL)
+          mTable = &mTables[t];
+      }
+
+    int mSpawn = GetSpawnState(k);
+    for (int f = 0; f < PIECES_ROTATIONS; f++)
+      for (int r = 0; r < PIECES_ROTATIONS; r++)
+      {
+        KickTable &mKick = mKicks[k][f][r];
+        memset(&mKick, 0, sizeof(mKick));
+        mKick.mCount = 1;
+        if (mTable == NULL || f == r)
+          continue;
+
+        const std::vector<int> &mOffsets =
+            mTable->mOffsets[(f - mSpawn + PIECES_ROTATIONS) % PIECES_ROTATIONS]
+                            [(r - mSpawn + PIECES_ROTATIONS) % PIECES_ROTATIONS];
+        if (mOffsets.empty())
+          continue;
+
+        mKick.mCount = mOffsets.size() / 2;
+        for (int i = 0; i < mKick.mCount; i++)
+        {
+          mKick.mOffsets[i][0] = mOffsets[2 * i];
+          mKick.mOffsets[i][1] = -mOffsets[2 * i + 1];
+        }
+      }
+  }
+  return true;
+}
+
+// Load a kick table from a text file, see LoadKicks
+// pPath - path of the kick table file
+bool Pieces::LoadKicksFromFile(const char *pPath)
+{
+  std::ifstream mFile(pPath);
+  if (!mFile)
+  {
+    std::cerr << "Couldn't open kick table " << pPath << std::endl;
+    return false;
+  }
+  return LoadKicks(mFile, pPath);
+}
 
 // Return the type of block (0-no block, 1-normal block, 2-pivot block)
 // pPieces - piece to draw
 // pRotation - 1 of the 4 possible rotations
-// px - horizontal position in blocks
-// py - vertical position in blocks
-int Pieces::GetBlockType(int pPieces, int pRotation, int pX, int pY)
+// px - vertical position in blocks
+// py - horizontal position in blocks
+int Pieces::GetBlockType(int pPieces, int pRotation, int pX, int pY) const
 {
-  return mPieces[pPieces][pRotation][pX][pY];
+  const PieceShape &mShape = mShapes[pPieces][pRotation];
+  if (!(mShape.mRows[pX] & (1 << pY)))
+    return 0;
+
+  for (int i = 0; i < mShape.mNumCells; i++)
+    if (mShape.mCells[i].mY == pX && mShape.mCells[i].mX == pY)
+      return mShape.mCells[i].mType;
+  return 1;
 }
 
 // Return the horizontal displacement of the piece that has to be applied
 // to create it in the correct positon
 // pPieces - pieces to draw
 // pRotation - 1 out of the 4 possible rotations
-int Pieces::GetXInitialPosition(int pPieces, int pRotation)
+int Pieces::GetXInitialPosition(int pPieces, int pRotation) const
 {
-  return mPiecesInitialPosition[pPieces][pRotation][0];
+  return mShapes[pPieces][pRotation].mInitialX;
 }
 
 // Return the vertical displacement of the pieces that has to be applied
 // in order to create it in the correct position
-int Pieces::GetYInitialPosition(int pPieces, int pRotation)
+int Pieces::GetYInitialPosition(int pPieces, int pRotation) const
+{
+  return mShapes[pPieces][pRotation].mInitialY;
+}
+
+// Return the lowest filled row of a column of the piece matrix, or -1 if
+// the column is empty
+// pPieces - piece kind
+// pRotation - 1 out of the 4 possible rotations
+// pX - column of the piece matrix
+int Pieces::GetBottomProfile(int pPieces, int pRotation, int pX) const
+{
+  return mShapes[pPieces][pRotation].mBottom[pX];
+}
+
+// Return a fingerprint of the piece set, FNV-1a over the rows of every
+// rotation, to tell apart results computed with other pieces
+unsigned long long Pieces::GetHash() const
 {
-  return mPiecesInitialPosition[pPieces][pRotation][1];
+  unsigned long long mHash = 0xcbf29ce484222325ull;
+  for (int k = 0; k < mKinds; k++)
+    for (int r = 0; r < PIECES_ROTATIONS; r++)
+      for (int j = 0; j < PIECES_MAX_BLOCKS; j++)
+      {
+        mHash ^= mShapes[k][r].mRows[j];
+        mHash *= 0x100000001b3ull;
+      }
+  return mHash;
 }
@@ -0,0 +1,54 @@
+/*****************************************************************************************
+ File: Placement.cpp
+ Desc: Enumeration of the resting positions of a piece
+*****************************************************************************************/
+
+#include "include/Placement.h"
+#include <cstring>
+
+/*
+======================================
+Find every position where a piece can rest by dropping it straight down
+from the top of the board, in every rotation and column. Rotations that
+repeat the shape of an earlier one are skipped
+
+Parameters:
+>> pBoard: board to place the piece in
+>> pPieces: the piece set
+>> pPiece: kind of the piece
+>> pOut: array of at least MAX_PLACEMENTS placements
+
+returns the number of placements
+======================================
+*/
+int EnumeratePlacements(const BoardBits &pBoard, const Pieces &pPieces,
+                        int pPiece, Placement *pOut)
+{
+  int mCount = 0;
+
+  for (int r = 0; r < PIECES_ROTATIONS; r++)
+  {
+    const PieceShape &mShape = pPieces.GetShape(pPiece, r);
+
+    bool mRepeated = false;
+    for (int q = 0; q < r && !mRepeated; q++)
+      mRepeated = memcmp(pPieces.GetShape(pPiece, q).mRows, mShape.mRows,
+                         sizeof(mShape.mRows)) == 0;
+    if (mRepeated)
+      continue;
+
+    int mY = pPieces.GetYInitialPosition(pPiece, r);
+    for (int mX = -mShape.mMinX; mX + mShape.mMaxX < BOARD_WIDTH; mX++)
+    {
+      if (!pBoard.IsPossibleMovement(pPieces, mX, mY, pPiece, r))
+        continue;
+
+      Placement &mPlacement = pOut[mCount++];
+      mPlacement.mX = mX;
+      mPlacement.mY = mY + pBoard.GetDropDistance(pPieces, mX, mY, pPiece, r);
+      mPlacement.mRotation = r;
+    }
+  }
+
+  return mCount;
+}
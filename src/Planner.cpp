@@ -0,0 +1,334 @@
+/*****************************************************************************************
+ File: Planner.cpp
+ Desc: Cheapest key inputs that take a falling piece to a placement
+*****************************************************************************************/
+
+#include "include/Planner.h"
+#include <algorithm>
+#include <cstring>
+
+#define PLAN_UNREACHED 0xffff // cost of a state the search didn't reach
+#define PLAN_MAX_COST 20      // most an input can cost, so costs fit
+
+// Index of a piece state in the searches
+static inline int StateIndex(int pX, int pY, int pRotation)
+{
+  return (pRotation * PLAN_ROWS + pY + PLAN_Y_OFFSET) * PLAN_COLUMNS + pX +
+         PLAN_X_OFFSET;
+}
+
+// True if both rotations have the same blocks, wherever they are in the
+// piece matrix
+static bool SameBlocks(const PieceShape &pA, const PieceShape &pB)
+{
+  if (pA.mMaxX - pA.mMinX != pB.mMaxX - pB.mMinX ||
+      pA.mMaxY - pA.mMinY != pB.mMaxY - pB.mMinY)
+    return false;
+
+  for (int j = 0; j <= pA.mMaxY - pA.mMinY; j++)
+    if (pA.mRows[pA.mMinY + j] >> pA.mMinX != pB.mRows[pB.mMinY + j] >> pB.mMinX)
+      return false;
+  return true;
+}
+
+/*
+======================================
+Init, with every input costing 1. Searches the empty board from the
+spawn of every piece and rotation of the set
+======================================
+*/
+Planner::Planner(const Pieces *pPieces)
+    : mPieces(pPieces), mBoard(NULL), mPiece(0)
+{
+  for (int a = 0; a < ACTION_COUNT; a++)
+    mCosts[a] = 1;
+  mOpen.reserve(PLAN_STATES * ACTION_COUNT);
+  mEmptyBoard.Clear();
+  SearchEmpty();
+}
+
+/*
+======================================
+Set the cost of an input, from 0 to PLAN_MAX_COST. The searches of the
+empty board are made again with it
+======================================
+*/
+void Planner::SetCost(int pAction, int pCost)
+{
+  if (pAction < 0 || pAction >= ACTION_COUNT)
+    return;
+
+  mCosts[pAction] = std::max(0, std::min(pCost, PLAN_MAX_COST));
+  SearchEmpty();
+}
+
+void Planner::SearchEmpty()
+{
+  mEmpty.resize(mPieces->GetKinds() * PIECES_ROTATIONS);
+  for (int k = 0; k < mPieces->GetKinds(); k++)
+    for (int r = 0; r < PIECES_ROTATIONS; r++)
+      Run(mEmpty[k * PIECES_ROTATIONS + r], mEmptyBoard, k,
+          BOARD_WIDTH / 2 + mPieces->GetXInitialPosition(k, r),
+          mPieces->GetYInitialPosition(k, r), r, NULL);
+}
+
+// True if the piece of the search fits at a position, tested once per search
+bool Planner::Fits(int pX, int pY, int pRotation)
+{
+  if (pX < -PLAN_X_OFFSET || pX >= BOARD_WIDTH || pY < -PLAN_Y_OFFSET ||
+      pY >= BOARD_HEIGHT)
+    return false;
+
+  signed char &mFits = mFit[StateIndex(pX, pY, pRotation)];
+  if (mFits < 0)
+    mFits = mBoard->IsPossibleMovement(*mPieces, pX, pY, mPiece, pRotation);
+  return mFits != 0;
+}
+
+/*
+======================================
+Reach the states one input away from a state, the way the game moves the
+piece: the rotations take the first of their kicks that fits
+======================================
+*/
+void Planner::Expand(Search &pSearch, int pState)
+{
+  int mX = pState % PLAN_COLUMNS - PLAN_X_OFFSET;
+  int mY = pState / PLAN_COLUMNS % PLAN_ROWS - PLAN_Y_OFFSET;
+  int mRotation = pState / (PLAN_COLUMNS * PLAN_ROWS);
+
+  for (int a = 0; a < ACTION_COUNT; a++)
+  {
+    int mNewX = mX, mNewY = mY, mNewRotation = mRotation;
+    bool mMoved = false;
+    switch (a)
+    {
+    case ACTION_LEFT:
+      mMoved = Fits(--mNewX, mNewY, mNewRotation);
+      break;
+    case ACTION_RIGHT:
+      mMoved = Fits(++mNewX, mNewY, mNewRotation);
+      break;
+    case ACTION_SOFT_DROP:
+      mMoved = Fits(mNewX, ++mNewY, mNewRotation);
+      break;
+    case ACTION_ROTATE:
+    case ACTION_ROTATE_CCW:
+    case ACTION_ROTATE_180:
+    {
+      int mTurns = a == ACTION_ROTATE ? 1 : a == ACTION_ROTATE_CCW ? 3 : 2;
+      mNewRotation = (mRotation + mTurns) % PIECES_ROTATIONS;
+      const KickTable &mKicks = mPieces->GetKicks(mPiece, mRotation, mNewRotation);
+      for (int i = 0; i < mKicks.mCount && !mMoved; i++)
+      {
+        mNewX = mX + mKicks.mOffsets[i][0];
+        mNewY = mY + mKicks.mOffsets[i][1];
+        mMoved = Fits(mNewX, mNewY, mNewRotation);
+      }
+      break;
+    }
+    }
+    if (!mMoved)
+      continue;
+
+    int mNew = StateIndex(mNewX, mNewY, mNewRotation);
+    int mCost = pSearch.mCost[pState] + mCosts[a];
+    if (mCost < pSearch.mCost[mNew])
+    {
+      pSearch.mCost[mNew] = mCost;
+      pSearch.mParent[mNew] = pState;
+      pSearch.mInput[mNew] = a;
+      Open mEntry = {mCost, mNew};
+      mOpen.push_back(mEntry);
+      std::push_heap(mOpen.begin(), mOpen.end());
+    }
+  }
+}
+
+// Most states a hard drop takes to one placement
+#define PLAN_MAX_DROPS (PIECES_ROTATIONS * PLAN_ROWS)
+
+/*
+======================================
+States a hard drop takes to a placement: the columns above every rotation
+with the same blocks, down to where it rests
+
+returns how many there are, 0 if the placement isn't a resting position
+of the piece
+======================================
+*/
+static int FindDrops(const BoardBits &pBoard, const Pieces &pPieces,
+                     int pPiece, const Placement &pTarget, int *pDrops)
+{
+  const PieceShape &mTarget = pPieces.GetShape(pPiece, pTarget.mRotation);
+  int mCount = 0;
+  for (int r = 0; r < PIECES_ROTATIONS; r++)
+  {
+    const PieceShape &mShape = pPieces.GetShape(pPiece, r);
+    if (!SameBlocks(mShape, mTarget))
+      continue;
+
+    int mX = pTarget.mX + mTarget.mMinX - mShape.mMinX;
+    int mY = pTarget.mY + mTarget.mMinY - mShape.mMinY;
+    if (mX < -PLAN_X_OFFSET || mX >= BOARD_WIDTH || mY < -PLAN_Y_OFFSET ||
+        mY >= BOARD_HEIGHT ||
+        !pBoard.IsPossibleMovement(pPieces, mX, mY, pPiece, r) ||
+        pBoard.IsPossibleMovement(pPieces, mX, mY + 1, pPiece, r))
+      continue;
+
+    for (int y = mY; y >= -PLAN_Y_OFFSET &&
+                     pBoard.IsPossibleMovement(pPieces, mX, y, pPiece, r);
+         y--)
+      pDrops[mCount++] = StateIndex(mX, y, r);
+  }
+  return mCount;
+}
+
+/*
+======================================
+Search the states cheapest first from a start, until the cheapest state a
+hard drop takes to the target is reached or, without a target, until
+every reachable state is
+
+returns the state the hard drop is made from, or -1 if the target can't
+be reached
+======================================
+*/
+int Planner::Run(Search &pSearch, const BoardBits &pBoard, int pPiece, int pX,
+                 int pY, int pRotation, const Placement *pTarget)
+{
+  mBoard = &pBoard;
+  mPiece = pPiece;
+  memset(mFit, -1, sizeof(mFit));
+  memset(pSearch.mCost, 0xff, sizeof(pSearch.mCost));
+  mOpen.clear();
+
+  unsigned char mIsDrop[PLAN_STATES];
+  if (pTarget != NULL)
+  {
+    int mDrops[PLAN_MAX_DROPS];
+    int mCount = FindDrops(pBoard, *mPieces, pPiece, *pTarget, mDrops);
+    if (mCount == 0)
+      return -1;
+
+    memset(mIsDrop, 0, sizeof(mIsDrop));
+    for (int i = 0; i < mCount; i++)
+      mIsDrop[mDrops[i]] = 1;
+  }
+
+  if (!Fits(pX, pY, pRotation))
+    return -1;
+
+  int mStart = StateIndex(pX, pY, pRotation);
+  pSearch.mCost[mStart] = 0;
+  pSearch.mParent[mStart] = -1;
+  Open mFirst = {0, mStart};
+  mOpen.push_back(mFirst);
+
+  while (!mOpen.empty())
+  {
+    std::pop_heap(mOpen.begin(), mOpen.end());
+    Open mNext = mOpen.back();
+    mOpen.pop_back();
+    if (mNext.mCost > pSearch.mCost[mNext.mState])
+      continue; // reached cheaper since it was queued
+
+    if (pTarget != NULL && mIsDrop[mNext.mState])
+      return mNext.mState;
+    Expand(pSearch, mNext.mState);
+  }
+  return -1;
+}
+
+/*
+======================================
+Cheapest state of a finished search a hard drop takes to the target
+
+returns -1 if the target can't be reached
+======================================
+*/
+int Planner::FindDrop(const Search &pSearch, const BoardBits &pBoard,
+                      const Placement &pTarget)
+{
+  int mDrops[PLAN_MAX_DROPS];
+  int mCount = FindDrops(pBoard, *mPieces, mPiece, pTarget, mDrops);
+
+  int mBest = -1;
+  for (int i = 0; i < mCount; i++)
+    if (pSearch.mCost[mDrops[i]] != PLAN_UNREACHED &&
+        (mBest < 0 || pSearch.mCost[mDrops[i]] < pSearch.mCost[mBest]))
+      mBest = mDrops[i];
+  return mBest;
+}
+
+// Inputs from the start of a search to a state, and the hard drop
+bool Planner::Unwind(const Search &pSearch, int pState, InputPlan &pPlan) const
+{
+  pPlan.mCount = 0;
+  for (int s = pState; pSearch.mParent[s] >= 0; s = pSearch.mParent[s])
+  {
+    if (pPlan.mCount == PLAN_MAX_INPUTS - 1)
+      return false;
+    pPlan.mInputs[pPlan.mCount++] = pSearch.mInput[s];
+  }
+  std::reverse(pPlan.mInputs, pPlan.mInputs + pPlan.mCount);
+
+  pPlan.mInputs[pPlan.mCount++] = ACTION_HARD_DROP;
+  pPlan.mCost = pSearch.mCost[pState] + mCosts[ACTION_HARD_DROP];
+  return true;
+}
+
+/*
+======================================
+Plan the inputs for a piece that just spawned
+
+returns the cost of the plan, or -1 if the placement can't be reached
+======================================
+*/
+int Planner::Plan(const BoardBits &pBoard, int pPiece, int pRotation,
+                  const Placement &pTarget, InputPlan &pPlan)
+{
+  return Plan(pBoard, pPiece,
+              BOARD_WIDTH / 2 + mPieces->GetXInitialPosition(pPiece, pRotation),
+              mPieces->GetYInitialPosition(pPiece, pRotation), pRotation,
+              pTarget, pPlan);
+}
+
+/*
+======================================
+Plan the inputs that take a piece from its position to a placement
+
+Parameters:
+>> pBoard: blocks of the board
+>> pPiece, pX, pY, pRotation: falling piece
+>> pTarget: resting position to take it to, a rotation with the same
+   blocks at the same place does as well
+>> pPlan: filled with the inputs
+
+returns the cost of the plan, or -1 if the placement can't be reached
+======================================
+*/
+int Planner::Plan(const BoardBits &pBoard, int pPiece, int pX, int pY,
+                  int pRotation, const Placement &pTarget, InputPlan &pPlan)
+{
+  pPlan.mCount = 0;
+  pPlan.mCost = 0;
+
+  // A piece at its spawn over an empty board was searched already
+  bool mClear = true;
+  for (int j = 0; j < BOARD_HEIGHT && mClear; j++)
+    mClear = pBoard.mRows[j] == 0;
+
+  if (mClear &&
+      pX == BOARD_WIDTH / 2 + mPieces->GetXInitialPosition(pPiece, pRotation) &&
+      pY == mPieces->GetYInitialPosition(pPiece, pRotation))
+  {
+    const Search &mCached = mEmpty[pPiece * PIECES_ROTATIONS + pRotation];
+    mPiece = pPiece;
+    int mDrop = FindDrop(mCached, mEmptyBoard, pTarget);
+    return mDrop >= 0 && Unwind(mCached, mDrop, pPlan) ? pPlan.mCost : -1;
+  }
+
+  int mDrop = Run(mSearch, pBoard, pPiece, pX, pY, pRotation, &pTarget);
+  return mDrop >= 0 && Unwind(mSearch, mDrop, pPlan) ? pPlan.mCost : -1;
+}
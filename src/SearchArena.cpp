@@ -0,0 +1,148 @@
+/*****************************************************************************************
+ File: SearchArena.cpp
+ Desc: Bump allocators of cache line sized search nodes, one per thread
+*****************************************************************************************/
+
+#include "include/SearchArena.h"
+#include <atomic>
+
+/*
+======================================
+Init, the first block is allocated up front
+======================================
+*/
+SearchArena::SearchArena() : mBlock(0), mNext(NULL), mEnd(NULL), mUsed(0), mPeak(0)
+{
+  Reset();
+}
+
+SearchArena::~SearchArena()
+{
+  for (size_t i = 0; i < mBlocks.size(); i++)
+    delete[] mBlocks[i];
+}
+
+// First cache line aligned node of a block
+static unsigned char *FirstNode(unsigned char *pBlock)
+{
+  size_t mAddress = (size_t)pBlock;
+  return pBlock + (ARENA_NODE_SIZE - mAddress % ARENA_NODE_SIZE) % ARENA_NODE_SIZE;
+}
+
+/*
+======================================
+Drop every node in O(1), the blocks are kept for the next decision
+======================================
+*/
+void SearchArena::Reset()
+{
+  if (mUsed > mPeak)
+    mPeak = mUsed;
+  mUsed = 0;
+
+  if (mBlocks.empty())
+    mBlocks.push_back(new unsigned char[(ARENA_BLOCK_NODES + 1) * ARENA_NODE_SIZE]);
+  mBlock = 0;
+  mNext = FirstNode(mBlocks[0]);
+  mEnd = mNext + ARENA_BLOCK_NODES * ARENA_NODE_SIZE;
+}
+
+/*
+======================================
+Slow path of NewNode, moves to the next block, allocating it the first time
+the arena gets this big
+======================================
+*/
+BoardBits *SearchArena::Grow(const BoardBits &pFrom)
+{
+  mBlock++;
+  if (mBlock == mBlocks.size())
+    mBlocks.push_back(new unsigned char[(ARENA_BLOCK_NODES + 1) * ARENA_NODE_SIZE]);
+
+  mNext = FirstNode(mBlocks[mBlock]);
+  mEnd = mNext + ARENA_BLOCK_NODES * ARENA_NODE_SIZE;
+  return NewNode(pFrom);
+}
+
+//------------------------------
+// Thread arenas
+//------------------------------
+
+static std::atomic<unsigned int> sNextId(1);
+
+// Arena of the last set asked for by this thread
+static thread_local unsigned int tCachedId = 0;
+static thread_local SearchArena *tCachedArena = NULL;
+
+ThreadArenas::ThreadArenas() : mId(sNextId.fetch_add(1)) {}
+
+ThreadArenas::~ThreadArenas()
+{
+  for (size_t i = 0; i < mArenas.size(); i++)
+    delete mArenas[i].mArena;
+}
+
+/*
+======================================
+Arena of the calling thread, made the first time the thread asks
+======================================
+*/
+SearchArena &ThreadArenas::Get()
+{
+  if (tCachedId == mId)
+    return *tCachedArena;
+
+  std::lock_guard<std::mutex> mLock(mMutex);
+  std::thread::id mThread = std::this_thread::get_id();
+
+  SearchArena *mArena = NULL;
+  for (size_t i = 0; i < mArenas.size() && mArena == NULL; i++)
+    if (mArenas[i].mThread == mThread)
+      mArena = mArenas[i].mArena;
+
+  if (mArena == NULL)
+  {
+    Entry mEntry = {mThread, new SearchArena()};
+    mArenas.push_back(mEntry);
+    mArena = mEntry.mArena;
+  }
+
+  tCachedId = mId;
+  tCachedArena = mArena;
+  return *mArena;
+}
+
+/*
+======================================
+Reset the arena of every thread, no thread may be making nodes
+======================================
+*/
+void ThreadArenas::ResetAll()
+{
+  std::lock_guard<std::mutex> mLock(mMutex);
+  for (size_t i = 0; i < mArenas.size(); i++)
+    mArenas[i].mArena->Reset();
+}
+
+/*
+======================================
+Totals over the threads: nodes since the last reset and bytes held
+======================================
+*/
+size_t ThreadArenas::GetUsed()
+{
+  std::lock_guard<std::mutex> mLock(mMutex);
+  size_t mTotal = 0;
+  for (size_t i = 0; i < mArenas.size(); i++)
+    mTotal += mArenas[i].mArena->GetUsed();
+  return mTotal;
+}
+
+size_t ThreadArenas::GetReserved()
+{
+  std::lock_guard<std::mutex> mLock(mMutex);
+  size_t mTotal = 0;
+  for (size_t i = 0; i < mArenas.size(); i++)
+    mTotal += mArenas[i].mArena->GetReserved();
+  return mTotal;
+}
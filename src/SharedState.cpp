@@ -0,0 +1,224 @@
+/*****************************************************************************************
+ File: SharedState.cpp
+ Desc: Live game state published in POSIX shared memory
+*****************************************************************************************/
+
+#include "include/SharedState.h"
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+======================================
+Init
+======================================
+*/
+SharedState::SharedState() : mLayout(NULL), mOwner(false) { mName[0] = 0; }
+
+SharedState::~SharedState() { Close(); }
+
+/*
+======================================
+Create the segment and publish into it, done by the game
+
+Parameters:
+>> pName: name of the segment, like "/tetris"
+
+returns false if the segment can't be created
+======================================
+*/
+bool SharedState::Create(const char *pName)
+{
+#ifdef _WIN32
+  return false;
+#else
+  Close();
+
+  int mFd = shm_open(pName, O_CREAT | O_RDWR, 0644);
+  if (mFd < 0)
+    return false;
+
+  if (ftruncate(mFd, sizeof(SharedStateLayout)) != 0)
+  {
+    close(mFd);
+    shm_unlink(pName);
+    return false;
+  }
+
+  void *mMemory = mmap(NULL, sizeof(SharedStateLayout), PROT_READ | PROT_WRITE,
+                       MAP_SHARED, mFd, 0);
+  close(mFd);
+  if (mMemory == MAP_FAILED)
+  {
+    shm_unlink(pName);
+    return false;
+  }
+
+  mLayout = new (mMemory) SharedStateLayout();
+  mLayout->mSequence.store(0);
+  mLayout->mInputHead.store(0);
+  mLayout->mInputTail.store(0);
+  memset(&mLayout->mState, 0, sizeof(mLayout->mState));
+  mLayout->mVersion = SHARED_STATE_VERSION;
+  mLayout->mSize = sizeof(SharedStateLayout);
+
+  // Readers check the magic last, once everything else is in place
+  std::atomic_thread_fence(std::memory_order_release);
+  mLayout->mMagic = SHARED_STATE_MAGIC;
+
+  snprintf(mName, sizeof(mName), "%s", pName);
+  mOwner = true;
+  return true;
+#endif
+}
+
+/*
+======================================
+Map a segment created by a running game, done by the observers
+
+Parameters:
+>> pName: name of the segment
+
+returns false if there is no segment or its layout doesn't match
+======================================
+*/
+bool SharedState::Attach(const char *pName)
+{
+#ifdef _WIN32
+  return false;
+#else
+  Close();
+
+  int mFd = shm_open(pName, O_RDWR, 0);
+  if (mFd < 0)
+    return false;
+
+  void *mMemory = mmap(NULL, sizeof(SharedStateLayout), PROT_READ | PROT_WRITE,
+                       MAP_SHARED, mFd, 0);
+  close(mFd);
+  if (mMemory == MAP_FAILED)
+    return false;
+
+  mLayout = (SharedStateLayout *)mMemory;
+  if (mLayout->mMagic != SHARED_STATE_MAGIC ||
+      mLayout->mVersion != SHARED_STATE_VERSION ||
+      mLayout->mSize != sizeof(SharedStateLayout))
+  {
+    Close();
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return true;
+#endif
+}
+
+/*
+======================================
+Unmap the segment, the game also removes its name
+======================================
+*/
+void SharedState::Close()
+{
+#ifndef _WIN32
+  if (mLayout == NULL)
+    return;
+
+  munmap(mLayout, sizeof(SharedStateLayout));
+  mLayout = NULL;
+
+  if (mOwner)
+    shm_unlink(mName);
+  mOwner = false;
+#endif
+}
+
+/*
+======================================
+Write a new snapshot. Only the game calls this, readers spinning on an odd
+sequence never make it wait
+======================================
+*/
+void SharedState::Publish(const GameState &pState)
+{
+  unsigned int mSequence = mLayout->mSequence.load(std::memory_order_relaxed);
+
+  mLayout->mSequence.store(mSequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  memcpy(&mLayout->mState, &pState, sizeof(pState));
+
+  mLayout->mSequence.store(mSequence + 2, std::memory_order_release);
+}
+
+/*
+======================================
+Read a consistent snapshot straight from the mapped memory, retrying if the
+game wrote meanwhile. A game that dies while publishing leaves the segment
+half written for good, so the retries are bounded
+
+returns false if the segment is not mapped, or if no consistent snapshot
+was read in SHARED_READ_RETRIES tries, pState is then undefined
+======================================
+*/
+bool SharedState::Read(GameState &pState) const
+{
+  if (mLayout == NULL)
+    return false;
+
+  for (int mTry = 0; mTry < SHARED_READ_RETRIES; mTry++)
+  {
+    unsigned int mBefore = mLayout->mSequence.load(std::memory_order_acquire);
+    if (mBefore & 1)
+      continue;
+
+    memcpy(&pState, &mLayout->mState, sizeof(pState));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (mLayout->mSequence.load(std::memory_order_relaxed) == mBefore)
+      return true;
+  }
+  return false;
+}
+
+/*
+======================================
+Queue a key for the game, done by one observer at a time
+
+returns false if the queue is full
+======================================
+*/
+bool SharedState::PushInput(int pKey)
+{
+  unsigned int mHead = mLayout->mInputHead.load(std::memory_order_relaxed);
+  if (mHead - mLayout->mInputTail.load(std::memory_order_acquire) ==
+      SHARED_INPUT_SIZE)
+    return false;
+
+  mLayout->mInput[mHead & (SHARED_INPUT_SIZE - 1)] = pKey;
+  mLayout->mInputHead.store(mHead + 1, std::memory_order_release);
+  return true;
+}
+
+/*
+======================================
+Take the oldest injected key, done by the game
+
+returns false if there is none
+======================================
+*/
+bool SharedState::PopInput(int &pKey)
+{
+  unsigned int mTail = mLayout->mInputTail.load(std::memory_order_relaxed);
+  if (mTail == mLayout->mInputHead.load(std::memory_order_acquire))
+    return false;
+
+  pKey = mLayout->mInput[mTail & (SHARED_INPUT_SIZE - 1)];
+  mLayout->mInputTail.store(mTail + 1, std::memory_order_release);
+  return true;
+}
@@ -0,0 +1,355 @@
+/*****************************************************************************************
+ File: Simulation.cpp
+ Desc: Game logic on its own thread, snapshots out through a triple buffer
+*****************************************************************************************/
+
+#include "include/Simulation.h"
+#include "include/Trace.h"
+#include <chrono>
+
+/*
+======================================
+Init
+
+Parameters:
+>> pGame: game to run, only touched by the simulation thread once started
+>> pShared: shared memory to publish to and take injected keys from, or NULL
+>> pIO: IO of the renderer, woken up for every new frame, or NULL
+>> pSoakRounds: rounds to play by itself, 0 to play the keys
+======================================
+*/
+Simulation::Simulation(Game *pGame, SharedState *pShared, IO *pIO,
+                       int pSoakRounds)
+    : mGame(pGame), mShared(pShared), mIO(pIO), mSoakRounds(pSoakRounds),
+      mFramePending(false), mRunning(false), mFinished(false), mRestartStart(0), mRestarts(0),
+      mRestartTotal(0), mRestartMin(0), mRestartMax(0), mRestartLast(0)
+{
+}
+
+Simulation::~Simulation() { Stop(); }
+
+/*
+======================================
+Publish the first frame and start the simulation thread, the game runs on
+the timers of the simulation from now on
+======================================
+*/
+void Simulation::Start()
+{
+  if (mRunning.load())
+    return;
+
+  mStart = std::chrono::steady_clock::now();
+  mTimers = TimerWheel(0);
+  mGame->SetTimers(&mTimers, 0);
+
+  Publish();
+  mRunning.store(true);
+  mThread = std::thread(&Simulation::Loop, this);
+}
+
+/*
+======================================
+Stop the simulation thread, the game is left as it was
+======================================
+*/
+void Simulation::Stop()
+{
+  if (!mRunning.exchange(false))
+    return;
+
+  {
+    std::lock_guard<std::mutex> mLock(mWakeMutex);
+    mWakeUp.notify_one();
+  }
+  mThread.join();
+  mGame->SetTimers(NULL, 0);
+}
+
+/*
+======================================
+Queue a key for the simulation and wake it up
+
+returns false if the queue is full and the key was dropped
+======================================
+*/
+bool Simulation::PushKey(int pKey)
+{
+  if (!mInput.Push(pKey))
+    return false;
+
+  std::lock_guard<std::mutex> mLock(mWakeMutex);
+  mWakeUp.notify_one();
+  return true;
+}
+
+/*
+======================================
+Copy the game into the triple buffer and the shared memory, and wake up
+the renderer unless it was already woken for a frame it hasn't taken
+======================================
+*/
+void Simulation::Publish()
+{
+  TRACE_SCOPE("Publish");
+  GameState &mState = mFrames.GetBack();
+  mGame->GetState(mState);
+  mFrames.Publish();
+
+  if (mIO != NULL && !mFramePending.exchange(true))
+    mIO->WakeUp();
+
+  if (mShared != NULL)
+    mShared->Publish(mState);
+
+  // The first frame of a new round ends the restart
+  if (mRestartStart != 0)
+  {
+    unsigned long long mTicks = SDL_GetPerformanceCounter() - mRestartStart;
+    mRestartStart = 0;
+
+    unsigned long long mCount = mRestarts.load(std::memory_order_relaxed);
+    if (mCount == 0 || mTicks < mRestartMin.load(std::memory_order_relaxed))
+      mRestartMin.store(mTicks, std::memory_order_relaxed);
+    if (mTicks > mRestartMax.load(std::memory_order_relaxed))
+      mRestartMax.store(mTicks, std::memory_order_relaxed);
+    mRestartTotal.fetch_add(mTicks, std::memory_order_relaxed);
+    mRestartLast.store(mTicks, std::memory_order_relaxed);
+    mRestarts.store(mCount + 1, std::memory_order_release);
+  }
+}
+
+/*
+======================================
+Take the latest frame for drawing. A frame published from now on wakes the
+renderer up again
+
+returns false if no new frame came since the last one
+======================================
+*/
+bool Simulation::Update()
+{
+  mFramePending.store(false);
+  return mFrames.Update();
+}
+
+// Start a new round in place and time it until its first frame
+void Simulation::Restart()
+{
+  mRestartStart = SDL_GetPerformanceCounter();
+  mGame->Reset();
+}
+
+/*
+======================================
+Restarts timed so far. Every restart is counted, however many happen
+between two frames of the renderer
+======================================
+*/
+RestartStats Simulation::GetRestartStats() const
+{
+  RestartStats mStats;
+  mStats.mCount = mRestarts.load(std::memory_order_acquire);
+  double mMs = 1000.0 / SDL_GetPerformanceFrequency();
+  mStats.mMin = mRestartMin.load(std::memory_order_relaxed) * mMs;
+  mStats.mMax = mRestartMax.load(std::memory_order_relaxed) * mMs;
+  mStats.mLast = mRestartLast.load(std::memory_order_relaxed) * mMs;
+  mStats.mAverage =
+      mStats.mCount > 0
+          ? mRestartTotal.load(std::memory_order_relaxed) * mMs / mStats.mCount
+          : 0;
+  return mStats;
+}
+
+/*
+======================================
+Play one key, pressed or released (KEY_RELEASED). Holding a move repeats
+it until the key is let go
+======================================
+*/
+void Simulation::HandleKey(int pKey)
+{
+  if (pKey & KEY_RELEASED)
+  {
+    switch (pKey & ~KEY_RELEASED)
+    {
+    case (SDLK_h):
+      mGame->StopRepeat(MOVE_LEFT);
+      break;
+    case (SDLK_l):
+      mGame->StopRepeat(MOVE_RIGHT);
+      break;
+    case (SDLK_j):
+      mGame->StopRepeat(MOVE_DOWN);
+      break;
+    }
+    return;
+  }
+
+  if (mGame->IsGameOver())
+  {
+    if (pKey == SDLK_RETURN || pKey == SDLK_r)
+      Restart();
+    return;
+  }
+
+  switch (pKey)
+  {
+  case (SDLK_l):
+  {
+    mGame->MoveRight();
+    mGame->StartRepeat(MOVE_RIGHT);
+    break;
+  }
+
+  case (SDLK_h):
+  {
+    mGame->MoveLeft();
+    mGame->StartRepeat(MOVE_LEFT);
+    break;
+  }
+
+  case (SDLK_j):
+  {
+    mGame->MoveDown();
+    mGame->StartRepeat(MOVE_DOWN);
+    break;
+  }
+
+  case (SDLK_x):
+  {
+    mGame->HardDrop();
+    break;
+  }
+
+  case (SDLK_z):
+  {
+    mGame->Rotate();
+    break;
+  }
+
+  case (SDLK_a):
+  {
+    mGame->Rotate(3);
+    break;
+  }
+
+  case (SDLK_s):
+  {
+    mGame->Rotate(2);
+    break;
+  }
+  }
+}
+
+/*
+======================================
+Milliseconds since Start. The soak test has no clock, its time only moves
+when it waits for a timer
+======================================
+*/
+unsigned long long Simulation::Now()
+{
+  if (mSoakRounds > 0)
+    return mTimers.GetNow();
+
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - mStart)
+      .count();
+}
+
+/*
+======================================
+Sleep until the next timer or a key. Keys injected through the shared
+memory can't wake the thread, so it also checks them every SIM_SHARED_POLL
+======================================
+*/
+void Simulation::Sleep()
+{
+  TRACE_SCOPE("Sleep");
+  unsigned long long mDeadline = mTimers.GetNextDeadline();
+  if (mShared != NULL && mDeadline > Now() + SIM_SHARED_POLL)
+    mDeadline = Now() + SIM_SHARED_POLL;
+
+  std::unique_lock<std::mutex> mLock(mWakeMutex);
+  if (mDeadline == WHEEL_NEVER)
+    mWakeUp.wait(mLock, [this] {
+      return !mRunning.load() || mInput.Size() > 0;
+    });
+  else
+    mWakeUp.wait_until(
+        mLock, mStart + std::chrono::milliseconds(mDeadline), [this] {
+          return !mRunning.load() || mInput.Size() > 0;
+        });
+}
+
+/*
+======================================
+Simulation thread. Plays the waiting keys and the expired timers, publishes
+the result and sleeps until there is something to do. The soak test drops
+every piece as soon as it appears, skips the delays and starts the next
+round at once
+======================================
+*/
+void Simulation::Loop()
+{
+  int mRound = 1;
+
+  while (mRunning.load())
+  {
+    // ----- Input -----
+
+    {
+      TRACE_SCOPE("Input");
+      int mKey;
+      while (mInput.Pop(mKey))
+        HandleKey(mKey);
+
+      // Keys injected by another process are taps, pressed and let go
+      while (mShared != NULL && mShared->PopInput(mKey))
+      {
+        HandleKey(mKey);
+        HandleKey(mKey | KEY_RELEASED);
+      }
+    }
+
+    // ----- Soak test -----
+
+    unsigned long long mNow = Now();
+    if (mSoakRounds > 0)
+    {
+      if (mGame->IsGameOver())
+      {
+        if (mRound >= mSoakRounds)
+        {
+          // Finished before the last frame, whose wake up ends the
+          // renderer's loop
+          mFinished.store(true);
+          Publish();
+          return;
+        }
+
+        Restart();
+        mRound++;
+      }
+      else if (!mGame->IsSpawning())
+        mGame->HardDrop();
+      else
+        mNow = mTimers.GetNextDeadline();
+    }
+
+    // ----- Timers -----
+
+    {
+      TRACE_SCOPE("Timers");
+      TimerEvent mEvent;
+      while (mTimers.PopExpired(mNow, mEvent))
+        mGame->OnTimer(mEvent);
+    }
+
+    Publish();
+
+    if (mSoakRounds == 0)
+      Sleep();
+  }
+}
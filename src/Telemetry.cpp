@@ -0,0 +1,190 @@
+/*****************************************************************************************
+ File: Telemetry.cpp
+ Desc: Gameplay telemetry written as JSONL or binary records by a background
+       thread
+*****************************************************************************************/
+
+#include "include/Telemetry.h"
+#include <chrono>
+#include <cstring>
+
+static const char *sTypeNames[] = {"lock", "clear", "game_over"};
+
+/*
+======================================
+Init
+======================================
+*/
+Telemetry::Telemetry()
+    : mDropped(0), mRunning(false), mWritten(0), mBinary(false), mFile(NULL)
+{
+  mStart = 0;
+  mStart = Now();
+}
+
+Telemetry::~Telemetry() { Close(); }
+
+/*
+======================================
+Return the microseconds elapsed since the telemetry was created
+======================================
+*/
+unsigned long long Telemetry::Now()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+             .count() -
+         mStart;
+}
+
+/*
+======================================
+Open the output file and start the writer thread. Files ending in ".bin" get
+raw TelemetryEvent records after a small header, any other file gets one
+JSON object per line
+
+Parameters:
+>> pPath: file to write
+
+returns false if the file can't be opened
+======================================
+*/
+bool Telemetry::Open(const char *pPath)
+{
+  Close();
+
+  size_t mLen = strlen(pPath);
+  mBinary = mLen > 4 && strcmp(pPath + mLen - 4, ".bin") == 0;
+
+  mFile = fopen(pPath, mBinary ? "wb" : "w");
+  if (mFile == NULL)
+    return false;
+
+  if (mBinary)
+  {
+    // Magic, version and record size so readers can check the layout
+    unsigned int mHeader[3] = {0x4c455454 /* TTEL */, 1,
+                               (unsigned int)sizeof(TelemetryEvent)};
+    fwrite(mHeader, sizeof(mHeader), 1, mFile);
+  }
+
+  mRunning.store(true);
+  mWriter = std::thread(&Telemetry::WriterLoop, this);
+  return true;
+}
+
+/*
+======================================
+Stop the writer thread once every queued event is written, and report how
+many events were written and dropped
+======================================
+*/
+void Telemetry::Close()
+{
+  if (mFile == NULL)
+    return;
+
+  mRunning.store(false);
+  mWriter.join();
+
+  if (!mBinary)
+    fprintf(mFile, "{\"type\":\"summary\",\"written\":%llu,\"dropped\":%llu}\n",
+            mWritten, mDropped.load());
+  fclose(mFile);
+  mFile = NULL;
+
+  printf("telemetry: %llu events written, %llu dropped\n", mWritten,
+         mDropped.load());
+}
+
+/*
+======================================
+Queue an event for the writer, stamped with the current time. Called from
+the game loop, so it never waits: if the ring is full the event is dropped
+======================================
+*/
+void Telemetry::Emit(TelemetryEvent &pEvent)
+{
+  pEvent.mTime = Now();
+  if (!mRing.Push(pEvent))
+    mDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+unsigned long long Telemetry::GetDropped() { return mDropped.load(); }
+unsigned long long Telemetry::GetWritten() { return mWritten; }
+
+/*
+======================================
+Writer thread, drains the ring in batches and flushes the file periodically
+======================================
+*/
+void Telemetry::WriterLoop()
+{
+  unsigned long long mLastFlush = Now();
+  TelemetryEvent mEvent;
+
+  for (;;)
+  {
+    bool mRunningNow = mRunning.load();
+
+    int mBatch = 0;
+    while (mRing.Pop(mEvent))
+    {
+      WriteEvent(mEvent);
+      mBatch++;
+    }
+
+    if (!mRunningNow)
+      break;
+
+    if (Now() - mLastFlush > TELEMETRY_FLUSH_TIME * 1000ull)
+    {
+      fflush(mFile);
+      mLastFlush = Now();
+    }
+
+    if (mBatch == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+}
+
+/*
+======================================
+Write one event in the format of the file
+======================================
+*/
+void Telemetry::WriteEvent(const TelemetryEvent &pEvent)
+{
+  mWritten++;
+
+  if (mBinary)
+  {
+    fwrite(&pEvent, sizeof(pEvent), 1, mFile);
+    return;
+  }
+
+  fprintf(mFile,
+          "{\"type\":\"%s\",\"round\":%d,\"time_us\":%llu,\"pieces\":%d,"
+          "\"piece\":%d,\"rotation\":%d,\"lines\":%d,\"total_lines\":%d,"
+          "\"keys\":%d,\"piece_time_us\":%llu,\"score\":%d,\"level\":%d",
+          sTypeNames[pEvent.mType], pEvent.mRound, pEvent.mTime,
+          pEvent.mPieces, pEvent.mPiece, pEvent.mRotation, pEvent.mLines,
+          pEvent.mTotalLines, pEvent.mKeys, pEvent.mPieceTime, pEvent.mScore,
+          pEvent.mLevel);
+
+  // The end of a round carries the per session rates
+  if (pEvent.mType == TELEMETRY_GAME_OVER && pEvent.mPieces > 0)
+  {
+    fprintf(mFile,
+            ",\"round_time_us\":%llu,\"pieces_per_second\":%.3f,"
+            "\"lines_per_piece\":%.3f,\"keys_per_piece\":%.3f,"
+            "\"time_per_piece_ms\":%.3f",
+            pEvent.mPieceTime,
+            pEvent.mPieceTime ? pEvent.mPieces * 1e6 / pEvent.mPieceTime : 0.0,
+            (double)pEvent.mTotalLines / pEvent.mPieces,
+            (double)pEvent.mTotalKeys / pEvent.mPieces,
+            pEvent.mPieceTime / 1000.0 / pEvent.mPieces);
+  }
+
+  fprintf(mFile, "}\n");
+}
@@ -0,0 +1,163 @@
+/*****************************************************************************************
+ File: ThreadPool.cpp
+ Desc: Work stealing thread pool used by the parallel searches
+*****************************************************************************************/
+
+#include "include/ThreadPool.h"
+
+// Queue of the calling thread, 0 for threads outside the pool
+static thread_local ThreadPool *sPool = 0;
+static thread_local int sQueueIndex = 0;
+
+/*
+======================================
+Init
+
+Parameters:
+>> pThreads: threads working on the tasks, the thread calling Wait counts as
+   one of them
+======================================
+*/
+ThreadPool::ThreadPool(int pThreads) : mQueued(0), mRunning(true), mSleeping(0)
+{
+  if (pThreads < 1)
+    pThreads = 1;
+
+  for (int i = 0; i < pThreads; i++)
+    mQueues.push_back(new Queue());
+
+  for (int i = 1; i < pThreads; i++)
+    mWorkers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> mLock(mSleepMutex);
+    mRunning.store(false);
+  }
+  mWakeUp.notify_all();
+
+  for (size_t i = 0; i < mWorkers.size(); i++)
+    mWorkers[i].join();
+  for (size_t i = 0; i < mQueues.size(); i++)
+    delete mQueues[i];
+}
+
+int ThreadPool::GetThreads() { return mQueues.size(); }
+
+int ThreadPool::GetQueueIndex() { return sPool == this ? sQueueIndex : 0; }
+
+/*
+======================================
+Queue a task on the queue of the calling thread, or run it right away when
+the queue is full
+
+Parameters:
+>> pGroup: group the task belongs to
+>> pFunction: function to run
+>> pArg: argument of the function
+======================================
+*/
+void ThreadPool::Submit(TaskGroup &pGroup, void (*pFunction)(void *),
+                        void *pArg)
+{
+  Task mTask = {pFunction, pArg, &pGroup};
+
+  Queue *mQueue = mQueues[GetQueueIndex()];
+  {
+    std::lock_guard<std::mutex> mLock(mQueue->mMutex);
+    if (mQueue->mTail - mQueue->mHead < POOL_QUEUE_SIZE)
+    {
+      pGroup.mPending.fetch_add(1);
+      mQueue->mTasks[mQueue->mTail++ % POOL_QUEUE_SIZE] = mTask;
+      mQueue = 0;
+    }
+  }
+  if (mQueue)
+  {
+    pFunction(pArg);
+    return;
+  }
+  mQueued.fetch_add(1);
+
+  if (mSleeping > 0)
+    mWakeUp.notify_one();
+}
+
+/*
+======================================
+Run one task: the newest of the own queue or else the oldest of another one
+
+returns false if there was no task
+======================================
+*/
+bool ThreadPool::RunOne(int pIndex)
+{
+  if (mQueued.load() == 0)
+    return false;
+
+  Task mTask;
+  bool mFound = false;
+  int mCount = mQueues.size();
+  for (int i = 0; i < mCount && !mFound; i++)
+  {
+    Queue *mQueue = mQueues[(pIndex + i) % mCount];
+    std::lock_guard<std::mutex> mLock(mQueue->mMutex);
+    if (mQueue->mHead == mQueue->mTail)
+      continue;
+
+    if (i == 0)
+      mTask = mQueue->mTasks[--mQueue->mTail % POOL_QUEUE_SIZE];
+    else
+      mTask = mQueue->mTasks[mQueue->mHead++ % POOL_QUEUE_SIZE];
+    mFound = true;
+  }
+
+  if (!mFound)
+    return false;
+
+  mQueued.fetch_sub(1);
+  mTask.mFunction(mTask.mArg);
+  mTask.mGroup->mPending.fetch_sub(1);
+  return true;
+}
+
+/*
+======================================
+Wait until every task of the group has run, running tasks meanwhile
+======================================
+*/
+void ThreadPool::Wait(TaskGroup &pGroup)
+{
+  int mIndex = GetQueueIndex();
+  while (pGroup.mPending.load() > 0)
+  {
+    if (!RunOne(mIndex))
+      std::this_thread::yield();
+  }
+}
+
+/*
+======================================
+Worker thread, runs tasks and sleeps while there are none
+======================================
+*/
+void ThreadPool::WorkerLoop(int pIndex)
+{
+  sPool = this;
+  sQueueIndex = pIndex;
+
+  while (mRunning.load())
+  {
+    if (RunOne(pIndex))
+      continue;
+
+    std::unique_lock<std::mutex> mLock(mSleepMutex);
+    mSleeping++;
+    mWakeUp.wait_for(mLock, std::chrono::milliseconds(1), [this] {
+      return mQueued.load() > 0 || !mRunning.load();
+    });
+    mSleeping--;
+  }
+}
@@ -0,0 +1,273 @@
+/*****************************************************************************************
+ File: TimerWheel.cpp
+ Desc: Hierarchical timer wheel with O(1) schedule and cancel
+*****************************************************************************************/
+
+#include "include/TimerWheel.h"
+
+// Ticks covered by one slot of level pLevel, and by the whole level
+#define SLOT_SPAN(pLevel) (1ull << (WHEEL_SLOT_BITS * (pLevel)))
+#define LEVEL_SPAN(pLevel) (1ull << (WHEEL_SLOT_BITS * ((pLevel) + 1)))
+
+/*
+======================================
+Init
+
+Parameters:
+>> pNow: tick the wheel starts at
+======================================
+*/
+TimerWheel::TimerWheel(unsigned long long pNow)
+    : mFree(-1), mNow(pNow), mPending(0)
+{
+  for (int i = 0; i < LIST_COUNT; i++)
+    mHeads[i] = mTails[i] = -1;
+  for (int l = 0; l < WHEEL_LEVELS; l++)
+    mBusy[l] = 0;
+}
+
+/*
+======================================
+Append a node to a list, timers of the same tick expire in the order they
+were scheduled
+======================================
+*/
+void TimerWheel::Link(int pNode, int pList)
+{
+  Node &mNode = mNodes[pNode];
+  mNode.mList = pList;
+  mNode.mNext = -1;
+  mNode.mPrev = mTails[pList];
+
+  if (mTails[pList] >= 0)
+    mNodes[mTails[pList]].mNext = pNode;
+  else
+    mHeads[pList] = pNode;
+  mTails[pList] = pNode;
+
+  if (pList < LIST_OVERFLOW)
+    mBusy[pList / WHEEL_SLOTS] |= 1ull << (pList % WHEEL_SLOTS);
+}
+
+void TimerWheel::Unlink(int pNode)
+{
+  Node &mNode = mNodes[pNode];
+  int mList = mNode.mList;
+
+  if (mNode.mPrev >= 0)
+    mNodes[mNode.mPrev].mNext = mNode.mNext;
+  else
+    mHeads[mList] = mNode.mNext;
+  if (mNode.mNext >= 0)
+    mNodes[mNode.mNext].mPrev = mNode.mPrev;
+  else
+    mTails[mList] = mNode.mPrev;
+
+  if (mList < LIST_OVERFLOW && mHeads[mList] < 0)
+    mBusy[mList / WHEEL_SLOTS] &= ~(1ull << (mList % WHEEL_SLOTS));
+  mNode.mList = -1;
+}
+
+/*
+======================================
+Put a node in the slot of the highest group of bits where its deadline and
+now differ. The groups above it are equal and the deadline is later, so
+the slot is always ahead of the current slot of its level
+======================================
+*/
+void TimerWheel::Place(int pNode)
+{
+  unsigned long long mDeadline = mNodes[pNode].mDeadline;
+  if (mDeadline <= mNow)
+  {
+    Link(pNode, LIST_EXPIRED);
+    return;
+  }
+
+  int mLevel = (63 - __builtin_clzll(mDeadline ^ mNow)) / WHEEL_SLOT_BITS;
+  if (mLevel >= WHEEL_LEVELS)
+  {
+    Link(pNode, LIST_OVERFLOW);
+    return;
+  }
+
+  int mSlot = (int)(mDeadline >> (WHEEL_SLOT_BITS * mLevel)) & (WHEEL_SLOTS - 1);
+  Link(pNode, mLevel * WHEEL_SLOTS + mSlot);
+}
+
+/*
+======================================
+Place again every node of a list, they move to a lower level or expire
+======================================
+*/
+void TimerWheel::Cascade(int pList)
+{
+  int mNode = mHeads[pList];
+  mHeads[pList] = mTails[pList] = -1;
+  if (pList < LIST_OVERFLOW)
+    mBusy[pList / WHEEL_SLOTS] &= ~(1ull << (pList % WHEEL_SLOTS));
+
+  while (mNode >= 0)
+  {
+    int mNext = mNodes[mNode].mNext;
+    Place(mNode);
+    mNode = mNext;
+  }
+}
+
+/*
+======================================
+Advance one tick. The levels whose slot starts at the new tick are
+cascaded from the top down, then the timers of the tick expire
+======================================
+*/
+void TimerWheel::Tick()
+{
+  mNow++;
+
+  if ((mNow & (LEVEL_SPAN(WHEEL_LEVELS - 1) - 1)) == 0)
+    Cascade(LIST_OVERFLOW);
+  for (int l = WHEEL_LEVELS - 1; l > 0; l--)
+    if ((mNow & (SLOT_SPAN(l) - 1)) == 0)
+      Cascade(l * WHEEL_SLOTS + (int)((mNow >> (WHEEL_SLOT_BITS * l)) &
+                                      (WHEEL_SLOTS - 1)));
+
+  Cascade((int)(mNow & (WHEEL_SLOTS - 1)));
+}
+
+/*
+======================================
+Start a timer
+
+Parameters:
+>> pDeadline: tick it expires at, a past tick expires at once
+>> pOwner, pType: returned with the expired timer
+
+returns the handle of the timer, valid until it expires or is cancelled
+======================================
+*/
+int TimerWheel::Schedule(unsigned long long pDeadline, int pOwner, int pType)
+{
+  int mNode = mFree;
+  if (mNode >= 0)
+    mFree = mNodes[mNode].mNext;
+  else
+  {
+    mNode = (int)mNodes.size();
+    mNodes.push_back(Node());
+  }
+
+  Node &mEntry = mNodes[mNode];
+  mEntry.mDeadline = pDeadline;
+  mEntry.mOwner = pOwner;
+  mEntry.mType = pType;
+  Place(mNode);
+  mPending++;
+  return mNode;
+}
+
+/*
+======================================
+Stop a timer before it expires
+
+returns false if the timer isn't pending
+======================================
+*/
+bool TimerWheel::Cancel(int pTimer)
+{
+  if (!IsPending(pTimer))
+    return false;
+
+  Unlink(pTimer);
+  mNodes[pTimer].mNext = mFree;
+  mFree = pTimer;
+  mPending--;
+  return true;
+}
+
+bool TimerWheel::IsPending(int pTimer) const
+{
+  return pTimer >= 0 && pTimer < (int)mNodes.size() &&
+         mNodes[pTimer].mList >= 0;
+}
+
+/*
+======================================
+Take the next expired timer, advancing the wheel up to pNow only as far as
+needed to find one. Timers come out in deadline order, and a timer that an
+expired one schedules comes out in order with the rest, even when the
+wheel is catching up with a long interval
+
+Parameters:
+>> pNow: current tick
+>> pEvent: the expired timer, its handle is free again
+
+returns false once no timer is due at pNow
+======================================
+*/
+bool TimerWheel::PopExpired(unsigned long long pNow, TimerEvent &pEvent)
+{
+  while (mHeads[LIST_EXPIRED] < 0)
+  {
+    if (mNow >= pNow)
+      return false;
+
+    // No slot has work before the next busy one, skip the empty ticks
+    unsigned long long mNext = GetNextDeadline();
+    if (mNext > pNow)
+    {
+      mNow = pNow;
+      return false;
+    }
+    if (mNext > mNow + 1)
+      mNow = mNext - 1;
+    Tick();
+  }
+
+  int mNode = mHeads[LIST_EXPIRED];
+  const Node &mEntry = mNodes[mNode];
+  pEvent.mTimer = mNode;
+  pEvent.mOwner = mEntry.mOwner;
+  pEvent.mType = mEntry.mType;
+  pEvent.mDeadline = mEntry.mDeadline;
+  Cancel(mNode);
+  return true;
+}
+
+/*
+======================================
+Earliest tick the wheel has work at: a deadline, or the start of a slot of
+a higher level that must move down. Never later than the next deadline, so
+a loop can sleep until then
+
+returns WHEEL_NEVER if no timer is pending
+======================================
+*/
+unsigned long long TimerWheel::GetNextDeadline() const
+{
+  if (mHeads[LIST_EXPIRED] >= 0)
+    return mNow;
+
+  unsigned long long mNext = WHEEL_NEVER;
+  for (int l = 0; l < WHEEL_LEVELS; l++)
+  {
+    if (mBusy[l] == 0)
+      continue;
+
+    // Busy slots are all ahead of the current one, the lowest comes first
+    unsigned long long mStart = (mNow & ~(LEVEL_SPAN(l) - 1)) +
+                                ((unsigned long long)__builtin_ctzll(mBusy[l])
+                                 << (WHEEL_SLOT_BITS * l));
+    if (mStart < mNext)
+      mNext = mStart;
+  }
+
+  if (mHeads[LIST_OVERFLOW] >= 0)
+  {
+    unsigned long long mWrap =
+        (mNow | (LEVEL_SPAN(WHEEL_LEVELS - 1) - 1)) + 1;
+    if (mWrap < mNext)
+      mNext = mWrap;
+  }
+  return mNext;
+}
@@ -0,0 +1,148 @@
+/*****************************************************************************************
+ File: Trace.cpp
+ Desc: Per thread ring buffers of trace events and their Chrome trace export
+*****************************************************************************************/
+
+#include "include/Trace.h"
+
+#if TETRIS_TRACE
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::sEnabled(false);
+
+// One complete event, a scope with its start and end time in nanoseconds
+struct TraceEvent
+{
+  const char *mName;
+  unsigned long long mStart;
+  unsigned long long mEnd;
+};
+
+// Events recorded by one thread. Only the owner thread writes, the exporter
+// reads up to the published head
+struct TraceRing
+{
+  TraceEvent mEvents[TRACE_RING_SIZE];
+  std::atomic<unsigned long long> mHead;
+  int mThread;
+};
+
+// Rings of every thread that has recorded, kept until exit so the events of
+// finished threads can still be exported
+static std::mutex sRingsMutex;
+static std::vector<TraceRing *> sRings;
+static thread_local TraceRing *sThreadRing = 0;
+
+/*
+======================================
+Turn recording on or off. Trace points cost a single branch while off
+======================================
+*/
+void Trace::Enable(bool pEnabled)
+{
+  sEnabled.store(pEnabled, std::memory_order_relaxed);
+}
+
+/*
+======================================
+Return a monotonic time stamp in nanoseconds
+======================================
+*/
+unsigned long long Trace::Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/*
+======================================
+Append an event to the ring of the calling thread. The oldest events are
+overwritten once the ring is full
+======================================
+*/
+void Trace::Record(const char *pName, unsigned long long pStart,
+                   unsigned long long pEnd)
+{
+  TraceRing *mRing = sThreadRing;
+  if (mRing == 0)
+  {
+    mRing = new TraceRing();
+    mRing->mHead.store(0);
+
+    std::lock_guard<std::mutex> mLock(sRingsMutex);
+    mRing->mThread = sRings.size() + 1;
+    sRings.push_back(mRing);
+    sThreadRing = mRing;
+  }
+
+  unsigned long long mHead = mRing->mHead.load(std::memory_order_relaxed);
+  TraceEvent &mEvent = mRing->mEvents[mHead & (TRACE_RING_SIZE - 1)];
+  mEvent.mName = pName;
+  mEvent.mStart = pStart;
+  mEvent.mEnd = pEnd;
+  mRing->mHead.store(mHead + 1, std::memory_order_release);
+}
+
+/*
+======================================
+Write the events of every thread as Chrome trace JSON, loadable in
+chrome://tracing or ui.perfetto.dev. The owners keep recording while a
+ring is read: its events are copied, then the head is read again and the
+copies its owner may have overwritten in between are dropped
+
+Parameters:
+>> pPath: file to write
+
+returns false if the file can't be written
+======================================
+*/
+bool Trace::Export(const char *pPath)
+{
+  FILE *mFile = fopen(pPath, "w");
+  if (mFile == NULL)
+    return false;
+
+  fprintf(mFile, "{\"traceEvents\":[");
+  bool mFirst = true;
+
+  std::vector<TraceEvent> mCopy(TRACE_RING_SIZE);
+  std::lock_guard<std::mutex> mLock(sRingsMutex);
+  for (size_t r = 0; r < sRings.size(); r++)
+  {
+    TraceRing *mRing = sRings[r];
+    unsigned long long mHead = mRing->mHead.load(std::memory_order_acquire);
+    unsigned long long mTail =
+        mHead > TRACE_RING_SIZE ? mHead - TRACE_RING_SIZE : 0;
+    for (unsigned long long i = mTail; i < mHead; i++)
+      mCopy[i - mTail] = mRing->mEvents[i & (TRACE_RING_SIZE - 1)];
+
+    // The owner writes the slot of its head before publishing it, so only
+    // the events after the ring's length behind the new head are intact
+    std::atomic_thread_fence(std::memory_order_acquire);
+    unsigned long long mNewHead = mRing->mHead.load(std::memory_order_relaxed);
+    unsigned long long mFirstKept = mTail;
+    if (mNewHead + 1 > mTail + TRACE_RING_SIZE)
+      mFirstKept = mNewHead + 1 - TRACE_RING_SIZE;
+
+    for (unsigned long long i = mFirstKept; i < mHead; i++)
+    {
+      const TraceEvent &mEvent = mCopy[i - mTail];
+      fprintf(mFile,
+              "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+              "\"ts\":%.3f,\"dur\":%.3f}",
+              mFirst ? "" : ",", mEvent.mName, mRing->mThread,
+              mEvent.mStart / 1000.0, (mEvent.mEnd - mEvent.mStart) / 1000.0);
+      mFirst = false;
+    }
+  }
+
+  fprintf(mFile, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  return fclose(mFile) == 0;
+}
+
+#endif // TETRIS_TRACE
@@ -0,0 +1,202 @@
+/*****************************************************************************************
+ File: VecEnv.cpp
+ Desc: Batch of game environments for training agents
+*****************************************************************************************/
+
+#include "include/VecEnv.h"
+#include <cstring>
+
+/*
+======================================
+Init
+
+Parameters:
+>> pPieces: piece set of every environment
+>> pEnvs: environments in the batch
+>> pThreads: threads stepping them, the caller is one of them
+======================================
+*/
+VecEnv::VecEnv(Pieces *pPieces, int pEnvs, int pThreads)
+    : mPieces(pPieces), mPool(pThreads), mActions(NULL), mSeeds(NULL)
+{
+  memset(&mBuffers, 0, sizeof(mBuffers));
+  for (int i = 0; i < pEnvs; i++)
+    mEnvs.push_back(new Env(pPieces));
+
+  // A few partitions per thread, so a thread that is done early can steal
+  int mCount = mPool.GetThreads() * 4;
+  if (mCount > pEnvs)
+    mCount = pEnvs;
+  for (int p = 0; p < mCount; p++)
+  {
+    Partition mPartition = {this, pEnvs * p / mCount, pEnvs * (p + 1) / mCount,
+                            0};
+    mPartitions.push_back(mPartition);
+  }
+}
+
+VecEnv::~VecEnv()
+{
+  for (size_t i = 0; i < mEnvs.size(); i++)
+    delete mEnvs[i];
+}
+
+/*
+======================================
+Write the observation of an environment into the buffers and keep its mask
+
+returns false if the falling piece has no legal action
+======================================
+*/
+bool VecEnv::Observe(int pIndex)
+{
+  Env &mEnv = *mEnvs[pIndex];
+  const BoardBits &mBits = mEnv.mBoard.GetBits();
+
+  // Blocks, and free blocks with a block above them in their column
+  unsigned char *mBlocks = mBuffers.mBoards + (size_t)pIndex * ENV_BOARD_SIZE;
+  unsigned char *mHoles = mBlocks + BOARD_HEIGHT * BOARD_WIDTH;
+  unsigned int mCovered = 0;
+  for (int j = 0; j < BOARD_HEIGHT; j++)
+  {
+    unsigned int mRow = mBits.mRows[j];
+    unsigned int mHoleRow = mCovered & ~mRow;
+    mCovered |= mRow;
+    for (int i = 0; i < BOARD_WIDTH; i++)
+    {
+      mBlocks[j * BOARD_WIDTH + i] = (mRow >> i) & 1;
+      mHoles[j * BOARD_WIDTH + i] = (mHoleRow >> i) & 1;
+    }
+  }
+
+  int mKinds = mPieces->GetKinds();
+  unsigned char *mOneHot = mBuffers.mPieces + (size_t)pIndex * 2 * mKinds;
+  memset(mOneHot, 0, 2 * mKinds);
+  mOneHot[mEnv.mGame.mPiece] = 1;
+  mOneHot[mKinds + mEnv.mGame.GetNextPiece()] = 1;
+
+  Placement mPlacements[MAX_PLACEMENTS];
+  int mCount = EnumeratePlacements(mEnv.mBoard, *mPieces, mEnv.mGame.mPiece,
+                                   mPlacements);
+  memset(mEnv.mMask, 0, sizeof(mEnv.mMask));
+  for (int i = 0; i < mCount; i++)
+  {
+    const PieceShape &mShape =
+        mPieces->GetShape(mEnv.mGame.mPiece, mPlacements[i].mRotation);
+    mEnv.mMask[mPlacements[i].mRotation * BOARD_WIDTH + mPlacements[i].mX +
+               mShape.mMinX] = 1;
+  }
+  memcpy(mBuffers.mMasks + (size_t)pIndex * ENV_ACTIONS, mEnv.mMask,
+         ENV_ACTIONS);
+  return mCount > 0;
+}
+
+void VecEnv::ResetPartition(void *pArg)
+{
+  Partition *mPartition = (Partition *)pArg;
+  VecEnv *mVec = mPartition->mEnv;
+  for (int i = mPartition->mFirst; i < mPartition->mLast; i++)
+  {
+    mVec->mEnvs[i]->mGame.Reset(mVec->mSeeds[i]);
+    mVec->Observe(i);
+    mVec->mBuffers.mRewards[i] = 0;
+    mVec->mBuffers.mDones[i] = 0;
+  }
+}
+
+/*
+======================================
+Play the action of every environment of a partition
+======================================
+*/
+void VecEnv::StepPartition(void *pArg)
+{
+  Partition *mPartition = (Partition *)pArg;
+  VecEnv *mVec = mPartition->mEnv;
+  const Pieces &mPieces = *mVec->mPieces;
+
+  for (int i = mPartition->mFirst; i < mPartition->mLast; i++)
+  {
+    Env &mEnv = *mVec->mEnvs[i];
+    Game &mGame = mEnv.mGame;
+    int mAction = mVec->mActions[i];
+    int mReward = 0;
+    bool mDone = true;
+
+    if (mAction >= 0 && mAction < ENV_ACTIONS && mEnv.mMask[mAction])
+    {
+      int mRotation = mAction / BOARD_WIDTH;
+      const PieceShape &mShape = mPieces.GetShape(mGame.mPiece, mRotation);
+      int mX = mAction % BOARD_WIDTH - mShape.mMinX;
+      int mY = mPieces.GetYInitialPosition(mGame.mPiece, mRotation);
+      mY += mEnv.mBoard.GetDropDistance(mX, mY, mGame.mPiece, mRotation);
+
+      int mLines = mGame.GetLines();
+      mGame.mPosX = mX;
+      mGame.mPosY = mY;
+      mGame.mRotation = mRotation;
+      mDone = mGame.LockPiece();
+      mReward = mGame.GetLines() - mLines;
+    }
+
+    // A piece with nowhere to go ends the episode as well
+    if (mDone || !mVec->Observe(i))
+    {
+      mDone = true;
+      mGame.Reset();
+      mVec->Observe(i);
+      mPartition->mEpisodes++;
+    }
+
+    mVec->mBuffers.mRewards[i] = (float)mReward;
+    mVec->mBuffers.mDones[i] = mDone;
+  }
+}
+
+// Run a function over every partition and wait for them
+void VecEnv::Run(void (*pFunction)(void *))
+{
+  TaskGroup mGroup;
+  for (size_t p = 0; p < mPartitions.size(); p++)
+    mPool.Submit(mGroup, pFunction, &mPartitions[p]);
+  mPool.Wait(mGroup);
+}
+
+/*
+======================================
+Start a new episode in every environment and write the observations
+
+Parameters:
+>> pSeeds: seed of the pieces of each environment, the episodes that
+   follow take theirs from it
+======================================
+*/
+void VecEnv::Reset(const unsigned int *pSeeds)
+{
+  mSeeds = pSeeds;
+  Run(ResetPartition);
+}
+
+/*
+======================================
+Play one action in every environment and write the observations, rewards
+and ends of episodes
+
+Parameters:
+>> pActions: action of each environment
+======================================
+*/
+void VecEnv::Step(const int *pActions)
+{
+  mActions = pActions;
+  Run(StepPartition);
+}
+
+// Episodes finished since the environments were created
+unsigned long long VecEnv::GetEpisodes() const
+{
+  unsigned long long mTotal = 0;
+  for (size_t p = 0; p < mPartitions.size(); p++)
+    mTotal += mPartitions[p].mEpisodes;
+  return mTotal;
+}
@@ -0,0 +1,85 @@
+//: BatchResult.h
+
+#ifndef __BATCH_RESULT__
+#define __BATCH_RESULT__
+
+#include "Evaluator.h"
+#include <cstdio>
+#include <vector>
+
+#define BATCH_RESULT_VERSION 2 // version 1 files, without a sequence, load too
+#define BATCH_CLEAR_SIZES 8 // line clears counted by size, larger ones go
+                            // to the last
+#define SKETCH_SUB_BITS 7   // buckets per power of two, as bits
+#define SKETCH_BUCKETS ((64 - SKETCH_SUB_BITS + 1) << SKETCH_SUB_BITS)
+
+//------------------------------
+// Quantile sketch of non negative integers. Values below 2^SKETCH_SUB_BITS
+// have a bucket each, larger ones share a bucket with the values within
+// 1 / 2^SKETCH_SUB_BITS of them. The buckets are fixed, so merging two
+// sketches adds their counts and gives exactly the sketch of all the values,
+// in any order.
+//------------------------------
+
+struct Sketch
+{
+  unsigned long long mCount, mSum, mMin, mMax;
+  std::vector<unsigned long long> mBuckets;
+
+  Sketch();
+  void Add(unsigned long long pValue);
+  void Merge(const Sketch &pOther);
+  unsigned long long GetQuantile(double pQuantile) const;
+
+  static int GetBucket(unsigned long long pValue);
+  static unsigned long long GetBucketLow(int pBucket);
+};
+
+//------------------------------
+// Seeds [mFirst, mLast) played by a run
+//------------------------------
+
+struct SeedRange
+{
+  unsigned long long mFirst, mLast;
+};
+
+//------------------------------
+// Result of a batch of headless games, played by the greedy bot from a
+// range of seeds. The file names the settings of the games and the seeds
+// they cover, so results of separate runs can be checked and merged: every
+// total is an integer sum, min or max, and merging any split of a seed
+// range gives byte for byte the file a single run over the range writes.
+// A run saves its partial result as it goes and resumes from it.
+//------------------------------
+
+class BatchResult
+{
+public:
+  // Settings, results must share them to be merged
+  unsigned long long mPieceSet; // Pieces::GetHash of the piece set
+  unsigned long long mSequence; // PieceSequence::GetHash, 0 for the seeds
+  int mMaxPieces;               // pieces before a game is stopped
+  EvalWeights mWeights;
+  std::vector<SeedRange> mSeeds; // sorted, not touching each other
+
+  // Totals
+  unsigned long long mGames, mCapped; // games played, stopped at mMaxPieces
+  unsigned long long mClears[BATCH_CLEAR_SIZES]; // by lines cleared at once
+  Sketch mScore, mLines, mPieces; // per game, mPieces until game over
+
+  BatchResult();
+
+  void AddSeeds(unsigned long long pFirst, unsigned long long pLast);
+  void AddGame(unsigned long long pScore, unsigned long long pLines,
+               unsigned long long pPieces, bool pCapped,
+               const unsigned long long *pClears);
+  bool IsCompatible(const BatchResult &pOther) const;
+  bool Merge(const BatchResult &pOther);
+
+  bool Save(const char *pPath) const;
+  bool Load(const char *pPath);
+  void Print(FILE *pFile) const;
+};
+
+#endif // __BATCH_RESULT__
@@ -0,0 +1,97 @@
+//: Battle.h
+
+#ifndef __BATTLE__
+#define __BATTLE__
+
+#include "Controller.h"
+#include "Evaluator.h"
+#include "MpscQueue.h"
+#include "ThreadPool.h"
+#include <vector>
+
+#define BATTLE_QUEUE_SIZE 256 // attacks a board can receive in one tick
+
+//------------------------------
+// Garbage sent by a player, applied by the target at the next tick
+//------------------------------
+
+struct GarbageAttack
+{
+  int mSender;
+  int mSequence; // attacks sent by the sender before this one
+  int mLines;
+  int mHole;     // free column of the garbage lines
+};
+
+//------------------------------
+// One board of a battle, played by the greedy bot
+//------------------------------
+
+struct BattlePlayer
+{
+  Board mBoard;
+  Game mGame;
+  Controller mControl;
+  // Attacks sent during even and odd ticks, a tick takes the ones of the
+  // tick before while the others fill the second queue
+  MpscQueue<GarbageAttack, BATTLE_QUEUE_SIZE> mIncoming[2];
+  std::vector<GarbageAttack> mPending; // incoming attacks being applied
+
+  unsigned int mRand;    // target and hole choices
+  int mLines;            // lines cleared at the last tick
+  int mSequence;         // attacks sent
+  unsigned long long mSent, mReceived, mDropped; // garbage lines
+  unsigned long long mDeathTick; // tick the board topped out, or 0
+
+  BattlePlayer(Pieces *pPieces, unsigned int pSeed);
+};
+
+//------------------------------
+// Battle of many boards in one process. Every tick each board takes the
+// garbage sent to it during the tick before, then its bot plays one tick;
+// lines it clears go as garbage to a random opponent through the lock free
+// queue of that board. Boards are split in contiguous partitions, one task
+// of the thread pool each, and the tick ends when every partition is done.
+//
+// A board only reads its own state, the queue of the tick before and the
+// players alive at the start of the tick, and applies its garbage sorted by
+// sender, so a seed gives the same battle whatever the number of threads.
+//------------------------------
+
+class Battle
+{
+  struct Partition
+  {
+    Battle *mBattle;
+    int mFirst, mLast;
+  };
+
+  Pieces *mPieces;
+  EvalWeights mWeights;
+  std::vector<BattlePlayer *> mPlayers;
+  std::vector<char> mAlive; // at the start of the tick
+  std::vector<Partition> mPartitions;
+  ThreadPool mPool;
+  unsigned long long mTick;
+  int mAliveCount;
+
+  static void RunPartition(void *pArg);
+  void TickPlayer(int pIndex);
+  int ChooseTarget(int pIndex);
+
+public:
+  Battle(Pieces *pPieces, const EvalWeights &pWeights, int pPlayers,
+         unsigned int pSeed, int pThreads);
+  ~Battle();
+
+  void Tick();
+  int Run(unsigned long long pMaxTicks);
+
+  int GetPlayers() const { return (int)mPlayers.size(); }
+  int GetAlive() const { return mAliveCount; }
+  unsigned long long GetTick() const { return mTick; }
+  BattlePlayer &GetPlayer(int pIndex) { return *mPlayers[pIndex]; }
+  unsigned long long Hash() const;
+};
+
+#endif // __BATTLE__
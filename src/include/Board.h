@@ -13,31 +13,95 @@
 #define BOARD_HEIGHT 20 // board height in blocks
 #define MIN_VERTICAL_MARGIN 20  // minimum vertical margin for the board limit
 #define MIN_HORIZONAL_MARGIN 20 // minimum horizontal margin for the board limit
-#define PIECES_BLOCKS                                                          \
-  5 // number of horizontal and vertical blocks of martrix pieces
+#define BOARD_FULL_ROW ((1 << BOARD_WIDTH) - 1) // mask of a completed line
+
+// Row masks handled by one vector instruction in the batched kernels, 16
+// with AVX2 and 8 with SSE2 or the scalar fallback
+#if defined(__AVX2__)
+#define BATCH_WIDTH 16
+#else
+#define BATCH_WIDTH 8
+#endif
+
+//------------------------------
+// Blocks of a board and nothing else, small enough for one cache line so
+// searches can make millions of them cheaply. The piece set is passed to
+// the methods that need piece shapes. Board wraps one of these with the
+// piece set and the screen layout.
+//------------------------------
+
+struct BoardBits
+{
+  // Filled blocks of each line, bit x is the block in column x
+  unsigned short mRows[BOARD_HEIGHT];
+  signed char mColumnTop[BOARD_WIDTH]; // highest filled row of each column,
+                                       // or BOARD_HEIGHT if it is empty
+
+  void Clear();
+  bool IsFreeBlock(int pX, int pY) const { return !(mRows[pY] & (1 << pX)); }
+  bool IsPossibleMovement(const Pieces &pPieces, int pX, int pY, int pPiece,
+                          int pRotation) const;
+  int TryRotation(const Pieces &pPieces, int &pX, int &pY, int pPiece,
+                  int pFrom, int pTo) const;
+  void StorePieces(const Pieces &pPieces, int pX, int pY, int pPiece,
+                   int pRotation);
+  int DeletePossibleLines();
+  bool InsertGarbage(int pLines, int pHole);
+  bool IsGameOver() const { return mRows[0] != 0; }
+  int GetColumnHeight(int pX) const { return BOARD_HEIGHT - mColumnTop[pX]; }
+  int GetDropDistance(const Pieces &pPieces, int pX, int pY, int pPiece,
+                      int pRotation) const;
+  unsigned long long Hash() const;
+
+private:
+  void DeleteLine(int pY);
+  int ScanDropDistance(const Pieces &pPieces, int pX, int pY, int pPiece,
+                       int pRotation) const;
+
+  // Mask of a piece row placed with its matrix at column pX
+  static unsigned int ShiftRow(unsigned int pRow, int pX)
+  {
+    return pX >= 0 ? pRow << pX : pRow >> -pX;
+  }
+};
 
 class Board {
-  enum {
-    POS_FREE,
-    POS_FILLED
-  }; // POS_FREE = free podsiton of the board, POS_FILLED = filled positon of
-     // board
-  int mBoard[BOARD_WIDTH][BOARD_HEIGHT];
+  BoardBits mBits;
   Pieces *mPieces;
   int mScreenHeight;
 
-  void InitBoard();
-  void DeleteLine(int pY);
-
 public:
   Board(Pieces *pPieces, int pScreenHeight);
 
+  void Reset();
   int GetXPosInPixels(int pPos);
   int GetYPosInPixels(int pPos);
-  bool IsFreeBlock(int pX, int pY);
-  bool IsPossibleMovement(int pX, int pY, int pPieces, int pRotation);
-  void StorePieces(int pX, int pY, int pPieces, int pRotation);
-  void DeletePossibleLines();
-  bool IsGameOver();
+  const BoardBits &GetBits() const { return mBits; }
+  bool IsFreeBlock(int pX, int pY) const { return mBits.IsFreeBlock(pX, pY); }
+  unsigned short GetRow(int pY) const { return mBits.mRows[pY]; }
+  bool IsPossibleMovement(int pX, int pY, int pPieces, int pRotation) const
+  {
+    return mBits.IsPossibleMovement(*mPieces, pX, pY, pPieces, pRotation);
+  }
+  int TryRotation(int &pX, int &pY, int pPiece, int pFrom, int pTo) const
+  {
+    return mBits.TryRotation(*mPieces, pX, pY, pPiece, pFrom, pTo);
+  }
+  void StorePieces(int pX, int pY, int pPieces, int pRotation)
+  {
+    mBits.StorePieces(*mPieces, pX, pY, pPieces, pRotation);
+  }
+  int DeletePossibleLines() { return mBits.DeletePossibleLines(); }
+  bool InsertGarbage(int pLines, int pHole)
+  {
+    return mBits.InsertGarbage(pLines, pHole);
+  }
+  bool IsGameOver() const { return mBits.IsGameOver(); }
+  int GetColumnHeight(int pX) const { return mBits.GetColumnHeight(pX); }
+  int GetDropDistance(int pX, int pY, int pPiece, int pRotation) const
+  {
+    return mBits.GetDropDistance(*mPieces, pX, pY, pPiece, pRotation);
+  }
+  unsigned long long Hash() const { return mBits.Hash(); }
 };
 #endif // !__BOARD__
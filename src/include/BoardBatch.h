@@ -0,0 +1,56 @@
+//: BoardBatch.h
+
+#ifndef __BOARD_BATCH__
+#define __BOARD_BATCH__
+
+#include "Board.h"
+#include <vector>
+
+//------------------------------
+// Board batch, many boards played in lockstep. The row masks are stored as
+// a structure of arrays, row y of every board next to each other, so one
+// vector instruction tests a collision, stores a piece or finds a full row
+// for BATCH_WIDTH boards at once.
+//
+// Each board is a lane. Every step spawns the piece chosen for each lane
+// at the top of its board and lets gravity drop all of them together, one
+// row at a time, until each one is stored. Since all pieces start on the
+// same row, the row under test is the same for every lane and only the
+// rows of the pieces are touched. Lanes whose piece has landed, lanes
+// without a piece and lanes whose game is over are masked out.
+//------------------------------
+
+class BoardBatch
+{
+  const Pieces *mPieces;
+  int mBoards; // lanes in use
+  int mLanes;  // lanes stored, a multiple of BATCH_WIDTH
+  int mWindow; // rows of the tallest piece of the set
+
+  // Row y of lane l is at [y * mLanes + l]
+  std::vector<unsigned short> mRows;  // filled blocks
+  std::vector<unsigned short> mPiece; // next piece, from its top row
+  std::vector<unsigned short> mAlive; // 0xffff while the game goes on
+  std::vector<int> mLines;            // lines cleared by each lane
+
+  void ClearLines(int pFirst, int pTop, int pBottom);
+
+public:
+  BoardBatch(const Pieces *pPieces, int pBoards);
+
+  void Reset();
+  void ResetLane(int pLane);
+
+  void SetPiece(int pLane, int pPiece, int pRotation, int pX);
+  unsigned long long Step();
+
+  int GetBoards() const { return mBoards; }
+  bool IsAlive(int pLane) const { return mAlive[pLane] != 0; }
+  int GetLines(int pLane) const { return mLines[pLane]; }
+  unsigned short GetRow(int pLane, int pY) const
+  {
+    return mRows[pY * mLanes + pLane];
+  }
+};
+
+#endif // __BOARD_BATCH__
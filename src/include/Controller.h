@@ -0,0 +1,52 @@
+//: Controller.h
+
+#ifndef __CONTROLLER__
+#define __CONTROLLER__
+
+#include "Game.h"
+#include "GameState.h"
+#include "Placement.h"
+#include "TimerWheel.h"
+
+// Actions a program can play, each one a key tapped once
+enum ControlAction
+{
+  ACTION_LEFT,
+  ACTION_RIGHT,
+  ACTION_ROTATE,
+  ACTION_SOFT_DROP, // one row down
+  ACTION_HARD_DROP, // down to the stack and lock
+  ACTION_ROTATE_CCW,
+  ACTION_ROTATE_180,
+  ACTION_COUNT
+};
+
+//------------------------------
+// Control of a game by a program instead of the keyboard. Actions go
+// straight to the game and time only moves when the caller steps it, a
+// tick of TICK_TIME milliseconds at a time, on a virtual clock of its own:
+// the game runs as fast as it is driven, never waits on the wall clock or
+// the display, and the same seed and calls always give the same game. The
+// game may have no IO, or be drawn by the caller between steps.
+//------------------------------
+
+class Controller
+{
+  Game *mGame;
+  TimerWheel mTimers;
+  unsigned long long mTicks; // ticks stepped since the last Reset
+
+public:
+  Controller(Game *pGame);
+  ~Controller();
+
+  void Reset(unsigned int pSeed);
+  bool Act(int pAction);
+  bool Place(const Placement &pPlacement);
+  void Step(int pTicks);
+  int StepToPiece(int pMaxTicks);
+  void GetState(GameState &pState) { mGame->GetState(pState); }
+  unsigned long long GetTicks() const { return mTicks; }
+};
+
+#endif // __CONTROLLER__
@@ -0,0 +1,98 @@
+//: EvalCache.h
+
+#ifndef __EVAL_CACHE__
+#define __EVAL_CACHE__
+
+#include "Evaluator.h"
+#include "SpscRing.h"
+#include <atomic>
+#include <cstdio>
+
+#define EVAL_CACHE_MAGIC 0x43455454 // "TTEC"
+#define EVAL_CACHE_VERSION 1
+#define EVAL_CACHE_WAYS 4        // entries of a bucket, one cache line
+#define EVAL_CACHE_BITS 16       // buckets of a new file, as bits
+#define EVAL_CACHE_MAX_BITS 28
+
+//------------------------------
+// Cached choice of the bot. The key is the hash of the board, the piece and
+// the settings; mCheck holds the key xored with mData, so a reader that
+// meets an entry half written by another process sees a key that doesn't
+// match and takes it as a miss.
+// mData: score as float bits << 32, flags << 24, rotation << 16, y << 8, x
+//------------------------------
+
+struct EvalCacheEntry
+{
+  std::atomic<unsigned long long> mCheck;
+  std::atomic<unsigned long long> mData;
+};
+
+struct alignas(CACHE_LINE_SIZE) EvalCacheBucket
+{
+  EvalCacheEntry mEntries[EVAL_CACHE_WAYS];
+};
+
+struct alignas(CACHE_LINE_SIZE) EvalCacheHeader
+{
+  unsigned int mMagic;
+  unsigned int mVersion;
+  unsigned int mBucketBits;
+};
+
+//------------------------------
+// Counters of one user of the cache, summed by the caller
+//------------------------------
+
+struct EvalCacheStats
+{
+  unsigned long long mHits, mMisses;
+  unsigned long long mHitNs, mMissNs; // time spent answering each
+
+  EvalCacheStats();
+  void Add(const EvalCacheStats &pOther);
+  void Print(FILE *pFile) const;
+};
+
+//------------------------------
+// Evaluation cache, the best placement of a piece on a board kept in a
+// memory mapped file. The file is a table of buckets of EVAL_CACHE_WAYS
+// entries: a lookup reads the one cache line of its bucket and never takes
+// a lock, so any number of processes can share the file while they play,
+// and it keeps its entries for the next run. Entries of other piece sets
+// and weights have other keys and never match.
+//------------------------------
+
+class EvalCache
+{
+  EvalCacheHeader *mHeader;
+  EvalCacheBucket *mBuckets;
+  size_t mSize;                  // bytes mapped
+  unsigned long long mMask;      // buckets - 1
+  unsigned long long mSettings;  // hash of the pieces and weights
+  const Pieces *mPieces;
+  EvalWeights mWeights;
+
+  bool Map(int pFd);
+
+public:
+  EvalCache();
+  ~EvalCache();
+
+  bool Open(const char *pPath, const Pieces &pPieces,
+            const EvalWeights &pWeights, int pBucketBits = EVAL_CACHE_BITS);
+  void Close();
+  bool IsOpen() const { return mHeader != NULL; }
+  int GetBucketBits() const { return IsOpen() ? mHeader->mBucketBits : 0; }
+
+  unsigned long long GetKey(const BoardBits &pBoard, int pPiece) const;
+  bool Lookup(unsigned long long pKey, bool &pFound, Placement &pBest,
+              double &pScore) const;
+  void Store(unsigned long long pKey, bool pFound, const Placement &pBest,
+             double pScore);
+
+  bool ChoosePlacement(const Board &pBoard, int pPiece, Placement &pBest,
+                       EvalCacheStats &pStats);
+};
+
+#endif // __EVAL_CACHE__
@@ -0,0 +1,38 @@
+//: Evaluator.h
+
+#ifndef __EVALUATOR__
+#define __EVALUATOR__
+
+#include "Features.h"
+#include <cstddef>
+
+//------------------------------
+// Weights of the board evaluation used by the bots. Positive weights
+// reward a feature, negative weights penalize it
+//------------------------------
+
+struct EvalWeights
+{
+  double mHeight;    // sum of the column heights
+  double mHoles;     // free blocks with a filled block above them
+  double mBumpiness; // sum of the height differences of adjacent columns
+  double mWells;     // sum of the depths of the columns lower than both
+                     // neighbours
+  double mLines;     // lines cleared by the placement
+
+  EvalWeights();
+};
+
+double Evaluate(const FeatureVector &pFeatures, const EvalWeights &pWeights);
+double Evaluate(const BoardBits &pBoard, const EvalWeights &pWeights);
+
+inline double Evaluate(const Board &pBoard, const EvalWeights &pWeights)
+{
+  return Evaluate(pBoard.GetBits(), pWeights);
+}
+
+bool ChoosePlacement(const Board &pBoard, const Pieces &pPieces, int pPiece,
+                     const EvalWeights &pWeights, Placement &pBest,
+                     double *pScore = NULL);
+
+#endif // __EVALUATOR__
@@ -0,0 +1,92 @@
+//: Expectimax.h
+
+#ifndef __EXPECTIMAX__
+#define __EXPECTIMAX__
+
+#include "Evaluator.h"
+#include "Placement.h"
+#include "SearchArena.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <vector>
+
+#define SEARCH_LOSS -1e9          // value of a placement that ends the game
+#define SEARCH_PARALLEL_DEPTH 2   // chance nodes with at least this many
+                                  // plies left split over the pool
+#define SEARCH_TABLE_BITS 20      // log2 of the transposition table entries
+
+//------------------------------
+// Statistics of the last search
+//------------------------------
+
+struct SearchStats
+{
+  unsigned long long mNodes; // boards generated by a placement
+  int mDepth;                // plies of the deepest completed iteration
+  double mSeconds;
+  unsigned long long mTableHits;
+  size_t mArenaNodes;     // nodes made by the decision
+  size_t mArenaBytes;     // arena bytes used by the decision
+  size_t mArenaPeakBytes; // most arena bytes used by one decision so far
+
+  double NodesPerSecond() const { return mSeconds > 0 ? mNodes / mSeconds : 0; }
+};
+
+//------------------------------
+// Expectimax search over placements. Max nodes choose the placement of a
+// known piece, chance nodes average over every kind of unknown piece.
+// The root placements and the chance nodes near the root run in parallel on
+// a thread pool and share one lock free transposition table. The boards of
+// the tree are made in per thread arenas, reset after every decision.
+//------------------------------
+
+class Expectimax
+{
+  // Transposition table entry, mCheck is the key xor the value so a torn
+  // read of an entry written by another thread is detected
+  struct TableEntry
+  {
+    std::atomic<unsigned long long> mCheck;
+    std::atomic<unsigned long long> mValue;
+  };
+
+  const Pieces *mPieces;
+  ThreadPool *mPool;
+  EvalWeights mWeights;
+  std::vector<TableEntry> mTable;
+  unsigned long long mTableMask;
+  ThreadArenas mArenas;
+  size_t mPeakNodes;
+
+  std::atomic<bool> mStop;
+  std::atomic<unsigned long long> mNodes, mTableHits;
+  unsigned long long mDeadline; // nanoseconds, 0 for no deadline
+
+  friend struct RootTask;
+  friend struct ChanceTask;
+
+  bool SearchDepth(const BoardBits &pBoard, int pPiece, int pNextPiece,
+                   int pDepth, Placement *pBest);
+  double MaxNode(const BoardBits &pBoard, int pPiece, int pNextPiece,
+                 int pDepth, SearchArena &pArena, unsigned long long &pNodes);
+  double LeafNode(const BoardBits &pBoard, int pPiece,
+                  unsigned long long &pNodes);
+  double PlacementValue(const BoardBits &pBoard, const Placement &pPlacement,
+                        int pPiece, int pNextPiece, int pDepth,
+                        SearchArena &pArena, unsigned long long &pNodes);
+  double ChanceNode(const BoardBits &pBoard, int pDepth, SearchArena &pArena,
+                    unsigned long long &pNodes);
+  bool Lookup(unsigned long long pKey, double &pValue);
+  void Store(unsigned long long pKey, double pValue);
+  bool CheckStop();
+
+public:
+  Expectimax(const Pieces *pPieces, ThreadPool *pPool,
+             const EvalWeights &pWeights, int pTableBits = SEARCH_TABLE_BITS);
+
+  Placement Search(const Board &pBoard, int pPiece, int pNextPiece,
+                   int pTimeBudget, int pMaxDepth, SearchStats *pStats);
+  void ClearTable();
+};
+
+#endif // __EXPECTIMAX__
@@ -0,0 +1,50 @@
+//: Features.h
+
+#ifndef __FEATURES__
+#define __FEATURES__
+
+#include "Placement.h"
+
+//------------------------------
+// Features of a board, in a fixed layout shared by the bots and offline
+// analysis. Every value is computed with masks and popcounts over the row
+// masks, never block by block.
+//------------------------------
+
+enum FeatureIndex
+{
+  FEATURE_HEIGHT,             // sum of the column heights
+  FEATURE_MAX_HEIGHT,         // height of the highest column
+  FEATURE_HOLES,              // free blocks with a filled block above them
+  FEATURE_COVERED,            // filled blocks with a hole below them
+  FEATURE_BUMPINESS,          // sum of the height differences of adjacent
+                              // columns
+  FEATURE_WELLS,              // sum of the depths of the columns lower than
+                              // both neighbours, the walls are full columns
+  FEATURE_MAX_WELL,           // depth of the deepest of those columns
+  FEATURE_ROW_TRANSITIONS,    // filled to free changes along the rows of the
+                              // stack, the walls are filled
+  FEATURE_COLUMN_TRANSITIONS, // filled to free changes down the columns, the
+                              // floor is filled
+  FEATURE_LINES,              // lines cleared by the placement, 0 for a board
+  FEATURE_COLUMN_HEIGHT,      // height of column 0, then one per column
+  FEATURE_COUNT = FEATURE_COLUMN_HEIGHT + BOARD_WIDTH
+};
+
+struct FeatureVector
+{
+  short mValues[FEATURE_COUNT];
+
+  short operator[](int pIndex) const { return mValues[pIndex]; }
+};
+
+const char *GetFeatureName(int pIndex);
+
+void ExtractFeatures(const BoardBits &pBoard, FeatureVector &pOut);
+void ExtractFeatures(const BoardBits *pBoards, int pCount,
+                     FeatureVector *pOut);
+int ExtractPlacementFeatures(const BoardBits &pBoard, const Pieces &pPieces,
+                             int pPiece, Placement *pPlacements,
+                             FeatureVector *pOut);
+
+#endif // __FEATURES__
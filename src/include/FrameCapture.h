@@ -0,0 +1,55 @@
+//: FrameCapture.h
+
+#ifndef __FRAME_CAPTURE__
+#define __FRAME_CAPTURE__
+
+#include "SpscRing.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#define CAPTURE_MAX_BUFFERS 64 // largest frame pool
+#define CAPTURE_FPS 60         // frame rate written in the Y4M header
+
+//------------------------------
+// Frame capture, streams presented frames to a file from a writer thread.
+// Frames are read back into a pool of reusable buffers; the render thread
+// only takes free buffers and hands filled ones over, so it never waits on
+// the disk. When every buffer is waiting to be written the frame is
+// dropped and counted.
+//------------------------------
+
+class FrameCapture
+{
+  SpscRing<unsigned char *, CAPTURE_MAX_BUFFERS> mFree;   // writer to render
+  SpscRing<unsigned char *, CAPTURE_MAX_BUFFERS> mFilled; // render to writer
+  std::vector<unsigned char *> mBuffers;
+  std::vector<unsigned char> mYuv; // converted frame, writer thread only
+  int mSourceWidth, mSourceHeight; // size of the frames read back
+  int mWidth, mHeight;             // size of the frames written
+  bool mConvert; // write YUV 4:2:0 Y4M instead of raw RGB24
+  FILE *mFile;
+  std::thread mWriter;
+  std::atomic<bool> mRunning;
+  std::atomic<unsigned long long> mCaptured, mDropped;
+  unsigned long long mWritten;
+
+  void WriterLoop();
+  void WriteFrame(const unsigned char *pPixels);
+  void ConvertToYuv(const unsigned char *pPixels);
+
+public:
+  FrameCapture();
+  ~FrameCapture();
+
+  bool Start(const char *pPath, int pWidth, int pHeight, int pBuffers);
+  void Stop();
+  bool IsCapturing() const { return mFile != NULL; }
+
+  unsigned char *AcquireBuffer();
+  void SubmitBuffer(unsigned char *pBuffer);
+  int GetPitch() const { return mSourceWidth * 3; }
+};
+
+#endif // __FRAME_CAPTURE__
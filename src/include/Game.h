@@ -3,17 +3,79 @@
 #define __GAME__
 
 #include "Board.h"
+#include "GameState.h"
 #include "IO.h"
+#include "Metrics.h"
+#include "PieceSequence.h"
 #include "Pieces.h"
+#include "Telemetry.h"
+#include "TimerWheel.h"
 #include <time.h>
 
-#define WAIT_TIME 700
+#define WAIT_TIME 700       // milliseconds per row at level 0
+#define TICK_TIME 16        // milliseconds per gravity tick (~60 Hz)
+#define LEVEL_LINES 10      // lines to clear before the next level
+#define LEVEL_MAX 15        // highest level (20G)
+#define GRAVITY_ONE_G 256   // gravity of one row per tick, in 1/256 rows
+#define GRAVITY_20G (20 * GRAVITY_ONE_G) // the whole board every tick
+#define NEXT_POS_X (BOARD_WIDTH + 5) // position of the next piece preview
+#define NEXT_POS_Y 5
+
+// Timers of a game driven by a TimerWheel, in milliseconds
+#define LOCK_DELAY 500  // a piece on the stack locks after this long
+#define LOCK_RESETS 15  // moves and rotations that restart the lock delay
+#define DAS_TIME 167    // a held key waits this long before repeating
+#define ARR_TIME 33     // and then repeats this often
+#define CLEAR_DELAY 200 // pause after a piece clears lines
+#define ENTRY_DELAY 100 // pause before the next piece appears
+
+enum GameTimer
+{
+  TIMER_GRAVITY, // the piece falls the rows the level gravity accumulated
+  TIMER_LOCK,    // the lock delay ran out
+  TIMER_REPEAT,  // the held move repeats
+  TIMER_CLEAR,   // the line clear delay ended, the entry delay starts
+  TIMER_ENTRY,   // the next piece appears
+  TIMER_TYPES
+};
+
+enum GameMove
+{
+  MOVE_LEFT,
+  MOVE_RIGHT,
+  MOVE_DOWN
+};
 
 class Game {
   int mScreenHeight;
-  int mNextPosX, mNextPosY;
   int mNextPiece, mNextRotation;
   int score;
+  int mLevel, mStartLevel;
+  int mLines;
+  int mGravityAcc; // fraction of a row accumulated by gravity, 1/256 rows
+  int mGhostY;     // resting row of the falling piece
+  bool mGameOver;
+  unsigned int mSeed;      // seed of the current round
+  unsigned int mRandState; // state of the piece generator
+  const PieceSequence *mSequence; // pieces read from a sequence, or NULL
+  unsigned long long mSequenceStart, mSequenceCursor; // first and next piece
+  int mRound;
+  unsigned long long mTicks;
+  int mPiecesPlaced;
+  int mKeys, mTotalKeys; // key presses for the falling piece and the round
+
+  // Timers, when the game is driven by a wheel
+  TimerWheel *mTimers;
+  int mOwner;              // owner of the timers of this game in the wheel
+  int mGravityTimer, mLockTimer, mRepeatTimer, mEntryTimer; // or -1
+  int mGravityTicks;       // ticks until the gravity timer expires
+  int mLockResets;         // lock delay restarts used by the piece
+  int mRepeatMove;         // GameMove held, or -1
+  bool mSpawning;          // no piece falls until the entry delay ends
+
+  Telemetry *mTelemetry;
+  unsigned long long mPieceStart, mRoundStart; // telemetry time stamps
+  Metrics *mMetrics;
 
   Board *mBoard;
   Pieces *mPieces;
@@ -22,16 +84,58 @@ class Game {
   int GetRand(int pA, int pB);
   void InitGame();
   void DrawPiece(int pX, int pY, int pPieces, int pRotation);
-  void DrawBoard();
+  void DrawGhost(const GameState &pState);
+  void DrawBoard(const GameState &pState);
+  void UpdateGhost();
+  void EmitTelemetry(int pType, int pLines);
+  bool Shift(int pDx);
+  bool StepDown();
+  bool Repeat(int pMove);
+  void ScheduleGravity();
+  void UpdateLock(bool pMoved);
+  void StartEntry(bool pCleared);
+  void CancelTimers();
+  void EndGame();
+  void PickPiece(int &pPiece, int &pRotation);
 
 public:
-  Game(Board *pBoard, Pieces *pPieces, IO *pIO, int pScreenHeight);
+  Game(Board *pBoard, Pieces *pPieces, IO *pIO, int pScreenHeight,
+       int pStartLevel = 0);
+
+  void Reset();
+  void Reset(unsigned int pSeed);
+  bool IsGameOver();
+  unsigned int GetSeed();
+  int GetNextPiece();
+  void SetSequence(const PieceSequence *pSequence, unsigned long long pStart);
+  void SetTelemetry(Telemetry *pTelemetry);
+  void SetMetrics(Metrics *pMetrics);
+  void SetTimers(TimerWheel *pTimers, int pOwner);
+  void OnTimer(const TimerEvent &pEvent);
+  void StartRepeat(int pMove);
+  void StopRepeat(int pMove);
+  bool IsSpawning();
+  void GetState(GameState &pState);
 
-  void DrawScene();
+  void DrawScene(const GameState &pState);
+  void DrawGameOver();
   void CreateNewPiece();
   void incrementScore();
   int getScore();
 
+  int GetLevel();
+  int GetLines();
+  int GetGravity();
+
+  bool MoveLeft();
+  bool MoveRight();
+  bool MoveDown();
+  bool Rotate(int pTurns = 1); // quarter turns clockwise, 3 is counter-clockwise
+  bool HardDrop();
+  bool ApplyGravity();
+  bool LockPiece();
+  bool AddGarbage(int pLines, int pHole);
+
   int mPosX, mPosY;      // Position of the piece that is falling down
   int mPiece, mRotation; // kind and rotation the piece is falling down
 };
@@ -0,0 +1,29 @@
+//: GameState.h
+
+#ifndef __GAME_STATE__
+#define __GAME_STATE__
+
+#include "Board.h"
+
+//------------------------------
+// Plain copy of everything needed to show or inspect a game: the board
+// blocks, the falling and next pieces and the counters. It holds no
+// pointers, so it can be copied between threads and processes as is.
+//------------------------------
+
+struct GameState
+{
+  unsigned short mRows[BOARD_HEIGHT]; // bit x of row y is block (x, y)
+  int mPiece, mRotation;              // falling piece
+  int mPosX, mPosY;                   // position of the falling piece
+  int mGhostY;                        // row where the falling piece rests
+  int mNextPiece, mNextRotation;      // preview piece
+  int mScore, mLevel, mLines;
+  int mRound;
+  int mGameOver;
+  int mSpawning;                      // no falling piece, the next one is
+                                      // waiting for the entry delay
+  unsigned long long mTick;           // gravity ticks in the round
+};
+
+#endif // __GAME_STATE__
@@ -2,8 +2,12 @@
 
 #ifndef __IO__
 #define __IO__
+#include "Board.h"
+#include "FrameCapture.h"
 #include <SDL.h>
 
+#define KEY_RELEASED 0x20000000 // or'ed into the key code of a key let go
+
 enum color
 {
   BLACK,
@@ -14,28 +18,47 @@ enum color
   MAGENTA,
   YELLOW,
   WHITE,
+  GREY,
   COLOR_MAX
 };
 
 class IO
 {
 public:
-  IO();
+  IO(bool pVsync = true);
+  ~IO();
 
   void DrawRectangle(int pX1, int pY1, int pX2, int pY2, enum color pC);
+  void DrawBoardCells(const unsigned short *pRows, int pX, int pY, enum color pC);
   void ClearScreen();
   int GetScreenHeight();
-  int InitGraph();
+  int InitGraph(bool pVsync = true);
   int PollKey();
+  int WaitKey();
+  void WakeUp();
   int Getkey();
   int IsKeyDown(int pKey);
   void UpdateScreen();
   void DrawText(const char *text, int pX1, int pY1, int pX2, int pY2, enum color pC);
   void DrawScore(int score);
+  bool StartCapture(const char *pPath, int pBuffers);
+  void StopCapture();
 
 private:
   static SDL_Window *window;
   static SDL_Renderer *renderer;
+  // Board mirrored in a texture of one texel per cell, and the cell borders
+  // of the whole board pre-rendered in a texture drawn over it
+  static SDL_Texture *boardTexture;
+  static SDL_Texture *cellTexture;
+  static bool boardTexturesFailed; // rectangles are drawn instead
+  FrameCapture capture; // frames presented while capturing
+  static Uint32 boardPixels[BOARD_HEIGHT][BOARD_WIDTH];
+  static unsigned short boardRows[BOARD_HEIGHT];
+  static int boardColor; // color of the uploaded cells, or -1 before any
+  static Uint32 wakeEvent; // event that ends a WaitKey, or 0 if none
+  bool CreateBoardTextures();
+  void DestroyBoardTextures();
   void DrawDigitAsBlocks(int digit, int x, int y, int blockSize, enum color pC);
 };
 #endif // __IO__
@@ -0,0 +1,199 @@
+//: Lanes.h
+
+#ifndef __LANES__
+#define __LANES__
+
+//------------------------------
+// Lanes, the few vector operations the batched kernels need over 16 bit
+// lanes: AVX2, SSE2 or a plain loop the compiler may vectorize by itself.
+// A mask lane is 0xffff or 0. Arithmetic is on signed 16 bit values
+//------------------------------
+
+#include "Board.h" // BATCH_WIDTH
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+typedef __m256i Lanes;
+
+static inline Lanes Load(const unsigned short *p)
+{
+  return _mm256_loadu_si256((const __m256i *)p);
+}
+static inline void Store(unsigned short *p, Lanes a)
+{
+  _mm256_storeu_si256((__m256i *)p, a);
+}
+static inline Lanes Splat(unsigned short v) { return _mm256_set1_epi16(v); }
+static inline Lanes And(Lanes a, Lanes b) { return _mm256_and_si256(a, b); }
+static inline Lanes Or(Lanes a, Lanes b) { return _mm256_or_si256(a, b); }
+static inline Lanes Xor(Lanes a, Lanes b) { return _mm256_xor_si256(a, b); }
+static inline Lanes AndNot(Lanes a, Lanes b)
+{
+  return _mm256_andnot_si256(a, b);
+}
+static inline Lanes CmpEq(Lanes a, Lanes b) { return _mm256_cmpeq_epi16(a, b); }
+static inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_epi16(a, b); }
+static inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_epi16(a, b); }
+static inline Lanes Min(Lanes a, Lanes b) { return _mm256_min_epi16(a, b); }
+static inline Lanes Max(Lanes a, Lanes b) { return _mm256_max_epi16(a, b); }
+static inline Lanes ShiftLeft(Lanes a, int n) { return _mm256_slli_epi16(a, n); }
+static inline Lanes ShiftRight(Lanes a, int n)
+{
+  return _mm256_srli_epi16(a, n);
+}
+static inline int Count(Lanes pMask)
+{
+  return __builtin_popcount(_mm256_movemask_epi8(pMask)) / 2;
+}
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+typedef __m128i Lanes;
+
+static inline Lanes Load(const unsigned short *p)
+{
+  return _mm_loadu_si128((const __m128i *)p);
+}
+static inline void Store(unsigned short *p, Lanes a)
+{
+  _mm_storeu_si128((__m128i *)p, a);
+}
+static inline Lanes Splat(unsigned short v) { return _mm_set1_epi16(v); }
+static inline Lanes And(Lanes a, Lanes b) { return _mm_and_si128(a, b); }
+static inline Lanes Or(Lanes a, Lanes b) { return _mm_or_si128(a, b); }
+static inline Lanes Xor(Lanes a, Lanes b) { return _mm_xor_si128(a, b); }
+static inline Lanes AndNot(Lanes a, Lanes b) { return _mm_andnot_si128(a, b); }
+static inline Lanes CmpEq(Lanes a, Lanes b) { return _mm_cmpeq_epi16(a, b); }
+static inline Lanes Add(Lanes a, Lanes b) { return _mm_add_epi16(a, b); }
+static inline Lanes Sub(Lanes a, Lanes b) { return _mm_sub_epi16(a, b); }
+static inline Lanes Min(Lanes a, Lanes b) { return _mm_min_epi16(a, b); }
+static inline Lanes Max(Lanes a, Lanes b) { return _mm_max_epi16(a, b); }
+static inline Lanes ShiftLeft(Lanes a, int n) { return _mm_slli_epi16(a, n); }
+static inline Lanes ShiftRight(Lanes a, int n) { return _mm_srli_epi16(a, n); }
+static inline int Count(Lanes pMask)
+{
+  return __builtin_popcount(_mm_movemask_epi8(pMask)) / 2;
+}
+
+#else
+
+struct Lanes
+{
+  unsigned short v[BATCH_WIDTH];
+};
+
+static inline Lanes Load(const unsigned short *p)
+{
+  Lanes r;
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    r.v[i] = p[i];
+  return r;
+}
+static inline void Store(unsigned short *p, Lanes a)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    p[i] = a.v[i];
+}
+static inline Lanes Splat(unsigned short v)
+{
+  Lanes r;
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    r.v[i] = v;
+  return r;
+}
+static inline Lanes And(Lanes a, Lanes b)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] &= b.v[i];
+  return a;
+}
+static inline Lanes Or(Lanes a, Lanes b)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] |= b.v[i];
+  return a;
+}
+static inline Lanes Xor(Lanes a, Lanes b)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] ^= b.v[i];
+  return a;
+}
+static inline Lanes AndNot(Lanes a, Lanes b)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] = ~a.v[i] & b.v[i];
+  return a;
+}
+static inline Lanes CmpEq(Lanes a, Lanes b)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] = a.v[i] == b.v[i] ? 0xffff : 0;
+  return a;
+}
+static inline Lanes Add(Lanes a, Lanes b)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] += b.v[i];
+  return a;
+}
+static inline Lanes Sub(Lanes a, Lanes b)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] -= b.v[i];
+  return a;
+}
+static inline Lanes Min(Lanes a, Lanes b)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] = (short)a.v[i] < (short)b.v[i] ? a.v[i] : b.v[i];
+  return a;
+}
+static inline Lanes Max(Lanes a, Lanes b)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] = (short)a.v[i] > (short)b.v[i] ? a.v[i] : b.v[i];
+  return a;
+}
+static inline Lanes ShiftLeft(Lanes a, int n)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] <<= n;
+  return a;
+}
+static inline Lanes ShiftRight(Lanes a, int n)
+{
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    a.v[i] >>= n;
+  return a;
+}
+static inline int Count(Lanes pMask)
+{
+  int mCount = 0;
+  for (int i = 0; i < BATCH_WIDTH; i++)
+    mCount += pMask.v[i] != 0;
+  return mCount;
+}
+
+#endif
+
+static inline bool Any(Lanes pMask) { return Count(pMask) != 0; }
+
+// Lanes of pMask take a, the others b
+static inline Lanes Blend(Lanes pMask, Lanes a, Lanes b)
+{
+  return Or(And(pMask, a), AndNot(pMask, b));
+}
+
+// Set bits of every lane, SWAR since SSE2 and AVX2 have no 16 bit popcount
+static inline Lanes PopCount(Lanes a)
+{
+  a = Sub(a, And(ShiftRight(a, 1), Splat(0x5555)));
+  a = Add(And(a, Splat(0x3333)), And(ShiftRight(a, 2), Splat(0x3333)));
+  a = And(Add(a, ShiftRight(a, 4)), Splat(0x0f0f));
+  return And(Add(a, ShiftRight(a, 8)), Splat(0x1f));
+}
+
+#endif // __LANES__
@@ -0,0 +1,89 @@
+//: Metrics.h
+
+#ifndef __METRICS__
+#define __METRICS__
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#define METRICS_BUCKETS 12      // histogram buckets, +Inf not included
+#define METRICS_CLEAR_SIZES 8   // line clears counted by size, larger ones
+                                // go to the last
+#define METRICS_POLL_TIME 100   // milliseconds between checks for Stop
+#define METRICS_REQUEST_SIZE 2048 // bytes of a request that are read
+
+//------------------------------
+// Histogram with fixed bucket bounds. Observe only adds to atomic counters,
+// the buckets are made cumulative when they are written out.
+//------------------------------
+
+struct MetricsHistogram
+{
+  const double *mBounds; // upper bounds of the buckets, METRICS_BUCKETS
+  std::atomic<unsigned long long> mBuckets[METRICS_BUCKETS + 1];
+  std::atomic<unsigned long long> mSum; // in millionths of the unit
+
+  explicit MetricsHistogram(const double *pBounds);
+  void Observe(double pValue);
+};
+
+//------------------------------
+// Metrics, counters and histograms of the game served in the Prometheus
+// text format over HTTP on localhost. The game loop and the simulation
+// thread only add to relaxed atomic counters; a listener thread of its own
+// accepts the scrapes and reads them, so a scrape never takes a lock the
+// game waits for.
+//------------------------------
+
+class Metrics
+{
+  // Main loop
+  MetricsHistogram mFrameTime; // seconds between presented frames
+  std::atomic<unsigned long long> mFrames;
+  std::atomic<int> mInputDepth; // keys waiting for the simulation
+  std::atomic<unsigned long long> mInputDepthMax;
+  std::atomic<double> mPiecesPerSecond;
+
+  // Game
+  std::atomic<unsigned long long> mTicks;
+  std::atomic<unsigned long long> mPieces;
+  std::atomic<unsigned long long> mLines;
+  std::atomic<unsigned long long> mClears[METRICS_CLEAR_SIZES];
+  std::atomic<unsigned long long> mGameOvers;
+
+  // Listener
+  std::atomic<unsigned long long> mScrapes;
+  std::atomic<bool> mRunning;
+  int mSocket;
+  int mPort;
+  std::thread mListener;
+
+  void ListenerLoop();
+  void Serve(int pClient);
+  void Write(std::string &pOut);
+
+public:
+  Metrics();
+  ~Metrics();
+
+  bool Start(int pPort);
+  void Stop();
+  int GetPort() const { return mPort; }
+
+  // Main loop
+  void AddFrame(double pSeconds);
+  void SetInputDepth(int pDepth);
+  void SetPiecesPerSecond(double pRate);
+
+  // Game
+  void AddTicks(int pTicks)
+  {
+    mTicks.fetch_add(pTicks, std::memory_order_relaxed);
+  }
+  void AddPiece(int pLines);
+  void AddGameOver() { mGameOvers.fetch_add(1, std::memory_order_relaxed); }
+  unsigned long long GetPieces() const { return mPieces.load(); }
+};
+
+#endif // __METRICS__
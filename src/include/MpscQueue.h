@@ -0,0 +1,88 @@
+//: MpscQueue.h
+
+#ifndef __MPSC_QUEUE__
+#define __MPSC_QUEUE__
+
+#include "SpscRing.h"
+#include <atomic>
+#include <cstddef>
+
+//------------------------------
+// Fixed size queue for any number of producer threads and one consumer
+// thread, without locks. Every slot has a sequence number: a producer
+// claims the next slot with a compare and swap on the head and publishes
+// its item by advancing the slot sequence, the consumer takes a slot once
+// its sequence says it was published. Push fails when the queue is full
+// and Pop fails when it is empty, neither side ever waits.
+//
+// The head and tail are kept on cache lines of their own by padding rather
+// than alignment, so queues can be members of objects created with new.
+//
+// T - element type, copied in and out
+// N - capacity, a power of two
+//------------------------------
+
+template <typename T, size_t N> class MpscQueue
+{
+  static_assert((N & (N - 1)) == 0, "MpscQueue capacity must be a power of 2");
+
+  struct Slot
+  {
+    std::atomic<size_t> mSequence; // position it holds an item for, plus one
+    T mItem;
+  };
+
+  Slot mSlots[N];
+  char mPadSlots[CACHE_LINE_SIZE];
+  std::atomic<size_t> mHead; // next slot to claim
+  char mPadHead[CACHE_LINE_SIZE];
+  size_t mTail; // next slot to read
+  char mPadTail[CACHE_LINE_SIZE];
+
+public:
+  MpscQueue() : mHead(0), mTail(0)
+  {
+    for (size_t i = 0; i < N; i++)
+      mSlots[i].mSequence.store(i, std::memory_order_relaxed);
+  }
+
+  // Producer side, any thread, returns false if the queue is full
+  bool Push(const T &pItem)
+  {
+    size_t mPos = mHead.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      Slot &mSlot = mSlots[mPos & (N - 1)];
+      size_t mSequence = mSlot.mSequence.load(std::memory_order_acquire);
+      if (mSequence == mPos)
+      {
+        if (mHead.compare_exchange_weak(mPos, mPos + 1,
+                                        std::memory_order_relaxed))
+        {
+          mSlot.mItem = pItem;
+          mSlot.mSequence.store(mPos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (mSequence < mPos)
+        return false; // the slot still holds the item of the last round
+      else
+        mPos = mHead.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Consumer side, returns false if the queue is empty
+  bool Pop(T &pItem)
+  {
+    Slot &mSlot = mSlots[mTail & (N - 1)];
+    if (mSlot.mSequence.load(std::memory_order_acquire) != mTail + 1)
+      return false;
+
+    pItem = mSlot.mItem;
+    mSlot.mSequence.store(mTail + N, std::memory_order_release);
+    mTail++;
+    return true;
+  }
+};
+
+#endif // __MPSC_QUEUE__
@@ -0,0 +1,121 @@
+//: PerfectClear.h
+
+#ifndef __PERFECT_CLEAR__
+#define __PERFECT_CLEAR__
+
+#include "Placement.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define PC_MAX_HEIGHT 6      // rows of the tallest field the solver takes
+#define PC_MAX_PIECES 32     // longest piece sequence
+#define PC_MAX_PLACEMENTS 256 // resting positions of a piece, tucks included
+#define PC_SHARDS 64         // locks of the failed state set
+#define PC_SHARD_BITS 14     // log2 of the entries of each lock
+#define PC_BUCKET 4          // entries an insert or a lookup may probe
+
+//------------------------------
+// Answer of the solver. Every answer but PC_FOUND is a proof that the
+// pieces can't clear the board: the root failed one of the prunings, or
+// every placement of every piece was tried
+//------------------------------
+
+enum PcResult
+{
+  PC_FOUND,      // the solution holds the placements
+  PC_INVALID,    // blocks above the field, or a bad height or sequence
+  PC_CELLS,      // no field height has a free cell count the pieces fill
+  PC_REGIONS,    // a region between full columns can't be filled by pieces
+  PC_ENCLOSED,   // free blocks no piece can ever reach
+  PC_EXHAUSTED   // searched every placement
+};
+
+struct PcStats
+{
+  unsigned long long mNodes;     // boards reached by a placement
+  unsigned long long mFailHits;  // boards found in the failed state set
+  unsigned long long mPruned[3]; // boards cut by cells, regions, enclosed
+  double mSeconds;
+};
+
+//------------------------------
+// Perfect clear solver: finds placements of the coming pieces, in order,
+// that leave the board empty. Pieces move like in the game, left, right,
+// down and rotating through the wall kicks of the piece set, so tucks and
+// spins under overhangs count, and every block must stay inside the bottom
+// rows of the field.
+//
+// Boards are searched depth first. A board is cut when the cells left
+// can't be the blocks of the remaining pieces for any field height, when a
+// region walled off by full columns can't hold whole pieces, or when free
+// blocks are enclosed and no line clear can ever open them. Boards that
+// failed are kept in a set shared by the threads; the placements of the
+// first piece run as tasks on the pool.
+//------------------------------
+
+class PerfectClear
+{
+  // A board that failed: the field rows packed 10 bits each from the floor
+  // up and the pieces already placed. Entries of older solves are stale
+  struct State
+  {
+    unsigned long long mRows;
+    int mIndex;
+    unsigned int mGeneration;
+  };
+
+  // Part of the failed state set, a fixed open addressed table: a full
+  // bucket replaces an entry, which only costs some pruning
+  struct Shard
+  {
+    std::mutex mMutex;
+    std::vector<State> mStates;
+  };
+
+  // Rotations of the same shape, rotation r at (x, y) fills the blocks of
+  // an earlier rotation q at (x + mDx, y + mDy)
+  struct Same
+  {
+    bool mSame;
+    signed char mDx, mDy;
+  };
+
+  const Pieces *mPieces;
+  ThreadPool *mPool;
+  Shard mShards[PC_SHARDS];
+  unsigned int mGeneration;
+  Same mSame[PIECES_MAX_KINDS][PIECES_ROTATIONS][PIECES_ROTATIONS];
+
+  // The problem being solved
+  int mSequence[PC_MAX_PIECES];
+  int mCount;
+  int mSums[PC_MAX_PIECES + 1]; // blocks of the first i pieces
+  int mGcds[PC_MAX_PIECES + 1]; // gcd of the blocks of the pieces from i on
+  int mSmallest[PC_MAX_PIECES + 1]; // fewest blocks of the pieces from i on
+
+  std::atomic<int> mFoundRoot; // lowest root placement with a solution
+  std::atomic<unsigned long long> mNodes, mFailHits, mPruned[3];
+
+  friend struct PcTask;
+
+  int Enumerate(const BoardBits &pBoard, int pPiece, int pTop,
+                Placement *pOut) const;
+  int Prune(const BoardBits &pBoard, int pIndex, int pHeight) const;
+  int Search(const BoardBits &pBoard, int pIndex, int pHeight, int pRoot,
+             Placement *pPath, int &pUsed, unsigned long long *pCounts);
+  bool IsFailed(unsigned long long pRows, int pIndex);
+  void AddFailed(unsigned long long pRows, int pIndex);
+
+public:
+  PerfectClear(const Pieces *pPieces, ThreadPool *pPool);
+
+  PcResult Solve(const BoardBits &pBoard, const int *pSequence, int pCount,
+                 int pHeight, Placement *pSolution, int &pUsed,
+                 PcStats *pStats);
+};
+
+const char *GetPcResultName(PcResult pResult);
+
+#endif // __PERFECT_CLEAR__
@@ -0,0 +1,82 @@
+//: PieceSequence.h
+
+#ifndef __PIECE_SEQUENCE__
+#define __PIECE_SEQUENCE__
+
+#include "Pieces.h"
+#include <cstddef>
+
+#define SEQUENCE_MAGIC 0x51455354 // "TSEQ"
+#define SEQUENCE_VERSION 1
+#define SEQUENCE_BITS 3                          // bits of every piece
+#define SEQUENCE_MAX_KINDS (1 << SEQUENCE_BITS) // kinds a file can hold
+
+// How the pieces of a sequence were drawn
+enum SequencePolicy
+{
+  SEQUENCE_UNIFORM, // every piece drawn on its own
+  SEQUENCE_BAG,     // shuffled bags of one piece of every kind
+  SEQUENCE_POLICIES
+};
+
+//------------------------------
+// Header of a sequence file, followed by the pieces packed SEQUENCE_BITS
+// bits each, the first piece in the low bits of the first byte, and one
+// spare byte so any piece can be read with a 16 bit load
+//------------------------------
+
+struct SequenceHeader
+{
+  unsigned int mMagic;
+  unsigned int mVersion;
+  unsigned int mSeed;   // seed the pieces were drawn from
+  unsigned int mPolicy; // SequencePolicy
+  unsigned int mKinds;  // pieces of the set
+  unsigned int mReserved;
+  unsigned long long mPieceSet; // Pieces::GetHash of the set
+  unsigned long long mLength;   // pieces in the file
+};
+
+//------------------------------
+// Pre-generated piece sequence read from a memory mapped file. The file is
+// mapped read-only once and shared by every game of the process, each game
+// reading at a cursor of its own, so any number of games see the same
+// pieces without copies. Write draws a sequence and saves it.
+//------------------------------
+
+class PieceSequence
+{
+  const SequenceHeader *mHeader; // mapped file, or NULL
+  const unsigned char *mBits;    // packed pieces
+  size_t mSize;
+
+  PieceSequence(const PieceSequence &);
+  PieceSequence &operator=(const PieceSequence &);
+
+public:
+  PieceSequence();
+  ~PieceSequence();
+
+  bool Open(const char *pPath, const Pieces &pPieces);
+  void Close();
+  bool IsOpen() const { return mHeader != NULL; }
+  const SequenceHeader &GetHeader() const { return *mHeader; }
+  unsigned long long GetLength() const { return mHeader->mLength; }
+  unsigned long long GetHash() const;
+
+  // Piece at a position of the sequence, below GetLength, or -1 if the file
+  // holds a code that isn't a piece of the set
+  int GetPiece(unsigned long long pIndex) const
+  {
+    unsigned long long mBit = pIndex * SEQUENCE_BITS;
+    unsigned int mWord = mBits[mBit >> 3] | (mBits[(mBit >> 3) + 1] << 8);
+    unsigned int mPiece = (mWord >> (mBit & 7)) & (SEQUENCE_MAX_KINDS - 1);
+    return mPiece < mHeader->mKinds ? (int)mPiece : -1;
+  }
+
+  static bool Write(const char *pPath, const Pieces &pPieces,
+                    unsigned int pSeed, int pPolicy,
+                    unsigned long long pLength);
+};
+
+#endif // __PIECE_SEQUENCE__
@@ -3,16 +3,99 @@
 #ifndef __PIECES__
 #define __PIECES__
 
+#define PIECES_KINDS 7         // number of pieces of the built-in set
+#define PIECES_MAX_KINDS 32    // maximum number of pieces of a loaded set
+#define PIECES_ROTATIONS 4     // number of rotations of each piece
+#define PIECES_BLOCKS                                                          \
+  5 // number of horizontal and vertical blocks of martrix pieces
+#define PIECES_MAX_BLOCKS 8    // maximum width and height of a piece matrix
+#define PIECES_MAX_CELLS 16    // maximum number of blocks of a piece
+#define PIECES_MAX_KICKS 8     // most positions tried by one rotation
+#define PIECES_MAX_NAME 16     // longest piece name, with its terminator
+
+#include <iosfwd>
+
+//------------------------------
+// Piece cell, one filled block of a piece matrix
+//------------------------------
+
+struct PieceCell
+{
+  signed char mX, mY; // column and row in the piece matrix
+  signed char mType;  // 1-normal block, 2-pivot block
+};
+
+//------------------------------
+// Piece shape, one rotation of a piece compiled for collision and drawing
+//------------------------------
+
+struct PieceShape
+{
+  // Filled blocks of each row of the matrix, bit x is column x
+  unsigned short mRows[PIECES_MAX_BLOCKS];
+  // Lowest filled row of every column, -1 for an empty column
+  signed char mBottom[PIECES_MAX_BLOCKS];
+  // Bounding box of the filled blocks inside the matrix
+  signed char mMinX, mMaxX, mMinY, mMaxY;
+  // Displacement to apply to create the piece in the correct position
+  signed char mInitialX, mInitialY;
+  signed char mNumCells;
+  PieceCell mCells[PIECES_MAX_CELLS];
+};
+
+//------------------------------
+// Wall kicks of one rotation of a piece: the offsets tried in order from
+// its position, in board blocks with y growing down. The first position
+// that fits is taken, the first offset is usually 0,0
+//------------------------------
+
+struct KickTable
+{
+  signed char mCount;
+  signed char mOffsets[PIECES_MAX_KICKS][2];
+};
+
 //------------------------------
 // Pieces
 //------------------------------
 
 class Pieces
 {
+  PieceShape mShapes[PIECES_MAX_KINDS][PIECES_ROTATIONS];
+  KickTable mKicks[PIECES_MAX_KINDS][PIECES_ROTATIONS][PIECES_ROTATIONS];
+  char mNames[PIECES_MAX_KINDS][PIECES_MAX_NAME];
+  int mKinds;
+  int mSize; // width and height of the piece matrices
+
+  void InitBuiltIn();
+  void CompileShape(PieceShape &pShape, const int pMatrix[][PIECES_MAX_BLOCKS],
+                    int pInitialX, int pInitialY);
+  int GetSpawnState(int pPieces) const;
+  bool LoadKicks(std::istream &pStream, const char *pSource);
+
 public:
-  int GetBlockType(int pPieces, int pRotation, int pX, int pY);
-  int GetXInitialPosition(int pPieces, int pRotation);
-  int GetYInitialPosition(int pPieces, int pRotation);
+  Pieces();
+
+  bool LoadFromFile(const char *pPath);
+  bool LoadKicksFromFile(const char *pPath);
+
+  int GetKinds() const { return mKinds; }
+  int GetSize() const { return mSize; }
+  const char *GetName(int pPieces) const { return mNames[pPieces]; }
+  const PieceShape &GetShape(int pPieces, int pRotation) const
+  {
+    return mShapes[pPieces][pRotation];
+  }
+  const KickTable &GetKicks(int pPieces, int pFrom, int pTo) const
+  {
+    return mKicks[pPieces][pFrom][pTo];
+  }
+
+  int GetBlockType(int pPieces, int pRotation, int pX, int pY) const;
+  int GetXInitialPosition(int pPieces, int pRotation) const;
+  int GetYInitialPosition(int pPieces, int pRotation) const;
+  int GetBottomProfile(int pPieces, int pRotation, int pX) const;
+  unsigned long long GetHash() const;
 };
 
 #endif //__PIECES__
@@ -0,0 +1,30 @@
+//: Placement.h
+
+#ifndef __PLACEMENT__
+#define __PLACEMENT__
+
+#include "Board.h"
+
+// Upper bound of the resting placements of one piece
+#define MAX_PLACEMENTS (PIECES_ROTATIONS * (BOARD_WIDTH + PIECES_MAX_BLOCKS))
+
+//------------------------------
+// Resting position of a piece, where it would be stored in the board
+//------------------------------
+
+struct Placement
+{
+  int mX, mY;
+  int mRotation;
+};
+
+int EnumeratePlacements(const BoardBits &pBoard, const Pieces &pPieces,
+                        int pPiece, Placement *pOut);
+
+inline int EnumeratePlacements(const Board &pBoard, const Pieces &pPieces,
+                               int pPiece, Placement *pOut)
+{
+  return EnumeratePlacements(pBoard.GetBits(), pPieces, pPiece, pOut);
+}
+
+#endif // __PLACEMENT__
@@ -0,0 +1,91 @@
+//: Planner.h
+
+#ifndef __PLANNER__
+#define __PLANNER__
+
+#include "Controller.h"
+#include "Placement.h"
+#include <vector>
+
+#define PLAN_MAX_INPUTS 64 // longest input sequence of a plan
+
+// Piece positions searched: every column and row a piece matrix can take
+// in the board, and a margin above it for the spawn and the kicks
+#define PLAN_X_OFFSET PIECES_MAX_BLOCKS
+#define PLAN_Y_OFFSET (2 * PIECES_MAX_BLOCKS)
+#define PLAN_COLUMNS (BOARD_WIDTH + PLAN_X_OFFSET)
+#define PLAN_ROWS (BOARD_HEIGHT + PLAN_Y_OFFSET)
+#define PLAN_STATES (PIECES_ROTATIONS * PLAN_ROWS * PLAN_COLUMNS)
+
+//------------------------------
+// Input sequence that takes a falling piece to a placement, ending with
+// the hard drop that locks it there
+//------------------------------
+
+struct InputPlan
+{
+  int mCount;                             // inputs
+  int mCost;                              // sum of the cost of the inputs
+  unsigned char mInputs[PLAN_MAX_INPUTS]; // ControlAction of each input
+};
+
+//------------------------------
+// Planner of the cheapest inputs from a piece position to a placement. It
+// searches the piece states (x, y, rotation) cheapest first, moving them
+// the way the game does: shifts, soft drops and the rotations with their
+// wall kicks, so tucks and spins under overhangs are found too. Gravity is
+// left out, the inputs are taken to be faster than it.
+//
+// The searches of the empty board from every spawn are made once when the
+// planner is created and plans for an empty board are read back from them.
+// Every search keeps its state in the planner, so each thread needs its own.
+//------------------------------
+
+class Planner
+{
+  // Search from one start, every state with its cost and how it was reached
+  struct Search
+  {
+    unsigned short mCost[PLAN_STATES]; // PLAN_UNREACHED if not reached
+    short mParent[PLAN_STATES];
+    unsigned char mInput[PLAN_STATES];
+  };
+
+  // Searched position still to expand, cheapest first
+  struct Open
+  {
+    int mCost;
+    int mState;
+    bool operator<(const Open &pOther) const { return mCost > pOther.mCost; }
+  };
+
+  const Pieces *mPieces;
+  int mCosts[ACTION_COUNT];
+  const BoardBits *mBoard;       // board of the search being made
+  int mPiece;                    // piece of the search being made
+  signed char mFit[PLAN_STATES]; // 1 fits, 0 doesn't, -1 not tested yet
+  Search mSearch;
+  std::vector<Open> mOpen;
+  std::vector<Search> mEmpty; // searches of the empty board, piece x spawn
+  BoardBits mEmptyBoard;
+
+  bool Fits(int pX, int pY, int pRotation);
+  void Expand(Search &pSearch, int pState);
+  int Run(Search &pSearch, const BoardBits &pBoard, int pPiece, int pX,
+          int pY, int pRotation, const Placement *pTarget);
+  int FindDrop(const Search &pSearch, const BoardBits &pBoard,
+               const Placement &pTarget);
+  bool Unwind(const Search &pSearch, int pState, InputPlan &pPlan) const;
+  void SearchEmpty();
+
+public:
+  Planner(const Pieces *pPieces);
+
+  void SetCost(int pAction, int pCost);
+  int Plan(const BoardBits &pBoard, int pPiece, int pRotation,
+           const Placement &pTarget, InputPlan &pPlan);
+  int Plan(const BoardBits &pBoard, int pPiece, int pX, int pY, int pRotation,
+           const Placement &pTarget, InputPlan &pPlan);
+};
+
+#endif // __PLANNER__
@@ -0,0 +1,97 @@
+//: SearchArena.h
+
+#ifndef __SEARCH_ARENA__
+#define __SEARCH_ARENA__
+
+#include "Board.h"
+#include "SpscRing.h"
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define ARENA_NODE_SIZE CACHE_LINE_SIZE // bytes of every node
+#define ARENA_BLOCK_NODES 4096          // nodes added when an arena grows
+
+static_assert(sizeof(BoardBits) <= ARENA_NODE_SIZE,
+              "a search node must fit in one cache line");
+
+//------------------------------
+// Bump allocator of search nodes for one thread. Every node is a BoardBits
+// in its own cache line. Nodes are never freed one by one: Reset drops all
+// of them at once after a decision and keeps the memory, so once the arena
+// has grown to the size of a search, making a node is a pointer increment
+// and a copy without touching the heap.
+//------------------------------
+
+class SearchArena
+{
+  std::vector<unsigned char *> mBlocks; // allocations, as returned by new
+  size_t mBlock;                        // block being filled
+  unsigned char *mNext, *mEnd;          // free part of that block
+  size_t mUsed, mPeak;                  // nodes since the last Reset, most
+                                        // nodes of one decision
+
+  BoardBits *Grow(const BoardBits &pFrom);
+
+  SearchArena(const SearchArena &);
+  SearchArena &operator=(const SearchArena &);
+
+public:
+  SearchArena();
+  ~SearchArena();
+
+  // A copy of pFrom that lives until the next Reset
+  BoardBits *NewNode(const BoardBits &pFrom)
+  {
+    if (mNext == mEnd)
+      return Grow(pFrom);
+
+    BoardBits *mNode = (BoardBits *)mNext;
+    *mNode = pFrom;
+    mNext += ARENA_NODE_SIZE;
+    mUsed++;
+    return mNode;
+  }
+
+  void Reset();
+  size_t GetUsed() const { return mUsed; }
+  size_t GetPeak() const { return mPeak > mUsed ? mPeak : mUsed; }
+  size_t GetReserved() const
+  {
+    return mBlocks.size() * ARENA_BLOCK_NODES * ARENA_NODE_SIZE;
+  }
+};
+
+//------------------------------
+// One search arena for every thread that asks for one, for parallel
+// searches. Get finds the arena of the calling thread through a thread
+// local cache, so the lock is only taken the first time a thread asks.
+//------------------------------
+
+class ThreadArenas
+{
+  struct Entry
+  {
+    std::thread::id mThread;
+    SearchArena *mArena;
+  };
+
+  std::mutex mMutex;
+  std::vector<Entry> mArenas;
+  unsigned int mId; // never reused, tells the thread local caches apart
+
+  ThreadArenas(const ThreadArenas &);
+  ThreadArenas &operator=(const ThreadArenas &);
+
+public:
+  ThreadArenas();
+  ~ThreadArenas();
+
+  SearchArena &Get();
+  void ResetAll();
+  size_t GetUsed();
+  size_t GetReserved();
+};
+
+#endif // __SEARCH_ARENA__
@@ -0,0 +1,63 @@
+//: SharedState.h
+
+#ifndef __SHARED_STATE__
+#define __SHARED_STATE__
+
+#include "GameState.h"
+#include "SpscRing.h"
+#include <atomic>
+
+#define SHARED_STATE_MAGIC 0x53535454 // "TTSS"
+#define SHARED_STATE_VERSION 2
+#define SHARED_INPUT_SIZE 64 // keys waiting to be injected, a power of two
+#define SHARED_READ_RETRIES 1000 // tries of Read before it gives up
+
+//------------------------------
+// Layout of the shared memory segment. The game state is guarded by a
+// sequence lock: the sequence is odd while the game writes, and a reader
+// keeps its copy only if the sequence was even and unchanged around it.
+// Injected keys travel the other way through a ring with one producer.
+//------------------------------
+
+struct SharedStateLayout
+{
+  unsigned int mMagic;
+  unsigned int mVersion;
+  unsigned int mSize; // sizeof(SharedStateLayout)
+
+  alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> mSequence;
+  GameState mState;
+
+  alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> mInputHead;
+  alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> mInputTail;
+  int mInput[SHARED_INPUT_SIZE];
+};
+
+//------------------------------
+// Shared state, publishes the live game state in a POSIX shared memory
+// segment for other processes. Readers map it once; reading a snapshot
+// needs no system call and never blocks the game.
+//------------------------------
+
+class SharedState
+{
+  SharedStateLayout *mLayout;
+  char mName[256];
+  bool mOwner;
+
+public:
+  SharedState();
+  ~SharedState();
+
+  bool Create(const char *pName);
+  bool Attach(const char *pName);
+  void Close();
+
+  void Publish(const GameState &pState);
+  bool Read(GameState &pState) const;
+
+  bool PushInput(int pKey);
+  bool PopInput(int &pKey);
+};
+
+#endif // __SHARED_STATE__
@@ -0,0 +1,88 @@
+//: Simulation.h
+
+#ifndef __SIMULATION__
+#define __SIMULATION__
+
+#include "Game.h"
+#include "SharedState.h"
+#include "SpscRing.h"
+#include "TimerWheel.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define SIM_INPUT_SIZE 64 // keys waiting for the simulation
+#define SIM_SHARED_POLL 1 // milliseconds between checks for injected keys
+
+// Restarts timed by the simulation, in milliseconds
+struct RestartStats
+{
+  unsigned long long mCount;
+  double mMin, mAverage, mMax, mLast;
+};
+
+//------------------------------
+// Simulation thread, runs the game logic away from the thread that draws
+// and pumps the SDL events. Keys come in through an SPSC ring and every
+// state of the game goes out as a GameState snapshot through a triple
+// buffer, so a slow present never delays input or gravity and the renderer
+// always draws the latest complete state. The renderer is woken up through
+// its IO when a new state is published, so it can sleep between frames.
+//
+// The game runs on the timers of a TimerWheel. The thread sleeps until the
+// next deadline or a key, whichever comes first; the soak test runs on a
+// virtual clock that jumps straight to the next deadline.
+//------------------------------
+
+class Simulation
+{
+  Game *mGame;
+  SharedState *mShared; // live state for other processes, or NULL
+  IO *mIO;              // woken up when a frame is published, or NULL
+  int mSoakRounds;      // rounds to play by itself, 0 to play the keys
+
+  SpscRing<int, SIM_INPUT_SIZE> mInput;
+  TripleBuffer<GameState> mFrames;
+  std::atomic<bool> mFramePending; // renderer woken, frame not taken yet
+  std::thread mThread;
+  std::atomic<bool> mRunning;
+  std::atomic<bool> mFinished;
+
+  // Game over to the first published frame of the next round, in
+  // performance counter ticks. Only the simulation thread writes them
+  unsigned long long mRestartStart; // counter at the restart being timed
+  std::atomic<unsigned long long> mRestarts, mRestartTotal, mRestartMin,
+      mRestartMax, mRestartLast;
+
+  // Timers in milliseconds since Start, or of the virtual soak clock
+  TimerWheel mTimers;
+  std::chrono::steady_clock::time_point mStart;
+  std::mutex mWakeMutex;
+  std::condition_variable mWakeUp; // a key came or the thread must stop
+
+  void Loop();
+  void HandleKey(int pKey);
+  void Publish();
+  void Restart();
+  unsigned long long Now();
+  void Sleep();
+
+public:
+  Simulation(Game *pGame, SharedState *pShared, IO *pIO, int pSoakRounds);
+  ~Simulation();
+
+  void Start();
+  void Stop();
+
+  bool PushKey(int pKey);
+  bool IsFinished() const { return mFinished.load(); }
+  int GetInputDepth() const { return (int)mInput.Size(); }
+  bool Update();
+  const GameState &GetFrame() const { return mFrames.GetFront(); }
+  RestartStats GetRestartStats() const;
+};
+
+#endif // __SIMULATION__
@@ -0,0 +1,63 @@
+//: SpscRing.h
+
+#ifndef __SPSC_RING__
+#define __SPSC_RING__
+
+#include <atomic>
+#include <cstddef>
+
+#define CACHE_LINE_SIZE 64
+
+//------------------------------
+// Fixed size ring buffer for one producer thread and one consumer thread.
+// Neither side ever blocks: Push fails when the ring is full and Pop fails
+// when it is empty.
+//
+// T - element type, copied in and out
+// N - capacity, a power of two
+//------------------------------
+
+template <typename T, size_t N> class SpscRing
+{
+  static_assert((N & (N - 1)) == 0, "SpscRing capacity must be a power of 2");
+
+  T mItems[N];
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> mHead; // next slot to write
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> mTail; // next slot to read
+
+public:
+  SpscRing() : mHead(0), mTail(0) {}
+
+  // Producer side, returns false if the ring is full
+  bool Push(const T &pItem)
+  {
+    size_t mPos = mHead.load(std::memory_order_relaxed);
+    if (mPos - mTail.load(std::memory_order_acquire) == N)
+      return false;
+
+    mItems[mPos & (N - 1)] = pItem;
+    mHead.store(mPos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, returns false if the ring is empty
+  bool Pop(T &pItem)
+  {
+    size_t mPos = mTail.load(std::memory_order_relaxed);
+    if (mPos == mHead.load(std::memory_order_acquire))
+      return false;
+
+    pItem = mItems[mPos & (N - 1)];
+    mTail.store(mPos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Number of elements waiting, approximate while the other side runs
+  size_t Size() const
+  {
+    return mHead.load(std::memory_order_acquire) -
+           mTail.load(std::memory_order_acquire);
+  }
+};
+
+#endif // __SPSC_RING__
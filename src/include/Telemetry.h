@@ -0,0 +1,74 @@
+//: Telemetry.h
+
+#ifndef __TELEMETRY__
+#define __TELEMETRY__
+
+#include "SpscRing.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#define TELEMETRY_RING_SIZE 4096   // events waiting for the writer
+#define TELEMETRY_FLUSH_TIME 1000  // milliseconds between file flushes
+
+enum TelemetryType
+{
+  TELEMETRY_LOCK,     // a piece was stored in the board
+  TELEMETRY_CLEAR,    // the piece completed one or more lines
+  TELEMETRY_GAME_OVER // the round ended
+};
+
+//------------------------------
+// Telemetry event, a fixed size record copied through the ring
+//------------------------------
+
+struct TelemetryEvent
+{
+  int mType;                 // TelemetryType
+  int mRound;                // round of the session
+  unsigned long long mTime;  // microseconds since the session started
+  int mPieces;               // pieces placed in the round, this one included
+  int mPiece, mRotation;     // kind and rotation of the piece
+  int mLines;                // lines cleared by this piece
+  int mTotalLines;           // lines cleared in the round
+  int mKeys;                 // key presses while this piece was falling
+  int mTotalKeys;            // key presses in the round
+  unsigned long long mPieceTime; // microseconds this piece was falling, or
+                                 // the round lasted for TELEMETRY_GAME_OVER
+  int mScore;
+  int mLevel;
+};
+
+//------------------------------
+// Telemetry, streams gameplay events to a file from a background thread.
+// Emit never blocks: when the ring is full the event is dropped and counted.
+//------------------------------
+
+class Telemetry
+{
+  SpscRing<TelemetryEvent, TELEMETRY_RING_SIZE> mRing;
+  std::atomic<unsigned long long> mDropped;
+  std::atomic<bool> mRunning;
+  unsigned long long mWritten;
+  unsigned long long mStart;
+  bool mBinary;
+  FILE *mFile;
+  std::thread mWriter;
+
+  void WriterLoop();
+  void WriteEvent(const TelemetryEvent &pEvent);
+
+public:
+  Telemetry();
+  ~Telemetry();
+
+  bool Open(const char *pPath);
+  void Close();
+
+  void Emit(TelemetryEvent &pEvent);
+  unsigned long long Now();
+  unsigned long long GetDropped();
+  unsigned long long GetWritten();
+};
+
+#endif // __TELEMETRY__
@@ -0,0 +1,72 @@
+//: ThreadPool.h
+
+#ifndef __THREAD_POOL__
+#define __THREAD_POOL__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------
+// Group of tasks that can be waited for together
+//------------------------------
+
+struct TaskGroup
+{
+  std::atomic<int> mPending;
+  TaskGroup() : mPending(0) {}
+};
+
+// Tasks a queue holds, a task submitted to a full queue runs at once
+#define POOL_QUEUE_SIZE 1024
+
+//------------------------------
+// Work stealing thread pool. Every worker keeps its own queue: it runs its
+// newest task first and steals the oldest tasks of the others when idle.
+// Waiting for a group runs queued tasks, so tasks can submit and wait for
+// their own subtasks without blocking a worker.
+//------------------------------
+
+class ThreadPool
+{
+  struct Task
+  {
+    void (*mFunction)(void *);
+    void *mArg;
+    TaskGroup *mGroup;
+  };
+
+  // Fixed ring, so queueing a task never allocates: the owner pushes and
+  // pops at mTail, thieves take from mHead
+  struct Queue
+  {
+    std::mutex mMutex;
+    unsigned int mHead, mTail;
+    Task mTasks[POOL_QUEUE_SIZE];
+    Queue() : mHead(0), mTail(0) {}
+  };
+
+  std::vector<Queue *> mQueues; // queue 0 is shared by the outside threads
+  std::vector<std::thread> mWorkers;
+  std::atomic<int> mQueued;
+  std::atomic<bool> mRunning;
+  std::mutex mSleepMutex;
+  std::condition_variable mWakeUp;
+  std::atomic<int> mSleeping;
+
+  void WorkerLoop(int pIndex);
+  bool RunOne(int pIndex);
+  int GetQueueIndex();
+
+public:
+  explicit ThreadPool(int pThreads);
+  ~ThreadPool();
+
+  int GetThreads();
+  void Submit(TaskGroup &pGroup, void (*pFunction)(void *), void *pArg);
+  void Wait(TaskGroup &pGroup);
+};
+
+#endif // __THREAD_POOL__
@@ -0,0 +1,88 @@
+//: TimerWheel.h
+
+#ifndef __TIMER_WHEEL__
+#define __TIMER_WHEEL__
+
+#include <vector>
+
+#define WHEEL_SLOT_BITS 6                     // slots of a level, as bits
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)    // 64 slots, one bit each
+#define WHEEL_LEVELS 4                        // 2^24 ticks before overflow
+#define WHEEL_NEVER (~0ull)                   // no timer is scheduled
+
+//------------------------------
+// Timer that expired, as returned by PopExpired
+//------------------------------
+
+struct TimerEvent
+{
+  int mTimer;                    // handle given by Schedule, already free
+  int mOwner;                    // session the timer belongs to
+  int mType;                     // what to do, defined by the owner
+  unsigned long long mDeadline;  // tick it was due
+};
+
+//------------------------------
+// Hierarchical timer wheel. Level 0 has a slot for each of the next 64
+// ticks, every level above covers 64 slots of the one below. A timer goes
+// to the lowest level whose slot tells its deadline apart from now, and
+// moves down a level each time the wheel reaches its slot, so it is
+// touched at most WHEEL_LEVELS times. Deadlines past the top level wait in
+// an overflow list until the top level wraps.
+//
+// Timers are nodes of a pool linked by index, so scheduling and cancelling
+// are O(1) and nothing is allocated once the pool has grown to the most
+// timers pending at once. A bit per slot finds the next busy slot without
+// scanning empty ones, which is what lets the wheel jump over idle time
+// and a loop sleep until the next deadline.
+//
+// Time is whatever the caller counts in ticks, like milliseconds of a real
+// or virtual clock; it only has to go forward.
+//------------------------------
+
+class TimerWheel
+{
+  struct Node
+  {
+    unsigned long long mDeadline;
+    int mNext, mPrev; // list of the slot, or the free list
+    int mList;        // list holding the node, -1 when free
+    int mOwner, mType;
+  };
+
+  // Lists are slots of the levels, then the overflow and expired lists
+  enum
+  {
+    LIST_OVERFLOW = WHEEL_LEVELS * WHEEL_SLOTS,
+    LIST_EXPIRED,
+    LIST_COUNT
+  };
+
+  std::vector<Node> mNodes;
+  int mFree;                             // first free node
+  int mHeads[LIST_COUNT], mTails[LIST_COUNT];
+  unsigned long long mBusy[WHEEL_LEVELS]; // bit s: slot s is not empty
+  unsigned long long mNow;                // last tick processed
+  int mPending;
+
+  void Link(int pNode, int pList);
+  void Unlink(int pNode);
+  void Place(int pNode);
+  void Cascade(int pList);
+  void Tick();
+
+public:
+  explicit TimerWheel(unsigned long long pNow = 0);
+
+  int Schedule(unsigned long long pDeadline, int pOwner, int pType);
+  bool Cancel(int pTimer);
+  bool IsPending(int pTimer) const;
+
+  bool PopExpired(unsigned long long pNow, TimerEvent &pEvent);
+  unsigned long long GetNextDeadline() const;
+
+  unsigned long long GetNow() const { return mNow; }
+  int GetPending() const { return mPending; }
+};
+
+#endif // __TIMER_WHEEL__
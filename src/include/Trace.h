@@ -0,0 +1,75 @@
+//: Trace.h
+
+#ifndef __TRACE__
+#define __TRACE__
+
+//------------------------------
+// Scoped timers exported as Chrome / Perfetto trace JSON
+//
+// TRACE_SCOPE("name") records how long the enclosing scope takes. Events go
+// to a ring buffer owned by the recording thread, so recording never locks.
+// Build with TETRIS_TRACE=0 to compile every trace point out.
+//------------------------------
+
+#ifndef TETRIS_TRACE
+#define TETRIS_TRACE 1
+#endif
+
+#if TETRIS_TRACE
+
+#include <atomic>
+
+#define TRACE_RING_SIZE 65536 // events kept per thread, a power of two
+
+class Trace
+{
+public:
+  static void Enable(bool pEnabled);
+  static bool IsEnabled()
+  {
+    return sEnabled.load(std::memory_order_relaxed);
+  }
+  static bool Export(const char *pPath);
+
+  static unsigned long long Now();
+  static void Record(const char *pName, unsigned long long pStart,
+                     unsigned long long pEnd);
+
+private:
+  static std::atomic<bool> sEnabled;
+};
+
+// Records the scope if tracing was on when it opened, whatever happens to
+// it before the scope closes
+class TraceScope
+{
+  const char *mName;
+  unsigned long long mStart;
+  bool mEnabled;
+
+public:
+  explicit TraceScope(const char *pName) : mName(pName), mStart(0)
+  {
+    mEnabled = Trace::IsEnabled();
+    if (mEnabled)
+      mStart = Trace::Now();
+  }
+
+  ~TraceScope()
+  {
+    if (mEnabled)
+      Trace::Record(mName, mStart, Trace::Now());
+  }
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(mTraceScope, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+
+#endif // TETRIS_TRACE
+
+#endif // __TRACE__
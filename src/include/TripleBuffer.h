@@ -0,0 +1,60 @@
+//: TripleBuffer.h
+
+#ifndef __TRIPLE_BUFFER__
+#define __TRIPLE_BUFFER__
+
+#include "SpscRing.h"
+#include <atomic>
+
+//------------------------------
+// Triple buffer, hands the latest value from one writer thread to one
+// reader thread without locks. The writer fills the back slot and swaps it
+// with the middle one; the reader swaps the middle slot with its front slot
+// when a newer value is there. Neither side ever waits, values the reader
+// didn't pick up in time are overwritten, and the front value stays
+// untouched until the reader takes the next one.
+//
+// T - value type, copied into the back slot by the writer
+//------------------------------
+
+template <typename T> class TripleBuffer
+{
+  enum { FRESH = 4 }; // set in mMiddle when the writer published a value
+
+  struct alignas(CACHE_LINE_SIZE) Slot
+  {
+    T mValue;
+  };
+
+  Slot mSlots[3];
+  alignas(CACHE_LINE_SIZE) std::atomic<int> mMiddle; // slot between the sides
+  alignas(CACHE_LINE_SIZE) int mBack;                // writer side only
+  alignas(CACHE_LINE_SIZE) int mFront;               // reader side only
+
+public:
+  TripleBuffer() : mMiddle(1), mBack(0), mFront(2) {}
+
+  // Writer side, the slot to fill before Publish
+  T &GetBack() { return mSlots[mBack].mValue; }
+
+  // Writer side, makes the back slot the newest value
+  void Publish()
+  {
+    mBack = mMiddle.exchange(mBack | FRESH, std::memory_order_acq_rel) & 3;
+  }
+
+  // Reader side, moves to the newest value, returns false if there is none
+  // since the last call
+  bool Update()
+  {
+    if (!(mMiddle.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & 3;
+    return true;
+  }
+
+  // Reader side, the value taken by the last Update
+  const T &GetFront() const { return mSlots[mFront].mValue; }
+};
+
+#endif // __TRIPLE_BUFFER__
@@ -0,0 +1,91 @@
+//: VecEnv.h
+
+#ifndef __VEC_ENV__
+#define __VEC_ENV__
+
+#include "Game.h"
+#include "Placement.h"
+#include "ThreadPool.h"
+#include <vector>
+
+#define ENV_PLANES 2 // board planes: blocks, and free blocks under a block
+#define ENV_BOARD_SIZE (ENV_PLANES * BOARD_HEIGHT * BOARD_WIDTH)
+#define ENV_ACTIONS (PIECES_ROTATIONS * BOARD_WIDTH) // rotation, left column
+
+//------------------------------
+// Buffers the observations are written to, owned by the caller and laid
+// out for N environments back to back, one byte per value:
+//   mBoards  - N x ENV_PLANES x BOARD_HEIGHT x BOARD_WIDTH
+//   mPieces  - N x 2 x kinds, one hot falling piece then next piece
+//   mMasks   - N x ENV_ACTIONS, 1 for the legal actions
+//   mRewards - N, lines cleared by the step
+//   mDones   - N, 1 if the step ended the episode
+//------------------------------
+
+struct EnvBuffers
+{
+  unsigned char *mBoards;
+  unsigned char *mPieces;
+  unsigned char *mMasks;
+  float *mRewards;
+  unsigned char *mDones;
+};
+
+//------------------------------
+// Batch of environments for training agents on the game itself. An action
+// places the falling piece: rotation * BOARD_WIDTH + the column of its
+// left block, dropped straight down like EnumeratePlacements; the legal
+// ones are given in the mask. An illegal action or a top out ends the
+// episode and the environment starts the next one at once, its
+// observation is then the first of the new episode.
+//
+// Environments are split in contiguous partitions stepped by the thread
+// pool. Every buffer is the caller's and nothing is allocated per step.
+//------------------------------
+
+class VecEnv
+{
+  struct Env
+  {
+    Board mBoard;
+    Game mGame;
+    unsigned char mMask[ENV_ACTIONS]; // legal actions of the falling piece
+    Env(Pieces *pPieces) : mBoard(pPieces, 0), mGame(&mBoard, pPieces, NULL, 0)
+    {
+    }
+  };
+
+  struct Partition
+  {
+    VecEnv *mEnv;
+    int mFirst, mLast;
+    unsigned long long mEpisodes; // finished in the partition
+  };
+
+  Pieces *mPieces;
+  std::vector<Env *> mEnvs;
+  std::vector<Partition> mPartitions;
+  ThreadPool mPool;
+  EnvBuffers mBuffers;
+  const int *mActions;        // of the step being played
+  const unsigned int *mSeeds; // of the reset being played
+
+  static void ResetPartition(void *pArg);
+  static void StepPartition(void *pArg);
+  void Run(void (*pFunction)(void *));
+  bool Observe(int pIndex);
+
+public:
+  VecEnv(Pieces *pPieces, int pEnvs, int pThreads);
+  ~VecEnv();
+
+  int GetEnvs() const { return (int)mEnvs.size(); }
+  int GetPieceSize() const { return 2 * mPieces->GetKinds(); }
+  void SetBuffers(const EnvBuffers &pBuffers) { mBuffers = pBuffers; }
+
+  void Reset(const unsigned int *pSeeds);
+  void Step(const int *pActions);
+  unsigned long long GetEpisodes() const;
+};
+
+#endif // __VEC_ENV__
@@ -1,121 +1,295 @@
 //: Main.cpp
+#include "include/Controller.h"
+#include "include/Evaluator.h"
 #include "include/Game.h"
+#include "include/Metrics.h"
+#include "include/SharedState.h"
+#include "include/Simulation.h"
+#include "include/Trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
-int main(int argc, char *argv[]) {
-  // class for drawing staff, it uses SDL for the rendering. Change the methods
-  // of this class in order to use a different renderer
-  IO mIO;
-  int mScreenHeight = mIO.GetScreenHeight();
+// Stepped play: the greedy bot drives the game through a Controller and
+// every frame shows the game pTicks ticks later, with no sleeps and no vsync,
+// so the game runs as fast as it can be played and drawn
+static void PlayStepped(Game &pGame, Board &pBoard, Pieces &pPieces, IO &pIO,
+                        int pTicks) {
+  Controller mControl(&pGame);
+  EvalWeights mWeights;
+  GameState mState;
+  unsigned long long mFrames = 0, mTicks = 0;
+  int mRounds = 1;
+  unsigned long long mStart = SDL_GetPerformanceCounter();
 
-  // Pieces
-  Pieces mPieces;
+  while (pIO.PollKey() != SDLK_ESCAPE) {
+    if (pGame.IsGameOver()) {
+      mTicks += mControl.GetTicks();
+      mControl.Reset(pGame.GetSeed() + 1);
+      mRounds++;
+    } else if (!pGame.IsSpawning()) {
+      Placement mBest;
+      if (ChoosePlacement(pBoard, pPieces, pGame.mPiece, mWeights, mBest))
+        mControl.Place(mBest);
+      else
+        mControl.Act(ACTION_HARD_DROP);
+    }
+    mControl.Step(pTicks);
 
-  // Board
-  Board mBoard(&mPieces, mScreenHeight);
+    mControl.GetState(mState);
+    pIO.ClearScreen();
+    pGame.DrawScene(mState);
+    if (mState.mGameOver)
+      pGame.DrawGameOver();
+    pIO.UpdateScreen();
+    mFrames++;
+  }
 
-  // Game
-  Game mGame(&mBoard, &mPieces, &mIO, mScreenHeight);
+  mTicks += mControl.GetTicks();
+  double mSeconds = (SDL_GetPerformanceCounter() - mStart) /
+                    (double)SDL_GetPerformanceFrequency();
+  printf("%d rounds, %llu frames, %llu ticks in %.2f s, %.0f ticks/s, "
+         "%.1fx real time\n",
+         mRounds, mFrames, mTicks, mSeconds, mTicks / mSeconds,
+         mTicks * TICK_TIME / 1000.0 / mSeconds);
+}
 
-  // Get the actual clock milliseconds (SDL)
-  unsigned long mTime1 = SDL_GetTicks();
+int main(int argc, char *argv[]) {
+  // Starting level, "--level N" on the command line
+  // Soak test, "--soak N" plays N rounds back to back by itself
+  // Piece set, "--pieces FILE" instead of the built-in tetrominoes
+  // Wall kicks, "--kicks FILE" instead of the built-in SRS table
+  // Piece sequence, "--sequence FILE" made by make_sequence instead of the
+  // random pieces
+  // Tracing, "--trace FILE" records the main loop phases, T or exit saves them
+  // Telemetry, "--telemetry FILE" streams gameplay events, JSONL or ".bin"
+  // Live state, "--shm NAME" publishes the game in shared memory and takes
+  // injected keys from it
+  // Capture, "--capture FILE" records every frame, Y4M for ".y4m" files or
+  // raw RGB24, "--capture-buffers N" frames can wait for the disk
+  // Metrics, "--metrics PORT" serves counters in the Prometheus text format
+  // at http://127.0.0.1:PORT/metrics
+  // Stepped play, "--stepped N" lets the bot play through the control API,
+  // N ticks per frame as fast as possible
+  int mStartLevel = 0;
+  int mSoakRounds = 0;
+  const char *mPieceSet = NULL;
+  const char *mKickTable = NULL;
+  const char *mSequenceFile = NULL;
+  const char *mTraceFile = NULL;
+  const char *mTelemetryFile = NULL;
+  const char *mSharedName = NULL;
+  const char *mCaptureFile = NULL;
+  int mCaptureBuffers = 8;
+  int mMetricsPort = -1;
+  int mSteppedTicks = 0;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--level") == 0)
+      mStartLevel = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--soak") == 0)
+      mSoakRounds = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--pieces") == 0)
+      mPieceSet = argv[i + 1];
+    if (strcmp(argv[i], "--kicks") == 0)
+      mKickTable = argv[i + 1];
+    if (strcmp(argv[i], "--sequence") == 0)
+      mSequenceFile = argv[i + 1];
+    if (strcmp(argv[i], "--trace") == 0)
+      mTraceFile = argv[i + 1];
+    if (strcmp(argv[i], "--telemetry") == 0)
+      mTelemetryFile = argv[i + 1];
+    if (strcmp(argv[i], "--shm") == 0)
+      mSharedName = argv[i + 1];
+    if (strcmp(argv[i], "--capture") == 0)
+      mCaptureFile = argv[i + 1];
+    if (strcmp(argv[i], "--capture-buffers") == 0)
+      mCaptureBuffers = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--metrics") == 0)
+      mMetricsPort = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--stepped") == 0)
+      mSteppedTicks = atoi(argv[i + 1]);
+  }
 
-  // ----- Main Loop -----
+#if TETRIS_TRACE
+  if (mTraceFile != NULL)
+    Trace::Enable(true);
+#else
+  if (mTraceFile != NULL)
+    fprintf(stderr, "tracing is not compiled in (TETRIS_TRACE=0)\n");
+#endif
 
-  while (!mIO.IsKeyDown(SDLK_ESCAPE)) {
-    // ----- Draw -----
+  // Pieces
+  Pieces mPieces;
+  if (mPieceSet != NULL && !mPieces.LoadFromFile(mPieceSet))
+    return 1;
+  if (mKickTable != NULL && !mPieces.LoadKicksFromFile(mKickTable))
+    return 1;
+  PieceSequence mSequence;
+  if (mSequenceFile != NULL && !mSequence.Open(mSequenceFile, mPieces)) {
+    fprintf(stderr, "%s isn't a piece sequence of this piece set\n",
+            mSequenceFile);
+    return 1;
+  }
 
-    mIO.ClearScreen();  // Clear screen
-    mGame.DrawScene();  // Draw staff
-    mIO.UpdateScreen(); // Put the graphic context in the screen
+  // class for drawing staff, it uses SDL for the rendering. Change the methods
+  // of this class in order to use a different renderer
+  IO mIO(mSteppedTicks <= 0);
+  int mScreenHeight = mIO.GetScreenHeight();
 
-    // ----- Input -----
+  // Board
+  Board mBoard(&mPieces, mScreenHeight);
 
-    int mKey = mIO.PollKey();
+  // Game
+  Game mGame(&mBoard, &mPieces, &mIO, mScreenHeight, mStartLevel);
+  if (mSequence.IsOpen()) {
+    mGame.SetSequence(&mSequence, 0);
+    mGame.Reset(mGame.GetSeed());
+  }
 
-    switch (mKey) {
-    case (SDLK_l): {
-      if (mBoard.IsPossibleMovement(mGame.mPosX + 1, mGame.mPosY, mGame.mPiece,
-                                    mGame.mRotation))
-        mGame.mPosX++;
-      break;
+  // Telemetry
+  Telemetry mTelemetry;
+  if (mTelemetryFile != NULL) {
+    if (!mTelemetry.Open(mTelemetryFile)) {
+      fprintf(stderr, "couldn't open telemetry %s\n", mTelemetryFile);
+      return 1;
     }
+    mGame.SetTelemetry(&mTelemetry);
+  }
 
-    case (SDLK_h): {
-      if (mBoard.IsPossibleMovement(mGame.mPosX - 1, mGame.mPosY, mGame.mPiece,
-                                    mGame.mRotation))
-        mGame.mPosX--;
-      break;
-    }
+  // Video capture
+  if (mCaptureFile != NULL && !mIO.StartCapture(mCaptureFile, mCaptureBuffers)) {
+    fprintf(stderr, "couldn't open capture %s\n", mCaptureFile);
+    return 1;
+  }
 
-    case (SDLK_j): {
-      if (mBoard.IsPossibleMovement(mGame.mPosX, mGame.mPosY + 1, mGame.mPiece,
-                                    mGame.mRotation))
-        mGame.mPosY++;
-      break;
+  // Live state for other processes
+  SharedState mShared;
+  if (mSharedName != NULL && !mShared.Create(mSharedName)) {
+    fprintf(stderr, "couldn't create shared memory %s\n", mSharedName);
+    return 1;
+  }
+
+  // Metrics for the fleet monitoring
+  Metrics mMetrics;
+  if (mMetricsPort >= 0) {
+    if (!mMetrics.Start(mMetricsPort)) {
+      fprintf(stderr, "couldn't serve metrics on port %d\n", mMetricsPort);
+      return 1;
     }
+    printf("metrics at http://127.0.0.1:%d/metrics\n", mMetrics.GetPort());
+    mGame.SetMetrics(&mMetrics);
+  }
 
-    case (SDLK_x): {
-      // Check collision from up to down
-      while (mBoard.IsPossibleMovement(mGame.mPosX, mGame.mPosY, mGame.mPiece,
-                                       mGame.mRotation)) {
-        mGame.mPosY++;
-      }
+  if (mSteppedTicks > 0) {
+    PlayStepped(mGame, mBoard, mPieces, mIO, mSteppedTicks);
+    mMetrics.Stop();
+    mIO.StopCapture();
+    return 0;
+  }
 
-      mBoard.StorePieces(mGame.mPosX, mGame.mPosY - 1, mGame.mPiece,
-                         mGame.mRotation);
+  // The game runs on its own thread, this one pumps the events and draws
+  Simulation mSimulation(&mGame, mSharedName != NULL ? &mShared : NULL, &mIO,
+                         mSoakRounds);
+  mSimulation.Start();
 
-      mBoard.DeletePossibleLines();
+  // Rounds seen, and restarts reported as they come
+  int mRound = 1;
+  unsigned long long mRestarts = 0;
 
-      if (mBoard.IsGameOver()) {
-        mIO.Getkey();
-        exit(0);
-      }
+  // Last presented frame, and the pieces locked at the last rate sample
+  unsigned long long mFrameStart = SDL_GetPerformanceCounter();
+  unsigned long long mRateStart = mFrameStart, mRatePieces = 0;
 
-      mGame.CreateNewPiece();
+  // ----- Main Loop -----
 
-      // score
-      mGame.incrementScore();
+  bool mIdle = false; // no new frame came last time
+  while (!mIO.IsKeyDown(SDLK_ESCAPE) && !mSimulation.IsFinished()) {
+    // ----- Input -----
 
-      break;
+    // Between frames, sleep until a key comes or the simulation publishes
+    // the next frame
+    int mKey;
+    {
+      TRACE_SCOPE("PollKey");
+      mKey = mIdle ? mIO.WaitKey() : mIO.PollKey();
     }
 
-    case (SDLK_z): {
-      if (mBoard.IsPossibleMovement(mGame.mPosX, mGame.mPosY, mGame.mPiece,
-                                    (mGame.mRotation + 1) % 4))
-        mGame.mRotation = (mGame.mRotation + 1) % 4;
-
+    if (mKey == SDLK_ESCAPE)
       break;
-    }
-    }
 
-    // ----- Vertical movement -----
+#if TETRIS_TRACE
+    if (mKey == SDLK_t && mTraceFile != NULL)
+      Trace::Export(mTraceFile);
+#endif
 
-    unsigned long mTime2 = SDL_GetTicks();
+    if (mKey != -1)
+      mSimulation.PushKey(mKey);
 
-    if ((mTime2 - mTime1) > WAIT_TIME) {
-      if (mBoard.IsPossibleMovement(mGame.mPosX, mGame.mPosY + 1, mGame.mPiece,
-                                    mGame.mRotation)) {
-        mGame.mPosY++;
-      } else {
-        mBoard.StorePieces(mGame.mPosX, mGame.mPosY, mGame.mPiece,
-                           mGame.mRotation);
+    // ----- Draw -----
 
-        mBoard.DeletePossibleLines();
+    // Nothing changed since the last frame, wait for the next state
+    mIdle = !mSimulation.Update();
+    if (mIdle)
+      continue;
+    const GameState &mState = mSimulation.GetFrame();
 
-        if (mBoard.IsGameOver()) {
-          mIO.Getkey();
-          exit(0);
-        }
+    {
+      TRACE_SCOPE("ClearScreen");
+      mIO.ClearScreen(); // Clear screen
+    }
+    {
+      TRACE_SCOPE("DrawScene");
+      mGame.DrawScene(mState); // Draw staff
+      if (mState.mGameOver)
+        mGame.DrawGameOver();
+    }
+    {
+      TRACE_SCOPE("UpdateScreen");
+      mIO.UpdateScreen(); // Put the graphic context in the screen
+    }
 
-        mGame.CreateNewPiece();
+    if (mMetricsPort >= 0) {
+      unsigned long long mNow = SDL_GetPerformanceCounter();
+      double mFrequency = (double)SDL_GetPerformanceFrequency();
+      mMetrics.AddFrame((mNow - mFrameStart) / mFrequency);
+      mMetrics.SetInputDepth(mSimulation.GetInputDepth());
+      mFrameStart = mNow;
 
-        // score
-        mGame.incrementScore();
+      if (mNow - mRateStart >= SDL_GetPerformanceFrequency()) {
+        unsigned long long mPieces = mMetrics.GetPieces();
+        mMetrics.SetPiecesPerSecond((mPieces - mRatePieces) * mFrequency /
+                                    (mNow - mRateStart));
+        mRatePieces = mPieces;
+        mRateStart = mNow;
       }
+    }
 
-      mTime1 = SDL_GetTicks();
+    if (mState.mRound != mRound) {
+      mRound = mState.mRound;
+      RestartStats mStats = mSimulation.GetRestartStats();
+      if (mStats.mCount != mRestarts && mSoakRounds == 0)
+        printf("round %d playable %.3f ms after game over\n", mRound,
+               mStats.mLast);
+      mRestarts = mStats.mCount;
     }
   }
 
+  mSimulation.Stop();
+  mMetrics.Stop();
+  if (mSimulation.Update())
+    mRound = mSimulation.GetFrame().mRound;
+  mIO.StopCapture();
+
+#if TETRIS_TRACE
+  if (mTraceFile != NULL && !Trace::Export(mTraceFile))
+    fprintf(stderr, "couldn't write trace %s\n", mTraceFile);
+#endif
+
+  RestartStats mStats = mSimulation.GetRestartStats();
+  if (mStats.mCount > 0)
+    printf("%d rounds, %llu restarts, game over to playable min %.3f ms "
+           "avg %.3f ms max %.3f ms\n",
+           mRound, mStats.mCount, mStats.mMin, mStats.mAverage, mStats.mMax);
+
   return 0;
 }
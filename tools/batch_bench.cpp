@@ -0,0 +1,170 @@
+//: batch_bench.cpp
+// Compares playing N boards in lockstep with BoardBatch against playing N
+// scalar Boards, both fed the same per-board decisions
+#include "BoardBatch.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+//------------------------------
+// Next piece of a board: a random piece, rotation and column
+//------------------------------
+
+struct Decision
+{
+  int mPiece, mRotation, mX;
+};
+
+static Decision Decide(unsigned int &pSeed, const Pieces &pPieces)
+{
+  Decision mDecision;
+  pSeed = pSeed * 1103515245u + 12345u;
+  mDecision.mPiece = (pSeed >> 16) % pPieces.GetKinds();
+  pSeed = pSeed * 1103515245u + 12345u;
+  mDecision.mRotation = (pSeed >> 16) % PIECES_ROTATIONS;
+
+  const PieceShape &mShape =
+      pPieces.GetShape(mDecision.mPiece, mDecision.mRotation);
+  int mRange = BOARD_WIDTH - mShape.mMaxX + mShape.mMinX;
+  pSeed = pSeed * 1103515245u + 12345u;
+  mDecision.mX = -mShape.mMinX + (pSeed >> 16) % mRange;
+  return mDecision;
+}
+
+//------------------------------
+// Scalar board, plays its pieces like a BoardBatch lane
+//------------------------------
+
+struct ScalarLane
+{
+  Board mBoard;
+  unsigned int mSeed;
+  int mLines;
+
+  ScalarLane(Pieces *pPieces, unsigned int pSeed)
+      : mBoard(pPieces, 0), mSeed(pSeed), mLines(0)
+  {
+  }
+
+  // Spawn the next piece and let it fall one row at a time until it is
+  // stored, a lane that is over starts a new game
+  unsigned long long Step(const Pieces &pPieces, unsigned long long &pGames)
+  {
+    Decision mDecision = Decide(mSeed, pPieces);
+    int mX = mDecision.mX;
+    int mY = -pPieces.GetShape(mDecision.mPiece, mDecision.mRotation).mMinY;
+
+    unsigned long long mSteps = 0;
+    bool mOver = !mBoard.IsPossibleMovement(mX, mY, mDecision.mPiece,
+                                            mDecision.mRotation);
+    if (!mOver)
+    {
+      for (;;)
+      {
+        mSteps++;
+        if (!mBoard.IsPossibleMovement(mX, mY + 1, mDecision.mPiece,
+                                       mDecision.mRotation))
+          break;
+        mY++;
+      }
+      mBoard.StorePieces(mX, mY, mDecision.mPiece, mDecision.mRotation);
+      mLines += mBoard.DeletePossibleLines();
+      mOver = mBoard.IsGameOver();
+    }
+
+    if (mOver)
+    {
+      mBoard.Reset();
+      mLines = 0;
+      pGames++;
+    }
+    return mSteps;
+  }
+};
+
+int main(int argc, char *argv[]) {
+  // "--boards N" boards played together, "--steps S" pieces per board,
+  // "--pieces FILE" piece set to play
+  int mBoards = 1024;
+  int mSteps = 1000;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--boards") == 0)
+      mBoards = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--steps") == 0)
+      mSteps = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mBoards < 1)
+    mBoards = 1;
+
+  // Scalar boards
+  std::vector<ScalarLane> mScalar;
+  unsigned long long mScalarGames = 0, mScalarSteps = 0;
+  for (int i = 0; i < mBoards; i++)
+    mScalar.push_back(ScalarLane(&mPieces, 1 + i));
+
+  std::chrono::steady_clock::time_point mStart =
+      std::chrono::steady_clock::now();
+  for (int s = 0; s < mSteps; s++) {
+    for (int i = 0; i < mBoards; i++)
+      mScalarSteps += mScalar[i].Step(mPieces, mScalarGames);
+  }
+  double mScalarSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - mStart)
+                              .count();
+
+  // The same boards in lockstep, lanes that are over start a new game
+  BoardBatch mBatch(&mPieces, mBoards);
+  std::vector<unsigned int> mSeeds;
+  for (int i = 0; i < mBoards; i++)
+    mSeeds.push_back(1 + i);
+  unsigned long long mBatchGames = 0, mBatchSteps = 0;
+
+  mStart = std::chrono::steady_clock::now();
+  for (int s = 0; s < mSteps; s++) {
+    for (int i = 0; i < mBoards; i++) {
+      Decision mDecision = Decide(mSeeds[i], mPieces);
+      mBatch.SetPiece(i, mDecision.mPiece, mDecision.mRotation, mDecision.mX);
+    }
+    mBatchSteps += mBatch.Step();
+
+    for (int i = 0; i < mBoards; i++) {
+      if (!mBatch.IsAlive(i)) {
+        mBatch.ResetLane(i);
+        mBatchGames++;
+      }
+    }
+  }
+  double mBatchSeconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - mStart)
+                             .count();
+
+  // Both must end with the same boards
+  int mMismatches = 0;
+  for (int i = 0; i < mBoards; i++) {
+    bool mSame = mBatch.GetLines(i) == mScalar[i].mLines;
+    for (int j = 0; j < BOARD_HEIGHT; j++)
+      mSame = mSame && mBatch.GetRow(i, j) == mScalar[i].mBoard.GetRow(j);
+    mMismatches += !mSame;
+  }
+
+  double mScalarRate = mScalarSteps / mScalarSeconds;
+  double mBatchRate = mBatchSteps / mBatchSeconds;
+  printf("%d boards, %d pieces each, %d boards per vector\n", mBoards, mSteps,
+         BATCH_WIDTH);
+  printf("%-8s %14s %16s %8s\n", "", "board-steps", "board-steps/s", "games");
+  printf("%-8s %14llu %16.0f %8llu\n", "scalar", mScalarSteps, mScalarRate,
+         mScalarGames);
+  printf("%-8s %14llu %16.0f %8llu\n", "batch", mBatchSteps, mBatchRate,
+         mBatchGames);
+  printf("speedup %.2fx, %d mismatched boards\n", mBatchRate / mScalarRate,
+         mMismatches);
+
+  return mMismatches == 0 ? 0 : 1;
+}
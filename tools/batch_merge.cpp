@@ -0,0 +1,39 @@
+//: batch_merge.cpp
+// Merges the result files of batch_run shards into one, exactly: merging
+// every shard of a seed range writes the file a single run over it writes
+#include "BatchResult.h"
+#include <cstdio>
+
+int main(int argc, char *argv[]) {
+  // "batch_merge OUT IN..." writes the merge of the IN files to OUT
+  if (argc < 3) {
+    fprintf(stderr, "usage: batch_merge OUT IN...\n");
+    return 1;
+  }
+
+  BatchResult mMerged;
+  for (int i = 2; i < argc; i++) {
+    BatchResult mResult;
+    if (!mResult.Load(argv[i])) {
+      fprintf(stderr, "couldn't read the result %s\n", argv[i]);
+      return 1;
+    }
+
+    if (i == 2)
+      mMerged = mResult;
+    else if (!mMerged.IsCompatible(mResult)) {
+      fprintf(stderr, "%s was played with other settings\n", argv[i]);
+      return 1;
+    } else if (!mMerged.Merge(mResult)) {
+      fprintf(stderr, "%s has seeds already merged\n", argv[i]);
+      return 1;
+    }
+  }
+
+  if (!mMerged.Save(argv[1])) {
+    fprintf(stderr, "couldn't write %s\n", argv[1]);
+    return 1;
+  }
+  mMerged.Print(stdout);
+  return 0;
+}
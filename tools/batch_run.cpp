@@ -0,0 +1,285 @@
+//: batch_run.cpp
+// Plays one shard of a seed range with the greedy bot and writes a result
+// file that batch_merge combines with the other shards. Shards share
+// nothing: each one is a pure function of its seeds and settings, and a
+// shard restarted on the same file resumes where it was stopped
+#include "BatchResult.h"
+#include "EvalCache.h"
+#include "Game.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+//------------------------------
+// One headless game, the game of a seed is always the same
+//------------------------------
+
+struct GameTask
+{
+  Pieces *mPieces;
+  EvalWeights mWeights;
+  EvalCache *mCache; // or NULL
+  const PieceSequence *mSequence; // or NULL
+  unsigned int mSeed;
+  int mMaxPieces;
+  // results
+  int mScore, mLines, mPlaced;
+  bool mCapped;
+  unsigned long long mClears[BATCH_CLEAR_SIZES];
+  EvalCacheStats mStats;
+};
+
+static void RunGame(void *pArg)
+{
+  GameTask *mTask = (GameTask *)pArg;
+  Board mBoard(mTask->mPieces, 0);
+  Game mGame(&mBoard, mTask->mPieces, NULL, 0);
+
+  // With a sequence every seed reads its own stretch of it, the same in
+  // every run given the file; main checks the file is long enough for them
+  // not to overlap
+  if (mTask->mSequence != NULL)
+    mGame.SetSequence(mTask->mSequence,
+                      mTask->mSeed * (unsigned long long)(mTask->mMaxPieces + 2));
+  mGame.Reset(mTask->mSeed);
+
+  memset(mTask->mClears, 0, sizeof(mTask->mClears));
+  mTask->mPlaced = 0;
+  mTask->mCapped = true;
+  while (mTask->mPlaced < mTask->mMaxPieces) {
+    Placement mBest;
+    bool mFound =
+        mTask->mCache != NULL
+            ? mTask->mCache->ChoosePlacement(mBoard, mGame.mPiece, mBest,
+                                             mTask->mStats)
+            : ChoosePlacement(mBoard, *mTask->mPieces, mGame.mPiece,
+                              mTask->mWeights, mBest);
+    if (!mFound) {
+      mTask->mCapped = false;
+      break;
+    }
+
+    mGame.mPosX = mBest.mX;
+    mGame.mPosY = mBest.mY;
+    mGame.mRotation = mBest.mRotation;
+    mTask->mPlaced++;
+
+    int mLines = mGame.GetLines();
+    bool mOver = mGame.LockPiece();
+    int mCleared = mGame.GetLines() - mLines;
+    if (mCleared > 0)
+      mTask->mClears[std::min(mCleared, BATCH_CLEAR_SIZES) - 1]++;
+    if (mOver) {
+      mTask->mCapped = false;
+      break;
+    }
+  }
+  mTask->mScore = mGame.getScore();
+  mTask->mLines = mGame.GetLines();
+}
+
+// "A:B" range of seeds, "I/N" shard
+static bool ParsePair(const char *pText, char pSeparator,
+                      unsigned long long &pA, unsigned long long &pB)
+{
+  char *mEnd;
+  pA = strtoull(pText, &mEnd, 10);
+  if (mEnd == pText || *mEnd != pSeparator)
+    return false;
+  pB = strtoull(mEnd + 1, &mEnd, 10);
+  return *mEnd == 0;
+}
+
+int main(int argc, char *argv[]) {
+  // "--seeds A:B" seeds of the whole run, "--shard I/N" the part this
+  // process plays, "--out FILE" result file, resumed if it exists,
+  // "--max-pieces P" pieces before a game is stopped, "--weights
+  // H,O,B,W,L" bot weights, "--chunk G" games between saves,
+  // "--threads T" workers, "--pieces FILE" piece set, "--cache FILE"
+  // evaluation cache shared with other runs, "--cache-bits B" its size,
+  // "--sequence FILE" pieces read from a sequence file of make_sequence
+  unsigned long long mFirst = 0, mLast = 1000;
+  unsigned long long mShard = 0, mShards = 1;
+  const char *mOut = NULL;
+  const char *mCachePath = NULL;
+  int mCacheBits = EVAL_CACHE_BITS;
+  const char *mSequencePath = NULL;
+  int mMaxPieces = 10000;
+  int mChunk = 1024;
+  int mThreads = std::thread::hardware_concurrency();
+  EvalWeights mWeights;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--seeds") == 0 &&
+        !ParsePair(argv[i + 1], ':', mFirst, mLast)) {
+      fprintf(stderr, "--seeds takes FIRST:END\n");
+      return 1;
+    }
+    if (strcmp(argv[i], "--shard") == 0 &&
+        !ParsePair(argv[i + 1], '/', mShard, mShards)) {
+      fprintf(stderr, "--shard takes INDEX/COUNT\n");
+      return 1;
+    }
+    if (strcmp(argv[i], "--out") == 0)
+      mOut = argv[i + 1];
+    if (strcmp(argv[i], "--max-pieces") == 0)
+      mMaxPieces = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--chunk") == 0)
+      mChunk = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--threads") == 0)
+      mThreads = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--cache") == 0)
+      mCachePath = argv[i + 1];
+    if (strcmp(argv[i], "--cache-bits") == 0)
+      mCacheBits = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--sequence") == 0)
+      mSequencePath = argv[i + 1];
+    if (strcmp(argv[i], "--weights") == 0 &&
+        sscanf(argv[i + 1], "%lf,%lf,%lf,%lf,%lf", &mWeights.mHeight,
+               &mWeights.mHoles, &mWeights.mBumpiness, &mWeights.mWells,
+               &mWeights.mLines) != 5) {
+      fprintf(stderr, "--weights takes 5 comma separated numbers\n");
+      return 1;
+    }
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mOut == NULL || mShards < 1 || mShard >= mShards || mFirst > mLast ||
+      mLast > 0x100000000ull) {
+    fprintf(stderr, "usage: batch_run --out FILE [--seeds FIRST:END] "
+                    "[--shard INDEX/COUNT]\n"
+                    "seeds are 32 bits, the shard index is below the count\n");
+    return 1;
+  }
+  if (mChunk < 1)
+    mChunk = 1;
+  if (mThreads < 1)
+    mThreads = 1;
+
+  // Contiguous part of the range, the shards together cover it exactly
+  unsigned long long mCount = mLast - mFirst;
+  unsigned long long mBegin = mFirst + mCount * mShard / mShards;
+  unsigned long long mEnd = mFirst + mCount * (mShard + 1) / mShards;
+
+  // Mapped once, every game reads it in place
+  PieceSequence mSequence;
+  if (mSequencePath != NULL && !mSequence.Open(mSequencePath, mPieces)) {
+    fprintf(stderr, "%s isn't a piece sequence of this piece set\n",
+            mSequencePath);
+    return 1;
+  }
+
+  // Every seed up to the end of the whole range needs a stretch of its own,
+  // a shorter file would wrap seeds onto the pieces of others
+  unsigned long long mStretch = (unsigned long long)mMaxPieces + 2;
+  if (mSequence.IsOpen() && mSequence.GetLength() < mLast * mStretch) {
+    fprintf(stderr, "%s holds %llu pieces, seeds up to %llu with %d pieces "
+                    "each need %llu\n",
+            mSequencePath, mSequence.GetLength(), mLast, mMaxPieces,
+            mLast * mStretch);
+    return 1;
+  }
+
+  BatchResult mResult;
+  mResult.mPieceSet = mPieces.GetHash();
+  mResult.mSequence = mSequence.IsOpen() ? mSequence.GetHash() : 0;
+  mResult.mMaxPieces = mMaxPieces;
+  mResult.mWeights = mWeights;
+
+  // A saved result of the same settings that covers the start of the shard
+  // is resumed
+  unsigned long long mNext = mBegin;
+  BatchResult mSaved;
+  if (mSaved.Load(mOut)) {
+    bool mPrefix = mSaved.mSeeds.empty() ||
+                   (mSaved.mSeeds.size() == 1 &&
+                    mSaved.mSeeds[0].mFirst == mBegin &&
+                    mSaved.mSeeds[0].mLast <= mEnd);
+    if (!mResult.IsCompatible(mSaved) || !mPrefix) {
+      fprintf(stderr, "%s holds another run, remove it or choose another "
+                      "file\n", mOut);
+      return 1;
+    }
+    mResult = mSaved;
+    if (!mSaved.mSeeds.empty())
+      mNext = mSaved.mSeeds[0].mLast;
+    printf("resuming %s at seed %llu\n", mOut, mNext);
+  }
+
+  // The cache only changes how fast a placement is found, never which
+  EvalCache mCache;
+  if (mCachePath != NULL) {
+    if (!mCache.Open(mCachePath, mPieces, mWeights, mCacheBits)) {
+      fprintf(stderr, "couldn't open the cache %s\n", mCachePath);
+      return 1;
+    }
+    printf("cache %s: %d buckets of %d entries\n", mCachePath,
+           1 << mCache.GetBucketBits(), EVAL_CACHE_WAYS);
+  }
+  EvalCacheStats mStats;
+
+  printf("shard %llu/%llu: seeds %llu to %llu, %d threads\n", mShard, mShards,
+         mBegin, mEnd, mThreads);
+
+  ThreadPool mPool(mThreads);
+  std::vector<GameTask> mTasks(mChunk);
+  std::chrono::steady_clock::time_point mStart =
+      std::chrono::steady_clock::now();
+  unsigned long long mPlayed = 0, mPlaced = 0;
+
+  // The result is saved after every chunk, always as a whole prefix; an
+  // empty or finished shard still writes its file
+  if (mNext == mEnd && !mResult.Save(mOut)) {
+    fprintf(stderr, "couldn't write %s\n", mOut);
+    return 1;
+  }
+  while (mNext < mEnd) {
+    int mGames = (int)std::min<unsigned long long>(mChunk, mEnd - mNext);
+    TaskGroup mGroup;
+    for (int g = 0; g < mGames; g++) {
+      GameTask &mTask = mTasks[g];
+      mTask.mPieces = &mPieces;
+      mTask.mWeights = mWeights;
+      mTask.mCache = mCache.IsOpen() ? &mCache : NULL;
+      mTask.mSequence = mSequence.IsOpen() ? &mSequence : NULL;
+      mTask.mStats = EvalCacheStats();
+      mTask.mSeed = (unsigned int)(mNext + g);
+      mTask.mMaxPieces = mMaxPieces;
+      mPool.Submit(mGroup, RunGame, &mTask);
+    }
+    mPool.Wait(mGroup);
+
+    for (int g = 0; g < mGames; g++) {
+      const GameTask &mTask = mTasks[g];
+      mResult.AddGame(mTask.mScore, mTask.mLines, mTask.mPlaced, mTask.mCapped,
+                      mTask.mClears);
+      mPlaced += mTask.mPlaced;
+      mStats.Add(mTask.mStats);
+    }
+    mResult.AddSeeds(mNext, mNext + mGames);
+    mNext += mGames;
+    mPlayed += mGames;
+
+    if (!mResult.Save(mOut)) {
+      fprintf(stderr, "couldn't write %s\n", mOut);
+      return 1;
+    }
+    double mSeconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - mStart)
+                          .count();
+    printf("seed %llu, %.0f games/s, %.0f pieces/s\n", mNext,
+           mPlayed / mSeconds, mPlaced / mSeconds);
+  }
+
+  mResult.Print(stdout);
+  if (mCache.IsOpen())
+    mStats.Print(stdout);
+  return 0;
+}
@@ -0,0 +1,85 @@
+//: battle_bench.cpp
+// Plays the same battle with 1 to N threads and prints ticks per second,
+// the scaling over one thread and whether every run ended the same
+#include "Battle.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+  // "--players P" boards in the battle, "--threads T" most threads tried,
+  // "--ticks K" most ticks played, "--seed S" seed of the battle,
+  // "--pieces FILE" piece set
+  int mPlayers = 100;
+  int mThreads = std::thread::hardware_concurrency();
+  unsigned long long mMaxTicks = 5000;
+  unsigned int mSeed = 1;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--players") == 0)
+      mPlayers = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--threads") == 0)
+      mThreads = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--ticks") == 0)
+      mMaxTicks = strtoull(argv[i + 1], NULL, 10);
+    if (strcmp(argv[i], "--seed") == 0)
+      mSeed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mPlayers < 2)
+    mPlayers = 2;
+  if (mThreads < 1)
+    mThreads = 1;
+
+  // 1, 2, 4... threads and the most asked for
+  std::vector<int> mCounts;
+  for (int t = 1; t < mThreads; t *= 2)
+    mCounts.push_back(t);
+  mCounts.push_back(mThreads);
+
+  EvalWeights mWeights;
+  double mBaseRate = 0;
+  unsigned long long mBaseHash = 0;
+  bool mSame = true;
+  for (size_t c = 0; c < mCounts.size(); c++) {
+    Battle mBattle(&mPieces, mWeights, mPlayers, mSeed, mCounts[c]);
+    std::chrono::steady_clock::time_point mStart =
+        std::chrono::steady_clock::now();
+    int mWinner = mBattle.Run(mMaxTicks);
+    double mSeconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - mStart)
+                          .count();
+
+    unsigned long long mSent = 0, mLines = 0;
+    for (int i = 0; i < mPlayers; i++) {
+      mSent += mBattle.GetPlayer(i).mSent;
+      mLines += mBattle.GetPlayer(i).mLines;
+    }
+
+    double mRate = mBattle.GetTick() / mSeconds;
+    unsigned long long mHash = mBattle.Hash();
+    if (c == 0) {
+      mBaseRate = mRate;
+      mBaseHash = mHash;
+    }
+    mSame = mSame && mHash == mBaseHash;
+
+    printf("%2d threads: %llu ticks in %.3f s, %.0f ticks/s, %.0f board "
+           "ticks/s, %.2fx\n",
+           mCounts[c], mBattle.GetTick(), mSeconds, mRate, mRate * mPlayers,
+           mRate / mBaseRate);
+    printf("            %d alive, winner %d, %llu lines, %llu garbage lines "
+           "sent, hash %016llx\n",
+           mBattle.GetAlive(), mWinner, mLines, mSent, mHash);
+  }
+
+  printf("%s\n", mSame ? "every thread count played the same battle"
+                       : "MISMATCH between thread counts");
+  return mSame ? 0 : 1;
+}
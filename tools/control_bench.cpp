@@ -0,0 +1,107 @@
+//: control_bench.cpp
+// Plays headless games with the greedy bot through the control API, the
+// clock stepped by the bot, and prints how much faster than real time they
+// run. Every game is played twice to check that stepping is deterministic
+#include "Controller.h"
+#include "Evaluator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//------------------------------
+// End of a game played through a Controller
+//------------------------------
+
+struct ControlResult
+{
+  int mScore, mLines, mPieces;
+  unsigned long long mTicks;
+};
+
+// One game: place every piece as soon as it falls, then let pTicks ticks
+// pass before the next decision
+static ControlResult PlayGame(Pieces &pPieces, unsigned int pSeed, int pTicks,
+                              int pMaxPieces) {
+  Board mBoard(&pPieces, 0);
+  Game mGame(&mBoard, &pPieces, NULL, 0);
+  Controller mControl(&mGame);
+  mControl.Reset(pSeed);
+  EvalWeights mWeights;
+
+  ControlResult mResult = {0, 0, 0, 0};
+  while (!mGame.IsGameOver() && mResult.mPieces < pMaxPieces) {
+    if (mGame.IsSpawning()) {
+      mControl.StepToPiece(1000);
+      continue;
+    }
+
+    Placement mBest;
+    if (ChoosePlacement(mBoard, pPieces, mGame.mPiece, mWeights, mBest))
+      mControl.Place(mBest);
+    else
+      mControl.Act(ACTION_HARD_DROP);
+    mResult.mPieces++;
+    mControl.Step(pTicks);
+  }
+
+  mResult.mScore = mGame.getScore();
+  mResult.mLines = mGame.GetLines();
+  mResult.mTicks = mControl.GetTicks();
+  return mResult;
+}
+
+int main(int argc, char *argv[]) {
+  // "--games G" games played, "--ticks N" ticks stepped after each piece,
+  // "--max-pieces P" pieces before a game is stopped, "--pieces FILE" piece
+  // set
+  int mGames = 200;
+  int mTicks = 1;
+  int mMaxPieces = 1000;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--games") == 0)
+      mGames = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--ticks") == 0)
+      mTicks = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--max-pieces") == 0)
+      mMaxPieces = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mGames < 1)
+    mGames = 1;
+
+  unsigned long long mPieceCount = 0, mLines = 0, mTickCount = 0;
+  int mMismatches = 0;
+  double mSeconds = 0;
+  for (int g = 0; g < mGames; g++) {
+    std::chrono::steady_clock::time_point mStart =
+        std::chrono::steady_clock::now();
+    ControlResult mResult = PlayGame(mPieces, 1 + g, mTicks, mMaxPieces);
+    mSeconds += std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - mStart)
+                    .count();
+
+    ControlResult mAgain = PlayGame(mPieces, 1 + g, mTicks, mMaxPieces);
+    if (mResult.mScore != mAgain.mScore || mResult.mLines != mAgain.mLines ||
+        mResult.mPieces != mAgain.mPieces || mResult.mTicks != mAgain.mTicks) {
+      printf("game %d played twice ended differently\n", g);
+      mMismatches++;
+    }
+
+    mPieceCount += mResult.mPieces;
+    mLines += mResult.mLines;
+    mTickCount += mResult.mTicks;
+  }
+
+  printf("%d games, %d ticks per piece: %llu pieces, %llu lines, %llu ticks\n",
+         mGames, mTicks, mPieceCount, mLines, mTickCount);
+  printf("%.3f s, %.0f pieces/s, %.0f ticks/s, %.0fx real time\n", mSeconds,
+         mPieceCount / mSeconds, mTickCount / mSeconds,
+         mTickCount * TICK_TIME / 1000.0 / mSeconds);
+  printf("replay: %s\n", mMismatches == 0 ? "deterministic" : "MISMATCH");
+  return mMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+//: env_bench.cpp
+// Steps a batch of training environments with random legal actions and
+// prints environment steps per second
+#include "VecEnv.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+  // "--envs N" environments, "--threads T" threads stepping them,
+  // "--steps S" steps of the whole batch, "--pieces FILE" piece set
+  int mEnvs = 1024;
+  int mThreads = std::thread::hardware_concurrency();
+  int mSteps = 1000;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--envs") == 0)
+      mEnvs = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--threads") == 0)
+      mThreads = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--steps") == 0)
+      mSteps = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mEnvs < 1)
+    mEnvs = 1;
+  if (mThreads < 1)
+    mThreads = 1;
+
+  VecEnv mVec(&mPieces, mEnvs, mThreads);
+
+  // One contiguous block per buffer, as a training loop would hand them
+  std::vector<unsigned char> mBoards((size_t)mEnvs * ENV_BOARD_SIZE);
+  std::vector<unsigned char> mPieceHots((size_t)mEnvs * mVec.GetPieceSize());
+  std::vector<unsigned char> mMasks((size_t)mEnvs * ENV_ACTIONS);
+  std::vector<float> mRewards(mEnvs);
+  std::vector<unsigned char> mDones(mEnvs);
+  EnvBuffers mBuffers = {&mBoards[0], &mPieceHots[0], &mMasks[0], &mRewards[0],
+                         &mDones[0]};
+  mVec.SetBuffers(mBuffers);
+
+  std::vector<unsigned int> mSeeds(mEnvs);
+  for (int i = 0; i < mEnvs; i++)
+    mSeeds[i] = 1 + i;
+  mVec.Reset(&mSeeds[0]);
+
+  std::vector<int> mActions(mEnvs);
+  unsigned int mRand = 12345;
+  double mPolicySeconds = 0, mStepSeconds = 0;
+  double mLines = 0;
+  for (int s = 0; s < mSteps; s++) {
+    // Random legal action from the mask of every environment
+    std::chrono::steady_clock::time_point mStart =
+        std::chrono::steady_clock::now();
+    for (int i = 0; i < mEnvs; i++) {
+      const unsigned char *mMask = &mMasks[(size_t)i * ENV_ACTIONS];
+      int mLegal[ENV_ACTIONS], mCount = 0;
+      for (int a = 0; a < ENV_ACTIONS; a++)
+        if (mMask[a])
+          mLegal[mCount++] = a;
+      mRand = mRand * 1103515245u + 12345u;
+      mActions[i] = mCount ? mLegal[(mRand >> 16) % mCount] : 0;
+    }
+    std::chrono::steady_clock::time_point mMiddle =
+        std::chrono::steady_clock::now();
+
+    mVec.Step(&mActions[0]);
+
+    mPolicySeconds +=
+        std::chrono::duration<double>(mMiddle - mStart).count();
+    mStepSeconds += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - mMiddle)
+                        .count();
+    for (int i = 0; i < mEnvs; i++)
+      mLines += mRewards[i];
+  }
+
+  double mTotal = (double)mEnvs * mSteps;
+  printf("%d envs x %d steps on %d threads: %.3f s stepping, %.3f s "
+         "choosing actions\n",
+         mEnvs, mSteps, mThreads, mStepSeconds, mPolicySeconds);
+  printf("%.2f M env steps/s, %llu episodes, %.0f lines\n",
+         mTotal / mStepSeconds / 1e6, mVec.GetEpisodes(), mLines);
+  return 0;
+}
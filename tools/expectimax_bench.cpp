@@ -0,0 +1,133 @@
+//: expectimax_bench.cpp
+// Measures the expectimax search speed and its scaling from 1 to N threads
+#include "Expectimax.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Every heap allocation of the process is counted, to check that searches
+// don't allocate once the arenas have grown
+static std::atomic<unsigned long long> sAllocations(0);
+
+void *operator new(size_t pSize)
+{
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(pSize ? pSize : 1);
+  if (p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t pSize) { return operator new(pSize); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// Build a mid game board by storing random placements
+static void RandomBoard(Board &pBoard, const Pieces &pPieces, unsigned int pSeed,
+                        int pMoves)
+{
+  Placement mPlacements[MAX_PLACEMENTS];
+  for (int i = 0; i < pMoves; i++) {
+    pSeed = pSeed * 1103515245u + 12345u;
+    int mPiece = (pSeed >> 16) % pPieces.GetKinds();
+    int mCount = EnumeratePlacements(pBoard, pPieces, mPiece, mPlacements);
+    if (mCount == 0)
+      return;
+
+    pSeed = pSeed * 1103515245u + 12345u;
+    const Placement &mPlacement = mPlacements[(pSeed >> 16) % mCount];
+
+    Board mNext = pBoard;
+    mNext.StorePieces(mPlacement.mX, mPlacement.mY, mPiece,
+                      mPlacement.mRotation);
+    mNext.DeletePossibleLines();
+    if (mNext.IsGameOver() || mNext.GetColumnHeight(0) > BOARD_HEIGHT / 2)
+      return;
+    pBoard = mNext;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  // "--threads N" highest thread count, "--depth D" plies per search,
+  // "--boards B" positions searched per thread count,
+  // "--budget MS" time budget per search instead of a fixed depth
+  int mMaxThreads = std::thread::hardware_concurrency();
+  int mDepth = 3;
+  int mBoards = 8;
+  int mBudget = 0;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--threads") == 0)
+      mMaxThreads = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--depth") == 0)
+      mDepth = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--boards") == 0)
+      mBoards = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--budget") == 0)
+      mBudget = atoi(argv[i + 1]);
+  }
+  if (mMaxThreads < 1)
+    mMaxThreads = 1;
+
+  Pieces mPieces;
+  std::vector<Board> mPositions;
+  for (int b = 0; b < mBoards; b++) {
+    Board mBoard(&mPieces, 0);
+    RandomBoard(mBoard, mPieces, 1000 + b, 12);
+    mPositions.push_back(mBoard);
+  }
+
+  std::vector<int> mThreadCounts;
+  for (int t = 1; t < mMaxThreads; t *= 2)
+    mThreadCounts.push_back(t);
+  mThreadCounts.push_back(mMaxThreads);
+
+  printf("%-8s %12s %14s %8s %10s %6s %12s %12s\n", "threads", "nodes",
+         "nodes/s", "speedup", "efficiency", "depth", "peak KiB", "allocs");
+
+  double mBaseRate = 0;
+  for (size_t t = 0; t < mThreadCounts.size(); t++) {
+    ThreadPool mPool(mThreadCounts[t]);
+    Expectimax mSearch(&mPieces, &mPool, EvalWeights());
+
+    unsigned long long mNodes = 0, mAllocations = 0;
+    double mSeconds = 0;
+    int mDepthSum = 0;
+    size_t mPeakBytes = 0;
+    for (size_t b = 0; b < mPositions.size(); b++) {
+      // Every run starts cold so thread counts do the same work
+      mSearch.ClearTable();
+
+      // The first search of a thread count grows the arenas, the others
+      // only allocate arena blocks when they need more nodes than any
+      // search before
+      SearchStats mStats;
+      unsigned long long mBefore = sAllocations.load();
+      mSearch.Search(mPositions[b], b % mPieces.GetKinds(),
+                     (b + 3) % mPieces.GetKinds(), mBudget,
+                     mBudget > 0 ? 16 : mDepth, &mStats);
+      if (b > 0)
+        mAllocations += sAllocations.load() - mBefore;
+      mNodes += mStats.mNodes;
+      mSeconds += mStats.mSeconds;
+      mDepthSum += mStats.mDepth;
+      mPeakBytes = mStats.mArenaPeakBytes;
+    }
+
+    double mRate = mNodes / mSeconds;
+    if (t == 0)
+      mBaseRate = mRate;
+    printf("%-8d %12llu %14.0f %8.2f %9.1f%% %6.1f %12zu %12llu\n",
+           mThreadCounts[t], mNodes, mRate, mRate / mBaseRate,
+           100.0 * mRate / mBaseRate / mThreadCounts[t],
+           (double)mDepthSum / mPositions.size(), mPeakBytes / 1024,
+           mAllocations);
+  }
+
+  return 0;
+}
@@ -0,0 +1,201 @@
+//: feature_bench.cpp
+// Measures the board feature extraction: a block by block walk, the bit
+// parallel kernel for one board and the batched kernel, and checks that
+// all three agree
+#include "Features.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Mid game boards: random placements from an empty board, every board
+// along the way is kept and a lost game starts again
+static void RandomBoards(std::vector<BoardBits> &pBoards, const Pieces &pPieces,
+                         int pCount)
+{
+  Placement mPlacements[MAX_PLACEMENTS];
+  unsigned int mSeed = 1;
+  BoardBits mBoard;
+  mBoard.Clear();
+
+  while ((int)pBoards.size() < pCount) {
+    mSeed = mSeed * 1103515245u + 12345u;
+    int mPiece = (mSeed >> 16) % pPieces.GetKinds();
+    int mCount = EnumeratePlacements(mBoard, pPieces, mPiece, mPlacements);
+
+    mSeed = mSeed * 1103515245u + 12345u;
+    if (mCount > 0) {
+      const Placement &mPlacement = mPlacements[(mSeed >> 16) % mCount];
+      mBoard.StorePieces(pPieces, mPlacement.mX, mPlacement.mY, mPiece,
+                         mPlacement.mRotation);
+      mBoard.DeletePossibleLines();
+    }
+    if (mCount == 0 || mBoard.IsGameOver())
+      mBoard.Clear();
+    else
+      pBoards.push_back(mBoard);
+  }
+}
+
+// The same features found block by block, the way they would be without
+// the row masks
+static void WalkFeatures(const BoardBits &pBoard, FeatureVector &pOut)
+{
+  short *mOut = pOut.mValues;
+  memset(mOut, 0, sizeof(pOut.mValues));
+
+  int mHeights[BOARD_WIDTH];
+  for (int i = 0; i < BOARD_WIDTH; i++) {
+    mHeights[i] = 0;
+    bool mFilledAbove = false;
+    int mHolesBelow = 0;
+    for (int j = 0; j < BOARD_HEIGHT; j++) {
+      bool mFree = pBoard.IsFreeBlock(i, j);
+      if (!mFree && !mFilledAbove)
+        mHeights[i] = BOARD_HEIGHT - j;
+      if (mFree && mFilledAbove)
+        mOut[FEATURE_HOLES]++;
+      mFilledAbove = mFilledAbove || !mFree;
+
+      bool mAboveFree = j == 0 || pBoard.IsFreeBlock(i, j - 1);
+      mOut[FEATURE_COLUMN_TRANSITIONS] += mFree != mAboveFree;
+    }
+    mOut[FEATURE_COLUMN_TRANSITIONS] += pBoard.IsFreeBlock(i, BOARD_HEIGHT - 1);
+
+    // Filled blocks with a hole somewhere below
+    for (int j = BOARD_HEIGHT - 1; j >= 0; j--) {
+      bool mFree = pBoard.IsFreeBlock(i, j);
+      if (!mFree && mHolesBelow > 0)
+        mOut[FEATURE_COVERED]++;
+      if (mFree && j > BOARD_HEIGHT - mHeights[i])
+        mHolesBelow++;
+    }
+
+    mOut[FEATURE_HEIGHT] += mHeights[i];
+    mOut[FEATURE_COLUMN_HEIGHT + i] = mHeights[i];
+    if (mHeights[i] > mOut[FEATURE_MAX_HEIGHT])
+      mOut[FEATURE_MAX_HEIGHT] = mHeights[i];
+    if (i > 0)
+      mOut[FEATURE_BUMPINESS] += abs(mHeights[i] - mHeights[i - 1]);
+  }
+
+  for (int i = 0; i < BOARD_WIDTH; i++) {
+    int mLeft = i > 0 ? mHeights[i - 1] : BOARD_HEIGHT;
+    int mRight = i < BOARD_WIDTH - 1 ? mHeights[i + 1] : BOARD_HEIGHT;
+    int mDepth = (mLeft < mRight ? mLeft : mRight) - mHeights[i];
+    if (mDepth > 0) {
+      mOut[FEATURE_WELLS] += mDepth;
+      if (mDepth > mOut[FEATURE_MAX_WELL])
+        mOut[FEATURE_MAX_WELL] = mDepth;
+    }
+  }
+
+  // Rows from the top of the stack down, the walls are filled
+  int mTop = BOARD_HEIGHT - mOut[FEATURE_MAX_HEIGHT];
+  for (int j = mTop; j < BOARD_HEIGHT; j++) {
+    bool mLastFree = false;
+    for (int i = 0; i < BOARD_WIDTH; i++) {
+      bool mFree = pBoard.IsFreeBlock(i, j);
+      mOut[FEATURE_ROW_TRANSITIONS] += mFree != mLastFree;
+      mLastFree = mFree;
+    }
+    mOut[FEATURE_ROW_TRANSITIONS] += mLastFree;
+  }
+}
+
+static double Seconds(std::chrono::steady_clock::time_point pStart)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       pStart)
+      .count();
+}
+
+int main(int argc, char *argv[]) {
+  // "--boards N" positions measured, "--rounds R" passes over them,
+  // "--pieces FILE" piece set, "--csv FILE" writes the features of every
+  // position for offline analysis
+  int mCount = 100000;
+  int mRounds = 10;
+  const char *mCsvFile = NULL;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--boards") == 0)
+      mCount = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--rounds") == 0)
+      mRounds = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--csv") == 0)
+      mCsvFile = argv[i + 1];
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mCount < 1)
+    mCount = 1;
+  if (mRounds < 1)
+    mRounds = 1;
+
+  std::vector<BoardBits> mBoards;
+  RandomBoards(mBoards, mPieces, mCount);
+
+  std::vector<FeatureVector> mWalk(mCount), mSingle(mCount), mBatch(mCount);
+  long long mChecksum = 0; // keeps the work from being optimized away
+
+  std::chrono::steady_clock::time_point mStart =
+      std::chrono::steady_clock::now();
+  for (int r = 0; r < mRounds; r++)
+    for (int i = 0; i < mCount; i++) {
+      WalkFeatures(mBoards[i], mWalk[i]);
+      mChecksum += mWalk[i][FEATURE_HOLES];
+    }
+  double mWalkSeconds = Seconds(mStart);
+
+  mStart = std::chrono::steady_clock::now();
+  for (int r = 0; r < mRounds; r++)
+    for (int i = 0; i < mCount; i++) {
+      ExtractFeatures(mBoards[i], mSingle[i]);
+      mChecksum += mSingle[i][FEATURE_HOLES];
+    }
+  double mSingleSeconds = Seconds(mStart);
+
+  mStart = std::chrono::steady_clock::now();
+  for (int r = 0; r < mRounds; r++) {
+    ExtractFeatures(&mBoards[0], mCount, &mBatch[0]);
+    mChecksum += mBatch[r % mCount][FEATURE_HOLES];
+  }
+  double mBatchSeconds = Seconds(mStart);
+
+  int mMismatches = 0;
+  for (int i = 0; i < mCount; i++)
+    mMismatches += memcmp(&mWalk[i], &mSingle[i], sizeof(FeatureVector)) != 0 ||
+                   memcmp(&mWalk[i], &mBatch[i], sizeof(FeatureVector)) != 0;
+
+  double mPositions = (double)mCount * mRounds;
+  printf("%d boards, %d rounds, %d boards per vector (checksum %lld)\n",
+         mCount, mRounds, BATCH_WIDTH, mChecksum);
+  printf("%-8s %16s %8s\n", "", "boards/s", "speedup");
+  printf("%-8s %16.0f %8.2f\n", "walk", mPositions / mWalkSeconds, 1.0);
+  printf("%-8s %16.0f %8.2f\n", "bits", mPositions / mSingleSeconds,
+         mWalkSeconds / mSingleSeconds);
+  printf("%-8s %16.0f %8.2f\n", "batch", mPositions / mBatchSeconds,
+         mWalkSeconds / mBatchSeconds);
+  printf("%d mismatched boards\n", mMismatches);
+
+  if (mCsvFile != NULL) {
+    FILE *mFile = fopen(mCsvFile, "w");
+    if (mFile == NULL) {
+      fprintf(stderr, "couldn't write %s\n", mCsvFile);
+      return 1;
+    }
+    for (int f = 0; f < FEATURE_COUNT; f++)
+      fprintf(mFile, "%s%c", GetFeatureName(f),
+              f + 1 < FEATURE_COUNT ? ',' : '\n');
+    for (int i = 0; i < mCount; i++)
+      for (int f = 0; f < FEATURE_COUNT; f++)
+        fprintf(mFile, "%d%c", mBatch[i][f], f + 1 < FEATURE_COUNT ? ',' : '\n');
+    fclose(mFile);
+  }
+
+  return mMismatches == 0 ? 0 : 1;
+}
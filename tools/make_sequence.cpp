@@ -0,0 +1,82 @@
+//: make_sequence.cpp
+// Draws a piece sequence and writes it to a file that games map and share
+// with --sequence, so every game of a run sees the same pieces
+#include "PieceSequence.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char *argv[]) {
+  // "--out FILE" sequence file, "--length N" pieces, "--seed S" seed of
+  // the pieces, "--policy uniform|bag" how they are drawn, "--pieces FILE"
+  // piece set
+  const char *mOut = NULL;
+  unsigned long long mLength = 1000000;
+  unsigned int mSeed = 1;
+  int mPolicy = SEQUENCE_BAG;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--out") == 0)
+      mOut = argv[i + 1];
+    if (strcmp(argv[i], "--length") == 0)
+      mLength = strtoull(argv[i + 1], NULL, 10);
+    if (strcmp(argv[i], "--seed") == 0)
+      mSeed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+    if (strcmp(argv[i], "--policy") == 0)
+      mPolicy = strcmp(argv[i + 1], "uniform") == 0 ? SEQUENCE_UNIFORM
+                : strcmp(argv[i + 1], "bag") == 0   ? SEQUENCE_BAG
+                                                    : -1;
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mOut == NULL || mLength == 0 || mPolicy < 0) {
+    fprintf(stderr, "usage: make_sequence --out FILE [--length N] [--seed S] "
+                    "[--policy uniform|bag] [--pieces FILE]\n");
+    return 1;
+  }
+  if (mPieces.GetKinds() > SEQUENCE_MAX_KINDS) {
+    fprintf(stderr, "a sequence holds %d kinds of pieces at most, the set has "
+                    "%d\n",
+            SEQUENCE_MAX_KINDS, mPieces.GetKinds());
+    return 1;
+  }
+
+  if (!PieceSequence::Write(mOut, mPieces, mSeed, mPolicy, mLength)) {
+    fprintf(stderr, "couldn't write %s\n", mOut);
+    return 1;
+  }
+
+  // Read it back the way the games will
+  PieceSequence mSequence;
+  if (!mSequence.Open(mOut, mPieces)) {
+    fprintf(stderr, "couldn't read back %s\n", mOut);
+    return 1;
+  }
+
+  unsigned long long mCounts[SEQUENCE_MAX_KINDS] = {0};
+  for (unsigned long long i = 0; i < mSequence.GetLength(); i++) {
+    int mPiece = mSequence.GetPiece(i);
+    if (mPiece < 0) {
+      fprintf(stderr, "%s holds a bad piece at %llu\n", mOut, i);
+      return 1;
+    }
+    mCounts[mPiece]++;
+  }
+
+  printf("%s: %llu pieces, %s, seed %u, %llu bytes, hash %016llx\n", mOut,
+         mSequence.GetLength(),
+         mPolicy == SEQUENCE_BAG ? "bag" : "uniform", mSeed,
+         (unsigned long long)(sizeof(SequenceHeader) +
+                              (mLength * SEQUENCE_BITS + 7) / 8 + 1),
+         mSequence.GetHash());
+  printf("first:");
+  for (unsigned long long i = 0; i < mSequence.GetLength() && i < 28; i++)
+    printf(" %s", mPieces.GetName(mSequence.GetPiece(i)));
+  printf("\ncounts:");
+  for (int k = 0; k < mPieces.GetKinds(); k++)
+    printf(" %s %llu", mPieces.GetName(k), mCounts[k]);
+  printf("\n");
+  return 0;
+}
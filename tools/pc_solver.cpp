@@ -0,0 +1,270 @@
+//: pc_solver.cpp
+// Perfect clear solver: finds how the coming pieces can empty a board, or
+// measures solve times over a set of random openings
+#include "PerfectClear.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Pieces by name, like "OIL" for the built-in set, or by number "0,3,1".
+// The longest name of the set that matches is taken; returns -1 for a
+// number that isn't a piece of the set
+static int ParseSequence(const char *pText, const Pieces &pPieces, int *pOut)
+{
+  int mCount = 0;
+  const char *p = pText;
+  while (*p != '\0' && mCount < PC_MAX_PIECES) {
+    if (*p >= '0' && *p <= '9') {
+      pOut[mCount] = strtol(p, (char **)&p, 10);
+      if (pOut[mCount++] >= pPieces.GetKinds())
+        return -1;
+      continue;
+    }
+
+    int mFound = -1;
+    size_t mLength = 0;
+    for (int k = 0; k < pPieces.GetKinds(); k++) {
+      size_t mName = strlen(pPieces.GetName(k));
+      if (mName > mLength && strncmp(p, pPieces.GetName(k), mName) == 0) {
+        mFound = k;
+        mLength = mName;
+      }
+    }
+    if (mFound >= 0) {
+      pOut[mCount++] = mFound;
+      p += mLength;
+    } else
+      p++; // separators
+  }
+  return mCount;
+}
+
+// Board from a text file of '#' and '.' lines, the last line on the floor
+static bool LoadBoard(const char *pPath, BoardBits &pBoard)
+{
+  FILE *mFile = fopen(pPath, "r");
+  if (mFile == NULL)
+    return false;
+
+  std::vector<unsigned short> mLines;
+  char mLine[256];
+  while (fgets(mLine, sizeof(mLine), mFile) != NULL) {
+    if (mLine[0] != '#' && mLine[0] != '.')
+      continue;
+    unsigned short mRow = 0;
+    for (int x = 0; x < BOARD_WIDTH && mLine[x] != '\0'; x++)
+      if (mLine[x] == '#')
+        mRow |= 1 << x;
+    mLines.push_back(mRow);
+  }
+  fclose(mFile);
+
+  if (mLines.size() > BOARD_HEIGHT)
+    return false;
+  pBoard.Clear();
+  int mTop = BOARD_HEIGHT - mLines.size();
+  for (size_t i = 0; i < mLines.size(); i++)
+    for (int x = 0; x < BOARD_WIDTH; x++)
+      if (mLines[i] & (1 << x)) {
+        pBoard.mRows[mTop + i] |= 1 << x;
+        if (pBoard.mColumnTop[x] > mTop + (int)i)
+          pBoard.mColumnTop[x] = mTop + i;
+      }
+  return true;
+}
+
+// Field lines of a board, with the blocks of one piece marked by the first
+// letter of its name
+static void PrintField(const BoardBits &pBoard, int pHeight, const Pieces &pPieces,
+                       const Placement *pPlacement, int pPiece)
+{
+  for (int j = BOARD_HEIGHT - pHeight; j < BOARD_HEIGHT; j++) {
+    printf("  |");
+    for (int x = 0; x < BOARD_WIDTH; x++) {
+      char mBlock = pBoard.IsFreeBlock(x, j) ? '.' : '#';
+      if (pPlacement != NULL) {
+        const PieceShape &mShape = pPieces.GetShape(pPiece, pPlacement->mRotation);
+        int mX = x - pPlacement->mX, mY = j - pPlacement->mY;
+        if (mX >= 0 && mX < PIECES_MAX_BLOCKS && mY >= 0 &&
+            mY < PIECES_MAX_BLOCKS && (mShape.mRows[mY] & (1 << mX)))
+          mBlock = pPieces.GetName(pPiece)[0];
+      }
+      putchar(mBlock);
+    }
+    printf("|\n");
+  }
+}
+
+// The next pieces of a 7-bag style randomizer: every kind once per bag
+static void Bag(unsigned int &pSeed, const Pieces &pPieces, int *pOut, int pCount)
+{
+  int mKinds = pPieces.GetKinds();
+  int mBag[PIECES_MAX_KINDS];
+  for (int i = 0; i < pCount; i++) {
+    if (i % mKinds == 0) {
+      for (int k = 0; k < mKinds; k++)
+        mBag[k] = k;
+      for (int k = mKinds - 1; k > 0; k--) {
+        pSeed = pSeed * 1103515245u + 12345u;
+        std::swap(mBag[k], mBag[(pSeed >> 16) % (k + 1)]);
+      }
+    }
+    pOut[i] = mBag[i % mKinds];
+  }
+}
+
+static double Percentile(std::vector<double> &pValues, double pRank)
+{
+  if (pValues.empty())
+    return 0;
+  std::sort(pValues.begin(), pValues.end());
+  return pValues[(size_t)(pRank * (pValues.size() - 1) + 0.5)];
+}
+
+static void PrintTimes(const char *pName, std::vector<double> &pTimes)
+{
+  printf("%-10s %6zu %10.3f %10.3f %10.3f %10.3f %10.3f\n", pName,
+         pTimes.size(), Percentile(pTimes, 0), Percentile(pTimes, 0.5),
+         Percentile(pTimes, 0.9), Percentile(pTimes, 0.99),
+         Percentile(pTimes, 1));
+}
+
+int main(int argc, char *argv[]) {
+  // Solve: "--board FILE" starting board, "--sequence OILJZST" coming
+  // pieces by name or number like "0,3,1", "--height H" lines of
+  // the field. Benchmark: "--bench N" openings, each "--prefill P" random
+  // pieces of a bag placed on an empty field and then "--count K" pieces to
+  // clear with. "--threads T", "--pieces FILE" for both
+  const char *mBoardFile = NULL;
+  const char *mSequenceText = NULL;
+  int mHeight = 4, mBench = 0, mPrefill = 2, mCount = 10;
+  int mThreads = std::thread::hardware_concurrency();
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--board") == 0)
+      mBoardFile = argv[i + 1];
+    if (strcmp(argv[i], "--sequence") == 0)
+      mSequenceText = argv[i + 1];
+    if (strcmp(argv[i], "--height") == 0)
+      mHeight = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--bench") == 0)
+      mBench = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--prefill") == 0)
+      mPrefill = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--count") == 0)
+      mCount = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--threads") == 0)
+      mThreads = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mThreads < 1)
+    mThreads = 1;
+  if (mCount > PC_MAX_PIECES)
+    mCount = PC_MAX_PIECES;
+
+  ThreadPool mPool(mThreads);
+  PerfectClear mSolver(&mPieces, &mPool);
+  Placement mSolution[PC_MAX_PIECES];
+  int mUsed;
+  PcStats mStats;
+
+  if (mBench == 0) {
+    BoardBits mBoard;
+    mBoard.Clear();
+    if (mBoardFile != NULL && !LoadBoard(mBoardFile, mBoard)) {
+      fprintf(stderr, "couldn't load board %s\n", mBoardFile);
+      return 1;
+    }
+    int mSequence[PC_MAX_PIECES];
+    int mPiecesCount =
+        mSequenceText != NULL ? ParseSequence(mSequenceText, mPieces, mSequence) : 0;
+    if (mPiecesCount < 0) {
+      fprintf(stderr, "--sequence names a piece the set doesn't have\n");
+      return 1;
+    }
+
+    PcResult mResult = mSolver.Solve(mBoard, mSequence, mPiecesCount, mHeight,
+                                     mSolution, mUsed, &mStats);
+    printf("%s in %.3f ms, %llu boards, %llu failed again, pruned %llu cells "
+           "%llu regions %llu enclosed\n",
+           GetPcResultName(mResult), mStats.mSeconds * 1000, mStats.mNodes,
+           mStats.mFailHits, mStats.mPruned[0], mStats.mPruned[1],
+           mStats.mPruned[2]);
+
+    for (int i = 0; i < mUsed; i++) {
+      const Placement &mPlacement = mSolution[i];
+      printf("%d: %s x %d y %d rotation %d\n", i + 1,
+             mPieces.GetName(mSequence[i]), mPlacement.mX, mPlacement.mY,
+             mPlacement.mRotation);
+      PrintField(mBoard, mHeight, mPieces, &mPlacement, mSequence[i]);
+      mBoard.StorePieces(mPieces, mPlacement.mX, mPlacement.mY, mSequence[i],
+                         mPlacement.mRotation);
+      mHeight -= mBoard.DeletePossibleLines();
+    }
+    return mResult == PC_FOUND ? 0 : 2;
+  }
+
+  // Openings: a few pieces dropped on the field, then the pieces to solve
+  std::vector<double> mAll, mFound, mNone;
+  int mResults[PC_EXHAUSTED + 1] = {0};
+  unsigned long long mNodes = 0;
+  for (int b = 0; b < mBench; b++) {
+    unsigned int mSeed = 1 + b;
+    int mSequence[2 * PC_MAX_PIECES];
+    Bag(mSeed, mPieces, mSequence, mPrefill + mCount);
+
+    BoardBits mBoard;
+    mBoard.Clear();
+    Placement mPlacements[MAX_PLACEMENTS];
+    for (int i = 0; i < mPrefill; i++) {
+      int mPlaced = EnumeratePlacements(mBoard, mPieces, mSequence[i], mPlacements);
+      for (int t = 0; t < mPlaced; t++) {
+        mSeed = mSeed * 1103515245u + 12345u;
+        const Placement &mPlacement = mPlacements[(mSeed >> 16) % mPlaced];
+        BoardBits mNext = mBoard;
+        mNext.StorePieces(mPieces, mPlacement.mX, mPlacement.mY, mSequence[i],
+                          mPlacement.mRotation);
+        if (mNext.DeletePossibleLines() == 0 &&
+            mNext.GetColumnHeight(0) <= mHeight) {
+          bool mInside = true;
+          for (int x = 0; x < BOARD_WIDTH; x++)
+            mInside = mInside && mNext.GetColumnHeight(x) <= mHeight;
+          if (mInside) {
+            mBoard = mNext;
+            break;
+          }
+        }
+      }
+    }
+
+    PcResult mResult = mSolver.Solve(mBoard, mSequence + mPrefill, mCount,
+                                     mHeight, mSolution, mUsed, &mStats);
+    double mMs = mStats.mSeconds * 1000;
+    mResults[mResult]++;
+    mNodes += mStats.mNodes;
+    mAll.push_back(mMs);
+    (mResult == PC_FOUND ? mFound : mNone).push_back(mMs);
+  }
+
+  double mTotal = 0;
+  for (size_t i = 0; i < mAll.size(); i++)
+    mTotal += mAll[i];
+  printf("%d openings, %d prefilled pieces, %d pieces, %d lines, %d threads\n",
+         mBench, mPrefill, mCount, mHeight, mThreads);
+  for (int r = 0; r <= PC_EXHAUSTED; r++)
+    if (mResults[r] > 0)
+      printf("  %-10s %d\n", GetPcResultName((PcResult)r), mResults[r]);
+  printf("%-10s %6s %10s %10s %10s %10s %10s\n", "ms", "count", "min", "p50",
+         "p90", "p99", "max");
+  PrintTimes("all", mAll);
+  PrintTimes("found", mFound);
+  PrintTimes("no clear", mNone);
+  printf("%.0f boards/s\n", mTotal > 0 ? mNodes / (mTotal / 1000) : 0);
+  return 0;
+}
@@ -0,0 +1,117 @@
+//: plan_bench.cpp
+// Plays headless games with the greedy bot, planning the inputs to every
+// placement of each piece and playing the plan of the one it picks through
+// the control API. Prints the planning time, with and without the cached
+// empty board searches, and checks every played plan lands where planned
+#include "Evaluator.h"
+#include "Planner.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char *argv[]) {
+  // "--games G" games played, "--max-pieces P" pieces before a game is
+  // stopped, "--pieces FILE" piece set
+  int mGames = 20;
+  int mMaxPieces = 500;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--games") == 0)
+      mGames = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--max-pieces") == 0)
+      mMaxPieces = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+
+  std::chrono::steady_clock::time_point mStart =
+      std::chrono::steady_clock::now();
+  Planner mPlanner(&mPieces);
+  double mInitSeconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - mStart)
+                            .count();
+
+  EvalWeights mWeights;
+  unsigned long long mPlans = 0, mCachedPlans = 0, mUnreachable = 0;
+  unsigned long long mInputs = 0, mPlayed = 0, mMissed = 0;
+  double mSeconds = 0, mCachedSeconds = 0;
+  for (int g = 0; g < mGames; g++) {
+    Board mBoard(&mPieces, 0);
+    Game mGame(&mBoard, &mPieces, NULL, 0);
+    Controller mControl(&mGame);
+    mControl.Reset(1 + g);
+
+    for (int p = 0; p < mMaxPieces && !mGame.IsGameOver(); p++) {
+      mControl.StepToPiece(1000);
+      if (mGame.IsGameOver())
+        break;
+
+      bool mEmpty = true;
+      for (int j = 0; j < BOARD_HEIGHT; j++)
+        mEmpty = mEmpty && mBoard.GetRow(j) == 0;
+
+      // Every placement, timed one by one
+      Placement mPlacements[MAX_PLACEMENTS];
+      int mCount = EnumeratePlacements(mBoard, mPieces, mGame.mPiece,
+                                       mPlacements);
+      InputPlan mPlan;
+      for (int i = 0; i < mCount; i++) {
+        std::chrono::steady_clock::time_point mBegin =
+            std::chrono::steady_clock::now();
+        int mCost = mPlanner.Plan(mBoard.GetBits(), mGame.mPiece, mGame.mPosX,
+                                  mGame.mPosY, mGame.mRotation, mPlacements[i],
+                                  mPlan);
+        double mTime = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - mBegin)
+                           .count();
+        if (mEmpty) {
+          mCachedPlans++;
+          mCachedSeconds += mTime;
+        } else {
+          mPlans++;
+          mSeconds += mTime;
+        }
+        mUnreachable += mCost < 0;
+      }
+
+      // Play the plan to the bot's pick and check where the piece lands
+      Placement mBest;
+      if (!ChoosePlacement(mBoard, mPieces, mGame.mPiece, mWeights, mBest) ||
+          mPlanner.Plan(mBoard.GetBits(), mGame.mPiece, mGame.mPosX,
+                        mGame.mPosY, mGame.mRotation, mBest, mPlan) < 0) {
+        mControl.Act(ACTION_HARD_DROP);
+        continue;
+      }
+
+      for (int i = 0; i < mPlan.mCount - 1; i++)
+        mControl.Act(mPlan.mInputs[i]);
+      int mY = mGame.mPosY + mBoard.GetDropDistance(mGame.mPosX, mGame.mPosY,
+                                                    mGame.mPiece,
+                                                    mGame.mRotation);
+      const PieceShape &mShape = mPieces.GetShape(mGame.mPiece, mGame.mRotation);
+      const PieceShape &mTarget = mPieces.GetShape(mGame.mPiece, mBest.mRotation);
+      bool mLanded = mGame.mPosX + mShape.mMinX == mBest.mX + mTarget.mMinX &&
+                     mY + mShape.mMinY == mBest.mY + mTarget.mMinY;
+      mControl.Act(ACTION_HARD_DROP);
+
+      mPlayed++;
+      mMissed += !mLanded;
+      mInputs += mPlan.mCount;
+    }
+  }
+
+  printf("planner init: %.3f ms, empty board searched for %d pieces x %d "
+         "spawns\n",
+         mInitSeconds * 1e3, mPieces.GetKinds(), PIECES_ROTATIONS);
+  printf("%llu plans searched: %.2f us each\n", mPlans,
+         mPlans ? mSeconds / mPlans * 1e6 : 0.0);
+  printf("%llu plans on the empty board: %.2f us each\n", mCachedPlans,
+         mCachedPlans ? mCachedSeconds / mCachedPlans * 1e6 : 0.0);
+  printf("%llu unreachable placements\n", mUnreachable);
+  printf("%llu plans played, %.2f inputs each, %llu landed elsewhere\n",
+         mPlayed, mPlayed ? (double)mInputs / mPlayed : 0.0, mMissed);
+  return mMissed == 0 ? 0 : 1;
+}
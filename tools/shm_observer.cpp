@@ -0,0 +1,84 @@
+//: shm_observer.cpp
+// Prints the live state a game publishes with --shm, and injects keys into it
+#include "SharedState.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Draw the board with the falling piece as text
+static void PrintState(const GameState &pState, const Pieces &pPieces)
+{
+  char mCells[BOARD_HEIGHT][BOARD_WIDTH + 1];
+  for (int j = 0; j < BOARD_HEIGHT; j++) {
+    for (int i = 0; i < BOARD_WIDTH; i++)
+      mCells[j][i] = pState.mRows[j] & (1 << i) ? '#' : '.';
+    mCells[j][BOARD_WIDTH] = 0;
+  }
+
+  if (!pState.mSpawning && pState.mPiece < pPieces.GetKinds()) {
+    const PieceShape &mShape = pPieces.GetShape(pState.mPiece, pState.mRotation);
+    for (int c = 0; c < mShape.mNumCells; c++) {
+      int mX = pState.mPosX + mShape.mCells[c].mX;
+      int mY = pState.mPosY + mShape.mCells[c].mY;
+      if (mX >= 0 && mX < BOARD_WIDTH && mY >= 0 && mY < BOARD_HEIGHT)
+        mCells[mY][mX] = '@';
+    }
+  }
+
+  printf("round %d tick %llu score %d level %d lines %d next %d%s\n",
+         pState.mRound, pState.mTick, pState.mScore, pState.mLevel,
+         pState.mLines, pState.mNextPiece, pState.mGameOver ? " GAME OVER" : "");
+  for (int j = 0; j < BOARD_HEIGHT; j++)
+    printf("|%s|\n", mCells[j]);
+}
+
+int main(int argc, char *argv[]) {
+  // "--name NAME" segment of the game, "--count N" snapshots to print,
+  // "--keys KEYS" characters to inject as key presses, like "hhzx"
+  const char *mName = "/tetris";
+  int mCount = 1;
+  const char *mKeys = "";
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--name") == 0)
+      mName = argv[i + 1];
+    if (strcmp(argv[i], "--count") == 0)
+      mCount = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--keys") == 0)
+      mKeys = argv[i + 1];
+  }
+
+  SharedState mShared;
+  if (!mShared.Attach(mName)) {
+    fprintf(stderr, "no game is publishing %s\n", mName);
+    return 1;
+  }
+
+  for (const char *c = mKeys; *c; c++)
+    if (!mShared.PushInput(*c))
+      fprintf(stderr, "input queue full, '%c' dropped\n", *c);
+
+  // Piece shapes of the built-in set, to draw the falling piece
+  Pieces mPieces;
+
+  GameState mState;
+  unsigned long long mLastTick = ~0ull;
+  int mLastRound = -1;
+  for (int n = 0; n < mCount;) {
+    if (!mShared.Read(mState)) {
+      // Mid publish or left half written by a dead game, try again later
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    if (mState.mTick != mLastTick || mState.mRound != mLastRound) {
+      PrintState(mState, mPieces);
+      mLastTick = mState.mTick;
+      mLastRound = mState.mRound;
+      n++;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  return 0;
+}
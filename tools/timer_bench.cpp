@@ -0,0 +1,304 @@
+//: timer_bench.cpp
+// Checks the timer wheel against an ordered set, then drives many game
+// sessions from one wheel on a virtual clock
+#include "Game.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <utility>
+#include <vector>
+
+static unsigned int NextRand(unsigned int &pSeed)
+{
+  pSeed = pSeed * 1103515245u + 12345u;
+  return pSeed >> 16;
+}
+
+// Delay of a random timer, mostly short ones like the game uses but some
+// reach the upper levels and the overflow list
+static unsigned long long RandomDelay(unsigned int &pSeed)
+{
+  unsigned int mKind = NextRand(pSeed) % 100;
+  if (mKind < 80)
+    return NextRand(pSeed) % 600;
+  if (mKind < 98)
+    return NextRand(pSeed) % 300000;
+  return ((unsigned long long)NextRand(pSeed) << 10) + NextRand(pSeed);
+}
+
+//------------------------------
+// Same timers on the wheel and on a std::set ordered by deadline: every
+// step schedules and cancels some timers and moves the clock, and both must
+// expire the same timers at their deadline
+//------------------------------
+
+static bool CheckWheel(int pSteps, double &pWheelSeconds, double &pSetSeconds,
+                       unsigned long long &pExpired) {
+  typedef std::pair<unsigned long long, int> Entry;
+  TimerWheel mWheel(1000);
+  std::set<Entry> mSet;
+  std::vector<unsigned long long> mDeadlines; // by wheel handle, or 0
+  std::vector<int> mPending;                  // handles that may be pending
+  unsigned int mSeed = 7;
+  unsigned long long mNow = 1000;
+  bool mOk = true;
+  pWheelSeconds = pSetSeconds = 0;
+  pExpired = 0;
+
+  std::vector<Entry> mFromWheel, mFromSet;
+  for (int s = 0; s < pSteps && mOk; s++) {
+    // Schedule and cancel, the set follows the wheel handles
+    int mNew = NextRand(mSeed) % 8;
+    for (int i = 0; i < mNew; i++) {
+      unsigned long long mDeadline = mNow + RandomDelay(mSeed);
+      int mTimer = mWheel.Schedule(mDeadline, 0, 0);
+      if (mTimer >= (int)mDeadlines.size())
+        mDeadlines.resize(mTimer + 1, 0);
+      mDeadlines[mTimer] = mDeadline;
+      mSet.insert(Entry(mDeadline, mTimer));
+      mPending.push_back(mTimer);
+    }
+    for (int i = NextRand(mSeed) % 3; i > 0 && !mPending.empty(); i--) {
+      size_t mPick = NextRand(mSeed) % mPending.size();
+      int mTimer = mPending[mPick];
+      mPending[mPick] = mPending.back();
+      mPending.pop_back();
+      if (mWheel.Cancel(mTimer)) {
+        mSet.erase(Entry(mDeadlines[mTimer], mTimer));
+        mDeadlines[mTimer] = 0;
+      }
+    }
+
+    // Mostly small steps, sometimes a long idle stretch
+    mNow += NextRand(mSeed) % 16 == 0 ? RandomDelay(mSeed) : NextRand(mSeed) % 20;
+
+    mFromWheel.clear();
+    TimerEvent mEvent;
+    unsigned long long mLast = 0;
+    while (mWheel.PopExpired(mNow, mEvent)) {
+      if (mEvent.mDeadline != mWheel.GetNow() || mEvent.mDeadline < mLast) {
+        printf("timer %d due at %llu expired at %llu\n", mEvent.mTimer,
+               mEvent.mDeadline, mWheel.GetNow());
+        mOk = false;
+      }
+      mLast = mEvent.mDeadline;
+      mDeadlines[mEvent.mTimer] = 0;
+      mFromWheel.push_back(Entry(mEvent.mDeadline, mEvent.mTimer));
+    }
+
+    mFromSet.clear();
+    while (!mSet.empty() && mSet.begin()->first <= mNow) {
+      mFromSet.push_back(*mSet.begin());
+      mSet.erase(mSet.begin());
+    }
+
+    // Timers of the same tick may come out in another order
+    std::set<Entry> mA(mFromWheel.begin(), mFromWheel.end());
+    std::set<Entry> mB(mFromSet.begin(), mFromSet.end());
+    if (mA != mB || mWheel.GetPending() != (int)mSet.size()) {
+      printf("step %d: wheel expired %d timers, set %d\n", s,
+             (int)mFromWheel.size(), (int)mFromSet.size());
+      mOk = false;
+    }
+    pExpired += mFromWheel.size();
+  }
+
+  // Speed of the same kind of workload on each, without the checks
+  for (int k = 0; k < 2; k++) {
+    std::chrono::steady_clock::time_point mStart =
+        std::chrono::steady_clock::now();
+    TimerWheel mTimers(0);
+    std::set<Entry> mOrdered;
+    mSeed = 7;
+    mNow = 0;
+    int mNext = 0;
+    for (int s = 0; s < pSteps; s++) {
+      int mNew = NextRand(mSeed) % 8;
+      for (int i = 0; i < mNew; i++) {
+        unsigned long long mDeadline = mNow + RandomDelay(mSeed);
+        if (k == 0)
+          mTimers.Schedule(mDeadline, 0, 0);
+        else
+          mOrdered.insert(Entry(mDeadline, mNext++));
+      }
+      mNow += NextRand(mSeed) % 20;
+
+      if (k == 0) {
+        TimerEvent mEvent;
+        while (mTimers.PopExpired(mNow, mEvent))
+          ;
+      } else {
+        while (!mOrdered.empty() && mOrdered.begin()->first <= mNow)
+          mOrdered.erase(mOrdered.begin());
+      }
+    }
+    double mSeconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - mStart)
+                          .count();
+    (k == 0 ? pWheelSeconds : pSetSeconds) = mSeconds;
+  }
+  return mOk;
+}
+
+//------------------------------
+// Game session with a bot pressing keys on timers of its own
+//------------------------------
+
+enum BotTimer
+{
+  BOT_KEY = TIMER_TYPES, // press the next key
+  BOT_RELEASE            // let the held key go
+};
+
+struct Session
+{
+  Board mBoard;
+  Game mGame;
+  unsigned int mSeed;
+  int mHeld; // GameMove held, or -1
+  unsigned long long mPieces, mLines, mGames;
+
+  Session(Pieces *pPieces, unsigned int pSeed)
+      : mBoard(pPieces, 0), mGame(&mBoard, pPieces, NULL, 0), mSeed(pSeed),
+        mHeld(-1), mPieces(0), mLines(0), mGames(0)
+  {
+    mGame.Reset(pSeed);
+  }
+
+  // Count the finished round and start the next one
+  void Restart()
+  {
+    mPieces += mGame.getScore() + 1;
+    mLines += mGame.GetLines();
+    mGames++;
+    mGame.Reset(NextRand(mSeed));
+  }
+
+  void PressKey(TimerWheel &pTimers, int pOwner)
+  {
+    if (mGame.IsGameOver())
+      Restart();
+
+    switch (NextRand(mSeed) % 8) {
+    case 0:
+    case 1:
+      mGame.MoveLeft();
+      break;
+    case 2:
+    case 3:
+      mGame.MoveRight();
+      break;
+    case 4:
+      mGame.Rotate();
+      break;
+    case 5:
+      mGame.MoveDown();
+      break;
+    case 6:
+      mGame.HardDrop();
+      break;
+    case 7:
+      if (mHeld < 0) {
+        mHeld = NextRand(mSeed) % 2 ? MOVE_LEFT : MOVE_RIGHT;
+        mGame.StartRepeat(mHeld);
+        pTimers.Schedule(pTimers.GetNow() + 100 + NextRand(mSeed) % 500,
+                         pOwner, BOT_RELEASE);
+      }
+      break;
+    }
+    pTimers.Schedule(pTimers.GetNow() + 50 + NextRand(mSeed) % 250, pOwner,
+                     BOT_KEY);
+  }
+};
+
+int main(int argc, char *argv[]) {
+  // "--sessions N" games on one wheel, "--seconds S" virtual time played,
+  // "--steps K" steps of the wheel check, "--pieces FILE" piece set to play
+  int mSessions = 1000;
+  int mSeconds = 600;
+  int mSteps = 200000;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--sessions") == 0)
+      mSessions = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--seconds") == 0)
+      mSeconds = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--steps") == 0)
+      mSteps = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mSessions < 1)
+    mSessions = 1;
+
+  // The wheel against the ordered set
+  double mWheelSeconds, mSetSeconds;
+  unsigned long long mExpired;
+  bool mOk = CheckWheel(mSteps, mWheelSeconds, mSetSeconds, mExpired);
+  printf("check: %d steps, %llu timers expired, %s\n", mSteps, mExpired,
+         mOk ? "same as std::set" : "MISMATCH");
+  printf("schedule and expire: wheel %.3f ms, std::set %.3f ms, %.2fx\n",
+         mWheelSeconds * 1000, mSetSeconds * 1000, mSetSeconds / mWheelSeconds);
+
+  // Sessions, the clock jumps to the next deadline like a loop that sleeps
+  std::vector<Session *> mGames;
+  TimerWheel mTimers(0);
+  for (int i = 0; i < mSessions; i++) {
+    mGames.push_back(new Session(&mPieces, 1 + i));
+    mGames[i]->mGame.SetTimers(&mTimers, i);
+    mTimers.Schedule(NextRand(mGames[i]->mSeed) % 250, i, BOT_KEY);
+  }
+
+  unsigned long long mEnd = (unsigned long long)mSeconds * 1000;
+  unsigned long long mEvents = 0, mWakeUps = 0;
+  int mMostPending = 0;
+  std::chrono::steady_clock::time_point mStart = std::chrono::steady_clock::now();
+  for (;;) {
+    unsigned long long mNow = mTimers.GetNextDeadline();
+    if (mNow > mEnd)
+      break;
+    mWakeUps++;
+
+    TimerEvent mEvent;
+    while (mTimers.PopExpired(mNow, mEvent)) {
+      Session &mSession = *mGames[mEvent.mOwner];
+      mEvents++;
+      if (mEvent.mType == BOT_KEY)
+        mSession.PressKey(mTimers, mEvent.mOwner);
+      else if (mEvent.mType == BOT_RELEASE) {
+        mSession.mGame.StopRepeat(mSession.mHeld);
+        mSession.mHeld = -1;
+      } else
+        mSession.mGame.OnTimer(mEvent);
+    }
+    if (mTimers.GetPending() > mMostPending)
+      mMostPending = mTimers.GetPending();
+  }
+  double mPlayed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - mStart)
+                       .count();
+
+  unsigned long long mPieceCount = 0, mLines = 0, mRounds = 0;
+  for (int i = 0; i < mSessions; i++) {
+    mPieceCount += mGames[i]->mPieces + mGames[i]->mGame.getScore();
+    mLines += mGames[i]->mLines + mGames[i]->mGame.GetLines();
+    mRounds += mGames[i]->mGames;
+    delete mGames[i];
+  }
+
+  printf("%d sessions, %d s of play each, %llu pieces, %llu lines, %llu games "
+         "over\n",
+         mSessions, mSeconds, mPieceCount, mLines, mRounds);
+  printf("%llu timer events in %.3f s, %.0f events/s, %.1f ns per event\n",
+         mEvents, mPlayed, mEvents / mPlayed, mPlayed * 1e9 / mEvents);
+  printf("%llu wake ups, at most %d timers pending; polling every 1 ms would "
+         "check %llu times\n",
+         mWakeUps, mMostPending, (unsigned long long)mSessions * mEnd);
+  printf("%.0fx faster than real time\n", mSeconds / mPlayed);
+
+  return mOk ? 0 : 1;
+}
@@ -0,0 +1,473 @@
+//: tuner.cpp
+// Tunes the evaluation weights of the greedy bot with CMA-ES. Every
+// candidate plays the same seeded headless games, spread over a thread pool
+#include "Evaluator.h"
+#include "Game.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TUNER_WEIGHTS 5 // height, holes, bumpiness, wells, lines
+
+static void ToWeights(const double *pX, EvalWeights &pWeights)
+{
+  pWeights.mHeight = pX[0];
+  pWeights.mHoles = pX[1];
+  pWeights.mBumpiness = pX[2];
+  pWeights.mWells = pX[3];
+  pWeights.mLines = pX[4];
+}
+
+//------------------------------
+// One headless game of a candidate
+//------------------------------
+
+struct GameTask
+{
+  Pieces *mPieces;
+  EvalWeights mWeights;
+  unsigned int mSeed;
+  int mMaxPieces;
+  int mLines, mPlaced; // results
+};
+
+static void RunGame(void *pArg)
+{
+  GameTask *mTask = (GameTask *)pArg;
+  Board mBoard(mTask->mPieces, 0);
+  Game mGame(&mBoard, mTask->mPieces, NULL, 0);
+  mGame.Reset(mTask->mSeed);
+
+  mTask->mPlaced = 0;
+  while (mTask->mPlaced < mTask->mMaxPieces) {
+    Placement mBest;
+    if (!ChoosePlacement(mBoard, *mTask->mPieces, mGame.mPiece,
+                         mTask->mWeights, mBest))
+      break;
+
+    mGame.mPosX = mBest.mX;
+    mGame.mPosY = mBest.mY;
+    mGame.mRotation = mBest.mRotation;
+    mTask->mPlaced++;
+    if (mGame.LockPiece())
+      break;
+  }
+  mTask->mLines = mGame.GetLines();
+}
+
+//------------------------------
+// CMA-ES state, maximizing the fitness. The search distribution is the
+// normal distribution N(mMean, mSigma^2 mC)
+//------------------------------
+
+struct Cma
+{
+  int mGeneration;
+  double mSigma;
+  double mMean[TUNER_WEIGHTS];
+  double mPs[TUNER_WEIGHTS], mPc[TUNER_WEIGHTS]; // evolution paths
+  double mC[TUNER_WEIGHTS][TUNER_WEIGHTS];
+  double mBest[TUNER_WEIGHTS], mBestFitness;
+  std::mt19937 mRandom;
+};
+
+// Settings the games of a generation depend on, a checkpoint resumes only
+// under the same ones
+struct Settings
+{
+  unsigned int mSeed;
+  int mGames, mPopulation, mMaxPieces;
+};
+
+// Eigen decomposition of the symmetric pA = pB diag(pD) pB^T by Jacobi
+// rotations
+static void Eigen(const double pA[TUNER_WEIGHTS][TUNER_WEIGHTS],
+                  double pB[TUNER_WEIGHTS][TUNER_WEIGHTS],
+                  double pD[TUNER_WEIGHTS])
+{
+  const int n = TUNER_WEIGHTS;
+  double a[TUNER_WEIGHTS][TUNER_WEIGHTS];
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++) {
+      a[i][j] = pA[i][j];
+      pB[i][j] = i == j;
+    }
+
+  for (int mSweep = 0; mSweep < 64; mSweep++) {
+    double mOff = 0;
+    for (int i = 0; i < n; i++)
+      for (int j = i + 1; j < n; j++)
+        mOff += a[i][j] * a[i][j];
+    if (mOff < 1e-30)
+      break;
+
+    for (int p = 0; p < n; p++)
+      for (int q = p + 1; q < n; q++) {
+        if (fabs(a[p][q]) < 1e-300)
+          continue;
+        double mTheta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+        double t = (mTheta >= 0 ? 1 : -1) /
+                   (fabs(mTheta) + sqrt(mTheta * mTheta + 1));
+        double c = 1 / sqrt(t * t + 1), s = t * c;
+
+        for (int k = 0; k < n; k++) {
+          double mKp = a[k][p], mKq = a[k][q];
+          a[k][p] = c * mKp - s * mKq;
+          a[k][q] = s * mKp + c * mKq;
+        }
+        for (int k = 0; k < n; k++) {
+          double mPk = a[p][k], mQk = a[q][k];
+          a[p][k] = c * mPk - s * mQk;
+          a[q][k] = s * mPk + c * mQk;
+        }
+        for (int k = 0; k < n; k++) {
+          double mKp = pB[k][p], mKq = pB[k][q];
+          pB[k][p] = c * mKp - s * mKq;
+          pB[k][q] = s * mKp + c * mKq;
+        }
+      }
+  }
+
+  for (int i = 0; i < n; i++)
+    pD[i] = a[i][i];
+}
+
+//------------------------------
+// Checkpoints, written to a temporary file and renamed so a killed run
+// always leaves a whole one
+//------------------------------
+
+static bool SaveCheckpoint(const char *pPath, const Settings &pSettings,
+                           const Cma &pCma)
+{
+  std::string mTemp = std::string(pPath) + ".tmp";
+  std::ofstream mOut(mTemp.c_str());
+  mOut.precision(17);
+  mOut << "tuner " << TUNER_WEIGHTS << "\n";
+  mOut << "settings " << pSettings.mSeed << " " << pSettings.mGames << " "
+       << pSettings.mPopulation << " " << pSettings.mMaxPieces << "\n";
+  mOut << "generation " << pCma.mGeneration << "\n";
+  mOut << "sigma " << pCma.mSigma << "\n";
+  mOut << "mean";
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    mOut << " " << pCma.mMean[i];
+  mOut << "\nps";
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    mOut << " " << pCma.mPs[i];
+  mOut << "\npc";
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    mOut << " " << pCma.mPc[i];
+  mOut << "\nc";
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    for (int j = 0; j < TUNER_WEIGHTS; j++)
+      mOut << " " << pCma.mC[i][j];
+  mOut << "\nbest " << pCma.mBestFitness;
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    mOut << " " << pCma.mBest[i];
+  mOut << "\nrandom " << pCma.mRandom << "\n";
+  mOut.close();
+
+  return mOut && rename(mTemp.c_str(), pPath) == 0;
+}
+
+// Loads the checkpoint at pPath, telling on stderr why it can't be resumed
+// when it doesn't parse or was saved under other settings
+static bool LoadCheckpoint(const char *pPath, const Settings &pSettings,
+                           Cma &pCma)
+{
+  std::ifstream mIn(pPath);
+  std::string mKey;
+  int mWeights;
+  if (!(mIn >> mKey >> mWeights) || mKey != "tuner" ||
+      mWeights != TUNER_WEIGHTS) {
+    fprintf(stderr, "%s isn't a checkpoint of %d weights\n", pPath,
+            TUNER_WEIGHTS);
+    return false;
+  }
+
+  Settings mSaved;
+  if (!(mIn >> mKey >> mSaved.mSeed >> mSaved.mGames >> mSaved.mPopulation >>
+        mSaved.mMaxPieces) || mKey != "settings") {
+    fprintf(stderr, "%s has no settings line\n", pPath);
+    return false;
+  }
+  if (mSaved.mSeed != pSettings.mSeed || mSaved.mGames != pSettings.mGames ||
+      mSaved.mPopulation != pSettings.mPopulation ||
+      mSaved.mMaxPieces != pSettings.mMaxPieces) {
+    fprintf(stderr,
+            "%s was saved with --seed %u --games %d --population %d "
+            "--max-pieces %d\n",
+            pPath, mSaved.mSeed, mSaved.mGames, mSaved.mPopulation,
+            mSaved.mMaxPieces);
+    return false;
+  }
+
+  mIn >> mKey >> pCma.mGeneration >> mKey >> pCma.mSigma >> mKey;
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    mIn >> pCma.mMean[i];
+  mIn >> mKey;
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    mIn >> pCma.mPs[i];
+  mIn >> mKey;
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    mIn >> pCma.mPc[i];
+  mIn >> mKey;
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    for (int j = 0; j < TUNER_WEIGHTS; j++)
+      mIn >> pCma.mC[i][j];
+  mIn >> mKey >> pCma.mBestFitness;
+  for (int i = 0; i < TUNER_WEIGHTS; i++)
+    mIn >> pCma.mBest[i];
+  mIn >> mKey >> pCma.mRandom;
+  if (mIn.fail()) {
+    fprintf(stderr, "%s is cut short or damaged\n", pPath);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  // "--generations N" generations to run, "--population L" candidates per
+  // generation, "--games G" games per candidate, "--max-pieces P" pieces
+  // before a game is stopped, "--sigma S" initial step size, "--seed S"
+  // seed of the games and the search, "--threads T" workers,
+  // "--checkpoint FILE" resume from and save to FILE, "--pieces FILE"
+  int mGenerations = 50;
+  int mPopulation = 12;
+  int mGames = 16;
+  int mMaxPieces = 500;
+  double mInitialSigma = 0.2;
+  unsigned int mSeed = 1;
+  int mThreads = std::thread::hardware_concurrency();
+  const char *mCheckpoint = NULL;
+  Pieces mPieces;
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--generations") == 0)
+      mGenerations = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--population") == 0)
+      mPopulation = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--games") == 0)
+      mGames = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--max-pieces") == 0)
+      mMaxPieces = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--sigma") == 0)
+      mInitialSigma = atof(argv[i + 1]);
+    if (strcmp(argv[i], "--seed") == 0)
+      mSeed = strtoul(argv[i + 1], NULL, 10);
+    if (strcmp(argv[i], "--threads") == 0)
+      mThreads = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--checkpoint") == 0)
+      mCheckpoint = argv[i + 1];
+    if (strcmp(argv[i], "--pieces") == 0 && !mPieces.LoadFromFile(argv[i + 1])) {
+      fprintf(stderr, "couldn't load pieces from %s\n", argv[i + 1]);
+      return 1;
+    }
+  }
+  if (mPopulation < 4)
+    mPopulation = 4;
+  if (mGames < 1)
+    mGames = 1;
+  if (mThreads < 1)
+    mThreads = 1;
+
+  // Strategy parameters, the defaults of Hansen's tutorial
+  const int n = TUNER_WEIGHTS;
+  int mMu = mPopulation / 2;
+  std::vector<double> mRecombination(mMu);
+  double mSum = 0, mSumSquares = 0;
+  for (int i = 0; i < mMu; i++) {
+    mRecombination[i] = log(mMu + 0.5) - log(i + 1.0);
+    mSum += mRecombination[i];
+  }
+  for (int i = 0; i < mMu; i++) {
+    mRecombination[i] /= mSum;
+    mSumSquares += mRecombination[i] * mRecombination[i];
+  }
+  double mMuEff = 1 / mSumSquares;
+  double mCs = (mMuEff + 2) / (n + mMuEff + 5);
+  double mDs = 1 + 2 * std::max(0.0, sqrt((mMuEff - 1) / (n + 1)) - 1) + mCs;
+  double mCc = (4 + mMuEff / n) / (n + 4 + 2 * mMuEff / n);
+  double mC1 = 2 / ((n + 1.3) * (n + 1.3) + mMuEff);
+  double mCmu = std::min(1 - mC1, 2 * (mMuEff - 2 + 1 / mMuEff) /
+                                      ((n + 2) * (n + 2) + mMuEff));
+  double mChiN = sqrt((double)n) * (1 - 1.0 / (4 * n) + 1.0 / (21 * n * n));
+
+  // Start from the default weights, or from the checkpoint when there is
+  // one. A checkpoint that can't be resumed stops the run rather than be
+  // overwritten by a fresh start
+  Settings mSettings = {mSeed, mGames, mPopulation, mMaxPieces};
+  Cma mCma;
+  bool mResume = mCheckpoint != NULL && std::ifstream(mCheckpoint).good();
+  if (mResume && !LoadCheckpoint(mCheckpoint, mSettings, mCma))
+    return 1;
+  if (!mResume) {
+    EvalWeights mDefaults;
+    double mStart[TUNER_WEIGHTS] = {mDefaults.mHeight, mDefaults.mHoles,
+                                    mDefaults.mBumpiness, mDefaults.mWells,
+                                    mDefaults.mLines};
+    mCma.mGeneration = 0;
+    mCma.mSigma = mInitialSigma;
+    for (int i = 0; i < n; i++) {
+      mCma.mMean[i] = mCma.mBest[i] = mStart[i];
+      mCma.mPs[i] = mCma.mPc[i] = 0;
+      for (int j = 0; j < n; j++)
+        mCma.mC[i][j] = i == j;
+    }
+    mCma.mBestFitness = -1;
+    mCma.mRandom.seed(mSeed);
+  } else
+    printf("resuming %s at generation %d\n", mCheckpoint, mCma.mGeneration);
+
+  ThreadPool mPool(mThreads);
+  std::vector<std::vector<double> > mX(mPopulation, std::vector<double>(n));
+  std::vector<GameTask> mTasks(mPopulation * mGames);
+  std::vector<double> mFitness(mPopulation);
+  std::vector<int> mOrder(mPopulation);
+  std::normal_distribution<double> mNormal;
+
+  printf("%-5s %10s %10s %9s %10s %12s\n", "gen", "best", "mean", "sigma",
+         "cand/s", "pieces/s");
+
+  for (int mEnd = mCma.mGeneration + mGenerations; mCma.mGeneration < mEnd;) {
+    std::chrono::steady_clock::time_point mStart =
+        std::chrono::steady_clock::now();
+
+    double mB[TUNER_WEIGHTS][TUNER_WEIGHTS], mD[TUNER_WEIGHTS];
+    Eigen(mCma.mC, mB, mD);
+    for (int i = 0; i < n; i++)
+      mD[i] = sqrt(std::max(mD[i], 1e-20));
+
+    // Sample the candidates, x = m + sigma B D z. The distribution keeps a
+    // spare sample that the checkpoint doesn't hold, every generation
+    // starts without one so a resumed run draws what an unbroken one does
+    mNormal.reset();
+    for (int k = 0; k < mPopulation; k++) {
+      double z[TUNER_WEIGHTS];
+      for (int i = 0; i < n; i++)
+        z[i] = mD[i] * mNormal(mCma.mRandom);
+      for (int i = 0; i < n; i++) {
+        double y = 0;
+        for (int j = 0; j < n; j++)
+          y += mB[i][j] * z[j];
+        mX[k][i] = mCma.mMean[i] + mCma.mSigma * y;
+      }
+    }
+
+    // Every candidate plays the same games, common random numbers keep the
+    // noise of the seeds out of the comparison
+    TaskGroup mGroup;
+    for (int k = 0; k < mPopulation; k++)
+      for (int g = 0; g < mGames; g++) {
+        GameTask &mTask = mTasks[k * mGames + g];
+        mTask.mPieces = &mPieces;
+        ToWeights(&mX[k][0], mTask.mWeights);
+        mTask.mSeed = mSeed + mCma.mGeneration * mGames + g;
+        mTask.mMaxPieces = mMaxPieces;
+        mPool.Submit(mGroup, RunGame, &mTask);
+      }
+    mPool.Wait(mGroup);
+
+    unsigned long long mPlaced = 0;
+    for (int k = 0; k < mPopulation; k++) {
+      int mLines = 0;
+      for (int g = 0; g < mGames; g++) {
+        mLines += mTasks[k * mGames + g].mLines;
+        mPlaced += mTasks[k * mGames + g].mPlaced;
+      }
+      mFitness[k] = (double)mLines / mGames;
+      mOrder[k] = k;
+    }
+    for (int i = 1; i < mPopulation; i++)
+      for (int j = i; j > 0 && mFitness[mOrder[j]] > mFitness[mOrder[j - 1]]; j--)
+        std::swap(mOrder[j], mOrder[j - 1]);
+
+    if (mFitness[mOrder[0]] > mCma.mBestFitness) {
+      mCma.mBestFitness = mFitness[mOrder[0]];
+      for (int i = 0; i < n; i++)
+        mCma.mBest[i] = mX[mOrder[0]][i];
+    }
+
+    // Move the mean to the weighted best half
+    double mOld[TUNER_WEIGHTS], mStep[TUNER_WEIGHTS];
+    for (int i = 0; i < n; i++) {
+      mOld[i] = mCma.mMean[i];
+      mCma.mMean[i] = 0;
+      for (int k = 0; k < mMu; k++)
+        mCma.mMean[i] += mRecombination[k] * mX[mOrder[k]][i];
+      mStep[i] = (mCma.mMean[i] - mOld[i]) / mCma.mSigma;
+    }
+
+    // Step size path, with C^-1/2 = B D^-1 B^T
+    double mWhite[TUNER_WEIGHTS], mNormPs = 0;
+    for (int i = 0; i < n; i++) {
+      mWhite[i] = 0;
+      for (int j = 0; j < n; j++)
+        mWhite[i] += mB[j][i] * mStep[j];
+      mWhite[i] /= mD[i];
+    }
+    for (int i = 0; i < n; i++) {
+      double mInvSqrt = 0;
+      for (int j = 0; j < n; j++)
+        mInvSqrt += mB[i][j] * mWhite[j];
+      mCma.mPs[i] = (1 - mCs) * mCma.mPs[i] +
+                    sqrt(mCs * (2 - mCs) * mMuEff) * mInvSqrt;
+      mNormPs += mCma.mPs[i] * mCma.mPs[i];
+    }
+    mNormPs = sqrt(mNormPs);
+
+    // Covariance path and rank-one plus rank-mu update
+    bool mHsig = mNormPs / sqrt(1 - pow(1 - mCs, 2.0 * (mCma.mGeneration + 1))) /
+                     mChiN <
+                 1.4 + 2.0 / (n + 1);
+    for (int i = 0; i < n; i++)
+      mCma.mPc[i] = (1 - mCc) * mCma.mPc[i] +
+                    (mHsig ? sqrt(mCc * (2 - mCc) * mMuEff) * mStep[i] : 0);
+
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++) {
+        double mRankMu = 0;
+        for (int k = 0; k < mMu; k++)
+          mRankMu += mRecombination[k] * (mX[mOrder[k]][i] - mOld[i]) *
+                     (mX[mOrder[k]][j] - mOld[j]) /
+                     (mCma.mSigma * mCma.mSigma);
+        mCma.mC[i][j] =
+            (1 - mC1 - mCmu) * mCma.mC[i][j] +
+            mC1 * (mCma.mPc[i] * mCma.mPc[j] +
+                   (mHsig ? 0 : mCc * (2 - mCc) * mCma.mC[i][j])) +
+            mCmu * mRankMu;
+      }
+
+    mCma.mSigma *= exp((mCs / mDs) * (mNormPs / mChiN - 1));
+    mCma.mGeneration++;
+
+    double mSeconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - mStart)
+                          .count();
+    double mMeanFitness = 0;
+    for (int k = 0; k < mPopulation; k++)
+      mMeanFitness += mFitness[k] / mPopulation;
+    printf("%-5d %10.1f %10.1f %9.4f %10.1f %12.0f\n", mCma.mGeneration,
+           mFitness[mOrder[0]], mMeanFitness, mCma.mSigma,
+           mPopulation / mSeconds, mPlaced / mSeconds);
+    fflush(stdout);
+
+    if (mCheckpoint != NULL && !SaveCheckpoint(mCheckpoint, mSettings, mCma))
+      fprintf(stderr, "couldn't write checkpoint %s\n", mCheckpoint);
+  }
+
+  printf("best %.1f lines per game\n", mCma.mBestFitness);
+  printf("height %.6f holes %.6f bumpiness %.6f wells %.6f lines %.6f\n",
+         mCma.mBest[0], mCma.mBest[1], mCma.mBest[2], mCma.mBest[3],
+         mCma.mBest[4]);
+  return 0;
+}